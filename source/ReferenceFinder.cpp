@@ -1 +1,9750 @@
-/******************************************************************************	ReferenceFinder - a program for finding compact folding sequences for locating 	approximate reference points on a unit square.		Version 3.1		Copyright 1999-2003 by Robert J. Lang. All rights reserved.		Rights of usage: you may compile this code and modifications thereof for your 	own personal use. You may not redistribute this code or modifications thereof.		ReferenceFinder is ANSI C++ code that should compile for any compiler/platform	that supports the C++ standard library.		After the program initializes, the user is prompted for x and y coordinates of	a desired point or line. The program responds with several folding sequences based on 	lines and marks made by folding (no measuring).		See file "README.txt" for version history and compilation notes.******************************************************************************/ #include "ReferenceFinder.h"#include <fstream>#include <sstream>#include <limits>#include <algorithm>#include <iomanip>using namespace std;// #define NO_CONSOLE to suppress all console functions (e.g., for a standalone module)// other than in class ConsoleTextDgmr, which is expressly designed for console output./*******	static member initialization -- variables that you might want to change (because they*	alter the behavior of the program) are defined here. Other static member variables are *	defined lower down in their respective sections.******/// Maximum rank and number of marks and lines to collect. These can be tweaked // up or down to trade off accuracy versus memory and initialization time.RefBase::rank_t ReferenceFinder::maxRank = 6;size_t ReferenceFinder::maxLines = 249323;size_t ReferenceFinder::maxMarks = 300000;// constants that quantify the discretization of marks and lines in forming keys.// The maximum key has the value (xNum * yNum) for marks, (aNum * dNum) for lines.// These numbers set a limit on the accuracy, since we won't create more than one// object for a given key.int RefMark::xNum = 2000;int RefMark::yNum = 2000;int RefLine::aNum = 2000;int RefLine::dNum = 2000;	// Defines "good enough" for a mark. For marks with errors better than this, we give// priority to lower-rank marks.double ReferenceFinder::maxError = .005;// Minimum allowable aspect ratio for a flap. Too skinny of a flap can't be folded// accurately.double ReferenceFinder::minAspectRatio = 0.100;// Sine of minimum intersection angle between creases that define a new mark. If// the lines are close to parallel, the mark is imprecise.double ReferenceFinder::minAngleSine = 0.342;	// = sin(20 degrees)// If visibilityMatters == true, we don't construct alignments that can't be made// with opaque paper. Otherwise, we allow alignments that can be done with // translucent paper.bool ReferenceFinder::visibilityMatters = true;// If clarifyVerbalAmbiguities == true, then verbal instructions that could be ambigious// because there are multiples solutions are clarified with additional information.// This is turned on and off by clients using RefBase::SetClarifyVerbalAmbiguities().bool RefBase::clarifyVerbalAmbiguities = true;// If axiomsInVerbalDirections == true, we list the axiom number at the beginning of// each verbal direction. This is turned on/off by clients using // RefBase::SetAxiomsInVerbalDirections().bool RefBase::axiomsInVerbalDirections = true;		// These are switches by which we can turn on and off the use of different types// of alignments. Default is to use all possible.bool RefLine_C2P_C2P::include = true;bool RefLine_P2P::include = true;bool RefLine_L2L::include = true;bool RefLine_L2L_C2P::include = true;bool RefLine_P2L_C2P::include = true;bool RefLine_P2L_P2L::include = true;bool RefLine_L2L_P2L::include = true;// We make a call to our show progress callback routine every maxTries attempts.int ReferenceFinder::maxTries = 200000;// Letters that are used for labels for marks and lines.char RefLine::mLabels[] = "ABCDEFGHIJ";char RefMark::mLabels[] = "PQRSTUVWXYZ";// Use unit square paperPaper RefBase::paper(1.0, 1.0);/********************************************************************************	Section 1: lightweight classes that represent points and lines*******************************************************************************//************	XYPt - a 2-vector that represents a point or 2-vector (direction vector).*	It is a lightweight mathematical object. Most operations are defined in the*	header, intended to be inlined for speed.***********//*******	operator<<(ostream& os, const XYPt& p) - Stream I/O for a XYPt spits out the *	point as a parenthesis-enclosed, comma-delimited pair.******/ostream& operator<<(ostream& os, const XYPt& p){	return os << "(" << (p.x) << "," << (p.y) << ")";}/************	XYLine - a class for representing a line by a scalar d and the unit normal to the*	line, u, where the point d*u is the point on the line closest to the origin. *	Note that (d,u) and (-d,-u) represent the same line. If u isn't a unit vector,*	many things will break, so when in doubt, use Normalize() or NormalizeSelf().***********//*******	operator<<(ostream& os, const XYLine& l) - Stream I/O for a XYLine spits out the *	values of d and u as a parenthesis-enclosed, comma-delimited pair, e.g., "(0,(1,0))".******/ostream& operator<<(ostream& os, const XYLine& l){	return os << "(" << (l.d) << "," << (l.u) << ")";}/************	XYRect - a class for representing rectangles by two points, the bottom left and*	top right corners.***********//*******	XYRect::GetAspectRatio() - return the aspect ratio of the rectangle, defined to be*	the smaller dimension divided by the larger dimension. If it's empty, return zero.*	If the rectangles is improperly defined, the aspect ratio may be negative.******/const double XYRect::GetAspectRatio() const{	double wd = GetWidth();	double ht = GetHeight();	if (abs(wd) < EPS && abs(ht) < EPS) return 0;	if (abs(wd) <= abs(ht)) return wd / ht;	return ht / wd;}/*******	XYRect::Include(const XYPt& p) - expand the XYRect to include the point p.******/XYRect& XYRect::Include(const XYPt& p){	if (bl.x > p.x) bl.x = p.x;	if (bl.y > p.y) bl.y = p.y;	if (tr.x < p.x) tr.x = p.x;	if (tr.y < p.y) tr.y = p.y;	return *this;}/*******	BoundingBox(const XYPt& p1, const XYPt& p2) - return an XYRect that includes both points.******/const XYRect BoundingBox(const XYPt& p1, const XYPt& p2){	XYRect r(p1);	return r.Include(p2);}/*******	BoundingBox(const XYPt& p1, const XYPt& p2, const XYPt& p3) - return an XYRect that*	includes all three points.******/const XYRect BoundingBox(const XYPt& p1, const XYPt& p2, const XYPt& p3){	XYRect r(p1);	return r.Include(p2).Include(p3);}/*******	operator<<(ostream& os, const XYRect& r) - Stream I/O for a XYRect spits out the *	values of bl and tr as a parenthesis-enclosed, comma-delimited pair, *	e.g., "((0,0),(1,1))".******/ostream& operator<<(ostream& os, const XYRect& r){	return os << "(" << (r.bl) << "," << (r.tr) << ")";}/********************************************************************************	Section 2: classes that represent reference marks and lines on a piece of paper*******************************************************************************//************	Paper - specialization of XYRect, used for representing the paper***********//*	Note: don't screw around with the order of Paper's member variables because	we rely on that order for constructor initialization. *//*******	Paper(double aWidth, double aHeight) - constructor sets the values of several*	other member variables that are useful to have around.******/Paper::Paper(double aWidth, double aHeight) : 	XYRect(0, 0, aWidth, aHeight), 	pWidth(aWidth), pHeight(aHeight),	botLeft(0, 0),	botRight(aWidth, 0),	topLeft(0, aHeight),	topRight(aWidth, aHeight),	topEdge(topLeft, topRight),	leftEdge(botLeft, topLeft),	rightEdge(botRight, topRight),	bottomEdge(botLeft, botRight),	upwardDiagonal(botLeft, topRight),	downwardDiagonal(topLeft, botRight){}/*******	Paper::ClipLine(const XYLine& al, XYPt& ap1, XYPt& ap2) - clip the line al to the paper,*	returning the endpoints of the clipped segment in ap1 and ap2. If the line misses the*	paper entirely, return false and leave ap1 and ap2 unchanged.******/const bool Paper::ClipLine(const XYLine& al, XYPt& ap1, XYPt& ap2) const{	// Start by collecting all points of intersection between the line and the	// four sides of the paper.		unsigned npts = 0;			// counter for number of points of intersection	XYPt ipts[4];				// list of points of intersection	XYPt p;						// a scratch pad for intersection points		if (topEdge.Intersects(al, p) && Encloses(p)) ipts[npts++] = p;	if (leftEdge.Intersects(al, p) && Encloses(p)) ipts[npts++] = p;	if (rightEdge.Intersects(al, p) && Encloses(p)) ipts[npts++] = p;	if (bottomEdge.Intersects(al, p) && Encloses(p)) ipts[npts++] = p;		if (npts == 0) return false;	// line entirely misses the paper	// Now parameterize all four points along the line, recording the minimum	// and maximum parameter values.		XYPt pt = al.d * al.u;					// a point on the line	XYPt up = al.u.Rotate90();				// a tangent to the line	double tmin =( ipts[0] - pt).Dot(up);	double tmax = tmin;	for (unsigned i = 1; i < npts; i++) {		double tt = (ipts[i] - pt).Dot(up);		if (tmin < tt) tmin = tt;		if (tmax > tt) tmax = tt;	};		// Compute the endpoints from our parameter ranges.		ap1 = pt + tmin * up;	ap2 = pt + tmax * up;	return true;}/*******	Paper::InteriorOverlaps(const XYLine& al) - return true if line al overlaps *	the paper in its interior. Return false if the line misses the paper entirely,*	only hits a corner, or only runs along an edge.******/const bool Paper::InteriorOverlaps(const XYLine& al) const{	XYPt pa, pb;								// endpoints of the fold line	if (!ClipLine(al, pa, pb)) return false;	// the line completely misses the paper		if (pa == pb) return false;					// line hits at a single point (a corner)		if (!BoundingBox(pa, pb).IsEmpty()) return true;	// bounding box has positive volume		// If still here, then the bounding box must be a line, either the edge of the paper	// or a vertical or horizontal line in the interior. We can test for the latter by 	// seeing if the midpoint of the line lies fully in the interior of the paper.		XYPt mp = MidPoint(pa, pb);		if (topEdge.Intersects(mp) || bottomEdge.Intersects(mp) || 		leftEdge.Intersects(mp) || rightEdge.Intersects(mp)) return false;		return true;}/*******	Paper::MakesSkinnyFlap(const XYLine& al) - The line al divides the paper into two*	portions. Return true if either of the two qualifies as a skinny flap. "Skinny" means*	a triangle (or quad) whose aspect ratio falls below a minimum size.******/const bool Paper::MakesSkinnyFlap(const XYLine& al) const	{	// Since "true" = "bad", we'll return true for any failures along the way due to bad	// input parameters.		XYPt p1, p2;						// endpoints of the line al	ClipLine(al, p1, p2);				// get the endpoints of the fold line on the paper		XYLine lb;							// perpendicular bisector of line segment p1-p2	lb.u = al.u.Rotate90();	lb.d = MidPoint(p1, p2).Dot(lb.u);	XYPt bp1, bp2;						// endpoints of the bisector	ClipLine(lb, bp1, bp2);				// get the endpoints of the bisector		// Get the bounding box that contains the fold line and a point on either side of the	// fold line. If this bounding box is below the minimum aspect ratio, then it contains	// a flap that falls below the minimum aspect ratio, so we return true.	if (abs(BoundingBox(p1, p2, bp1).GetAspectRatio()) < ReferenceFinder::minAspectRatio) 		return true;	if (abs(BoundingBox(p1, p2, bp2).GetAspectRatio()) < ReferenceFinder::minAspectRatio) 		return true;		// If we're still here, we didn't create any skinny flaps, so we're cool.		return false;}/************	class RefBase - base class for a mark or line. Non-static member variables are:*	mRank - the rank, which is the number of creases that need to be made to define it.*	mKey - a unique key that is used to efficiently store and search over marks and lines.*	mKey is initialized to 0. If the object has been successfully constructed, it will be set*	to an integer greater than 0, so mKey==0 is used as a test for successful construction.*	mIndex - a counter used in constructing the verbal sequence; basically, it's the order in*		which the object is created for a given folding sequence.**	Any subclasses of RefBase should be fairly lightweight because we'll be creating a couple *	hundred thousand of them during program initialization.***********//*******	RefBase static member initialization******/RefDgmr* RefBase::mDgmr;vector<RefBase*> RefBase::mSequence;vector<RefBase::DgmInfo> RefBase::mDgms;/*	Notes on Sequences.	A ref (RefMark or RefLine) is typically defined in terms of other refs, going all the way	back to RefMark_Original and RefLine_Original. The routine aRef->BuildAndNumberSequence()	constructs an ordered list of all the refs that make up aRef. The ordering is such that	ancestor refs come earlier in the list than refs derived from them. In addition to	constructing the list, BuildAndNumberSequence also sets the mIndex variable of each non-	original ref, so that each can be given a unique name (which depends on the index, and is	a letter, A-J for lines, P-Z for points).		This numbering scheme means that there can only be one sequence in existence at a time.	To insure this, the sequence is constructed in the static RefBase member variable mSequence,	which is public, so you can (if you like) read out this sequence.*//*******	RefBase::SequencePushSelf() - appends to the end of mSequence pointers to all the *	marks and lines needed to create this mark or line. Default behavior *	is to append a pointer to self.*	A subclass line or mark made from others should call SequencePushUnique() for each of *	the elements that define it, and then call the RefBase method for itself.******/void RefBase::SequencePushSelf(){	SequencePushUnique(this);}/*******	RefBase::BuildAndNumberSequence() - build a sequence (in mSequence) of all of the*	references that are needed to define this one; also set mIndex for each reference so*	that the relevant RefMarks and RefLines are sequentially numbered.******/void RefBase::BuildAndNumberSequence(){	// Clear out the old sequence		mSequence.clear();		// Build the sequence of marks and lines that go into making this object.	SequencePushSelf();			// Reset the counters for both marks and lines.		RefMark::ResetCount();	RefLine::ResetCount();	// go through the list of constituents and give every object a sequential index.		for (size_t i = 0; i < mSequence.size(); i++) mSequence[i]->SetIndex();}/*******	RefBase::SetClarifyVerbalAmbiguities(const bool f) - sets a flag; if true, then verbally*	ambiguous howto information includes extra info that resolves the ambiguity. Typically*	this will be true for text-only instruction, false for diagrammatic instruction.******/void RefBase::SetClarifyVerbalAmbiguities(const bool f){	clarifyVerbalAmbiguities = f;}/*******	RefBase::SetAxiomsInVerbalDirections(const bool f) - sets a flag; if true, then verbal*	directions will contain the axiom number.******/void RefBase::SetAxiomsInVerbalDirections(const bool f){	axiomsInVerbalDirections = f;}/*******	RefBase::PutHowto(ostream& os) - puts a statement about how to make this mark from its *	constituents to a stream. Overridden by most subclasses. Return true if we actually*	put something (original types will return false).******/const bool RefBase::PutHowto(ostream& /* os */) const{	return false;}/*******	RefBase::PutHowtoSequence(ostream& os) - sends the full how-to sequence to the given stream.******/ostream& RefBase::PutHowtoSequence(ostream& os){	// Build and number the sequence of marks and lines that go into making this object.	BuildAndNumberSequence();			// go through the sequence of references and print how to make the given mark or line.		for (size_t i = 0; i < mSequence.size(); i++)		if (mSequence[i]->PutHowto(os)) os << "." << endl;	return os;}		/*	Notes on diagrams.	A DgmInfo is a very simple object that contains just a couple of bits of information 	necessary to construct a complete diagram from the list of refs contained	in mSequence. Any diagram is a subsequence of mSequence, which, in effect, describes	all the refs that are already on the paper as well as the ref(s) currently being made. 		DgmInfo.idef is the index of the first ref in mSequence that is defined in the current	diagram.		DgmInfo.iact is the index of the last ref that is defined in the current diagram, 	which is the action line, if this diagram includes an action line. idef <= iact.*//*******	RefBase::BuildDiagrams() - Build a set of diagrams that describe how to fold this reference,*	by constructing a list of DgmInfo records (which refer to elements and subsequences of*	mSequence).******/void RefBase::BuildDiagrams(){	// Clear out the old set of diagrams		mDgms.clear();		// First, we need to build a sequence of all references that go into making this one.		BuildAndNumberSequence();		// Now, we need to note which elements of the sequence are action lines; there will be	// a diagram for each one of these.		size_t ss = mSequence.size();	for (size_t i = 0; i < ss; i++)		if (mSequence[i]->IsActionLine()) mDgms.push_back(DgmInfo(i, i));			// We should always have at least one diagram, even if there was only one ref in mSequence	// (which happens if the ref was a RefMark_Original or RefLine_Original).		if (mDgms.size() == 0) mDgms.push_back(DgmInfo(0, 0));		// And we make sure we have a diagram for the last ref in the sequence (which might not	// be the case if we ended with a RefMark or an original).		if (mDgms[mDgms.size() - 1].iact < ss - 1) mDgms.push_back(DgmInfo(0, ss - 1));		// Now we go through and set the idef fields of each DgmInfo record.		int id = 0;	for (size_t i = 0; i < mDgms.size(); i++) {		mDgms[i].idef = id;		id = mDgms[i].iact + 1;	}}/*******	RefBase::DrawPaper() - Draw the paper******/void RefBase::DrawPaper(){	vector<XYPt> corners;	corners.push_back(paper.botLeft);	corners.push_back(paper.botRight);	corners.push_back(paper.topRight);	corners.push_back(paper.topLeft);	mDgmr->DrawPoly(corners, RefDgmr::whitePoly);}/*******	RefBase::DrawDiagram(RefDgmr& aDgmr, const DgmInfo& aDgm) - draw the given diagram*	using the RefDgmr aDgmr.******/void RefBase::DrawDiagram(RefDgmr& aDgmr, const DgmInfo& aDgm){	// Set the current RefDgmr to be aDgmr.		mDgmr = &aDgmr;		// always draw the paper		DrawPaper();		// Make a note of the action line ref		RefBase* ral = mSequence[aDgm.iact];		// draw all refs specified by the DgmInfo. Most get drawn in normal style.	// The ref that is the action line (and all subsequent refs) get drawn in action style.	// Any refs that are used immediately by the action line get drawn in hilite style.	// Drawing for each diagram is done in multiple passes so that, for examples, labels end	// up on top of everything else.		for (short ipass = 0; ipass < maxPasses; ipass++) {		for (size_t i = 0; i < aDgm.iact; i++) {			RefBase* rb = mSequence[i];			if ((i >= aDgm.idef && rb->IsDerived()) || ral->UsesImmediate(rb)) 				rb->DrawSelf(hiliteRef, ipass);			else rb->DrawSelf(normalRef, ipass);		};		mSequence[aDgm.iact]->DrawSelf(actionRef, ipass);	}}/*******	RefBase::PutDiagramCaption(std::ostream& os, const DGMInfo& aDgm) - Put the caption to*	a particular diagram to a stream. The caption consists of how-to for those refs that*	are part of the action. The output is created as a single string containing possibly*	multiple sentences.******/void RefBase::PutDiagramCaption(std::ostream& os, const DgmInfo& aDgm){	for (size_t i = aDgm.idef; i <= aDgm.iact; i++) {		mSequence[i]->PutHowto(os);		os << ". ";	}}/*******	RefBase::UsesImmediate(RefBase* rb) - return true if this mark or line uses rb for *	immediate reference. "Immediate" means that if A uses B and B uses C, A->UsesImmediate(B)*	returns true but A->UsesImmediate(C) returns false. Default returns false; this will*	be used by original marks and lines.******/const bool RefBase::UsesImmediate(RefBase* /* rb */) const{	return false;}/*******	RefBase::IsDerived() -return true if this is a derived (rather than an original) mark*	or line. Note that this is not the same as mRank!=0, because the diagonals have mRank==1*	but are still considered original. Default is true since most objects will be derived.******/const bool RefBase::IsDerived() const{	return true;}/*******	RefBase::SequencePushUnique(RefBase* rb) - *	Utility used by subclasses when they implement SequencePushSelf(). This insures*	that a given mark only gets a single label.******/void RefBase::SequencePushUnique(RefBase* rb){	if (find(mSequence.begin(), mSequence.end(), rb) == mSequence.end()) mSequence.push_back(rb);}/************	RefMark - base class for a mark on the paper. ***********//*******	RefMark static member initialization******/RefBase::index_t RefMark::mCount = 0;		// Initialize class index/*******	RefMark::FinishConstructor() - Calculate the key value used for distinguishing RefMarks.*	This should be called at the end of every constructor if the mark is valid (and not*	if it isn't).******/void RefMark::FinishConstructor() {	const double fx = p.x / RefBase::paper.pWidth;	// fx is between 0 and 1	const double fy = p.y / RefBase::paper.pHeight;	// fy is between 0 and 1	key_t nx = static_cast<key_t> (floor(0.5 + fx * xNum));	key_t ny = static_cast<key_t> (floor(0.5 + fy * yNum));	mKey = 1 + nx * yNum + ny;}/*******	Distance(const XYPt& ap) - return the distance to a point ap. This is used when sorting*	marks by their distance from a given mark.******/const double RefMark::Distance(const XYPt& ap) const { 	return (p - ap).Mag(); } /*******	RefMark::IsOnEdge() - return true if this mark is on the edge of the paper******/const bool RefMark::IsOnEdge() const{	return (RefBase::paper.leftEdge.Intersects(p) || 		RefBase::paper.rightEdge.Intersects(p) ||		RefBase::paper.topEdge.Intersects(p) || 		RefBase::paper.bottomEdge.Intersects(p));}/*******	RefMark::IsActionLine() - return false, since marks can never be actions******/const bool RefMark::IsActionLine() const{	return false;}/*******	RefMark::KeySizeOK() - return true if the key_t type is large enough to hold all*	possible keys.******/const bool RefMark::KeySizeOK(){	return (xNum < numeric_limits<key_t>::max() / yNum);}/*******	RefMark::GetLabel() - return the label for this mark.******/const char RefMark::GetLabel() const{	return mLabels[mIndex - 1];}/*******	RefMark::PutName(ostream& os) - put the name of this mark to a stream. Default*	behavior gives this mark a letter. Return true if we used a letter, false if something*	else (i.e., the name of a RefMark_Original).******/const bool RefMark::PutName(ostream& os) const{	os << "point " << GetLabel();	return true;}/*******	RefMark::PutDistanceAndRank(ostream& os, const XYPt& ap) - put the distance from this mark*	to point ap to a stream.******/void RefMark::PutDistanceAndRank(ostream& os, const XYPt& ap) const{	os.precision(4);	os.setf(ios_base::fixed, ios_base::floatfield);	os << "Solution " << p.Chop() << ": err = " << Distance(ap) << " (rank " << mRank << ") ";}				/*******	RefMark::DrawSelf(RefStyle rstyle, short ipass) - Draw a RefMark in the indicated style******/void RefMark::DrawSelf(RefStyle rstyle, short ipass) const{	switch(ipass) {		case pointPass:			{				switch(rstyle) {					case normalRef:						mDgmr->DrawPt(p, RefDgmr::normalPt);						break;					case hiliteRef:						mDgmr->DrawPt(p, RefDgmr::hilitePt);						break;					case actionRef:						mDgmr->DrawPt(p, RefDgmr::actionPt);						break;				}			};			break;					case labelPass:			{			string sm(1, GetLabel());			switch(rstyle) {				case normalRef:					// Normal points don't get labels drawn					break;				case hiliteRef:					mDgmr->DrawLabel(p, sm, RefDgmr::hiliteLabel);					break;				case actionRef:					mDgmr->DrawLabel(p, sm, RefDgmr::actionLabel);					break;			};			break;		}	}}/*******	RefMark::SetIndex() - Most types of RefMark use the default method, which gives the mark*	an index from the class variable mCount and then bumps up the class variable.******/void RefMark::SetIndex(){	mIndex = ++mCount;}/*******	RefMark::ResetCount() - reset the static class variable mCount to zero.******/void RefMark::ResetCount(){	mCount = 0;}/************	RefMark_Original - Specialization of RefMark that represents a named mark*	(e.g., a corner).***********//*******	RefMark_Original::RefMark_Original(const XYPt& ap, rank_t arank, string as) - Constructor.******/RefMark_Original::RefMark_Original(const XYPt& ap, rank_t arank, string as) : 	RefMark(ap, arank), s(as){	FinishConstructor();}/*******	RefMark_Original::GetLabel() - return the label for this mark.******/const char RefMark_Original::GetLabel() const{	return 0;	// originals get no labels}/*******	RefMark_Original::PutName(ostream& os) - Put the name of this mark to a stream. Override*	to put the string name (rather than a letter).******/const bool RefMark_Original::PutName(ostream& os) const{	os << s;	// return the string	return false;}/*******	RefMark_Original::DrawSelf(RefStyle rstyle, short ipass) - Draw this mark******/void RefMark_Original::DrawSelf(RefStyle rstyle, short ipass) const{	// Override the default because original marks don't get labels and are only drawn	// when they are hilited or action (in which case we still draw them hilited).	if ((ipass == pointPass) && (rstyle == hiliteRef || rstyle == actionRef)) 		mDgmr->DrawPt(p, RefDgmr::hilitePt);}	/*******	RefMark_Original::IsDerived() - return false, since this is original******/const bool RefMark_Original::IsDerived() const{	return false;}/*******	RefMark_Original::SetIndex() - overridden because we don't use an index for named marks.******/void RefMark_Original::SetIndex(){	mIndex = 0;};/************	RefMark_Intersection - Specialization of a RefMark for a mark defined by the *	intersection of 2 lines.***********//*******	RefMark_Intersection(RefLine* arl1, RefLine* arl2) - Constructor.******/RefMark_Intersection::RefMark_Intersection(RefLine* arl1, RefLine* arl2) : 	RefMark(CalcMarkRank(arl1, arl2)), rl1(arl1), rl2(arl2){	// Get references to constituent math types		const XYLine& l1 = rl1->l;	const XYPt& u1 = rl1->l.u;//	const double& d1 = rl1->l.d;	const XYLine& l2 = rl2->l;	const XYPt& u2 = rl2->l.u;//	const double& d2 = rl2->l.d;			// If the lines don't intersect, it's not a valid point. If they do,	// assign the intersection to the member variable p.		if (!l1.Intersects(l2, p)) return;		// If the intersection point falls outside the square, it's not valid.		if (!RefBase::paper.Encloses(p)) return;		// If the lines intersect at less than a 30 degree angle, we won't keep this 	// point because such intersections are imprecise to use as reference points.		if (abs(u1.Dot(u2.Rotate90())) < ReferenceFinder::minAngleSine) return;			FinishConstructor();}/*******	RefMark_Intersection::UsesImmediate(RefBase* rb) - return true if this mark uses rb for *	immediate reference.******/const bool RefMark_Intersection::UsesImmediate(RefBase* rb) const{	return (rb == rl1 || rb == rl2);}/*******	RefMark_Intersection::SequencePushSelf() - Build the folding sequence*	that constructs this object.******/void RefMark_Intersection::SequencePushSelf(){	rl1->SequencePushSelf();	rl2->SequencePushSelf();	RefBase::SequencePushSelf();}/*******	RefMark_Intersection::PutHowto(ostream& os) - put a description of how to construct*	this mark.******/const bool RefMark_Intersection::PutHowto(ostream& os) const{	os << "The intersection of ";	rl1->PutName(os);	os << " with ";	rl2->PutName(os);	os << " is ";	PutName(os);	if (clarifyVerbalAmbiguities) {		os.precision(4);		os.setf(ios_base::fixed, ios_base::floatfield);		os << " = " << p.Chop();	};	return true;}/*******	RefMark_Intersection::MakeAll(rank_t arank) - Go*	through existing lines and create RefMark_Intersections with rank equal to arank, *	up to a cumulative total of maxMarks.******/void RefMark_Intersection::MakeAll(rank_t arank){	for (rank_t irank = 0; irank <= arank / 2; irank++) {		rank_t jrank = arank - irank;		bool sameRank = (irank == jrank);		RefContainer<RefLine>::rank_iterator li = ReferenceFinder::basisLines.maps[irank].begin();		if (sameRank) li++;		while (li != ReferenceFinder::basisLines.maps[irank].end()) {			RefContainer<RefLine>::rank_iterator lj = 				ReferenceFinder::basisLines.maps[jrank].begin();			while (lj != (sameRank ? li : ReferenceFinder::basisLines.maps[jrank].end())) { 				if (ReferenceFinder::basisMarks.TotalSize() >= ReferenceFinder::maxMarks) return;				RefMark_Intersection rmi(li->second, lj->second);				ReferenceFinder::basisMarks.AddCopyIfValidAndUnique(rmi);				lj++;			};			li++;		}	}	}/************	RefLine - base class for a reference line. ***********//*******	RefLine static member initialization******/RefBase::index_t RefLine::mCount = 0;		// Initialize class index/*******	RefLine::FinishConstructor()  - Calculate the key values used for sorting RefLines.*	Like its RefMark counterpart, this should be called at the end of every successfully*	constructed object, and it sets mKey to the proper value.******/void RefLine::FinishConstructor(){	// resolve the ambiguity in line orientation by requiring d>=0.		if (l.d < 0) {		l.d = -l.d;		l.u.x = -l.u.x;		l.u.y = -l.u.y;	};		double fa = (1. + atan2(l.u.y, l.u.x) / (3.14159265358979323)) / 2.0;	// fa is between 0 & 1	const double dmax = sqrt(pow(RefBase::paper.pWidth, 2) + 		pow(RefBase::paper.pHeight, 2));	const double fd = l.d / dmax;	// fd is between 0 and 1		key_t nd = static_cast <key_t> (floor(0.5 + fd * dNum));	if (nd == 0) fa = fmod(2 * fa, 1);	// for d=0, we map alpha and pi+alpha to the same key	key_t na = static_cast <key_t> (floor(0.5 + fa * aNum));	mKey = 1 + na * dNum + nd;}/*******	Distance (const XYLine& al) - return the "distance" between two lines, which is the *	Pythagorean	sum of the dot product of their direction vectors (roughly equivalent to *	angular separation)	and their distance scalars (roughly equivalent to parallel separation).******/const double RefLine::Distance (const XYLine& al) const{	return sqrt(pow(l.u.Dot(al.u.Rotate90()), 2) + pow(l.d - al.d * l.u.Dot(al.u), 2));}/*******	RefLine::IsOnEdge() - return true if this RefLine is on the edge of the paper******/const bool RefLine::IsOnEdge() const{	return ((RefBase::paper.leftEdge == l) || 		(RefBase::paper.topEdge == l) ||		(RefBase::paper.rightEdge == l) || 		(RefBase::paper.bottomEdge == l));}/*******	RefLine::IsActionLine() - return true, since MOST Reflines are actions******/const bool RefLine::IsActionLine() const{	return true;}/*******	RefLine::KeySizeOK() - return true if the key_t type is large enough to hold all*	possible keys.******/const bool RefLine::KeySizeOK(){	return aNum < numeric_limits<key_t>::max() / dNum;}/*******	RefLine::GetLabel() - return the label for this line.******/const char RefLine::GetLabel() const{	return mLabels[mIndex - 1];}/*******	RefLine::PutName(ostream& os) - put the name of this line to a stream. Default*	behavior gives this line a letter. Return true if we used a letter. (We'll*	return false if we use something else, i.e., a RefLine_Original).******/const bool RefLine::PutName(ostream& os) const{	os << "line " << GetLabel();	return true;}/*******	RefLine::PutDistanceAndRank(ostream& os, const XYLine& al) - put the distance *	between this line and line al to a stream along with the rank******/void RefLine::PutDistanceAndRank(ostream& os, const XYLine& al) const{	os.precision(4);	os.setf(ios_base::fixed, ios_base::floatfield);	os << "Solution " << l << ": err = " << Distance(al) << " (rank " << mRank << ") ";}				/*******	RefLine::DrawSelf(RefStyle rstyle, short ipass) - Draw a line in the given style.******/void RefLine::DrawSelf(RefStyle rstyle, short ipass) const{	XYPt p1, p2;	RefBase::paper.ClipLine(l, p1, p2);		switch(ipass) {		case linePass:			{				switch (rstyle) {					case normalRef:						mDgmr->DrawLine(p1, p2, RefDgmr::creaseLine);						break;					default: ; // keep compiler happy				}			};			break;					case hlinePass:	// hilited lines and action lines go on top of others			{				switch (rstyle) {					case hiliteRef:						mDgmr->DrawLine(p1, p2, RefDgmr::hiliteLine);						break;					case actionRef:						mDgmr->DrawLine(p1, p2, RefDgmr::valleyLine);						break;					default: ; // keep compiler happy				}			};			break;					case labelPass:			{				XYPt mp = MidPoint(p1, p2);	// label goes at the midpoint of the line				string sl(1, GetLabel());				switch (rstyle) {					case normalRef:						// normal lines don't get labels						break;					case hiliteRef:						mDgmr->DrawLabel(mp, sl, RefDgmr::hiliteLabel);						break;					case actionRef:						mDgmr->DrawLabel(mp, sl, RefDgmr::actionLabel);						break;					default: ;// keep compiler happy				}			};			break;		default: ;// keep compiler happy	}	// Subclasses will add arrows for actionRef}/*******	RefLine::SetIndex() - Most subclasses will use the default method, which sets the index*	from the class variable mCount and then bumps up the count.******/void RefLine::SetIndex(){	mIndex = ++mCount;}/*******	RefLine::ResetCount() - Reset the class variable mCount to zero.******/void RefLine::ResetCount(){	mCount = 0;}/************	RefLine_Original - Specialization of RefLine that represents a line that is the *	edge of the paper or an initial crease (like the diagonal).***********//*******	RefLine_Original::RefLine_Original(const XYLine& al, rank_t arank, string as) - Constructor.******/RefLine_Original::RefLine_Original(const XYLine& al, rank_t arank, string as) : 	RefLine(al, arank), s(as){	FinishConstructor();}/*******	RefLine_Original::IsActionLine() - return false because RefLine_Originals aren't actions,*	they're present from the beginning.******/const bool RefLine_Original::IsActionLine() const{	return false;}/*******	RefLine_Original::GetLabel() - return the label for this line.******/const char RefLine_Original::GetLabel() const{	return 0;	// originals get no label}/*******	RefLine_Original::PutName(ostream& os) - Put the name to a stream. Override the default*	method to use the actual string name, rather than a letter. Return false since we didn't*	use a letter.******/const bool RefLine_Original::PutName(ostream& os) const{	os << s;	return false;}/*******	RefLine_Original::DrawSelf(RefStyle rstyle, short ipass) - Draw this line *	in the appropriate style******/void RefLine_Original::DrawSelf(RefStyle rstyle, short ipass) const{		// RefLine_Originals don't get labels, and they are actionRef, we still draw them		// hilited.	XYPt p1, p2;	RefBase::paper.ClipLine(l, p1, p2);	switch(ipass) {		case linePass:			switch (rstyle) {				case normalRef:					mDgmr->DrawLine(p1, p2, RefDgmr::creaseLine);					break;				default: ; // keep compiler happy			}			break;		case hlinePass:			switch (rstyle) {				case hiliteRef:				case actionRef:					mDgmr->DrawLine(p1, p2, RefDgmr::hiliteLine);					break;				default: ; // keep compiler happy			}			break;		default: ; // keep compiler happy about unhandled cases	}}/*******	RefLine_Original::IsDerived() - return false, since this is original******/const bool RefLine_Original::IsDerived() const{	return false;}/*******	RefLine_Original::SetIndex() - set the index of this line. Override the default method*	to use an index of zero, since we've already got a name.******/void RefLine_Original::SetIndex(){	mIndex = 0;}/************	RefLine_C2P_C2P - Huzita-Hatori Axiom O1**	Make a crease through two points p1 and p2.***********//*******	RefLine_C2P_C2P(RefMark* arm1, RefMark* arm2) - Constructor. Initialize with the two*	marks that this line connects.******/RefLine_C2P_C2P::RefLine_C2P_C2P(RefMark* arm1, RefMark* arm2) : 	RefLine(CalcLineRank(arm1, arm2)), rm1(arm1), rm2(arm2){	// Get references to points		XYPt& p1 = rm1->p;	XYPt& p2 = rm2->p;		// Construct member data		l.u = (p2 - p1).Rotate90().Normalize();	l.d = .5 * (p1 + p2).Dot(l.u);		// Don't need to check visibility because this type is always visible.		// If this line creates a skinny flap, we won't use it.		if (RefBase::paper.MakesSkinnyFlap(l)) return;		// This type is always valid.		FinishConstructor();}/*******	RefLine_C2P_C2P::UsesImmediate(RefBase* rb) - return true if this line uses rb for *	immediate reference.******/const bool RefLine_C2P_C2P::UsesImmediate(RefBase* rb) const{	return (rb == rm1 || rb == rm2);}/*******	RefLine_C2P_C2P::SequencePushSelf() - Build the folding sequence*	that constructs this object.******/void RefLine_C2P_C2P::SequencePushSelf(){	rm1->SequencePushSelf();	rm2->SequencePushSelf();	RefBase::SequencePushSelf();}/*******	RefLine_C2P_C2P::PutHowto(ostream& os) - put the construction of this line to a stream.******/const bool RefLine_C2P_C2P::PutHowto(ostream& os) const{	if (axiomsInVerbalDirections) os << "[01] ";	os << "Form a crease connecting ";	rm1->PutName(os);	os << " with ";	rm2->PutName(os);	os << ", making ";	PutName(os);	return true;}/*******	RefLine_C2P_C2P::DrawSelf(RefStyle rstyle, short ipass) - Draw this line, *	adding arrows if appropriate******/void RefLine_C2P_C2P::DrawSelf(RefStyle rstyle, short ipass) const{	// Call the inherited method to draw the line		RefLine::DrawSelf(rstyle, ipass);		// If we're moving, we need arrows.		if ((ipass == arrowPass) && (rstyle == actionRef)) {			// Get the endpoints of the fold				XYPt& p1 = rm1->p;		XYPt& p2 = rm2->p;				// Get the perpendicular bisector of the fold				XYPt mp = MidPoint(p1, p2);		XYLine lb;		lb.u = l.u.Rotate90();		lb.d = mp.Dot(lb.u);				// Get the points where the bisector crosses the paper				XYPt p3, p4;		RefBase::paper.ClipLine(lb, p3, p4);				// Parameterize these points along the bisector. Don't care about sign.				double t3 = abs((p3 - mp).Dot(l.u));		double t4 = abs((p4 - mp).Dot(l.u));				// Construct a new pair of points that mate when folded and that are guaranteed to		// lie within the paper.				XYPt dp;		if (t3 < t4) dp = t3 * l.u;		else dp = t4 * l.u;		p3 = mp + dp;		p4 = mp - dp;				// Draw an arrow that connects these two points.				mDgmr->DrawFoldAndUnfoldArrow(p3, p4);	}}/*******	RefLine_C2P_C2P::MakeAll(rank_t arank) - Go*	through existing lines and marks and create RefLine_C2P_C2Ps with rank equal to arank,*	up to a cumulative total of maxLines.******/void RefLine_C2P_C2P::MakeAll(rank_t arank){	for (rank_t irank = 0; irank <= (arank - 1) / 2; irank++) {		rank_t jrank = arank - irank - 1;		bool sameRank = (irank == jrank);		RefContainer<RefMark>::rank_iterator mi = 			ReferenceFinder::basisMarks.maps[irank].begin();		if (sameRank) mi++;		while (mi != ReferenceFinder::basisMarks.maps[irank].end()) {			RefContainer<RefMark>::rank_iterator mj = 				ReferenceFinder::basisMarks.maps[jrank].begin();			while (mj != (sameRank ? mi : ReferenceFinder::basisMarks.maps[jrank].end())) {				if (ReferenceFinder::basisLines.TotalSize() >= ReferenceFinder::maxLines) return;				RefLine_C2P_C2P rlc(mi->second, mj->second);				ReferenceFinder::basisLines.AddCopyIfValidAndUnique(rlc);				mj++;			};			mi++;		}	}}/************	RefLine_P2P - Huzita-Hatori Axiom O2**	Bring p1 to p2.***********//*******	RefLine_P2P(RefMark* arm1, RefMark* arm2) - Constructor.******/RefLine_P2P::RefLine_P2P(RefMark* arm1, RefMark* arm2) : 	RefLine(CalcLineRank(arm1, arm2)), rm1(arm1), rm2(arm2){	// Get references to points		XYPt& p1 = rm1->p;	XYPt& p2 = rm2->p;		// Construct member data		l.u = (p2 - p1).Normalize();	l.d = .5 * (p1 + p2).Dot(l.u);		// Check visibility		bool p1edge = arm1->IsOnEdge();	bool p2edge = arm2->IsOnEdge();		if (ReferenceFinder::visibilityMatters) {		if (p1edge) whoMoves = p1Moves;		else if (p2edge) whoMoves = p2Moves;		else return;	}	else {		whoMoves = p1Moves;	};		// If this line creates a skinny flap, we won't use it.		if (RefBase::paper.MakesSkinnyFlap(l)) return;		// Set the key.	FinishConstructor();}/*******	RefLine_P2P::UsesImmediate(RefBase* rb) - return true if this line uses rb for *	immediate reference.******/const bool RefLine_P2P::UsesImmediate(RefBase* rb) const{	return (rb == rm1 || rb == rm2);}/*******	RefLine_P2P::SequencePushSelf() - Build the folding sequence*	that constructs this object.******/void RefLine_P2P::SequencePushSelf(){	switch (whoMoves) {		case p1Moves:			rm2->SequencePushSelf();			rm1->SequencePushSelf();			break;				case p2Moves:			rm1->SequencePushSelf();			rm2->SequencePushSelf();			break;	};			RefBase::SequencePushSelf();}/*******	RefLine_P2P::PutHowto(ostream& os) - put the construction of this line to a stream.******/const bool RefLine_P2P::PutHowto(ostream& os) const{	if (axiomsInVerbalDirections) os << "[02] ";	os << "Bring ";	switch (whoMoves) {		case p1Moves:			rm1->PutName(os);			os << " to ";			rm2->PutName(os);			break;					case p2Moves:			rm2->PutName(os);			os << " to ";			rm1->PutName(os);			break;	};	os << ", making ";	PutName(os);	return true;}/*******	RefLine_P2P::DrawSelf(RefStyle rstyle, short ipass) - Draw this line, *	adding arrows if appropriate******/void RefLine_P2P::DrawSelf(RefStyle rstyle, short ipass) const{	// Call inherited method to draw the lines		RefLine::DrawSelf(rstyle, ipass);		// If we're moving, we need an arrow		if ((ipass == arrowPass) && (rstyle == actionRef)) {		XYPt& p1 = rm1->p;		XYPt& p2 = rm2->p;		switch (whoMoves) {			case p1Moves:				mDgmr->DrawFoldAndUnfoldArrow(p1, p2);				break;			case p2Moves:				mDgmr->DrawFoldAndUnfoldArrow(p2, p1);				break;		}	}}			/*******	RefLine_P2P::MakeAll(rank_t arank) - Go*	through existing lines and marks and create RefLine_P2Ps with rank equal to arank,*	up to a cumulative total of maxLines.******/void RefLine_P2P::MakeAll(rank_t arank){	for (rank_t irank = 0; irank <= (arank - 1) / 2; irank++) {		rank_t jrank = arank - irank - 1;		bool sameRank = (irank == jrank);		RefContainer<RefMark>::rank_iterator mi = 			ReferenceFinder::basisMarks.maps[irank].begin();		if (sameRank) mi++;		while (mi != ReferenceFinder::basisMarks.maps[irank].end()) {			RefContainer<RefMark>::rank_iterator mj = 				ReferenceFinder::basisMarks.maps[jrank].begin();			while (mj != (sameRank ? mi : ReferenceFinder::basisMarks.maps[jrank].end())) {				if (ReferenceFinder::basisLines.TotalSize() >= ReferenceFinder::maxLines) return;				RefLine_P2P rlb(mi->second, mj->second);				ReferenceFinder::basisLines.AddCopyIfValidAndUnique(rlb);				mj++;			};			mi++;		}	}}/************	RefLine_L2L - Huzita-Hatori Axiom O3**	Bring line l1 to line l2.***********//*******	RefLine_L2L::RefLine_L2L(RefLine* arl1, RefLine* arl2, short iroot) - Constructor.*	iroot = 0 or 1.******/RefLine_L2L::RefLine_L2L(RefLine* arl1, RefLine* arl2, short iroot) : 	RefLine(CalcLineRank(arl1, arl2)), rl1(arl1), rl2(arl2){				// Get references to lines		XYLine& l1 = rl1->l;	XYPt& u1 = l1.u;	double& d1 = l1.d;	XYLine& l2 = rl2->l;	XYPt& u2 = l2.u;	double& d2 = l2.d;		// Parallel lines get handled specially. There's only one solution; we arbitrarily make	// it the iroot=0 solution.		if (l1.IsParallelTo(l2)) {		if (iroot == 0) {			l.u = u1;			l.d = .5 * (d1 + d2 * u2.Dot(u1));		}		else return; // iroot = 1 for parallel lines isn't a valid solution.	}	else {	// nonparallel lines			// Construct the direction vector for the bisector, depending on the value of iroot.				if (iroot == 0) l.u = (u1 + u2).Normalize();		else l.u = (u1 - u2).Normalize();				l.d = Intersection(l1, l2).Dot(l.u);	};		// If the paper doesn't overlap the fold line, we're not valid.		if (!RefBase::paper.InteriorOverlaps(l)) return;		// Check visibility		bool l1edge = arl1->IsOnEdge();	bool l2edge = arl2->IsOnEdge();		if (ReferenceFinder::visibilityMatters) {		if (l1edge) whoMoves = l1Moves;		else if (l2edge) whoMoves = l2Moves;		else {			XYPt lp1, lp2;			RefBase::paper.ClipLine(l1, lp1, lp2);			if (RefBase::paper.Encloses(l.Fold(lp1)) && 				RefBase::paper.Encloses(l.Fold(lp2))) whoMoves = l1Moves;			else {				RefBase::paper.ClipLine(l2, lp1, lp2);				if (RefBase::paper.Encloses(l.Fold(lp1)) && 					RefBase::paper.Encloses(l.Fold(lp2))) whoMoves = l2Moves;				else return;			}		}	}	else {		whoMoves = l1Moves;	};		// If this line creates a skinny flap, we won't use it.		if (RefBase::paper.MakesSkinnyFlap(l)) return;	// Set the key.		FinishConstructor();}/*******	RefLine_L2L::UsesImmediate(RefBase* rb) - return true if this line uses rb for *	immediate reference.******/const bool RefLine_L2L::UsesImmediate(RefBase* rb) const{	return (rb == rl1 || rb == rl2);}/*******	RefLine_L2L::SequencePushSelf() - Build the folding sequence*	that constructs this object.******/void RefLine_L2L::SequencePushSelf(){	switch (whoMoves) {		case l1Moves:			rl2->SequencePushSelf();			rl1->SequencePushSelf();			break;				case l2Moves:			rl1->SequencePushSelf();			rl2->SequencePushSelf();			break;	};	RefBase::SequencePushSelf();}/*******	RefLine_L2L::PutHowto(ostream& os) - put the construction of this line to a stream.******/const bool RefLine_L2L::PutHowto(ostream& os) const{	if (axiomsInVerbalDirections) os << "[03] ";	os << "Fold ";	switch (whoMoves) {		case l1Moves:			rl1->PutName(os);			os << " to ";			rl2->PutName(os);					break;				case l2Moves:			rl2->PutName(os);			os << " to ";			rl1->PutName(os);					break;	};	os << ", making ";	PutName(os);	if (clarifyVerbalAmbiguities) {		os << " through ";				// Now we need to specify which of the two bisectors this is, which we do		// by specifying a point where the bisector hits the edge of the square.				XYPt p;		rl1->l.Intersects(rl2->l, p);	// get the intersection of the two bisectors		XYPt pa, pb;		RefBase::paper.ClipLine(l, pa, pb);		// find where our fold line hits the paper.				// Return the first point of intersection between the fold line and the edge of the		// paper that _isn't_ the intersection of the two bisectors.				os.precision(2);		os.setf(ios_base::fixed, ios_base::floatfield);		if (p == pa) return os << pb.Chop();		os << pa.Chop();	};	return true;}/*******	RefLine_L2L::DrawSelf(RefStyle rstyle, short ipass) - Draw this line, adding arrows if appropriate******/void RefLine_L2L::DrawSelf(RefStyle rstyle, short ipass) const{	// Call inherited method to draw the lines		RefLine::DrawSelf(rstyle, ipass);		// If we're moving, we need an arrow that brings two points from one line to two points on	// the other line. We need to pick points that are within the paper for both lines.		if ((ipass == arrowPass) && (rstyle == actionRef)) {						XYLine& l1 = rl1->l;			XYLine& l2 = rl2->l;			XYPt p1a, p1b;			RefBase::paper.ClipLine(l1, p1a, p1b);	// endpoints of l1			XYPt p2a, p2b;			RefBase::paper.ClipLine(l2, p2a, p2b);	// endpoints of l2			p2a = l.Fold(p2a);								// flop l2 points onto l1			p2b = l.Fold(p2b);			XYPt du1 = l1.d * l1.u;				// a point on l1			XYPt up1 = l1.u.Rotate90();			// a tangent to l1			vector<double> tvals;				// holds parameterizations of the 4 points			tvals.push_back((p1a - du1).Dot(up1));	// parameterize p1a along l1			tvals.push_back((p1b - du1).Dot(up1));	// parameterize p1b along l1			tvals.push_back((p2a - du1).Dot(up1));	// parameterize p2a along l1			tvals.push_back((p2b - du1).Dot(up1));	// parameterize p2b along l1			sort(tvals.begin(), tvals.end());		// sort them in order; we want the middle 2			XYPt p1c = du1 + 0.5 * (tvals[1] + tvals[2]) * up1;			XYPt p2c = l.Fold(p1c);			switch(whoMoves) {				case l1Moves:					mDgmr->DrawFoldAndUnfoldArrow(p1c, p2c);					break;				case l2Moves:					mDgmr->DrawFoldAndUnfoldArrow(p1c, p2c);					break;			}	}}/*******	RefLine_L2L::MakeAll(rank_t arank) - Go*	through existing lines and marks and create RefLine_L2Ls with rank equal to arank*	up to a cumulative total of maxLines.******/void RefLine_L2L::MakeAll(rank_t arank){	for (rank_t irank = 0; irank <= (arank - 1) / 2; irank++) {		rank_t jrank = arank - irank - 1;		bool sameRank = (irank == jrank);		RefContainer<RefLine>::rank_iterator li = ReferenceFinder::basisLines.maps[irank].begin();		if (sameRank) li++;		while (li != ReferenceFinder::basisLines.maps[irank].end()) {			RefContainer<RefLine>::rank_iterator lj = 				ReferenceFinder::basisLines.maps[jrank].begin();			while (lj != (sameRank ? li : ReferenceFinder::basisLines.maps[jrank].end())) {				if (ReferenceFinder::basisLines.TotalSize() >= ReferenceFinder::maxLines) return;				RefLine_L2L rls1(li->second, lj->second, 0);				ReferenceFinder::basisLines.AddCopyIfValidAndUnique(rls1);				if (ReferenceFinder::basisLines.TotalSize() >= ReferenceFinder::maxLines) return;				RefLine_L2L rls2(li->second, lj->second, 1);				ReferenceFinder::basisLines.AddCopyIfValidAndUnique(rls2);				lj++;			};			li++;		}	}}/************	RefLine_L2L_C2P - Huzita-Hatori Axiom O4**	Bring line l1 to itself so that the crease goes through point p1***********//*******	RefLine_L2L_C2P::RefLine_L2L_C2P(RefLine* arl1, RefMark* arm1) - Constructor.******/RefLine_L2L_C2P::RefLine_L2L_C2P(RefLine* arl1, RefMark* arm1) : 	RefLine(CalcLineRank(arl1, arm1)), rl1(arl1), rm1(arm1){				// Get references to line and mark		XYPt& u1 = rl1->l.u;	double& d1 = rl1->l.d;	XYPt& p1 = rm1->p;		// Construct the direction vector and distance scalar for the fold line.		l.u = u1.Rotate90();	l.d = p1.Dot(l.u);	// The intersection of the fold line with line l1 must be enclosed in the paper.	// That point is the projection of p1 onto line l1.		XYPt p1p = p1 + (d1 - (p1.Dot(u1))) * u1;	if (!RefBase::paper.Encloses(p1p)) return;		// Don't need to check visibility, this kind is always visible.		// If this line creates a skinny flap, we won't use it.		if (RefBase::paper.MakesSkinnyFlap(l)) return;		// Set the key.		FinishConstructor();}/*******	RefLine_L2L_C2P::UsesImmediate(RefBase* rb) - return true if this line uses rb for *	immediate reference.******/const bool RefLine_L2L_C2P::UsesImmediate(RefBase* rb) const{	return (rb == rl1 || rb == rm1);}/*******	RefLine_L2L_C2P::SequencePushSelf() - Build the folding sequence*	that constructs this object.******/void RefLine_L2L_C2P::SequencePushSelf(){	rm1->SequencePushSelf();	rl1->SequencePushSelf();	RefBase::SequencePushSelf();}/*******	RefLine_L2L_C2P::PutHowto(ostream& os) - put the construction of this line to a stream.******/const bool RefLine_L2L_C2P::PutHowto(ostream& os) const{	if (axiomsInVerbalDirections) os << "[04] ";	os << "Fold ";	rl1->PutName(os);	os << " onto itself, making ";	PutName(os);	os << " through ";	rm1->PutName(os);	return true;}/*******	RefLine_L2L_C2P::DrawSelf(RefStyle rstyle, short ipass) - Draw this line, *	adding arrows if appropriate******/void RefLine_L2L_C2P::DrawSelf(RefStyle rstyle, short ipass) const{	// Call inherited method to draw the lines		RefLine::DrawSelf(rstyle, ipass);		// If we're moving, we need an arrow		if ((ipass == arrowPass) && (rstyle == actionRef)) {						XYPt p1, p2;			XYLine& l1 = rl1->l;			RefBase::paper.ClipLine(l1, p1, p2);	// get endpts of the reference line			XYPt pi = Intersection(l, l1);					// intersection w/ fold line			XYPt u1p = l1.u.Rotate90();						// tangent to reference line			double t1 = abs((p1 - pi).Dot(u1p));			double t2 = abs((p2 - pi).Dot(u1p));			double tmin = t1 < t2 ? t1 : t2;			mDgmr->DrawFoldAndUnfoldArrow(pi + tmin * u1p, pi - tmin * u1p);	}}/*******	RefLine_L2L_C2P::MakeAll(rank_t arank) - Go*	through existing lines and marks and create RefLine_L2L_C2Ps with rank equal to arank*	up to a cumulative total of maxLines.******/void RefLine_L2L_C2P::MakeAll(rank_t arank){	for (rank_t irank = 0; irank <= (arank - 1); irank++) {		rank_t jrank = arank - irank - 1;		RefContainer<RefLine>::rank_iterator li = 			ReferenceFinder::basisLines.maps[irank].begin();		while (li != ReferenceFinder::basisLines.maps[irank].end()) {			RefContainer<RefMark>::rank_iterator mj = 				ReferenceFinder::basisMarks.maps[jrank].begin();			while (mj != ReferenceFinder::basisMarks.maps[jrank].end()) {				if (ReferenceFinder::basisLines.TotalSize() >= ReferenceFinder::maxLines) return;				RefLine_L2L_C2P rls1(li->second, mj->second);				ReferenceFinder::basisLines.AddCopyIfValidAndUnique(rls1);				mj++;			};			li++;		}	}}/************	RefLine_P2L_C2P - Huzita-Hatori Axiom O5.**	Bring point p1 to line l1 so that the crease passes through point p2.***********//*******	RefLine_P2L_C2P::RefLine_P2L_C2P(RefMark* arm1, RefLine* arl1, RefMark* arm2, short iroot) - *	Constructor. iroot can be 0 or 1.******/RefLine_P2L_C2P::RefLine_P2L_C2P(RefMark* arm1, RefLine* arl1, RefMark* arm2, short iroot) :	RefLine(CalcLineRank(arm1, arl1, arm2)), rm1(arm1), rl1(arl1), rm2(arm2){	// Get references to the points and lines.		XYPt& p1 = rm1->p;	XYLine& l1 = rl1->l;	XYPt& u1 = l1.u;	double& d1 = l1.d;	XYPt& p2 = rm2->p;	// If either point is already on the line, then this isn't interesting, i.e., it's	// a trivial Haga construction.		if (l1.Intersects(p1) || l1.Intersects(p2)) return;		// Construct the line.		double a = d1 - p2.Dot(u1);	double b2 = (p2 - p1).Mag2() - a * a;		if (b2 < 0) return;		// no solution for negative b2 (implies imaginary b)		double b = sqrt(b2);	if ((b < EPS) && (iroot == 1)) return;	// degenerate case, there's only one solution		// Construct the image of p1 (p1p), which depends on which root we're after.		XYPt u1p = u1.Rotate90();	XYPt p1p = p2 + a * u1;	if (iroot == 0) p1p += b * u1p;	else p1p -= b * u1p;		// Validate; the point of incidence must lie within the square.		if (!RefBase::paper.Encloses(p1p)) return;		// Construct member data.	l.u = (p1p - p1).Normalize();	l.d = p2.Dot(l.u);		// Check visibility.		bool p1edge = arm1->IsOnEdge();	bool l1edge = arl1->IsOnEdge();		if (ReferenceFinder::visibilityMatters) {		if (p1edge) whoMoves = p1Moves;		else if (l1edge) whoMoves = l1Moves;		else return;	}	else {		whoMoves = p1Moves;	};		// If this line creates a skinny flap, we won't use it.		if (RefBase::paper.MakesSkinnyFlap(l)) return;		// Set the key.		FinishConstructor();}/*******	RefLine_P2L_C2P::UsesImmediate(RefBase* rb) - return true if this line uses rb for *	immediate reference.******/const bool RefLine_P2L_C2P::UsesImmediate(RefBase* rb) const{	return (rb == rl1 || rb == rm1 || rb == rm2);}/*******	RefLine_P2L_C2P::SequencePushSelf() - Build the folding sequence*	that constructs this object.******/void RefLine_P2L_C2P::SequencePushSelf(){	rm2->SequencePushSelf();	switch (whoMoves) {		case p1Moves:			rl1->SequencePushSelf();			rm1->SequencePushSelf();			break;					case l1Moves:			rm1->SequencePushSelf();			rl1->SequencePushSelf();			break;	};	RefBase::SequencePushSelf();}/*******	RefLine_P2L_C2P::PutHowto(ostream& os) - Put the name of this line to a stream.******/const bool RefLine_P2L_C2P::PutHowto(ostream& os) const{	if (axiomsInVerbalDirections) os << "[05] ";	os << "Bring ";	switch (whoMoves) {		case p1Moves:			rm1->PutName(os);			os << " to ";			rl1->PutName(os);			break;				case l1Moves:			rl1->PutName(os);			os << " to ";			rm1->PutName(os);			break;	};	if (clarifyVerbalAmbiguities) {				os << " so the crease goes through ";		rm2->PutName(os);	};	os << ", making ";	PutName(os);	return true;}/*******	RefLine_P2L_C2P::DrawSelf(RefStyle rstyle, short ipass) - Draw this line, *	adding arrows if appropriate******/void RefLine_P2L_C2P::DrawSelf(RefStyle rstyle, short ipass) const{	// Call inherited method to draw the lines		RefLine::DrawSelf(rstyle, ipass);		// If we're moving, we need an arrow		if ((ipass == arrowPass) && (rstyle == actionRef)) {					XYPt& p1 = rm1->p;		XYPt p1f = l.Fold(p1);		switch (whoMoves) {			case p1Moves:				mDgmr->DrawFoldAndUnfoldArrow(p1, p1f);				break;			case l1Moves:				mDgmr->DrawFoldAndUnfoldArrow(p1f, p1);				break;		}	}}/*******	RefLine_P2L_C2P::MakeAll(rank_t arank) - Go*	through existing lines and marks and create RefLine_P2L_C2Ps with rank equal arank*	up to a cumulative total of maxLines.******/void RefLine_P2L_C2P::MakeAll(rank_t arank){	for (rank_t irank = 0; irank <= (arank - 1); irank++)		for (rank_t jrank = 0; jrank <= (arank - 1 - irank); jrank++) {			rank_t krank = arank - irank - jrank - 1;			RefContainer<RefMark>::rank_iterator mi = 				ReferenceFinder::basisMarks.maps[irank].begin();			while (mi != ReferenceFinder::basisMarks.maps[irank].end()) {				RefContainer<RefLine>::rank_iterator lj = 					ReferenceFinder::basisLines.maps[jrank].begin();				while (lj != ReferenceFinder::basisLines.maps[jrank].end()) {					RefContainer<RefMark>::rank_iterator mk = 						ReferenceFinder::basisMarks.maps[krank].begin();					while (mk != ReferenceFinder::basisMarks.maps[krank].end()) {						if (mi != mk) {							if (ReferenceFinder::basisLines.TotalSize() >= 								ReferenceFinder::maxLines) return;							RefLine_P2L_C2P rlh1(mi->second, lj->second, mk->second, 0);							ReferenceFinder::basisLines.AddCopyIfValidAndUnique(rlh1);							if (ReferenceFinder::basisLines.TotalSize() >= 								ReferenceFinder::maxLines) return;							RefLine_P2L_C2P rlh2(mi->second, lj->second, mk->second, 1);							ReferenceFinder::basisLines.AddCopyIfValidAndUnique(rlh1);						};						mk++;					};					lj++;				};				mi++;			}		}}/************	RefLine_P2L_P2L - Huzita-Hatori Axiom O6.**	Bring point p1 to line l1 and point p2 to line l2.***********//*******	RefLine_P2L_P2L static member initialization******/short RefLine_P2L_P2L::order = 0;short RefLine_P2L_P2L::irootMax = 0;double RefLine_P2L_P2L::q1 = 0;double RefLine_P2L_P2L::q2 = 0;double RefLine_P2L_P2L::S = 0;double RefLine_P2L_P2L::Sr = 0;double RefLine_P2L_P2L::Si = 0;double RefLine_P2L_P2L::U = 0;/*******	CubeRoot(double x) - works for both positive and negative numbers******/double CubeRoot(double x){	if (x >= 0) return pow(x, 1./3);	else return -pow(-x, 1./3);}/*******	RefLine_P2L_P2L::RefLine_P2L_P2L(RefMark* arm1, RefLine* arl1, RefMark* arm2, RefLine* arl2, *		short iroot) - Constructor. Variable iroot can be 0, 1, or 2.******/RefLine_P2L_P2L::RefLine_P2L_P2L(RefMark* arm1, RefLine* arl1, RefMark* arm2, RefLine* arl2, 	short iroot) : 	RefLine(CalcLineRank(arm1, arl1, arm2, arl2)), rm1(arm1), rl1(arl1), rm2(arm2), rl2(arl2){	// Get references to the points and lines involved in the construction		XYPt& p1 = rm1->p;	XYLine& l1 = rl1->l;	XYPt& u1 = l1.u;	double& d1 = l1.d;	XYPt& p2 = rm2->p;	XYLine& l2 = rl2->l;	XYPt& u2 = l2.u;	double& d2 = l2.d;	// This is by far the most complex alignment, and it involves the solution of a cubic equation.		XYPt u1p = u1.Rotate90();	// we'll need this later.		// First, some trivial checks; we can't have p1 already on l1, or p2 already on l2.		if (l1.Intersects(p1)) return;	if (l2.Intersects(p2)) return;		// Also make sure we're using distinct points and lines.		if ((p1 == p2) || (l1 == l2)) return;		// Now construct the terms of the cubic equation. These are stored in static member variables	// during the iroot==0 construction; if iroot==1 or 2, we used the stored values.	double rc = 0;	// this will hold the root of the cubic equation after this switch(iroot).	switch (iroot) {		case 0:			{					// case iroot==0 computes a bunch of quantities that are used for all roots.				// Some of these get stored in private static member variables.								XYPt v1 = p1 + d1 * u1 - 2 * p2;				XYPt v2 = d1 * u1 - p1;				double c1 = p2.Dot(u2) - d2;				double c2 = 2 * v2.Dot(u1p);				double c3 = v2.Dot(v2);				double c4 = (v1 + v2).Dot(u1p);				double c5 = v1.Dot(v2);				double c6 = u1p.Dot(u2);				double c7 = v2.Dot(u2);								// the equation is a * r^3 + b * r^2 + c * r + d == 0								double a = c6;				double b = c1 + c4 * c6 + c7;				double c = c1 * c2 + c5 * c6 + c4 * c7;				double d = c1 * c3 + c5 * c7;						// compute the order of the equation								if (abs(a) > EPS) order = 3;		// cubic equation				else if (abs(b) > EPS) order = 2;	// quadratic equation				else if (abs(c) > EPS) order = 1;	// linear equation				else order = 0;						// ill-formed equation (no variables!)								// what we do next depends on the order of the equation.								switch(order) {					case 0:				// ill-formed equation has 0 roots						return;										case 1:				// linear equation has 1 root						{							rc = -d / c;						}						break;										case 2:				// quadratic equation has 0, 1 or 2 roots						{											double disc = pow(c, 2) - 4 * b * d;							q1 = -c / (2 * b);							if (disc < 0) {								irootMax = -1;				// no roots								return;							}							else if (abs(disc) < EPS) {								irootMax = 0;				// 1 degenerate root								rc = q1;					// and here it is							}							else {								irootMax = 1;				// 2 roots								q2 = sqrt(disc) / (2 * b);								rc = q1 + q2;				// and here's the first							}						}						break;									case 3:				// cubic equation, has 1, 2, or 3 roots						{							// Construct coefficients that give the roots from Cardano's formula.														double a2 = b / a;							double a1 = c / a;							double a0 = d / a;														double Q = (3 * a1 - pow(a2, 2)) / 9;							double R = (9 * a2 * a1 - 27 * a0 - 2 * pow(a2, 3)) / 54;							double D = pow(Q, 3) + pow(R, 2);							U = -a2 / 3;														// The number of roots depends on the value of D.														if (D > 0) {								irootMax = 0;				// one root								double rD = sqrt(D);								S = CubeRoot(R + rD);								double T = CubeRoot(R - rD);								rc = U + S + T;				// and here it is.							}							else if (abs(D) < EPS) {								irootMax = 1;				// two roots								S = pow(R, 1./3);								rc = U + 2 * S;				// here's the first							}							else { // D < 0								irootMax = 2;				// three roots								double rD = sqrt(-D);								double phi = atan2(rD, R) / 3;								double rS = pow(pow(R, 2) - D, 1./6);								Sr = rS * cos(phi);								Si = rS * sin(phi);								rc = U + 2 * Sr;			// here's the first							}						}						break;	// end of case 3 of order					}			}					break;	// end of case 0 of iroot		// for the other two roots, we'll rely on the fact that the coefficients		// of the equation and first root have already been constructed.				case 1: // of iroot, meaning we're looking for the second root					if (irootMax < 1) return;			switch(order) {				case 2:					rc = q1 - q2;		// second root of a quadratic					break;								case 3:					// second root of a cubic					if (irootMax == 1)						rc = U - S;					else // irootMax == 2						rc = U - Sr - sqrt(3.) * Si;					break;			};			break;	// end of case 1 of iroot				case 2:	// of iroot, meaning we're looking for the third root					if (irootMax < 2) return;			switch(order) {				case 3:					// third root of a cubic					rc = U - Sr + sqrt(3.) * Si;					break;			};			break;	// end of case 2 of iroot				};	// end of switch(iroot).		// If we're here, rc contains a root of the equation, which must still be validated.				XYPt p1p = d1 * u1 + rc * u1p;					// image of p1 in fold line		if (p1p == p1) return;							// we only consider p1 off of the fold line		l.u = (p1p - p1).Normalize();					// normal to fold line	l.d = l.u.Dot(MidPoint(p1p, p1));				// d-parameter of fold line	XYPt p2p = p2 + 2 * (l.d - p2.Dot(l.u)) * l.u;	// image of p2 in fold line		// Validate; the images of p1 and p2 must lie within the square.		if (!RefBase::paper.Encloses(p1p) || !RefBase::paper.Encloses(p2p)) return;		// Validate visibility; we require that the alignment be visible even with opaque paper.	// Meaning that the moving parts must be edge points or edge lines.		// Note whether p1 and p2 are on the same side of the fold line. If they are, then either	// both points move or both lines move. If they're not, then one of each moves.		bool sameSide = ((p1.Dot(l.u) - l.d) * (p2.Dot(l.u) - l.d) >= 0);		// Note which points and lines are on the edge of the paper		bool p1edge = rm1->IsOnEdge();	bool p2edge = rm2->IsOnEdge();	bool l1edge = rl1->IsOnEdge();	bool l2edge = rl2->IsOnEdge();		// Now, check the visibility of this alignment and use it to specify which parts move		if (ReferenceFinder::visibilityMatters) {		if (sameSide)			if (p1edge && p2edge) whoMoves = p1p2Moves;			else if (l1edge && l2edge) whoMoves = l1l2Moves;			else return;		else			if (p1edge && l2edge) whoMoves = p1l2Moves;			else if (p2edge && l1edge) whoMoves = p2l1Moves;			else return;	}	else {		if (sameSide) whoMoves = p1p2Moves;		else whoMoves = p1l2Moves;	};		// If this line creates a skinny flap, we won't use it.		if (RefBase::paper.MakesSkinnyFlap(l)) return;		// Set the key.		FinishConstructor();}/*******	RefLine_P2L_P2L::UsesImmediate(RefBase* rb) - return true if this line uses rb for *	immediate reference.******/const bool RefLine_P2L_P2L::UsesImmediate(RefBase* rb) const{	return (rb == rl1 || rb == rm1 || rb == rl2 || rb == rm2);}/*******	RefLine_P2L_P2L::SequencePushSelf() - Build the folding sequence*	that constructs this object.******/void RefLine_P2L_P2L::SequencePushSelf(){	switch (whoMoves) {		case p1p2Moves:			rl2->SequencePushSelf();			rl1->SequencePushSelf();			rm2->SequencePushSelf();			rm1->SequencePushSelf();			break;					case l1l2Moves:			rm2->SequencePushSelf();			rm1->SequencePushSelf();			rl2->SequencePushSelf();			rl1->SequencePushSelf();			break;				case p1l2Moves:			rm2->SequencePushSelf();			rl1->SequencePushSelf();			rl2->SequencePushSelf();			rm1->SequencePushSelf();			break;				case p2l1Moves:			rl2->SequencePushSelf();			rm1->SequencePushSelf();			rl1->SequencePushSelf();			rm2->SequencePushSelf();			break;	};	RefBase::SequencePushSelf();}/*******	RefLine_P2L_P2L::PutHowto(ostream& os) - Put the name of this line to a stream.******/const bool RefLine_P2L_P2L::PutHowto(ostream& os) const{	if (axiomsInVerbalDirections) os << "[06] ";	os.precision(2);	os.setf(ios_base::fixed, ios_base::floatfield);	os << "Bring ";	switch (whoMoves) {		case p1p2Moves:			rm1->PutName(os);			os << " to ";			rl1->PutName(os);			if (clarifyVerbalAmbiguities)				os << " at point " << l.Fold(rm1->p).Chop();			os << " and ";			rm2->PutName(os);			os << " to ";			rl2->PutName(os);			break;				case l1l2Moves:			rl1->PutName(os);			if (clarifyVerbalAmbiguities)				os << " so that point " << l.Fold(rm1->p).Chop();			os << " touches ";			rm1->PutName(os);			os << " and ";			rl2->PutName(os);			os << " to ";			rm2->PutName(os);			break;				case p1l2Moves:			rm1->PutName(os);			os << " to ";			rl1->PutName(os);			if (clarifyVerbalAmbiguities)				os << " at point " << l.Fold(rm1->p).Chop();			os << " and ";			rl2->PutName(os);			os << " to ";			rm2->PutName(os);			break;				case p2l1Moves:			rl1->PutName(os);			os << " to ";			rm1->PutName(os);			os << " and ";			rm2->PutName(os);			os << " to ";			rl2->PutName(os);			if (clarifyVerbalAmbiguities)				os << " at point " << l.Fold(rm2->p).Chop();			break;	};	os << ", making ";	PutName(os);	return true;}/*******	RefLine_P2P_P2L::DrawSelf(RefStyle rstyle, short ipass) - Draw this line, *	adding arrows if appropriate******/void RefLine_P2L_P2L::DrawSelf(RefStyle rstyle, short ipass) const{	// Call inherited method to draw the lines		RefLine::DrawSelf(rstyle, ipass);		// If we're moving, we need an arrow		if ((ipass == arrowPass) && (rstyle == actionRef)) {							XYPt& p1a = rm1->p;				XYPt p1b = l.Fold(p1a);				XYPt& p2a = rm2->p;				XYPt p2b = l.Fold(p2a);		switch (whoMoves) {			case p1p2Moves:				mDgmr->DrawFoldAndUnfoldArrow(p1a, p1b);				mDgmr->DrawFoldAndUnfoldArrow(p2a, p2b);				break;							case l1l2Moves:				mDgmr->DrawFoldAndUnfoldArrow(p1b, p1a);				mDgmr->DrawFoldAndUnfoldArrow(p2b, p2a);				break;						case p1l2Moves:				mDgmr->DrawFoldAndUnfoldArrow(p1a, p1b);				mDgmr->DrawFoldAndUnfoldArrow(p2b, p2a);				break;						case p2l1Moves:				mDgmr->DrawFoldAndUnfoldArrow(p1b, p1a);				mDgmr->DrawFoldAndUnfoldArrow(p2a, p2b);				break;		}	}}/*******	RefLine_P2L_P2L::MakeAll(rank_t arank) - Go*	through existing lines and marks and create RefLine_P2L_P2Ls with rank equal arank*	up to a cumulative total of maxLines.******/void RefLine_P2L_P2L::MakeAll(rank_t arank){	// psrank == sum of ranks of the two points	// lsrank == sum of ranks of the two lines		for (rank_t psrank = 0; psrank <= (arank - 1); psrank++)		for (rank_t lsrank = 0; lsrank <= (arank - 1) - psrank; lsrank++)			// point order doesn't matter, so rank(pt[i]) will always be <= rank(pt[j])			for (rank_t irank = 0; irank <= psrank / 2; irank++) {				rank_t jrank = psrank - irank;				bool psameRank = (irank == jrank);								// line order does matter, so both lines vary over all ranks								for (rank_t krank = 0; krank <= lsrank; krank++)					for (rank_t lrank = 0; lrank <= lsrank - krank; lrank++) {								// iterate over all combinations of points & lines with given rank								RefContainer<RefMark>::rank_iterator mi = 							ReferenceFinder::basisMarks.maps[irank].begin();						if (psameRank) mi++;						while (mi != ReferenceFinder::basisMarks.maps[irank].end()) {							RefContainer<RefMark>::rank_iterator mj = 								ReferenceFinder::basisMarks.maps[jrank].begin();							while (mj != (psameRank ? mi : 								ReferenceFinder::basisMarks.maps[jrank].end())) {								RefContainer<RefLine>::rank_iterator lk = 									ReferenceFinder::basisLines.maps[krank].begin();								while (lk != ReferenceFinder::basisLines.maps[krank].end()) {									RefContainer<RefLine>::rank_iterator ll = 										ReferenceFinder::basisLines.maps[lrank].begin();									while (ll != ReferenceFinder::basisLines.maps[lrank].end()) {										if (lk != ll) {											if (ReferenceFinder::basisLines.TotalSize() >= 												ReferenceFinder::maxLines) return;											RefLine_P2L_P2L rlp0(mi->second, lk->second, 												mj->second, ll->second, 0);											ReferenceFinder::basisLines.AddCopyIfValidAndUnique(												rlp0);											if (ReferenceFinder::basisLines.TotalSize() >= 												ReferenceFinder::maxLines) return;											RefLine_P2L_P2L rlp1(mi->second, lk->second, 												mj->second, ll->second, 1);											ReferenceFinder::basisLines.AddCopyIfValidAndUnique(												rlp1);											if (ReferenceFinder::basisLines.TotalSize() >= 												ReferenceFinder::maxLines) return;											RefLine_P2L_P2L rlp2(mi->second, lk->second, 												mj->second, ll->second, 2);											ReferenceFinder::basisLines.AddCopyIfValidAndUnique(												rlp2);										};										ll++;									};									lk++;								};								mj++;							};							mi++;						}					}				}}/************	RefLine_L2L_P2L - Huzita-Hatori Axiom O7 (Hatori's Axiom).**	Bring line l1 onto itself so that point p1 falls on line l2.***********//*******	RefLine_L2L_P2L::RefLine_L2L_P2L(RefLine* arl1, RefMark* arm1, RefLine* arl2) - *	Constructor. iroot can be 0 or 1.******/RefLine_L2L_P2L::RefLine_L2L_P2L(RefLine* arl1, RefMark* arm1, RefLine* arl2) :	RefLine(CalcLineRank(arl1, arm1, arl2)), rl1(arl1), rm1(arm1), rl2(arl2){	// Get references		XYLine& l1 = rl1->l;	XYPt& u1 = l1.u;	double& d1 = l1.d;	XYPt& p1 = rm1->p;	XYLine& l2 = rl2->l;	XYPt& u2 = l2.u;//	double& d2 = l2.d;		// Construct direction vector and distance scalar		l.u = u2.Rotate90();		double uf1 = l.u.Dot(u1);		if (abs(uf1) < EPS) return;	// parallel lines, no solution		l.d = (d1 + 2 * p1.Dot(l.u) * uf1 - p1.Dot(u1)) / (2 * uf1);		// Make sure point of intersection of fold with l2 lies within the paper.		XYPt pt = Intersection(l, l2);	if (!RefBase::paper.Encloses(pt)) return;		// Make sure point of incidence of p1 on l1 lies within the paper.		XYPt p1p = l.Fold(p1);	if (!RefBase::paper.Encloses(p1p)) return;		// Make sure p1 isn't already on l1 (in which case the alignment is ill-defined).		if (l1.Intersects(p1)) return;		// Check visibility.		bool p1edge = arm1->IsOnEdge();	bool l1edge = arl1->IsOnEdge();		if (ReferenceFinder::visibilityMatters) {		XYPt lp1, lp2;		RefBase::paper.ClipLine(l, lp1, lp2);		double t1 = (lp1 - pt).Dot(l.u);		double t2 = (lp2 - pt).Dot(l.u);		double tp = (p1 - pt).Dot(l.u);		if ((t1 * tp) < 0) {			double ti = t2;			t2 = t1;			t1 = ti;		};	// now t1 is the parameter for the endpoint on the p1 side of l2.		if (p1edge && (abs(t1) <= abs(t2))) whoMoves = p1Moves;		else if (l1edge && (abs(t1) >= abs(t2))) whoMoves = l1Moves;		else return;	}	else {		whoMoves = p1Moves;	};			// If this line creates a skinny flap, we won't use it.		if (RefBase::paper.MakesSkinnyFlap(l)) return;			// Set the key.		FinishConstructor();}/*******	RefLine_L2L_P2L::UsesImmediate(RefBase* rb) - return true if this line uses rb for *	immediate reference.******/const bool RefLine_L2L_P2L::UsesImmediate(RefBase* rb) const{	return (rb == rl1 || rb == rm1 || rb == rl2);}/*******	RefLine_L2L_P2L::SequencePushSelf() - Build the folding sequence*	that constructs this object.******/void RefLine_L2L_P2L::SequencePushSelf(){	switch (whoMoves) {		case p1Moves:			rl1->SequencePushSelf();			rm1->SequencePushSelf();			break;		case l1Moves:			rm1->SequencePushSelf();			rl1->SequencePushSelf();			break;	};	rl2->SequencePushSelf(); 	RefBase::SequencePushSelf();}			/*******	RefLine_L2L_P2L::PutHowto(ostream& os) - Put the name of this line to a stream.******/const bool RefLine_L2L_P2L::PutHowto(ostream& os) const{	if (axiomsInVerbalDirections) os << "[07] ";	os << "Bring ";	rl2->PutName(os);	os << " onto itself so that ";	switch (whoMoves) {		case p1Moves:			rm1->PutName(os);			os << " touches ";			rl1->PutName(os);			break;				case l1Moves:			rl1->PutName(os);			os << " touches ";			rm1->PutName(os);			break;	};	os << ", making ";	PutName(os);	return true;}/*******	RefLine_L2L_P2L::DrawSelf(RefStyle rstyle, short ipass) - Draw this line, *	adding arrows if appropriate******/void RefLine_L2L_P2L::DrawSelf(RefStyle rstyle, short ipass) const{	// Call inherited method to draw the lines		RefLine::DrawSelf(rstyle, ipass);		// If we're moving, we need an arrow		if ((ipass == arrowPass) && (rstyle == actionRef)) {					// Draw line-to-itself arrow				XYPt p1, p2;		XYLine& l2 = rl2->l;		RefBase::paper.ClipLine(l2, p1, p2);	// get endpts of the reference line		XYPt pi = Intersection(l, l2);					// intersection w/ fold line		XYPt u1p = l2.u.Rotate90();						// tangent to reference line		double t1 = abs((p1 - pi).Dot(u1p));		double t2 = abs((p2 - pi).Dot(u1p));		double tmin = t1 < t2 ? t1 : t2;		mDgmr->DrawFoldAndUnfoldArrow(pi + tmin * u1p, pi - tmin * u1p);				// Draw point-to-line arrow				XYPt& p3 = rm1->p;		XYPt p3p = l.Fold(p3);		switch(whoMoves) {			case p1Moves:				mDgmr->DrawFoldAndUnfoldArrow(p3, p3p);				break;			case l1Moves:				mDgmr->DrawFoldAndUnfoldArrow(p3p, p3);				break;		}	}}/*******	RefLine_L2L_P2L::MakeAll(rank_t arank) - Go*	through existing lines and marks and create RefLine_L2L_P2Ls with rank equal arank*	up to a cumulative total of maxLines.******/void RefLine_L2L_P2L::MakeAll(rank_t arank){	for (rank_t irank = 0; irank <= (arank - 1); irank++)		for (rank_t jrank = 0; jrank <= (arank - 1 - irank); jrank++) {			rank_t krank = arank - irank - jrank - 1;			RefContainer<RefLine>::rank_iterator li = 				ReferenceFinder::basisLines.maps[irank].begin();			while (li != ReferenceFinder::basisLines.maps[irank].end()) {				RefContainer<RefMark>::rank_iterator mj = 					ReferenceFinder::basisMarks.maps[jrank].begin();				while (mj != ReferenceFinder::basisMarks.maps[jrank].end()) {					RefContainer<RefLine>::rank_iterator lk = 						ReferenceFinder::basisLines.maps[krank].begin();					while (lk != ReferenceFinder::basisLines.maps[krank].end()) {						if (li != lk) {							if (ReferenceFinder::basisLines.TotalSize() >= 								ReferenceFinder::maxLines) return;							RefLine_L2L_P2L rlh1(li->second, mj->second, lk->second);							ReferenceFinder::basisLines.AddCopyIfValidAndUnique(rlh1);						};						lk++;					};					mj++;				};				li++;			}		}}/********************************************************************************	Section 3: containers for collections of marks and lines**	These containers are templated on the object type; we use the same type for both*	RefMarks and RefLines.*******************************************************************************//************	RefContainer - a container for storing RefMark* and RefLine* that*	organizes them by rank and within a rank, uses a map<R*> to store them. The mKey*	member variable is used as the key in the map; only one object is stored per key.*	class R = RefMark or RefLine***********//*******	RefContainer<R>::RefContainer() - Constructor. Initialize arrays.******/template <class R>RefContainer<R>::RefContainer() : rcsz(0), rcbz(0){	// expand our map array to hold all the ranks that we will create		maps.resize(1 + ReferenceFinder::maxRank);}/*******	RefContainer<R>::TotalSize() - return the total size of the container, including*	all ranks and the buffer.******/template <class R>size_t RefContainer<R>::TotalSize() const{	return rcsz + rcbz;}/*******	RefContainer<R>::AddCopyIfValidAndUnique(Rs& ars) - Check the validity and uniqueness*	of object ars of type Rs (descended from type R), and if it passes, add it to the container.*	Used by all the MakeAll() functions. Note that we use the default (compiler-generated)*	copy constructor, which is OK since our objects only contain POD, pointers that we WANT*	blind-copied, and/or strings (which know how to copy themselves).******/template <class R>template <class Rs>void RefContainer<R>::AddCopyIfValidAndUnique(const Rs& ars){	// The ref is valid (fully constructed) if its key is something other than 0.	// It's unique if the container doesn't already have one with the same key in one of	// the rank maps.		if (ars.mKey != 0 && !Contains(&ars)) Add(new Rs(ars));	ReferenceFinder::OccasionalShowProgress();	// report progress if appropriate}/*******	RefContainer<R>::Reinitialize() - Reinitialize all arrays and related counters.******/template <class R>void RefContainer<R>::Reinitialize(){	rcsz = 0;	rcbz = 0;	resize(0);	maps.resize(0);	maps.resize(1 + ReferenceFinder::maxRank);}/*******	RefContainer<R>::Contains(R* ar) - return true if the container (or the buffer)*	contain an equivalent object.******/template <class R>bool RefContainer<R>::Contains(const R* ar) const{	// go through each rank and look for an object with the same key. If we find one,	// return true.	for (size_t ir = 0; ir < maps.size(); ir++) if (maps[ir].count(ar->mKey)) return true;		// Also check the buffer.		if (buffer.count(ar->mKey)) return true;		// Still here? then we didn't find it.		return false;}/*******	RefContainer<R>::Add(R* ar) - Add an element to the array; to be called only if an equivalent*	element isn't already present anywhere. To avoid corrupting iterators, we add the new*	element to the buffer; it will get added to the main container on the next call to*	FlushBuffer().******/template<class R>void RefContainer<R>::Add(R* ar){	// Add it to the buffer and increment the buffer size.		buffer.insert(map_t::value_type(ar->mKey, ar));	rcbz++;}/*******	RefContainer<R>::FlushBuffer() - put the contents of the buffer into the main container.******/template <class R>void RefContainer<R>::FlushBuffer(){	// Make room for the buffer in the sortable list.		reserve(size() + rcbz);		// Go through the buffer and add each element to the appropriate rank in the main container.		rank_iterator bi = buffer.begin();	while (bi != buffer.end()) {		R*& rr = bi->second;				// get pointer to each new element		maps[rr->mRank].insert(*bi);		// add to the map of the appropriate rank		push_back(rr);						// also add to our sortable list		rcsz++;								// increment our size counter		bi++;								// increment the buffer iterator	};	buffer.clear();							// clear the buffer	rcbz = 0;}/*******	RefContainer<R>::ClearMaps() - clear the map arrays. Called when they're no longer needed.******/template <class R>void RefContainer<R>::ClearMaps(){	for (size_t ir = 0; ir < maps.size(); ir++) maps[ir].clear();}/********************************************************************************	Section 4: routines for building sets of marks and lines and collecting statistics*******************************************************************************//************	CompareError - function object for comparing two refs of class R according to their *	distance from a target value of class X.***********//*******	CompareError<R>::operator()(R* r1, R* r2) - return true if rl1 is*	a better R than rl2. Comparison is strictly on distance, with ties resolved by rank.******/template <class R>bool CompareError<R>::operator()(R* r1, R* r2) const{	// Compare the distances from the stored R::bare_t. If the distances are equal,	// then compare the marks by their rank.		double d1 = r1->Distance(b);	double d2 = r2->Distance(b);		if (d1 == d2) return r1->mRank < r2->mRank;		else return d1 < d2;}/************	CompareRankAndError - function object for comparing two refs of class R according to their *	distance from a target value of class X, but for close points, letting rank win out***********//*******	CompareRankAndError<R>::operator()(R* r1, R* r2) - return true if r1 is*	a better R than r2. **	If either mark is farther than maxError, return true if r1 is closer than r2.*	If both are within maxError, then return true if r1 has a lower rank than r2.*	If both are within maxError and they have the same rank, then return true if r1 is closer.******/template <class R>bool CompareRankAndError<R>::operator()(R* r1, R* r2) const{	// Compare the distances from the given point. If both distances are less than or equal to maxError,	// compare the marks by their rank.		double d1 = r1->Distance(b);	double d2 = r2->Distance(b);			if ((d1 > ReferenceFinder::maxError) || (d2 > ReferenceFinder::maxError)) {		if (d1 == d2) return r1->mRank < r2->mRank;			else return d1 < d2;	}	else {		if (r1->mRank == r2->mRank) return d1 < d2;		else return r1->mRank < r2->mRank;	}}/************	ReferenceFinder - object that builds and maintains collections of marks and lines and*	can search throught the collection for marks and lines close to a target mark or line.***********//*******	ReferenceFinder static member initialization******/RefContainer<RefLine> ReferenceFinder::basisLines;RefContainer<RefMark> ReferenceFinder::basisMarks;void *ReferenceFinder::pShowProgressData = 0;ReferenceFinder::ProgressFn ReferenceFinder::pShowProgress = &ConsoleShowProgress;int ReferenceFinder::numTries;/*******	ReferenceFinder::SetShowProgress(ProgressFn apfn) - install a ProgressFn to use as *	the callback routine, overriding the default method which sends progress to the console.******/void ReferenceFinder::SetShowProgress(ProgressFn apfn, void *d){	pShowProgress = apfn;	pShowProgressData = d;}/*******	ReferenceFinder::ConsoleShowProgress(ProgressMsg pmsg, rank_t arank) - Show progress by*	reporting information to the console. Clients can install their own version of this*	function by calling ReferenceFinder::SetShowProgress(..).******/void ReferenceFinder::ConsoleShowProgress(ProgressMsg pmsg, rank_t arank, void*){#ifndef NO_CONSOLE	switch (pmsg) {		case msgInitializing:	// Called at beginning of initialization			cout << "Initializing using";			if (RefLine_C2P_C2P::include) cout << " O1,";			if (RefLine_P2P::include) cout << " O2,";			if (RefLine_L2L::include) cout << " O3,";			if (RefLine_L2L_C2P::include) cout << " O4,";			if (RefLine_P2L_C2P::include) cout << " O5,";			if (RefLine_P2L_P2L::include) cout << " O6,";			if (RefLine_L2L_P2L::include) cout << " O7,";			cout << " vis=";			if (visibilityMatters) cout << "true";			else cout << "false";			cout << flush;				break;					case msgWorking:		// Called while we're building lines and marks			cout << "." << flush;			break;				case msgRankCompleted:	// Called when we've finished a rank			cout << endl << "There are " << basisLines.TotalSize() << " lines and " << 				basisMarks.TotalSize() << " marks of rank <= " << arank << " " << flush;			break;				case msgInitialized:	// Called when we're completely done			// default doesn't do much, but clients might do something			cout << endl << endl << flush;			break;	}#endif}/*******	ReferenceFinder::OccasionalShowProgress() - routine called by RefContainer<R> to display *	progress during the time-consuming process of initialization. This routine updates its *	private counter each time it's called and only occasionally passes on a full call to *	pShowProgress. Clients can adjust the frequency of calling by changing the variable*	maxTries.******/void ReferenceFinder::OccasionalShowProgress(){	if (numTries < maxTries) numTries++;	else {		(*pShowProgress)(msgWorking, 0, pShowProgressData);		numTries = 0;	}}/*******	ReferenceFinder::MakeAllMarksAndLinesOfRank(rank_t arank) - create all marks and lines *	of a given rank.******/void ReferenceFinder::MakeAllMarksAndLinesOfRank(rank_t arank){	// construct all types of lines of the given rank. Note that the order in which we call	// the MakeAll() functions determines which types of RefLine get built, since the first	// object with a given key to be constructed gets the key slot.		// We give first preference to lines that don't involve making creases through	// points, because these are the hardest to do accurately in practice.		if (RefLine_L2L::include) RefLine_L2L::MakeAll(arank);	if (RefLine_P2P::include) RefLine_P2P::MakeAll(arank);	if (RefLine_L2L_P2L::include) RefLine_L2L_P2L::MakeAll(arank);	if (RefLine_P2L_P2L::include) RefLine_P2L_P2L::MakeAll(arank);		// Next, we'll make lines that put a crease through a single point.		if (RefLine_P2L_C2P::include) RefLine_P2L_C2P::MakeAll(arank);	if (RefLine_L2L_C2P::include) RefLine_L2L_C2P::MakeAll(arank);			// Finally, we'll do lines that put a crease through both points.			if (RefLine_C2P_C2P::include) RefLine_C2P_C2P::MakeAll(arank);				// Having constructed all lines in the buffer, add them to the main collection.		basisLines.FlushBuffer();		// construct all types of marks of the given rank		RefMark_Intersection::MakeAll(arank);		basisMarks.FlushBuffer();		// if we're reporting status, say how many we constructed.		(*pShowProgress)(msgRankCompleted, arank, pShowProgressData);}/*******	ReferenceFinder::MakeAllMarksAndLines() - create all marks and lines sequentially.******/void ReferenceFinder::MakeAllMarksAndLines(){	// Start by clearing out any old marks or lines; this is so we can restart if	// we want.		basisLines.Reinitialize();	basisMarks.Reinitialize();		// First thing we do is a range check on the key quantization. There should be some	// way to do this to generate a compile-time error rather than a run-time error, but	// I haven't figured out a good way to do it.		if (!RefMark::KeySizeOK() || !RefLine::KeySizeOK()) {#ifndef NO_CONSOLE		cout << "Sorry, RefBase::key_t isn't big enough to hold all key values.\n";		cout << "Please redefine key_t to a larger type and recompile the program.\n";#endif		exit(1);	};		// Let the user know that we're initializing and what operations we're using.		(*pShowProgress)(msgInitializing, 0, pShowProgressData);		// Build a bunch of marks of successively higher rank. Note that building lines	// up to rank 4 and marks up to rank 8 with no limits would result in 4185 lines and	// 1,090,203 marks, which would take about 60 MB of memory.		// Rank 0: Construct the four edges of the square.	basisLines.Add(new RefLine_Original(RefBase::paper.bottomEdge, 0, 		string("the bottom edge")));	basisLines.Add(new RefLine_Original(RefBase::paper.leftEdge, 0, 		string("the left edge")));	basisLines.Add(new RefLine_Original(RefBase::paper.rightEdge, 0, 		string("the right edge")));	basisLines.Add(new RefLine_Original(RefBase::paper.topEdge, 0, 		string("the top edge")));			// Rank 0: Construct the four corners of the square.		basisMarks.Add(new RefMark_Original(RefBase::paper.botLeft, 0, 		string("the bottom left corner")));	basisMarks.Add(new RefMark_Original(RefBase::paper.botRight, 0, 		string("the bottom right corner")));	basisMarks.Add(new RefMark_Original(RefBase::paper.topLeft, 0, 		string("the top left corner")));	basisMarks.Add(new RefMark_Original(RefBase::paper.topRight, 0, 		string("the top right corner")));			// Report our status for rank 0.		(*pShowProgress)(msgRankCompleted, 0, pShowProgressData);		// Rank 1: Construct the two diagonals.	basisLines.Add(new RefLine_Original(RefBase::paper.upwardDiagonal, 1, 		string("the upward diagonal")));	basisLines.Add(new RefLine_Original(RefBase::paper.downwardDiagonal, 1, 		string("the downward diagonal")));			// Flush the buffers.		basisLines.FlushBuffer();	basisMarks.FlushBuffer();	// Now build the rest, one rank at a time, starting with rank 1.		for (rank_t irank = 1; irank <= maxRank; irank++) {		MakeAllMarksAndLinesOfRank(irank);	};	// Once that's done, all the objects are in the sortable arrays and we can free up the	// memory used by the maps.		basisLines.ClearMaps();	basisMarks.ClearMaps();		(*pShowProgress)(msgInitialized, 0, pShowProgressData);}/*******	ReferenceFinder::MesserCubeRoot() - this routine builds Peter Messer's construction of *	cube root of 2.	Only used for testing, but I'll leave it in here for edification.******/void ReferenceFinder::MesserCubeRoot(){	// Rank 0: Construct the four edges of the square.	RefLine *be, *le, *re, *te;		ReferenceFinder::basisLines.Add(be = new RefLine_Original(		RefBase::paper.bottomEdge, 0, string("bottom edge")));	ReferenceFinder::basisLines.Add(le = new RefLine_Original(		RefBase::paper.leftEdge, 0, string("left edge")));	ReferenceFinder::basisLines.Add(re = new RefLine_Original(		RefBase::paper.rightEdge, 0, string("right edge")));	ReferenceFinder::basisLines.Add(te = new RefLine_Original		(RefBase::paper.topEdge, 0, string("top edge")));	// Rank 0: Construct the four corners of the square.		RefMark *blc, *brc, *tlc, *trc;		ReferenceFinder::basisMarks.Add(blc = new RefMark_Original(	RefBase::paper.botLeft, 0, string("bot left corner")));	ReferenceFinder::basisMarks.Add(brc = new RefMark_Original(	RefBase::paper.botRight, 0, string("bot right corner")));	ReferenceFinder::basisMarks.Add(tlc = new RefMark_Original(	RefBase::paper.topLeft, 0, string("top left corner")));	ReferenceFinder::basisMarks.Add(trc = new RefMark_Original(	RefBase::paper.topRight, 0, string("top right corner")));	// Create the endpoints of the two initial fold lines		RefMark *rma1, *rma2, *rmb1, *rmb2;		ReferenceFinder::basisMarks.Add(rma1 = new RefMark_Original(XYPt(0, 1./3), 0, 		string("(0, 1/3)")));	ReferenceFinder::basisMarks.Add(rma2 = new RefMark_Original(XYPt(1, 1./3), 0, 		string("(1, 1/3)")));	ReferenceFinder::basisMarks.Add(rmb1 = new RefMark_Original(XYPt(0, 2./3), 0, 		string("(0, 2/3)")));	ReferenceFinder::basisMarks.Add(rmb2 = new RefMark_Original(XYPt(1, 2./3), 0, 		string("(1, 2/3)")));	// Create and add the two initial fold lines.		RefLine *rla, *rlb;		ReferenceFinder::basisLines.Add(rla = new RefLine_C2P_C2P(rma1, rma2));	ReferenceFinder::basisLines.Add(rlb = new RefLine_C2P_C2P(rmb1, rmb2));		// Construct the fold line		RefLine_P2L_P2L rlc(brc, le, rma2, rlb, 0);		// Print the entire sequence	#ifndef NO_CONSOLE	rlc.PutHowtoSequence(cout);#endif		// quit the program		exit(1);}/*******	ReferenceFinder::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks) -- *	Find the best marks closest to a given point ap, storing the results in the vector vm.******/void ReferenceFinder::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks){	vm.resize(numMarks);	partial_sort_copy(basisMarks.begin(), basisMarks.end(), vm.begin(), vm.end(), 		CompareRankAndError<RefMark>(ap));}/*******	ReferenceFinder::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines) -- *	Find the best lines closest to a given line al, storing the results in the vector vl.******/void ReferenceFinder::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines){	vl.resize(numLines);	partial_sort_copy(basisLines.begin(), basisLines.end(), vl.begin(), vl.end(), 		CompareRankAndError<RefLine>(al));}/*******	ReferenceFinder::ValidateMark(XYPt ap) - return true if ap is a valid mark. *	Print an error message if it isn't.******/bool ReferenceFinder::ValidateMark(const XYPt& ap){	if (ap.x < 0 || ap.x > RefBase::paper.pWidth) {#ifndef NO_CONSOLE		cout << endl << "Error -- x coordinate should lie between 0 and " << 			RefBase::paper.pWidth << endl;#endif		return false;	}		if (ap.y < 0 || ap.y > RefBase::paper.pHeight) {#ifndef NO_CONSOLE		cout << endl << "Error -- y coordinate should lie between 0 and " << 			RefBase::paper.pHeight << endl;#endif		return false;	}	return true;}/*******	ReferenceFinder::ValidateLine(XYPt ap1, XYPt ap2) - validate the two entered points *	that define the line. Print an error message if they aren't distinct.******/bool ReferenceFinder::ValidateLine(const XYPt& ap1, const XYPt& ap2){	if ((ap1 - ap2).Mag() > EPS) return true;#ifndef NO_CONSOLE	cout.precision(10);	cout << endl << "Error -- the two points must be distinct (separated by at least " <<		EPS << ")." << endl;#endif	return false;}/*******	void ReferenceFinder::CalcStatistics() - compute statistics on the accuracy of the *	current set of marks for a randomly chosen set of points.******/void ReferenceFinder::CalcStatistics(){#ifndef NO_CONSOLE	const short numBuckets = 11;		// We'll sort errors in buckets of width .001.	int errBucket[numBuckets];			// array of the number of errors in each bucket	for (short i = 0; i < numBuckets; i++) errBucket[i] = 0;	// initialize the array		const int numTries = 1000;		// number of test cases	vector<double> errors(numTries);	// a record of all errors		vector <RefMark*> sortMarks(1);	// a vector to do our sorting into		// Run a bunch of test cases.				cout.precision(4);		cout.setf(ios_base::fixed, ios_base::floatfield);		cout << "(test #) error" << endl;		for (int i = 0; i < numTries; i++) {		// Pick a random coordinate		XYPt testPt((double(rand()) / (RAND_MAX * RefBase::paper.pWidth)), 			double(rand()) / (RAND_MAX * RefBase::paper.pHeight));				// Find the mark closest to the test mark.		partial_sort_copy(basisMarks.begin(), basisMarks.end(), 			sortMarks.begin(), sortMarks.end(), CompareError<RefMark>(testPt));					// note how close we were and print the error, 5 to a line		errors[i] = (testPt - sortMarks[0]->p).Mag();		cout << "(" << i + 1 << "/" << numTries << ") " << errors[i] << ", ";		if (fmod((double)i + 1, 5) == 0) cout << endl;				// also, compute a bucket index for this error		int errindex = int(errors[i] / .001);				// over the top goes into last bucket		if (errindex >= numBuckets) errindex = numBuckets - 1;				// record the error into the appropriate bucket				errBucket[errindex] += 1;	}		// Now print the distribution of errors		cout.precision(1);	cout << endl << "Distribution of errors:" << endl;	int cum = 0;	for (int i = 0; i < numBuckets -1; i++) {		cum += errBucket[i];		cout << "error < " << .001 * (i + 1) << " = " << cum << 			"(" << 100. * double(cum) / numTries << "%)" << endl;	}	cout << "error > 0.01 = " << numTries - cum <<		"(" << 100. * double(numTries - cum) / numTries << "%)" << endl;			// sort the errors and print percentiles of the errors		sort(errors.begin(), errors.end());	cout.precision(4);	cout << endl << "Distribution of errors:" << endl;	cout << "10th percentile :" << errors[int(.10 * numTries)] << endl;	cout << "20th percentile :" << errors[int(.20 * numTries)] << endl;	cout << "50th percentile :" << errors[int(.50 * numTries)] << endl;	cout << "80th percentile :" << errors[int(.80 * numTries)] << endl;	cout << "90th percentile :" << errors[int(.90 * numTries)] << endl;	cout << "95th percentile :" << errors[int(.95 * numTries)] << endl;	cout << "99th percentile :" << errors[int(.99 * numTries)] << endl;	cout << endl;#endif}/********************************************************************************	Section 5: Routines for drawing diagrams*******************************************************************************//************	RefDgmr - object that draws folding diagrams of references. Subclasses specialize*	to particular drawing environments (print vs screen, multiple GUIs, platform-specific*	drawing models, etc.***********//*	Notes on RefDgmr and its descendants.	Subclasses will typically maintain an internal graphics state that describes the location	of the diagram on the canvas and will implement the handful of virtual drawing methods	that render the diagram on the canvas. The base class does nothing. All points are given	in the paper coordinate system. The subclass implementation of drawing should determine	the layout of the diagrams and offset and scale appropriately to convert to canvas	coordinates. See PSFileDgmr for an example.*/	/*******	RefDgmr::DrawPt(const XYPt& aPt, PointStyle pstyle) - *	draw a point in the given style.******/void RefDgmr::DrawPt(const XYPt& /* aPt */, PointStyle /* pstyle */){}/*******	RefDgmr::DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle) - *	draw a line in the given style.******/void RefDgmr::DrawLine(const XYPt& /* fromPt */, const XYPt& /* toPt */, LineStyle /* lstyle */){}/*******	RefDgmr::DrawArc(const XYPt& ctr, const double rad, const double fromAngle,*	const double toAngle, LineStyle lstyle) - draw an arc in the given style.*	fromAngle and toAngle are given in radians.******/void RefDgmr::DrawArc(const XYPt& /* ctr */, const double /* rad */, const double /* fromAngle */,	const double /* toAngle */, const bool /* ccw */, LineStyle /* lstyle */){}/*******	RefDgmr::DrawPoly(const vector<XYPt>& poly, PolyStyle pstyle) -*	draw a polygon in the given style.******/void RefDgmr::DrawPoly(const vector<XYPt>& /* poly */, PolyStyle /* pstyle */){}/*******	RefDgmr::DrawLabel(const XYPt& aPt, const string& aString, LabelStyle lstyle) -*	draw a label at a given point******/void RefDgmr::DrawLabel(const XYPt& /* aPt */, const string& /* aString */, 	LabelStyle /* lstyle */){}/*	Class RefDgmr provides a set of routines for drawing arrows that are built on top of	the primitive routines above. These can be overridden if you want to implement a different	style of arrow.*//*******	RefDgmr::DrawValleyArrowhead(const XYPt& loc, const XYPt& dir, const double len) -*	Draw a valley-fold arrowhead with tip at location loc, direction dir, and size len.******/void RefDgmr::DrawValleyArrowhead(const XYPt& loc, const XYPt& dir, const double len){	DrawLine(loc, loc - len * dir.RotateCCW(.523), arrowLine);	DrawLine(loc, loc - len * dir.RotateCCW(-.523), arrowLine);}/*******	RefDgmr::DrawMountainArrowhead(const XYPt& loc, const XYPt& dir, const double len) -*	Draw a mountain arrowhead with tip at location loc, direction dir, and size len.******/void RefDgmr::DrawMountainArrowhead(const XYPt& loc, const XYPt& dir, const double len){	XYPt ldir = len * dir;	vector<XYPt> poly;	poly.push_back(loc);	poly.push_back(loc - ldir.RotateCCW(.523));	poly.push_back(loc - .8 * ldir);	DrawPoly(poly, arrowPoly);}/*******	RefDgmr::DrawUnfoldArrowhead(const XYPt& loc, const XYPt& dir, const double len) -*	Draw an unfold arrowhead with tip at location loc, direction dir, and size len.******/void RefDgmr::DrawUnfoldArrowhead(const XYPt& loc, const XYPt& dir, const double len){	XYPt ldir = len * dir;	vector<XYPt> poly;	poly.push_back(loc);	poly.push_back(loc - ldir.RotateCCW(.523));	poly.push_back(loc - .8 * ldir);	poly.push_back(loc - ldir.RotateCCW(-.523));	DrawPoly(poly, arrowPoly);}/*******	CalcArrow(const XYPt& fromPt, const XYPt& toPt,*	XYPt& ctr, double& rad, double& fromAngle, double& toAngle, bool& ccw,*	XYPt& fromDir, XYPt& toDir) - calculate all the parameters necessary to draw*	any type of arrow (valley, mountain, unfold, fold-and-unfold).******/void RefDgmr::CalcArrow(const XYPt& fromPt, const XYPt& toPt,	XYPt& ctr, double& rad, double& fromAngle, double& toAngle, bool& ccw,	double& ahSize, XYPt& fromDir, XYPt& toDir){	const double RADIANS = 57.29577951;	const double TWO_PI = 6.283185308;	const double PI = 3.1415926535;		const double ha = 30 / RADIANS;			// half-angle of arc of arrow, in degrees	const double tana = tan(ha);			// tan of this angle		XYPt mp = MidPoint(fromPt, toPt);		// midpoint of arrow line	XYPt mu = (toPt - fromPt);				// vector in direction of arrow line	XYPt mup = 0.5 * mu.Rotate90() / tana;	// vector from midpt to center of curvature		// Compute the center of rotation. There are two possible choices.	// We'll want the bulge of the arc to always be toward the inside of the square,	// i.e., closer to the middle of the square, so we pick the value of the center	// that's farther away.		XYPt sqmp = MidPoint(RefBase::paper.botLeft, RefBase::paper.topRight);	XYPt ctr1 = mp + mup;	XYPt ctr2 = mp - mup;	ctr = (ctr1 - sqmp).Mag() > (ctr2 - sqmp).Mag() ? ctr1 : ctr2;	// radius of the arc.	rad = (toPt - ctr).Mag();		// Now compute the angles of the lines to the two points.		XYPt fp = fromPt - ctr;	fromAngle = atan2(fp.y, fp.x);	XYPt tp = toPt - ctr;	toAngle = atan2(tp.y, tp.x);		// Check direction of rotation.		double ra = toAngle - fromAngle;	// rotation angle	while (ra < 0) ra += TWO_PI;		// get it into the right range	while (ra > TWO_PI) ra -= TWO_PI;		ccw = (ra < PI);					// true == arc goes in ccw direction		// Compute the size of the arrowheads		ahSize = RefBase::paper.pWidth;	if (ahSize > RefBase::paper.pHeight) ahSize = RefBase::paper.pHeight;	ahSize *= 0.15;	double ah1 = 0.4 * (toPt - fromPt).Mag();	if (ahSize > ah1) ahSize = ah1;		// Compute the direction vectors for the arrowheads		mu.NormalizeSelf();	toDir = ccw ? mu.RotateCCW(ha) : mu.RotateCCW(-ha);	mu *= -1;	fromDir = ccw ? mu.RotateCCW(-ha) : mu.RotateCCW(ha);}/*******	RefDgmr::DrawValleyArrow(XYPt& fromPt, XYPt& toPt) - draw a valley-fold*	arrows. fromPt is the moving point, toPt is the destination.******/void RefDgmr::DrawValleyArrow(const XYPt& fromPt, const XYPt& toPt){	XYPt ctr;	double rad;	double fromAngle;	double toAngle;	bool ccw;	double ahSize;	XYPt fromDir;	XYPt toDir;	CalcArrow(fromPt, toPt, ctr, rad, fromAngle, toAngle, ccw, ahSize, fromDir, toDir);	DrawArc(ctr, rad, fromAngle, toAngle, ccw, arrowLine);	DrawValleyArrowhead(toPt, toDir, ahSize);}/*******	RefDgmr::DrawMountainArrow(XYPt& fromPt, XYPt& toPt) - draw a mountain-fold*	arrows. fromPt is the moving point, toPt is the destination.******/void RefDgmr::DrawMountainArrow(const XYPt& fromPt, const XYPt& toPt){	XYPt ctr;	double rad;	double fromAngle;	double toAngle;	bool ccw;	double ahSize;	XYPt fromDir;	XYPt toDir;	CalcArrow(fromPt, toPt, ctr, rad, fromAngle, toAngle, ccw, ahSize, fromDir, toDir);	DrawArc(ctr, rad, fromAngle, toAngle, ccw, arrowLine);	DrawMountainArrowhead(toPt, toDir, ahSize);}/*******	RefDgmr::DrawUnfoldArrow(XYPt& fromPt, XYPt& toPt) - draw a unfold*	arrows. fromPt is the moving point, toPt is the destination.******/void RefDgmr::DrawUnfoldArrow(const XYPt& fromPt, const XYPt& toPt){	XYPt ctr;	double rad;	double fromAngle;	double toAngle;	bool ccw;	double ahSize;	XYPt fromDir;	XYPt toDir;	CalcArrow(fromPt, toPt, ctr, rad, fromAngle, toAngle, ccw, ahSize, fromDir, toDir);	DrawArc(ctr, rad, fromAngle, toAngle, ccw, arrowLine);	DrawUnfoldArrowhead(toPt, toDir, ahSize);}/*******	RefDgmr::DrawFoldAndUnfoldArrow(XYPt& fromPt, XYPt& toPt) - draw a fold-and-unfold*	arrows. fromPt is the moving point, toPt is the destination.******/void RefDgmr::DrawFoldAndUnfoldArrow(const XYPt& fromPt, const XYPt& toPt){	XYPt ctr;	double rad;	double fromAngle;	double toAngle;	bool ccw;	double ahSize;	XYPt fromDir;	XYPt toDir;	CalcArrow(fromPt, toPt, ctr, rad, fromAngle, toAngle, ccw, ahSize, fromDir, toDir);	DrawArc(ctr, rad, fromAngle, toAngle, ccw, arrowLine);	DrawValleyArrowhead(toPt, toDir, ahSize);	DrawUnfoldArrowhead(fromPt, fromDir, ahSize);}/************	class ConsoleTextDgmr - a minimal subclass of RefDgmr that puts verbal-only descriptions*	to the console.***********//*******	ConsoleTextDgmr::PutRefList(const R::bare_t& ar, vector<R*>& vr) - Write a list of *	references to the console, along with their error and how-to description. *	This template function is used in the mark- and line-specific routines that follow.******/template <class R>void ConsoleTextDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr){	RefBase::SetClarifyVerbalAmbiguities(true);	// resolve all ambiguities with extra info	RefBase::SetAxiomsInVerbalDirections(true);	// list the axioms with each alignment		// Print out the distance error, rank, and instructions for each ref.		cout << endl;	for (size_t i = 0; i < vr.size(); i++) {		vr[i]->PutDistanceAndRank(cout, ar);		cout << endl;		vr[i]->PutHowtoSequence(cout);	};	cout << endl;}/*******	ConsoleTextDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl) - *	write a list of lines to the console, including error and how-to description.******/void ConsoleTextDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl){	PutRefList(ll, vl);}/*******	ConsoleTextDgmr::PutMarkList(const XYPt& pp, vector<RefMark*> vm) - *	write a list of marks to the console, including error and how-to description.******/void ConsoleTextDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm){	PutRefList(pp, vm);}/************	PSFileDgmr - a specialization of RefDgmr that writes a PostScript file of diagrams.***********//*******	PSFileDgmr static member initialization******/double PSFileDgmr::usize = 64;		// 72 pts = 1 inch, 1 unit = 64 pts, fits 7 dgmsXYPt PSFileDgmr::origin;								// just needs to be initializedconst XYRect PSFileDgmr::pageSize(40, 40, 572, 752);	// printable area on the pageint PSFileDgmr::fileNum = 0;							// counter for output filesstring PSFileDgmr::fileName;							// name of output file/*******	PSFileDgmr::PSPt::PSPt(const XYPt& aPt) - constructor for a PostScript point, which*	scales the XYPt and offsets its according to the static variables origin and usize.******/PSFileDgmr::PSPt::PSPt(const XYPt& aPt) : 	px(origin.x + usize * aPt.x), 	py(origin.y + usize * aPt.y){}/*******	operator<<(ostream& os, const PSPt& pp) - Stream output for a PostScript point******/ostream& operator<<(ostream& os, const PSFileDgmr::PSPt& pp){	return os << pp.px << " " << pp.py;}/*******	PSFileDgmr::SetPointStyle(PointStyle pstyle) - set the current graphics state to the*	given PointStyle.******/void PSFileDgmr::SetPointStyle(PointStyle pstyle){	switch (pstyle) {		case normalPt:			psfile << "1 setlinewidth 0 setgray " << endl;			break;		case hilitePt:			psfile << "3 setlinewidth .5 .25 .25 setrgbcolor " << endl;			break;		case actionPt:			psfile << "3 setlinewidth .5 0 0 setrgbcolor " << endl;			break;	}}/*******	PSFileDgmr::SetLineStyle(LineStyle lstyle) - set the current graphics state to the*	given LineStyle******/void PSFileDgmr::SetLineStyle(LineStyle lstyle){	switch (lstyle) {		case creaseLine:			psfile << "[] 0 setdash .20 setlinewidth 0 setgray " << endl;			break;		case edgeLine:			psfile << "[] 0 setdash .5 setlinewidth 0 setgray " << endl;			break;		case hiliteLine:			psfile << "[] 0 setdash 1 setlinewidth 1 .5 .5 setrgbcolor " << endl;			break;		case valleyLine:			psfile << "[4 3] 0 setdash .5 setlinewidth 1 0 0 setrgbcolor " << endl;			break;		case mountainLine:			psfile << "[3 3 0 3 0 3] 0 setdash .5 setlinewidth 1 0 0 setrgbcolor " << endl;			break;		case arrowLine:			psfile << "[] 0 setdash .4 setlinewidth 0 .5 0 setrgbcolor " << endl;			break;	}}/*******	PSFileDgmr::SetPolyStyle(PolyStyle pstyle) - set the current graphics state to the*	given PolyStyle******/void PSFileDgmr::SetPolyStyle(PolyStyle pstyle){	switch (pstyle) {		case whitePoly:			psfile << ".95 .95 1 setrgbcolor " << endl;			break;		case coloredPoly:			psfile << "0 0 .5 setrgbcolor " << endl;			break;		case arrowPoly:			psfile << ".95 1 .95 setrgbcolor " << endl;			break;	}}/*******	PSFileDgmr::SetLabelStyle(LabelStyle lstyle) - set the current graphics state to the*	given LabelStyle******/void PSFileDgmr::SetLabelStyle(LabelStyle lstyle){	switch (lstyle) {		case normalLabel:			psfile << "0 setgray " << endl;			break;		case hiliteLabel:			psfile << ".5 .25 .25 setrgbcolor " << endl;			break;		case actionLabel:			psfile << ".5 0 0 setrgbcolor " << endl;			break;	}}/*******	PSFileDgmr::DrawPt(const XYPt& aPt, PointStyle pstyle) - draw a PostScript*	point in the indicated style.******/void PSFileDgmr::DrawPt(const XYPt& aPt, PointStyle pstyle){	SetPointStyle(pstyle);	psfile << "newpath " << PSPt(aPt) << " moveto 0 0 rlineto stroke" << endl;}/*******	PSFileDgmr::DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle) -*	Draw a PostScript line in the indicated style.******/void PSFileDgmr::DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle){	SetLineStyle(lstyle);	psfile << "newpath " << PSPt(fromPt) << " moveto " << PSPt(toPt) << " lineto stroke" << endl;}/*******	PSFileDgmr::DrawArc(const XYPt& ctr, const double rad, const double fromAngle,	const double toAngle, LineStyle lstyle) - draw a PostScript arc in the indicated style.******/void PSFileDgmr::DrawArc(const XYPt& ctr, const double rad, const double fromAngle,	const double toAngle, bool ccw, LineStyle lstyle){	SetLineStyle(lstyle);	const double RADIANS = 57.29577951;	if (ccw)		psfile << "newpath " << PSPt(ctr) << " " << rad * usize << " " << 		fromAngle * RADIANS << " " << toAngle * RADIANS  << " arc stroke" << endl;	else		psfile << "newpath " << PSPt(ctr) << " " << rad * usize << " " << 		fromAngle * RADIANS  << " " << toAngle * RADIANS  << " arcn stroke" << endl;}/*******	PSFileDgmr::DrawPoly(const vector<XYPt>& poly, PolyStyle pstyle) -*	Fill and stroke the given poly in the indicated style.******/void PSFileDgmr::DrawPoly(const vector<XYPt>& poly, PolyStyle pstyle){	psfile << "newpath " << PSPt(poly[poly.size()-1]) << " moveto " << endl;	for (size_t i = 0; i < poly.size(); i++)		psfile << PSPt(poly[i]) << " lineto" << endl;	psfile << "gsave " << endl;	// Fill the poly		SetPolyStyle(pstyle);	psfile << "fill grestore " << endl;		// Stroke the poly		switch (pstyle) {		case whitePoly:		case coloredPoly:			SetLineStyle(edgeLine);			break;		case arrowPoly:			SetLineStyle(arrowLine);			break;	};	psfile << "stroke " << endl;}/*******	PSFileDgmr::DrawLabel(const XYPt& aPt, const string& aString, labelStyle lstyle) -*	Draw a text label at the point aPt in the indicated style******/void PSFileDgmr::DrawLabel(const XYPt& aPt, const string& aString, LabelStyle lstyle){	SetLabelStyle(lstyle);	psfile << PSPt(aPt) << " moveto (" << aString << ") show " << endl;}/*******	PSFileDgmr::DecrementOrigin(double d) - decrement the origin by a distance*	d. If we drop below the bottom margin, start a new page.******/void PSFileDgmr::DecrementOrigin(double d){	origin.y -= d;	if (origin.y >= pageSize.bl.y) return;	psfile << "showpage" << endl;	psfile << "%%Page: " << ++pageNum << " " << pageNum << endl;	origin.y = pageSize.tr.y - d;}	/*******	PSFileDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr) -*	Draw a set of marks or lines to a PostScript file, showing distance and rank for*	each sequence.******/template <class R>void PSFileDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr){	RefBase::SetClarifyVerbalAmbiguities(false);	// don't need extra info with diagrams	RefBase::SetAxiomsInVerbalDirections(false);	// don't need axiom numbers	// Open a file for output.	stringstream filestr;	filestr << "ReferenceFinder_" << setw(3) << setfill('0') << ++fileNum << ".ps";	fileName = filestr.str();	// note filename in static variable for future reference	psfile.open(fileName.c_str(), ios::out | ios::trunc);	if (!psfile.good()) {		cout << "error opening file" << endl;		return;	};		// Put some comments so our readers are happy		psfile << "%!PS-Adobe-1.0" << endl;	psfile << "%%Pages: (atend)" << endl;	psfile << "%%EndComments" << endl;	psfile << "%%Page: 1 1" << endl;		// Set the page number. DecrementOrigin will update it as needed	pageNum = 1;		// Put some initial setup information		psfile << "1 setlinecap" << endl;	psfile << "1 setlinejoin" << endl;		// Setup and draw a header.		origin.x = pageSize.bl.x;	origin.y = pageSize.tr.y;	psfile << "/Times-Roman findfont 12 scalefont setfont" << endl;	psfile << "0 setgray" << endl;	DecrementOrigin(12);	DrawLabel(XYPt(0), "ReferenceFinder 3.1 by Robert J. Lang", normalLabel);		// Note the point we're searching for.	psfile << "/Times-Roman findfont 9 scalefont setfont" << endl;	DecrementOrigin(12);	stringstream targstr;	targstr << "Target: " << ar;	DrawLabel(XYPt(0), targstr.str(), normalLabel);		// Go through our list and draw all the diagrams in a single row.		for (size_t irow = 0; irow < vr.size(); irow++) {		DecrementOrigin(1.2 * usize * RefBase::paper.pHeight);		vr[irow]->BuildDiagrams();		origin.x = pageSize.bl.x;		for (size_t icol = 0; icol < RefBase::mDgms.size(); icol++) {			RefBase::DrawDiagram(*this, RefBase::mDgms[icol]);			origin.x += 1.2 * RefBase::paper.pWidth * usize;		};				// Also put the text description below the diagrams				origin.x = pageSize.bl.x;		DecrementOrigin(11);		ostringstream sd;		vr[irow]->PutDistanceAndRank(sd, ar);		DrawLabel(XYPt(0), sd.str(), normalLabel);		for (size_t i = 0; i < RefBase::mSequence.size(); i++) {			origin.x = pageSize.bl.x;			ostringstream s;			if (RefBase::mSequence[i]->PutHowto(s)) {				DecrementOrigin(11);				s << ".";				DrawLabel(XYPt(0), s.str(), normalLabel);			}		}	};		// Close the file.		psfile << "showpage" << endl;	psfile << "%%Trailer" << endl;	psfile << "%%Pages: " << pageNum << endl;	psfile.close();}/*******	PSFileDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm) -*	Write the PostScript code that draws folding sequences for a list of marks.******/void PSFileDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm){	PutRefList(pp, vm);}/*******	PSFileDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl) -*	Write the PostScript code that draws folding sequences for a list of lines.******/void PSFileDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl){	PutRefList(ll, vl);}
\ No newline at end of file
+/******************************************************************************
+
+	ReferenceFinder - a program for finding compact folding sequences for locating 
+	approximate reference points on a unit square.
+	
+	Version 3.1
+	
+	Copyright ©1999-2003 by Robert J. Lang. All rights reserved.
+	
+	Rights of usage: you may compile this code and modifications thereof for your 
+	own personal use. You may not redistribute this code or modifications thereof.
+	
+	ReferenceFinder is ANSI C++ code that should compile for any compiler/platform
+	that supports the C++ standard library.
+	
+	After the program initializes, the user is prompted for x and y coordinates of
+	a desired point or line. The program responds with several folding sequences based on 
+	lines and marks made by folding (no measuring).
+	
+	See file "README.txt" for version history and compilation notes.
+
+******************************************************************************/
+ 
+#include "ReferenceFinder.h"
+
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+#include <iomanip>
+#include <cstring>
+#include <ctime>
+
+// #define USE_MMAP to map snapshot files directly into memory (POSIX systems); otherwise
+// snapshots are read with an ifstream.
+
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// #define USE_AVX2 to compute the distances of search candidates four at a time with
+// AVX2 instructions, on processors that have them (GCC and compatible compilers).
+
+#ifdef USE_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+// #define NO_CONSOLE to suppress all console functions (e.g., for a standalone module)
+// other than in class ConsoleTextDgmr, which is expressly designed for console output.
+
+
+/*****
+*
+*	static member initialization -- variables that you might want to change (because they
+*	alter the behavior of the program) are defined here. Other static member variables are 
+*	defined lower down in their respective sections.
+*
+*****/
+
+// Maximum rank and number of marks and lines to collect. These can be tweaked 
+// up or down to trade off accuracy versus memory and initialization time.
+
+RefBase::rank_t ReferenceFinder::maxRank = 6;
+size_t ReferenceFinder::maxLines = 249323;
+size_t ReferenceFinder::maxMarks = 300000;
+
+// If memoryBudget isn't 0, MakeAllMarksAndLines() sets maxLines and maxMarks, in the 
+// same proportion as above, so that the marks and lines take about that many bytes.
+
+size_t ReferenceFinder::memoryBudget = 0;
+
+// If maxSeconds isn't 0, building stops once that many seconds have gone by (as told by 
+// a monotonic clock where there is one), and whatever was made by then is what we have. 
+// If fairShares == true, each rank gets an even share of the room for lines and marks 
+// left for it and the ranks above it, and each kind of line an even share of what's left 
+// of its rank's when its turn comes; room that one doesn't use goes to the ones after it. 
+// Otherwise, the kinds made first can use up all the room.
+
+double ReferenceFinder::maxSeconds = 0;
+bool ReferenceFinder::fairShares = false;
+
+// constants that quantify the discretization of marks and lines in forming keys.
+// The maximum key has the value (xNum * yNum) for marks, (aNum * dNum) for lines.
+// These numbers set a limit on the accuracy, since we won't create more than one
+// object for a given key. Finer ones need a bigger key_t (see USE_WIDE_KEYS) once
+// the product gets past the range of an int.
+
+int RefMark::xNum = 2000;
+int RefMark::yNum = 2000;
+int RefLine::aNum = 2000;
+int RefLine::dNum = 2000;
+	
+// Defines "good enough" for a mark. For marks with errors better than this, we give
+// priority to lower-rank marks.
+
+double ReferenceFinder::maxError = .005;
+
+// If useSearchIndex == true, FindBestMarks() and FindBestLines() only look at the 
+// marks and lines near the target instead of scanning the whole collection (through the
+// coordinate arrays of the indexes). The results are the same either way.
+
+bool ReferenceFinder::useSearchIndex = true;
+
+// If coverageCells isn't 0, the indexes come with coverage tables of coverageCells by 
+// coverageCells cells, one over the paper for marks and one over (angle, d) for lines, 
+// which list up to coverageDepth of the best refs for targets in each cell. If 
+// useCoverage == true, FindBestMarks() and FindBestLines() answer from a table when it
+// can vouch for the answer, which again is the same either way. The tables are made 
+// for the value of maxError at the time and aren't used if it changes.
+
+int ReferenceFinder::coverageCells = 0;
+int ReferenceFinder::coverageDepth = 64;
+bool ReferenceFinder::useCoverage = true;
+
+// Minimum allowable aspect ratio for a flap. Too skinny of a flap can't be folded
+// accurately.
+
+double ReferenceFinder::minAspectRatio = 0.100;
+
+// Sine of minimum intersection angle between creases that define a new mark. If
+// the lines are close to parallel, the mark is imprecise.
+
+double ReferenceFinder::minAngleSine = 0.342;	// = sin(20 degrees)
+
+// If visibilityMatters == true, we don't construct alignments that can't be made
+// with opaque paper. Otherwise, we allow alignments that can be done with 
+// translucent paper.
+
+bool ReferenceFinder::visibilityMatters = true;
+
+// These are switches by which we can turn on and off the use of different types
+// of alignments. Default is to use all possible.
+
+bool RefLine_C2P_C2P::include = true;
+bool RefLine_P2P::include = true;
+bool RefLine_L2L::include = true;
+bool RefLine_L2L_C2P::include = true;
+bool RefLine_P2L_C2P::include = true;
+bool RefLine_P2L_P2L::include = true;
+bool RefLine_L2L_P2L::include = true;
+
+// Name of the file in which MakeAllMarksAndLines() keeps a snapshot of the marks and lines,
+// so that later runs with the same settings don't have to build them again. Empty (the 
+// default) means always build from scratch and write no file.
+
+string ReferenceFinder::snapshotName = "";
+
+// If loadSnapshot == false, MakeAllMarksAndLines() ignores the snapshot and builds 
+// everything (which fills in buildStats), then saves a new snapshot.
+
+bool ReferenceFinder::loadSnapshot = true;
+
+// We make a call to our show progress callback routine every maxTries attempts.
+
+int ReferenceFinder::maxTries = 200000;
+
+// Number of threads that build each rank of marks and lines, and that answer batches of
+// searches; 0 means one per processor. Without USE_PTHREADS, everything is serial.
+
+int ReferenceFinder::numThreads = 0;
+
+// Letters that are used for labels for marks and lines.
+
+char RefLine::mLabels[] = "ABCDEFGHIJ";
+char RefMark::mLabels[] = "PQRSTUVWXYZ";
+
+// Use unit square paper
+
+Paper RefBase::paper(1.0, 1.0);
+
+
+/******************************************************************************
+*
+*	Section 1: lightweight classes that represent points and lines
+*
+******************************************************************************/
+
+
+/**********
+*
+*	XYPt - a 2-vector that represents a point or 2-vector (direction vector).
+*	It is a lightweight mathematical object. Most operations are defined in the
+*	header, intended to be inlined for speed.
+*
+**********/
+
+
+/*****
+*
+*	operator<<(ostream& os, const XYPt& p) - Stream I/O for a XYPt spits out the 
+*	point as a parenthesis-enclosed, comma-delimited pair.
+*
+*****/
+
+ostream& operator<<(ostream& os, const XYPt& p)
+{
+	return os << "(" << (p.x) << "," << (p.y) << ")";
+}
+
+
+/**********
+*
+*	XYLine - a class for representing a line by a scalar d and the unit normal to the
+*	line, u, where the point d*u is the point on the line closest to the origin. 
+*	Note that (d,u) and (-d,-u) represent the same line. If u isn't a unit vector,
+*	many things will break, so when in doubt, use Normalize() or NormalizeSelf().
+*
+**********/
+
+/*****
+*
+*	operator<<(ostream& os, const XYLine& l) - Stream I/O for a XYLine spits out the 
+*	values of d and u as a parenthesis-enclosed, comma-delimited pair, e.g., "(0,(1,0))".
+*
+*****/
+
+ostream& operator<<(ostream& os, const XYLine& l)
+{
+	return os << "(" << (l.d) << "," << (l.u) << ")";
+}
+
+
+/**********
+*
+*	XYRect - a class for representing rectangles by two points, the bottom left and
+*	top right corners.
+*
+**********/
+
+/*****
+*
+*	XYRect::GetAspectRatio() - return the aspect ratio of the rectangle, defined to be
+*	the smaller dimension divided by the larger dimension. If it's empty, return zero.
+*	If the rectangles is improperly defined, the aspect ratio may be negative.
+*
+*****/
+
+const double XYRect::GetAspectRatio() const
+{
+	double wd = GetWidth();
+	double ht = GetHeight();
+	if (abs(wd) < EPS && abs(ht) < EPS) return 0;
+	if (abs(wd) <= abs(ht)) return wd / ht;
+	return ht / wd;
+}
+
+
+/*****
+*
+*	XYRect::Include(const XYPt& p) - expand the XYRect to include the point p.
+*
+*****/
+
+XYRect& XYRect::Include(const XYPt& p)
+{
+	if (bl.x > p.x) bl.x = p.x;
+	if (bl.y > p.y) bl.y = p.y;
+	if (tr.x < p.x) tr.x = p.x;
+	if (tr.y < p.y) tr.y = p.y;
+	return *this;
+}
+
+
+/*****
+*
+*	BoundingBox(const XYPt& p1, const XYPt& p2) - return an XYRect that includes both points.
+*
+*****/
+
+const XYRect BoundingBox(const XYPt& p1, const XYPt& p2)
+{
+	XYRect r(p1);
+	return r.Include(p2);
+}
+
+
+/*****
+*
+*	BoundingBox(const XYPt& p1, const XYPt& p2, const XYPt& p3) - return an XYRect that
+*	includes all three points.
+*
+*****/
+
+const XYRect BoundingBox(const XYPt& p1, const XYPt& p2, const XYPt& p3)
+{
+	XYRect r(p1);
+	return r.Include(p2).Include(p3);
+}
+
+
+/*****
+*
+*	operator<<(ostream& os, const XYRect& r) - Stream I/O for a XYRect spits out the 
+*	values of bl and tr as a parenthesis-enclosed, comma-delimited pair, 
+*	e.g., "((0,0),(1,1))".
+*
+*****/
+
+ostream& operator<<(ostream& os, const XYRect& r)
+{
+	return os << "(" << (r.bl) << "," << (r.tr) << ")";
+}
+
+
+/******************************************************************************
+*
+*	Section 2: classes that represent reference marks and lines on a piece of paper
+*
+******************************************************************************/
+
+
+/**********
+*
+*	Paper - specialization of XYRect, used for representing the paper
+*
+**********/
+
+/*	Note: don't screw around with the order of Paper's member variables because
+	we rely on that order for constructor initialization. */
+
+/*****
+*
+*	Paper(double aWidth, double aHeight) - constructor sets the values of several
+*	other member variables that are useful to have around.
+*
+*****/
+
+Paper::Paper(double aWidth, double aHeight) : 
+	XYRect(0, 0, aWidth, aHeight), 
+	pWidth(aWidth), pHeight(aHeight),
+	botLeft(0, 0),
+	botRight(aWidth, 0),
+	topLeft(0, aHeight),
+	topRight(aWidth, aHeight),
+	topEdge(topLeft, topRight),
+	leftEdge(botLeft, topLeft),
+	rightEdge(botRight, topRight),
+	bottomEdge(botLeft, botRight),
+	upwardDiagonal(botLeft, topRight),
+	downwardDiagonal(topLeft, botRight)
+{
+}
+
+
+/*****
+*
+*	Paper::ClipLine(const XYLine& al, XYPt& ap1, XYPt& ap2) - clip the line al to the paper,
+*	returning the endpoints of the clipped segment in ap1 and ap2. If the line misses the
+*	paper entirely, return false and leave ap1 and ap2 unchanged.
+*
+*****/
+
+const bool Paper::ClipLine(const XYLine& al, XYPt& ap1, XYPt& ap2) const
+{
+	// Start by collecting all points of intersection between the line and the
+	// four sides of the paper.
+	
+	unsigned npts = 0;			// counter for number of points of intersection
+	XYPt ipts[4];				// list of points of intersection
+	XYPt p;						// a scratch pad for intersection points
+	
+	if (topEdge.Intersects(al, p) && Encloses(p)) ipts[npts++] = p;
+	if (leftEdge.Intersects(al, p) && Encloses(p)) ipts[npts++] = p;
+	if (rightEdge.Intersects(al, p) && Encloses(p)) ipts[npts++] = p;
+	if (bottomEdge.Intersects(al, p) && Encloses(p)) ipts[npts++] = p;
+	
+	if (npts == 0) return false;	// line entirely misses the paper
+
+	// Now parameterize all four points along the line, recording the minimum
+	// and maximum parameter values.
+	
+	XYPt pt = al.d * al.u;					// a point on the line
+	XYPt up = al.u.Rotate90();				// a tangent to the line
+	double tmin =( ipts[0] - pt).Dot(up);
+	double tmax = tmin;
+	for (unsigned i = 1; i < npts; i++) {
+		double tt = (ipts[i] - pt).Dot(up);
+		if (tmin < tt) tmin = tt;
+		if (tmax > tt) tmax = tt;
+	};
+	
+	// Compute the endpoints from our parameter ranges.
+	
+	ap1 = pt + tmin * up;
+	ap2 = pt + tmax * up;
+	return true;
+}
+
+
+/*****
+*
+*	Paper::InteriorOverlaps(const XYLine& al) - return true if line al overlaps 
+*	the paper in its interior. Return false if the line misses the paper entirely,
+*	only hits a corner, or only runs along an edge.
+*
+*****/
+
+const bool Paper::InteriorOverlaps(const XYLine& al) const
+{
+	XYPt pa, pb;								// endpoints of the fold line
+	if (!ClipLine(al, pa, pb)) return false;	// the line completely misses the paper
+	
+	if (pa == pb) return false;					// line hits at a single point (a corner)
+	
+	if (!BoundingBox(pa, pb).IsEmpty()) return true;	// bounding box has positive volume
+	
+	// If still here, then the bounding box must be a line, either the edge of the paper
+	// or a vertical or horizontal line in the interior. We can test for the latter by 
+	// seeing if the midpoint of the line lies fully in the interior of the paper.
+	
+	XYPt mp = MidPoint(pa, pb);
+	
+	if (topEdge.Intersects(mp) || bottomEdge.Intersects(mp) || 
+		leftEdge.Intersects(mp) || rightEdge.Intersects(mp)) return false;
+	
+	return true;
+}
+
+
+/*****
+*
+*	Paper::MakesSkinnyFlap(const XYLine& al) - The line al divides the paper into two
+*	portions. Return true if either of the two qualifies as a skinny flap. "Skinny" means
+*	a triangle (or quad) whose aspect ratio falls below a minimum size.
+*
+*****/
+
+const bool Paper::MakesSkinnyFlap(const XYLine& al) const	
+{
+	// Since "true" = "bad", we'll return true for any failures along the way due to bad
+	// input parameters.
+	
+	XYPt p1, p2;						// endpoints of the line al
+	ClipLine(al, p1, p2);				// get the endpoints of the fold line on the paper
+	
+	XYLine lb;							// perpendicular bisector of line segment p1-p2
+	lb.u = al.u.Rotate90();
+	lb.d = MidPoint(p1, p2).Dot(lb.u);
+	XYPt bp1, bp2;						// endpoints of the bisector
+	ClipLine(lb, bp1, bp2);				// get the endpoints of the bisector
+	
+	// Get the bounding box that contains the fold line and a point on either side of the
+	// fold line. If this bounding box is below the minimum aspect ratio, then it contains
+	// a flap that falls below the minimum aspect ratio, so we return true.
+
+	if (abs(BoundingBox(p1, p2, bp1).GetAspectRatio()) < ReferenceFinder::minAspectRatio) 
+		return true;
+	if (abs(BoundingBox(p1, p2, bp2).GetAspectRatio()) < ReferenceFinder::minAspectRatio) 
+		return true;
+	
+	// If we're still here, we didn't create any skinny flaps, so we're cool.
+	
+	return false;
+}
+
+
+/**********
+*
+*	class RefBase - base class for a mark or line. Non-static member variables are:
+*	mRank - the rank, which is the number of creases that need to be made to define it.
+*	mKey - a unique key that is used to efficiently store and search over marks and lines.
+*	mKey is initialized to 0. If the object has been successfully constructed, it will be set
+*	to an integer greater than 0, so mKey>0 is used as a test for successful construction.
+*	A constructor that turns an object down for a reason worth counting sets mKey to minus
+*	that reason (see Reject()); 0 means there was no solution.
+*
+*	The labels used in a verbal sequence are not stored in the refs; they are kept by the
+*	RefContext that the sequence is built in (see below).
+*
+*	Any subclasses of RefBase should be fairly lightweight because we'll be creating a couple 
+*	hundred thousand of them during program initialization.
+*
+**********/
+
+/*****
+*
+*	RefBase static member initialization
+*
+*****/
+
+/*	Notes on Sequences.
+	A ref (RefMark or RefLine) is typically defined in terms of other refs, going all the way
+	back to RefMark_Original and RefLine_Original. The routine aRef->BuildAndNumberSequence()
+	constructs an ordered list of all the refs that make up aRef. The ordering is such that
+	ancestor refs come earlier in the list than refs derived from them. In addition to
+	constructing the list, BuildAndNumberSequence also gives an index to each non-original 
+	ref, so that each can be given a unique name (which depends on the index, and is a 
+	letter, A-J for lines, P-Z for points).
+	
+	Since the same ref can be part of many sequences, the sequence and the indices are kept
+	in a RefContext that the caller supplies rather than in the refs themselves. Each 
+	RefContext holds one sequence at a time, in its public member mSequence, so you can (if
+	you like) read out this sequence; sequences in different contexts are independent.
+*/
+
+/*****
+*
+*	RefBase::RefBase(const RefRecord& ar) - Constructor that restores the rank and key of
+*	a ref from a snapshot record.
+*
+*****/
+
+RefBase::RefBase(const RefRecord& ar) : 
+	mRank(ar.mRank), mKey(ar.mKey)
+{
+}
+
+
+/*****
+*
+*	RefBase::operator new(size_t asize, RefArena& aa) - allocate a ref in arena aa.
+*
+*****/
+
+void* RefBase::operator new(size_t asize, RefArena& aa)
+{
+	return aa.Allocate(asize);
+}
+
+
+/*****
+*
+*	RefBase::SequencePushSelf(RefContext& ac) - appends to the end of ac.mSequence pointers
+*	to all the marks and lines needed to create this mark or line. Default behavior 
+*	is to append a pointer to self.
+*	A subclass line or mark made from others should call SequencePushUnique() for each of 
+*	the elements that define it, and then call the RefBase method for itself.
+*
+*****/
+
+void RefBase::SequencePushSelf(RefContext& ac)
+{
+	SequencePushUnique(ac, this);
+}
+
+
+/*****
+*
+*	RefBase::BuildAndNumberSequence(RefContext& ac) - build a sequence (in ac.mSequence) of 
+*	all of the references that are needed to define this one; also give each reference an 
+*	index in ac so that the relevant RefMarks and RefLines are sequentially numbered.
+*
+*****/
+
+void RefBase::BuildAndNumberSequence(RefContext& ac)
+{
+	// Clear out the old sequence
+	
+	ac.mSequence.clear();
+	
+	// Build the sequence of marks and lines that go into making this object.
+
+	SequencePushSelf(ac);	
+	
+	// Reset the counters for both marks and lines.
+	
+	ac.ResetIndices();
+
+	// go through the list of constituents and give every object a sequential index.
+	
+	for (size_t i = 0; i < ac.mSequence.size(); i++) ac.mSequence[i]->SetIndex(ac);
+}
+
+
+/*****
+*
+*	RefBase::PutHowto(const RefContext& ac, ostream& os) - puts a statement about how to 
+*	make this mark from its constituents to a stream. Overridden by most subclasses. Return
+*	true if we actually put something (original types will return false).
+*
+*****/
+
+const bool RefBase::PutHowto(const RefContext& /* ac */, ostream& /* os */) const
+{
+	return false;
+}
+
+
+/*****
+*
+*	RefBase::PutHowtoSequence(RefContext& ac, ostream& os) - sends the full how-to sequence
+*	to the given stream.
+*
+*****/
+
+ostream& RefBase::PutHowtoSequence(RefContext& ac, ostream& os)
+{
+	// Build and number the sequence of marks and lines that go into making this object.
+
+	BuildAndNumberSequence(ac);	
+	
+	// go through the sequence of references and print how to make the given mark or line.
+	
+	for (size_t i = 0; i < ac.mSequence.size(); i++)
+		if (ac.mSequence[i]->PutHowto(ac, os)) os << "." << endl;
+	return os;
+}
+		
+
+/*	Notes on diagrams.
+	A DgmInfo is a very simple object that contains just a couple of bits of information 
+	necessary to construct a complete diagram from the list of refs contained
+	in mSequence. Any diagram is a subsequence of mSequence, which, in effect, describes
+	all the refs that are already on the paper as well as the ref(s) currently being made. 
+	
+	DgmInfo.idef is the index of the first ref in mSequence that is defined in the current
+	diagram.
+	
+	DgmInfo.iact is the index of the last ref that is defined in the current diagram, 
+	which is the action line, if this diagram includes an action line. idef <= iact.
+*/
+
+/*****
+*
+*	RefBase::BuildDiagrams(RefContext& ac) - Build a set of diagrams that describe how to 
+*	fold this reference, by constructing a list of DgmInfo records in ac.mDgms (which refer 
+*	to elements and subsequences of ac.mSequence).
+*
+*****/
+
+void RefBase::BuildDiagrams(RefContext& ac)
+{
+	vector<DgmInfo>& mDgms = ac.mDgms;
+	
+	// Clear out the old set of diagrams
+	
+	mDgms.clear();
+	
+	// First, we need to build a sequence of all references that go into making this one.
+	
+	BuildAndNumberSequence(ac);
+	
+	// Now, we need to note which elements of the sequence are action lines; there will be
+	// a diagram for each one of these.
+	
+	size_t ss = ac.mSequence.size();
+	for (size_t i = 0; i < ss; i++)
+		if (ac.mSequence[i]->IsActionLine()) mDgms.push_back(DgmInfo(i, i));
+		
+	// We should always have at least one diagram, even if there was only one ref in mSequence
+	// (which happens if the ref was a RefMark_Original or RefLine_Original).
+	
+	if (mDgms.size() == 0) mDgms.push_back(DgmInfo(0, 0));
+	
+	// And we make sure we have a diagram for the last ref in the sequence (which might not
+	// be the case if we ended with a RefMark or an original).
+	
+	if (mDgms[mDgms.size() - 1].iact < ss - 1) mDgms.push_back(DgmInfo(0, ss - 1));
+	
+	// Now we go through and set the idef fields of each DgmInfo record.
+	
+	int id = 0;
+	for (size_t i = 0; i < mDgms.size(); i++) {
+		mDgms[i].idef = id;
+		id = mDgms[i].iact + 1;
+	}
+}
+
+
+/*****
+*
+*	RefBase::DrawPaper(const RefContext& ac) - Draw the paper with the RefDgmr of ac
+*
+*****/
+
+void RefBase::DrawPaper(const RefContext& ac)
+{
+	vector<XYPt> corners;
+	corners.push_back(paper.botLeft);
+	corners.push_back(paper.botRight);
+	corners.push_back(paper.topRight);
+	corners.push_back(paper.topLeft);
+	ac.mDgmr->DrawPoly(corners, RefDgmr::whitePoly);
+}
+
+
+/*****
+*
+*	RefBase::DrawDiagram(RefContext& ac, RefDgmr& aDgmr, const DgmInfo& aDgm) - draw the 
+*	given diagram of the sequence in ac using the RefDgmr aDgmr.
+*
+*****/
+
+void RefBase::DrawDiagram(RefContext& ac, RefDgmr& aDgmr, const DgmInfo& aDgm)
+{
+	// Set the current RefDgmr of this context to be aDgmr.
+	
+	ac.mDgmr = &aDgmr;
+	
+	// always draw the paper
+	
+	DrawPaper(ac);
+	
+	// Make a note of the action line ref
+	
+	RefBase* ral = ac.mSequence[aDgm.iact];
+	
+	// draw all refs specified by the DgmInfo. Most get drawn in normal style.
+	// The ref that is the action line (and all subsequent refs) get drawn in action style.
+	// Any refs that are used immediately by the action line get drawn in hilite style.
+	// Drawing for each diagram is done in multiple passes so that, for examples, labels end
+	// up on top of everything else.
+	
+	for (short ipass = 0; ipass < maxPasses; ipass++) {
+		for (size_t i = 0; i < aDgm.iact; i++) {
+			RefBase* rb = ac.mSequence[i];
+			if ((i >= aDgm.idef && rb->IsDerived()) || ral->UsesImmediate(rb)) 
+				rb->DrawSelf(ac, hiliteRef, ipass);
+			else rb->DrawSelf(ac, normalRef, ipass);
+		};
+		ac.mSequence[aDgm.iact]->DrawSelf(ac, actionRef, ipass);
+	}
+}
+
+
+/*****
+*
+*	RefBase::PutDiagramCaption(const RefContext& ac, std::ostream& os, const DGMInfo& aDgm)
+*	- Put the caption to a particular diagram to a stream. The caption consists of how-to
+*	for those refs that are part of the action. The output is created as a single string
+*	containing possibly multiple sentences.
+*
+*****/
+
+void RefBase::PutDiagramCaption(const RefContext& ac, std::ostream& os, const DgmInfo& aDgm)
+{
+	for (size_t i = aDgm.idef; i <= aDgm.iact; i++) {
+		ac.mSequence[i]->PutHowto(ac, os);
+		os << ". ";
+	}
+}
+
+
+/*****
+*
+*	RefBase::UsesImmediate(RefBase* rb) - return true if this mark or line uses rb for 
+*	immediate reference. "Immediate" means that if A uses B and B uses C, A->UsesImmediate(B)
+*	returns true but A->UsesImmediate(C) returns false. Default returns false; this will
+*	be used by original marks and lines.
+*
+*****/
+
+const bool RefBase::UsesImmediate(RefBase* /* rb */) const
+{
+	return false;
+}
+
+
+/*****
+*
+*	RefBase::Revalidate() - check this mark or line against the current settings, after 
+*	settings that only restrict which refs are valid have changed, and update whatever 
+*	depends on them. Return false if it no longer passes, or if one of the refs it is made 
+*	from has been dropped; dropped refs have their key set to 0. Default returns true; 
+*	this will be used by original marks and lines.
+*
+*****/
+
+bool RefBase::Revalidate()
+{
+	return true;
+}
+
+
+/*****
+*
+*	RefBase::IsDerived() -return true if this is a derived (rather than an original) mark
+*	or line. Note that this is not the same as mRank!=0, because the diagonals have mRank==1
+*	but are still considered original. Default is true since most objects will be derived.
+*
+*****/
+
+const bool RefBase::IsDerived() const
+{
+	return true;
+}
+
+
+/*****
+*
+*	RefBase::SequencePushUnique(RefContext& ac, RefBase* rb) - 
+*	Utility used by subclasses when they implement SequencePushSelf(). This insures
+*	that a given mark only gets a single label.
+*
+*****/
+
+void RefBase::SequencePushUnique(RefContext& ac, RefBase* rb)
+{
+	vector<RefBase*>& seq = ac.mSequence;
+	if (find(seq.begin(), seq.end(), rb) == seq.end()) seq.push_back(rb);
+}
+
+
+/**********
+*
+*	RefContext - the sequence, labels, diagrams and drawing style used to describe a ref.
+*
+**********/
+
+/*****
+*
+*	RefContext::RefContext() - Constructor, which sets the default style of verbal directions.
+*
+*****/
+
+RefContext::RefContext() : 
+	mDgmr(0), 
+	
+	// If clarifyVerbalAmbiguities == true, then verbal instructions that could be 
+	// ambigious because there are multiples solutions are clarified with additional
+	// information. Typically this will be true for text-only instruction, false for 
+	// diagrammatic instruction.
+	
+	clarifyVerbalAmbiguities(true), 
+	
+	// If axiomsInVerbalDirections == true, we list the axiom number at the beginning of
+	// each verbal direction.
+	
+	axiomsInVerbalDirections(true), 
+	mMarkCount(0), 
+	mLineCount(0)
+{
+}
+
+
+/*****
+*
+*	RefContext::GetIndex(const RefBase* rb) - return the index that labels rb in the current
+*	sequence, or 0 if rb has none. Sequences are short, so a linear search is fine.
+*
+*****/
+
+RefContext::index_t RefContext::GetIndex(const RefBase* rb) const
+{
+	for (size_t i = 0; i < mIndices.size(); i++)
+		if (mSequence[i] == rb) return mIndices[i];
+	return 0;
+}
+
+
+/*****
+*
+*	RefContext::SetIndex(const RefBase* rb, index_t aindex) - set the index that labels rb,
+*	which must be in the current sequence.
+*
+*****/
+
+void RefContext::SetIndex(const RefBase* rb, index_t aindex)
+{
+	for (size_t i = 0; i < mSequence.size(); i++)
+		if (mSequence[i] == rb) {
+			mIndices[i] = aindex;
+			return;
+		}
+}
+
+
+/*****
+*
+*	RefContext::ResetIndices() - clear the indices of the current sequence and reset the 
+*	counters for both marks and lines.
+*
+*****/
+
+void RefContext::ResetIndices()
+{
+	mIndices.assign(mSequence.size(), 0);
+	mMarkCount = 0;
+	mLineCount = 0;
+}
+
+
+/**********
+*
+*	RefMark - base class for a mark on the paper. 
+*
+**********/
+
+/*****
+*
+*	RefMark::FinishConstructor() - Calculate the key value used for distinguishing RefMarks.
+*	This should be called at the end of every constructor if the mark is valid (and not
+*	if it isn't).
+*
+*****/
+
+void RefMark::FinishConstructor()
+ {
+	const double fx = p.x / RefBase::paper.pWidth;	// fx is between 0 and 1
+	const double fy = p.y / RefBase::paper.pHeight;	// fy is between 0 and 1
+
+	key_t nx = static_cast<key_t> (floor(0.5 + fx * xNum));
+	key_t ny = static_cast<key_t> (floor(0.5 + fy * yNum));
+	mKey = 1 + nx * yNum + ny;
+}
+
+
+/*****
+*
+*	RefMark::RefMark(const RefRecord& ar) - Constructor that restores the coordinates of a
+*	mark from a snapshot record.
+*
+*****/
+
+RefMark::RefMark(const RefRecord& ar) : 
+	RefBase(ar), p(ar.mData[0], ar.mData[1])
+{
+}
+
+
+/*****
+*
+*	RefMark::Store(RefRecord& ar) - store the rank, key, and coordinates of this mark in a
+*	snapshot record. Subclasses fill in their type and the marks and lines they're made from.
+*
+*****/
+
+void RefMark::Store(RefRecord& ar) const
+{
+	ar.mWhoMoves = 0;
+	ar.mRank = mRank;
+	ar.mKey = mKey;
+	ar.mData[0] = p.x;
+	ar.mData[1] = p.y;
+	ar.mData[2] = 0;
+	for (short i = 0; i < 4; i++) ar.mParents[i] = -1;
+}
+
+
+/*****
+*
+*	Distance(const XYPt& ap) - return the distance to a point ap. This is used when sorting
+*	marks by their distance from a given mark.
+*
+*****/
+
+const double RefMark::Distance(const XYPt& ap) const
+ {
+ 	return (p - ap).Mag();
+ }
+ 
+
+/*****
+*
+*	RefMark::IsOnEdge() - return true if this mark is on the edge of the paper
+*
+*****/
+
+const bool RefMark::IsOnEdge() const
+{
+	return (RefBase::paper.leftEdge.Intersects(p) || 
+		RefBase::paper.rightEdge.Intersects(p) ||
+		RefBase::paper.topEdge.Intersects(p) || 
+		RefBase::paper.bottomEdge.Intersects(p));
+}
+
+
+/*****
+*
+*	RefMark::IsActionLine() - return false, since marks can never be actions
+*
+*****/
+
+const bool RefMark::IsActionLine() const
+{
+	return false;
+}
+
+
+/*****
+*
+*	RefMark::KeySizeOK() - return true if the key_t type is large enough to hold all
+*	possible keys.
+*
+*****/
+
+const bool RefMark::KeySizeOK()
+{
+	return (xNum < numeric_limits<key_t>::max() / yNum);
+}
+
+
+/*****
+*
+*	RefMark::MaxKey() - return an upper bound on the keys of marks.
+*
+*****/
+
+const size_t RefMark::MaxKey()
+{
+	return size_t(xNum + 1) * size_t(yNum + 1) + 1;
+}
+
+
+/*****
+*
+*	RefMark::MaxCount() - return an upper bound on the number of marks.
+*
+*****/
+
+const size_t RefMark::MaxCount()
+{
+	return ReferenceFinder::maxMarks;
+}
+
+
+/*****
+*
+*	RefMark::SetDiscretization(int axNum, int ayNum) - set the number of steps in x and y
+*	that the keys of marks tell apart. Takes effect with the next MakeAllMarksAndLines().
+*
+*****/
+
+void RefMark::SetDiscretization(int axNum, int ayNum)
+{
+	xNum = axNum;
+	yNum = ayNum;
+}
+
+
+/*****
+*
+*	RefMark::GetLabel(const RefContext& ac) - return the label for this mark.
+*
+*****/
+
+const char RefMark::GetLabel(const RefContext& ac) const
+{
+	return mLabels[ac.GetIndex(this) - 1];
+}
+
+
+/*****
+*
+*	RefMark::PutName(const RefContext& ac, ostream& os) - put the name of this mark to a
+*	stream. Default behavior gives this mark a letter. Return true if we used a letter,
+*	false if something else (i.e., the name of a RefMark_Original).
+*
+*****/
+
+const bool RefMark::PutName(const RefContext& ac, ostream& os) const
+{
+	os << "point " << GetLabel(ac);
+	return true;
+}
+
+
+/*****
+*
+*	RefMark::PutDistanceAndRank(ostream& os, const XYPt& ap) - put the distance from this mark
+*	to point ap to a stream.
+*
+*****/
+
+void RefMark::PutDistanceAndRank(ostream& os, const XYPt& ap) const
+{
+	os.precision(4);
+	os.setf(ios_base::fixed, ios_base::floatfield);
+	os << "Solution " << p.Chop() << ": err = " << Distance(ap) << " (rank " << mRank << ") ";
+}
+		
+		
+/*****
+*
+*	RefMark::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw a RefMark
+*	in the indicated style
+*
+*****/
+
+void RefMark::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	switch(ipass) {
+		case pointPass:
+			{
+				switch(rstyle) {
+					case normalRef:
+						ac.mDgmr->DrawPt(p, RefDgmr::normalPt);
+						break;
+					case hiliteRef:
+						ac.mDgmr->DrawPt(p, RefDgmr::hilitePt);
+						break;
+					case actionRef:
+						ac.mDgmr->DrawPt(p, RefDgmr::actionPt);
+						break;
+				}
+			};
+			break;
+			
+		case labelPass:
+			{
+			string sm(1, GetLabel(ac));
+			switch(rstyle) {
+				case normalRef:
+					// Normal points don't get labels drawn
+					break;
+				case hiliteRef:
+					ac.mDgmr->DrawLabel(p, sm, RefDgmr::hiliteLabel);
+					break;
+				case actionRef:
+					ac.mDgmr->DrawLabel(p, sm, RefDgmr::actionLabel);
+					break;
+			};
+			break;
+		}
+	}
+}
+
+
+/*****
+*
+*	RefMark::SetIndex(RefContext& ac) - Most types of RefMark use the default method, which
+*	gives the mark the next mark index of the context.
+*
+*****/
+
+void RefMark::SetIndex(RefContext& ac) const
+{
+	ac.SetIndex(this, ac.NextMarkIndex());
+}
+
+
+/**********
+*
+*	RefMark_Original - Specialization of RefMark that represents a named mark
+*	(e.g., a corner).
+*
+**********/
+
+/*****
+*
+*	RefMark_Original::RefMark_Original(const XYPt& ap, rank_t arank, const char* as) - Constructor.
+*
+*****/
+
+RefMark_Original::RefMark_Original(const XYPt& ap, rank_t arank, const char* as) : 
+	RefMark(ap, arank), s(as)
+{
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefMark_Original::RefMark_Original(const RefRecord& ar, const char* as) - Constructor that
+*	restores an original mark from a snapshot record, given its name.
+*
+*****/
+
+RefMark_Original::RefMark_Original(const RefRecord& ar, const char* as) : 
+	RefMark(ar), s(as)
+{
+}
+
+
+/*****
+*
+*	RefMark_Original::Store(RefRecord& ar) - store this mark in a snapshot record. The
+*	index of the name is filled in by the caller, who owns the table of names.
+*
+*****/
+
+void RefMark_Original::Store(RefRecord& ar) const
+{
+	RefMark::Store(ar);
+	ar.mType = markOriginal;
+}
+
+
+/*****
+*
+*	RefMark_Original::GetLabel(const RefContext& ac) - return the label for this mark.
+*
+*****/
+
+const char RefMark_Original::GetLabel(const RefContext& /* ac */) const
+{
+	return 0;	// originals get no labels
+}
+
+
+/*****
+*
+*	RefMark_Original::PutName(const RefContext& ac, ostream& os) - Put the name of this mark
+*	to a stream. Override to put the string name (rather than a letter).
+*
+*****/
+
+const bool RefMark_Original::PutName(const RefContext& /* ac */, ostream& os) const
+{
+	os << s;	// return the string
+	return false;
+}
+
+
+/*****
+*
+*	RefMark_Original::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw
+*	this mark
+*
+*****/
+
+void RefMark_Original::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	// Override the default because original marks don't get labels and are only drawn
+	// when they are hilited or action (in which case we still draw them hilited).
+
+	if ((ipass == pointPass) && (rstyle == hiliteRef || rstyle == actionRef)) 
+		ac.mDgmr->DrawPt(p, RefDgmr::hilitePt);
+}	
+
+
+/*****
+*
+*	RefMark_Original::IsDerived() - return false, since this is original
+*
+*****/
+
+const bool RefMark_Original::IsDerived() const
+{
+	return false;
+}
+
+
+/*****
+*
+*	RefMark_Original::SetIndex(RefContext& ac) - overridden because we don't use an index 
+*	for named marks.
+*
+*****/
+
+void RefMark_Original::SetIndex(RefContext& ac) const
+{
+	ac.SetIndex(this, 0);
+};
+
+
+/**********
+*
+*	RefMark_Intersection - Specialization of a RefMark for a mark defined by the 
+*	intersection of 2 lines.
+*
+**********/
+
+/*****
+*
+*	RefMark_Intersection(RefLine* arl1, RefLine* arl2) - Constructor.
+*
+*****/
+
+RefMark_Intersection::RefMark_Intersection(RefLine* arl1, RefLine* arl2) : 
+	RefMark(CalcMarkRank(arl1, arl2)), rl1(arl1), rl2(arl2)
+{
+	// Get references to constituent math types
+	
+	const XYLine& l1 = rl1->l;
+	const XYPt& u1 = rl1->l.u;
+//	const double& d1 = rl1->l.d;
+
+	const XYLine& l2 = rl2->l;
+	const XYPt& u2 = rl2->l.u;
+//	const double& d2 = rl2->l.d;	
+	
+	// If the lines don't intersect, it's not a valid point. If they do,
+	// assign the intersection to the member variable p.
+	
+	if (!l1.Intersects(l2, p)) return;
+	
+	// If the intersection point falls outside the square, it's not valid.
+	
+	if (!RefBase::paper.Encloses(p)) {
+		Reject(offPaper);
+		return;
+	}
+	
+	// If the lines intersect at less than a 30 degree angle, we won't keep this 
+	// point because such intersections are imprecise to use as reference points.
+	
+	if (abs(u1.Dot(u2.Rotate90())) < ReferenceFinder::minAngleSine) {
+		Reject(shallowAngle);
+		return;
+	}
+		
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefMark_Intersection(const RefRecord& ar) - Constructor that restores a mark from a
+*	snapshot record.
+*
+*****/
+
+RefMark_Intersection::RefMark_Intersection(const RefRecord& ar) : 
+	RefMark(ar), 
+	rl1(ReferenceFinder::basisLines[ar.mParents[0]]), 
+	rl2(ReferenceFinder::basisLines[ar.mParents[1]])
+{
+}
+
+
+/*****
+*
+*	RefMark_Intersection::Store(RefRecord& ar) - store this mark in a snapshot record.
+*
+*****/
+
+void RefMark_Intersection::Store(RefRecord& ar) const
+{
+	RefMark::Store(ar);
+	ar.mType = markIntersection;
+	ar.mParents[0] = ReferenceFinder::basisLines.IndexOf(rl1);
+	ar.mParents[1] = ReferenceFinder::basisLines.IndexOf(rl2);
+}
+
+
+/*****
+*
+*	RefMark_Intersection::UsesImmediate(RefBase* rb) - return true if this mark uses rb for 
+*	immediate reference.
+*
+*****/
+
+const bool RefMark_Intersection::UsesImmediate(RefBase* rb) const
+{
+	return (rb == rl1 || rb == rl2);
+}
+
+
+/*****
+*
+*	RefMark_Intersection::Revalidate() - check this mark against the current settings.
+*
+*****/
+
+bool RefMark_Intersection::Revalidate()
+{
+	return rl1->mKey > 0 && rl2->mKey > 0 && 
+		abs(rl1->l.u.Dot(rl2->l.u.Rotate90())) >= ReferenceFinder::minAngleSine;
+}
+
+
+/*****
+*
+*	RefMark_Intersection::SequencePushSelf(RefContext& ac) - Build the folding sequence
+*	that constructs this object.
+*
+*****/
+
+void RefMark_Intersection::SequencePushSelf(RefContext& ac)
+{
+	rl1->SequencePushSelf(ac);
+	rl2->SequencePushSelf(ac);
+	RefBase::SequencePushSelf(ac);
+}
+
+
+/*****
+*
+*	RefMark_Intersection::PutHowto(const RefContext& ac, ostream& os) - put a description of
+*	how to construct this mark.
+*
+*****/
+
+const bool RefMark_Intersection::PutHowto(const RefContext& ac, ostream& os) const
+{
+	os << "The intersection of ";
+	rl1->PutName(ac, os);
+	os << " with ";
+	rl2->PutName(ac, os);
+	os << " is ";
+	PutName(ac, os);
+	if (ac.clarifyVerbalAmbiguities) {
+		os.precision(4);
+		os.setf(ios_base::fixed, ios_base::floatfield);
+		os << " = " << p.Chop();
+	};
+	return true;
+}
+
+
+/*****
+*
+*	RefMark_Intersection::MakeAll(rank_t arank, RefBuilder<RefMark>& ab) - Go
+*	through existing lines and create RefMark_Intersections with rank equal to arank, 
+*	handing them to ab, which stops us at a cumulative total of maxMarks. Each line li
+*	is one unit of the outer iteration.
+*
+*****/
+
+void RefMark_Intersection::MakeAll(rank_t arank, RefBuilder<RefMark>& ab)
+{
+	for (rank_t irank = 0; irank <= arank / 2; irank++) {
+		rank_t jrank = arank - irank;
+		bool sameRank = (irank == jrank);
+		RefContainer<RefLine>::rank_iterator li = ReferenceFinder::basisLines.ranks[irank].begin();
+		if (sameRank) li++;
+		while (li != ReferenceFinder::basisLines.ranks[irank].end()) {
+			if (ab.Owns()) {
+				RefContainer<RefLine>::rank_iterator lj = 
+					ReferenceFinder::basisLines.ranks[jrank].begin();
+				while (lj != (sameRank ? li : ReferenceFinder::basisLines.ranks[jrank].end())) { 
+					if (ab.Done()) return;
+					RefMark_Intersection rmi(*li, *lj);
+					ab.AddCopyIfValidAndUnique(rmi);
+					lj++;
+				};
+			}
+			else if (ab.Done()) return;
+			li++;
+		}
+	}	
+}
+
+
+/**********
+*
+*	RefLine - base class for a reference line. 
+*
+**********/
+
+/*****
+*
+*	RefLine::FinishConstructor()  - Calculate the key values used for sorting RefLines.
+*	Like its RefMark counterpart, this should be called at the end of every successfully
+*	constructed object, and it sets mKey to the proper value.
+*
+*****/
+
+void RefLine::FinishConstructor()
+{
+	// resolve the ambiguity in line orientation by requiring d>=0.
+	
+	if (l.d < 0) {
+		l.d = -l.d;
+		l.u.x = -l.u.x;
+		l.u.y = -l.u.y;
+	};
+	
+	double fa = (1. + atan2(l.u.y, l.u.x) / (3.14159265358979323)) / 2.0;	// fa is between 0 & 1
+	const double dmax = sqrt(pow(RefBase::paper.pWidth, 2) + 
+		pow(RefBase::paper.pHeight, 2));
+	const double fd = l.d / dmax;	// fd is between 0 and 1
+	
+	key_t nd = static_cast <key_t> (floor(0.5 + fd * dNum));
+	if (nd == 0) fa = fmod(2 * fa, 1);	// for d=0, we map alpha and pi+alpha to the same key
+	key_t na = static_cast <key_t> (floor(0.5 + fa * aNum));
+	mKey = 1 + na * dNum + nd;
+}
+
+
+/*****
+*
+*	RefLine::RefLine(const RefRecord& ar) - Constructor that restores the line from a
+*	snapshot record.
+*
+*****/
+
+RefLine::RefLine(const RefRecord& ar) : 
+	RefBase(ar), l(ar.mData[0], XYPt(ar.mData[1], ar.mData[2]))
+{
+}
+
+
+/*****
+*
+*	RefLine::Store(RefRecord& ar) - store the rank, key, and line of this RefLine in a
+*	snapshot record. Subclasses fill in their type and the marks and lines they're made from.
+*
+*****/
+
+void RefLine::Store(RefRecord& ar) const
+{
+	ar.mWhoMoves = 0;
+	ar.mRank = mRank;
+	ar.mKey = mKey;
+	ar.mData[0] = l.d;
+	ar.mData[1] = l.u.x;
+	ar.mData[2] = l.u.y;
+	for (short i = 0; i < 4; i++) ar.mParents[i] = -1;
+}
+
+
+/*****
+*
+*	Distance (const XYLine& al) - return the "distance" between two lines, which is the 
+*	Pythagorean	sum of the dot product of their direction vectors (roughly equivalent to 
+*	angular separation)	and their distance scalars (roughly equivalent to parallel separation).
+*
+*****/
+
+const double RefLine::Distance (const XYLine& al) const
+{
+	return sqrt(pow(l.u.Dot(al.u.Rotate90()), 2) + pow(l.d - al.d * l.u.Dot(al.u), 2));
+}
+
+
+/*****
+*
+*	RefLine::IsOnEdge() - return true if this RefLine is on the edge of the paper
+*
+*****/
+
+const bool RefLine::IsOnEdge() const
+{
+	return ((RefBase::paper.leftEdge == l) || 
+		(RefBase::paper.topEdge == l) ||
+		(RefBase::paper.rightEdge == l) || 
+		(RefBase::paper.bottomEdge == l));
+}
+
+
+/*****
+*
+*	RefLine::IsActionLine() - return true, since MOST Reflines are actions
+*
+*****/
+
+const bool RefLine::IsActionLine() const
+{
+	return true;
+}
+
+
+/*****
+*
+*	RefLine::KeySizeOK() - return true if the key_t type is large enough to hold all
+*	possible keys.
+*
+*****/
+
+const bool RefLine::KeySizeOK()
+{
+	return aNum < numeric_limits<key_t>::max() / dNum;
+}
+
+
+/*****
+*
+*	RefLine::MaxKey() - return an upper bound on the keys of lines.
+*
+*****/
+
+const size_t RefLine::MaxKey()
+{
+	return size_t(aNum + 1) * size_t(dNum + 1) + 1;
+}
+
+
+/*****
+*
+*	RefLine::MaxCount() - return an upper bound on the number of lines.
+*
+*****/
+
+const size_t RefLine::MaxCount()
+{
+	return ReferenceFinder::maxLines;
+}
+
+
+/*****
+*
+*	RefLine::SetDiscretization(int aaNum, int adNum) - set the number of steps in angle and
+*	distance that the keys of lines tell apart. Takes effect with the next 
+*	MakeAllMarksAndLines().
+*
+*****/
+
+void RefLine::SetDiscretization(int aaNum, int adNum)
+{
+	aNum = aaNum;
+	dNum = adNum;
+}
+
+
+/*****
+*
+*	RefLine::GetLabel(const RefContext& ac) - return the label for this line.
+*
+*****/
+
+const char RefLine::GetLabel(const RefContext& ac) const
+{
+	return mLabels[ac.GetIndex(this) - 1];
+}
+
+
+/*****
+*
+*	RefLine::PutName(const RefContext& ac, ostream& os) - put the name of this line to a
+*	stream. Default behavior gives this line a letter. Return true if we used a letter.
+*	(We'll return false if we use something else, i.e., a RefLine_Original).
+*
+*****/
+
+const bool RefLine::PutName(const RefContext& ac, ostream& os) const
+{
+	os << "line " << GetLabel(ac);
+	return true;
+}
+
+
+/*****
+*
+*	RefLine::PutDistanceAndRank(ostream& os, const XYLine& al) - put the distance 
+*	between this line and line al to a stream along with the rank
+*
+*****/
+
+void RefLine::PutDistanceAndRank(ostream& os, const XYLine& al) const
+{
+	os.precision(4);
+	os.setf(ios_base::fixed, ios_base::floatfield);
+	os << "Solution " << l << ": err = " << Distance(al) << " (rank " << mRank << ") ";
+}
+		
+		
+/*****
+*
+*	RefLine::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw a line in
+*	the given style.
+*
+*****/
+
+void RefLine::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	XYPt p1, p2;
+	RefBase::paper.ClipLine(l, p1, p2);
+	
+	switch(ipass) {
+		case linePass:
+			{
+				switch (rstyle) {
+					case normalRef:
+						ac.mDgmr->DrawLine(p1, p2, RefDgmr::creaseLine);
+						break;
+					default: ; // keep compiler happy
+				}
+			};
+			break;
+			
+		case hlinePass:	// hilited lines and action lines go on top of others
+			{
+				switch (rstyle) {
+					case hiliteRef:
+						ac.mDgmr->DrawLine(p1, p2, RefDgmr::hiliteLine);
+						break;
+					case actionRef:
+						ac.mDgmr->DrawLine(p1, p2, RefDgmr::valleyLine);
+						break;
+					default: ; // keep compiler happy
+				}
+			};
+			break;
+			
+		case labelPass:
+			{
+				XYPt mp = MidPoint(p1, p2);	// label goes at the midpoint of the line
+				string sl(1, GetLabel(ac));
+				switch (rstyle) {
+					case normalRef:
+						// normal lines don't get labels
+						break;
+					case hiliteRef:
+						ac.mDgmr->DrawLabel(mp, sl, RefDgmr::hiliteLabel);
+						break;
+					case actionRef:
+						ac.mDgmr->DrawLabel(mp, sl, RefDgmr::actionLabel);
+						break;
+					default: ;// keep compiler happy
+				}
+			};
+			break;
+		default: ;// keep compiler happy
+	}
+	// Subclasses will add arrows for actionRef
+}
+
+
+/*****
+*
+*	RefLine::SetIndex(RefContext& ac) - Most subclasses will use the default method, which
+*	gives the line the next line index of the context.
+*
+*****/
+
+void RefLine::SetIndex(RefContext& ac) const
+{
+	ac.SetIndex(this, ac.NextLineIndex());
+}
+
+
+/**********
+*
+*	RefLine_Original - Specialization of RefLine that represents a line that is the 
+*	edge of the paper or an initial crease (like the diagonal).
+*
+**********/
+
+/*****
+*
+*	RefLine_Original::RefLine_Original(const XYLine& al, rank_t arank, const char* as) - Constructor.
+*
+*****/
+
+RefLine_Original::RefLine_Original(const XYLine& al, rank_t arank, const char* as) : 
+	RefLine(al, arank), s(as)
+{
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefLine_Original::RefLine_Original(const RefRecord& ar, const char* as) - Constructor that
+*	restores an original line from a snapshot record, given its name.
+*
+*****/
+
+RefLine_Original::RefLine_Original(const RefRecord& ar, const char* as) : 
+	RefLine(ar), s(as)
+{
+}
+
+
+/*****
+*
+*	RefLine_Original::Store(RefRecord& ar) - store this line in a snapshot record. The
+*	index of the name is filled in by the caller, who owns the table of names.
+*
+*****/
+
+void RefLine_Original::Store(RefRecord& ar) const
+{
+	RefLine::Store(ar);
+	ar.mType = lineOriginal;
+}
+
+
+/*****
+*
+*	RefLine_Original::IsActionLine() - return false because RefLine_Originals aren't actions,
+*	they're present from the beginning.
+*
+*****/
+
+const bool RefLine_Original::IsActionLine() const
+{
+	return false;
+}
+
+
+/*****
+*
+*	RefLine_Original::GetLabel(const RefContext& ac) - return the label for this line.
+*
+*****/
+
+const char RefLine_Original::GetLabel(const RefContext& /* ac */) const
+{
+	return 0;	// originals get no label
+}
+
+
+/*****
+*
+*	RefLine_Original::PutName(const RefContext& ac, ostream& os) - Put the name to a stream.
+*	Override the default method to use the actual string name, rather than a letter. Return
+*	false since we didn't use a letter.
+*
+*****/
+
+const bool RefLine_Original::PutName(const RefContext& /* ac */, ostream& os) const
+{
+	os << s;
+	return false;
+}
+
+
+/*****
+*
+*	RefLine_Original::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw
+*	this line in the appropriate style
+*
+*****/
+
+void RefLine_Original::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+		// RefLine_Originals don't get labels, and they are actionRef, we still draw them
+		// hilited.
+
+	XYPt p1, p2;
+	RefBase::paper.ClipLine(l, p1, p2);
+	switch(ipass) {
+		case linePass:
+			switch (rstyle) {
+				case normalRef:
+					ac.mDgmr->DrawLine(p1, p2, RefDgmr::creaseLine);
+					break;
+				default: ; // keep compiler happy
+			}
+			break;
+		case hlinePass:
+			switch (rstyle) {
+				case hiliteRef:
+				case actionRef:
+					ac.mDgmr->DrawLine(p1, p2, RefDgmr::hiliteLine);
+					break;
+				default: ; // keep compiler happy
+			}
+			break;
+		default: ; // keep compiler happy about unhandled cases
+	}
+}
+
+
+/*****
+*
+*	RefLine_Original::IsDerived() - return false, since this is original
+*
+*****/
+
+const bool RefLine_Original::IsDerived() const
+{
+	return false;
+}
+
+
+/*****
+*
+*	RefLine_Original::SetIndex(RefContext& ac) - set the index of this line. Override the
+*	default method to use an index of zero, since we've already got a name.
+*
+*****/
+
+void RefLine_Original::SetIndex(RefContext& ac) const
+{
+	ac.SetIndex(this, 0);
+}
+
+
+/**********
+*
+*	RefLine_C2P_C2P - Huzita-Hatori Axiom O1
+*
+*	Make a crease through two points p1 and p2.
+*
+**********/
+
+/*****
+*
+*	RefLine_C2P_C2P(RefMark* arm1, RefMark* arm2) - Constructor. Initialize with the two
+*	marks that this line connects.
+*
+*****/
+
+RefLine_C2P_C2P::RefLine_C2P_C2P(RefMark* arm1, RefMark* arm2) : 
+	RefLine(CalcLineRank(arm1, arm2)), rm1(arm1), rm2(arm2)
+{
+	// Get references to points
+	
+	XYPt& p1 = rm1->p;
+	XYPt& p2 = rm2->p;
+	
+	// Construct member data
+	
+	l.u = (p2 - p1).Rotate90().Normalize();
+	l.d = .5 * (p1 + p2).Dot(l.u);
+	
+	// Don't need to check visibility because this type is always visible.
+	
+	// If this line creates a skinny flap, we won't use it.
+	
+	if (RefBase::paper.MakesSkinnyFlap(l)) {
+		Reject(skinnyFlap);
+		return;
+	}
+	
+	// This type is always valid.
+	
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefLine_C2P_C2P(const RefRecord& ar) - Constructor that restores a line from a
+*	snapshot record.
+*
+*****/
+
+RefLine_C2P_C2P::RefLine_C2P_C2P(const RefRecord& ar) : 
+	RefLine(ar),
+	rm1(ReferenceFinder::basisMarks[ar.mParents[0]]),
+	rm2(ReferenceFinder::basisMarks[ar.mParents[1]])
+{
+}
+
+
+/*****
+*
+*	RefLine_C2P_C2P::Store(RefRecord& ar) - store this line in a snapshot record.
+*
+*****/
+
+void RefLine_C2P_C2P::Store(RefRecord& ar) const
+{
+	RefLine::Store(ar);
+	ar.mType = lineC2P_C2P;
+	ar.mParents[0] = ReferenceFinder::basisMarks.IndexOf(rm1);
+	ar.mParents[1] = ReferenceFinder::basisMarks.IndexOf(rm2);
+}
+
+
+/*****
+*
+*	RefLine_C2P_C2P::UsesImmediate(RefBase* rb) - return true if this line uses rb for 
+*	immediate reference.
+*
+*****/
+
+const bool RefLine_C2P_C2P::UsesImmediate(RefBase* rb) const
+{
+	return (rb == rm1 || rb == rm2);
+}
+
+
+/*****
+*
+*	RefLine_C2P_C2P::Revalidate() - check this line against the current settings.
+*
+*****/
+
+bool RefLine_C2P_C2P::Revalidate()
+{
+	return include && rm1->mKey > 0 && rm2->mKey > 0 && 
+		!RefBase::paper.MakesSkinnyFlap(l);
+}
+
+
+/*****
+*
+*	RefLine_C2P_C2P::SequencePushSelf(RefContext& ac) - Build the folding sequence
+*	that constructs this object.
+*
+*****/
+
+void RefLine_C2P_C2P::SequencePushSelf(RefContext& ac)
+{
+	rm1->SequencePushSelf(ac);
+	rm2->SequencePushSelf(ac);
+	RefBase::SequencePushSelf(ac);
+}
+
+
+/*****
+*
+*	RefLine_C2P_C2P::PutHowto(const RefContext& ac, ostream& os) - put the construction of
+*	this line to a stream.
+*
+*****/
+
+const bool RefLine_C2P_C2P::PutHowto(const RefContext& ac, ostream& os) const
+{
+	if (ac.axiomsInVerbalDirections) os << "[01] ";
+	os << "Form a crease connecting ";
+	rm1->PutName(ac, os);
+	os << " with ";
+	rm2->PutName(ac, os);
+	os << ", making ";
+	PutName(ac, os);
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_C2P_C2P::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw
+*	this line, adding arrows if appropriate
+*
+*****/
+
+void RefLine_C2P_C2P::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	// Call the inherited method to draw the line
+	
+	RefLine::DrawSelf(ac, rstyle, ipass);
+	
+	// If we're moving, we need arrows.
+	
+	if ((ipass == arrowPass) && (rstyle == actionRef)) {
+	
+		// Get the endpoints of the fold
+		
+		XYPt& p1 = rm1->p;
+		XYPt& p2 = rm2->p;
+		
+		// Get the perpendicular bisector of the fold
+		
+		XYPt mp = MidPoint(p1, p2);
+		XYLine lb;
+		lb.u = l.u.Rotate90();
+		lb.d = mp.Dot(lb.u);
+		
+		// Get the points where the bisector crosses the paper
+		
+		XYPt p3, p4;
+		RefBase::paper.ClipLine(lb, p3, p4);
+		
+		// Parameterize these points along the bisector. Don't care about sign.
+		
+		double t3 = abs((p3 - mp).Dot(l.u));
+		double t4 = abs((p4 - mp).Dot(l.u));
+		
+		// Construct a new pair of points that mate when folded and that are guaranteed to
+		// lie within the paper.
+		
+		XYPt dp;
+		if (t3 < t4) dp = t3 * l.u;
+		else dp = t4 * l.u;
+		p3 = mp + dp;
+		p4 = mp - dp;
+		
+		// Draw an arrow that connects these two points.
+		
+		ac.mDgmr->DrawFoldAndUnfoldArrow(p3, p4);
+	}
+}
+
+
+/*****
+*
+*	RefLine_C2P_C2P::MakeAll(rank_t arank, RefBuilder<RefLine>& ab) - Go
+*	through existing lines and marks and create RefLine_C2P_C2Ps with rank equal to arank,
+*	handing them to ab, which stops us at a cumulative total of maxLines. Each mark mi
+*	is one unit of the outer iteration.
+*
+*****/
+
+void RefLine_C2P_C2P::MakeAll(rank_t arank, RefBuilder<RefLine>& ab)
+{
+	for (rank_t irank = 0; irank <= (arank - 1) / 2; irank++) {
+		rank_t jrank = arank - irank - 1;
+		bool sameRank = (irank == jrank);
+		RefContainer<RefMark>::rank_iterator mi = 
+			ReferenceFinder::basisMarks.ranks[irank].begin();
+		if (sameRank) mi++;
+		while (mi != ReferenceFinder::basisMarks.ranks[irank].end()) {
+			if (ab.Owns()) {
+				RefContainer<RefMark>::rank_iterator mj = 
+					ReferenceFinder::basisMarks.ranks[jrank].begin();
+				while (mj != (sameRank ? mi : ReferenceFinder::basisMarks.ranks[jrank].end())) {
+					if (ab.Done()) return;
+					RefLine_C2P_C2P rlc(*mi, *mj);
+					ab.AddCopyIfValidAndUnique(rlc);
+					mj++;
+				};
+			}
+			else if (ab.Done()) return;
+			mi++;
+		}
+	}
+}
+
+
+/**********
+*
+*	RefLine_P2P - Huzita-Hatori Axiom O2
+*
+*	Bring p1 to p2.
+*
+**********/
+
+/*****
+*
+*	RefLine_P2P(RefMark* arm1, RefMark* arm2) - Constructor.
+*
+*****/
+
+RefLine_P2P::RefLine_P2P(RefMark* arm1, RefMark* arm2) : 
+	RefLine(CalcLineRank(arm1, arm2)), rm1(arm1), rm2(arm2)
+{
+	// Get references to points
+	
+	XYPt& p1 = rm1->p;
+	XYPt& p2 = rm2->p;
+	
+	// Construct member data
+	
+	l.u = (p2 - p1).Normalize();
+	l.d = .5 * (p1 + p2).Dot(l.u);
+	
+	// Check visibility
+	
+	if (!SetWhoMoves()) {
+		Reject(notVisible);
+		return;
+	}
+	
+	// If this line creates a skinny flap, we won't use it.
+	
+	if (RefBase::paper.MakesSkinnyFlap(l)) {
+		Reject(skinnyFlap);
+		return;
+	}
+	
+	// Set the key.
+
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefLine_P2P(const RefRecord& ar) - Constructor that restores a line from a
+*	snapshot record.
+*
+*****/
+
+RefLine_P2P::RefLine_P2P(const RefRecord& ar) : 
+	RefLine(ar),
+	rm1(ReferenceFinder::basisMarks[ar.mParents[0]]),
+	rm2(ReferenceFinder::basisMarks[ar.mParents[1]]),
+	whoMoves(WhoMoves(ar.mWhoMoves))
+{
+}
+
+
+/*****
+*
+*	RefLine_P2P::Store(RefRecord& ar) - store this line in a snapshot record.
+*
+*****/
+
+void RefLine_P2P::Store(RefRecord& ar) const
+{
+	RefLine::Store(ar);
+	ar.mType = lineP2P;
+	ar.mWhoMoves = static_cast<unsigned char>(whoMoves);
+	ar.mParents[0] = ReferenceFinder::basisMarks.IndexOf(rm1);
+	ar.mParents[1] = ReferenceFinder::basisMarks.IndexOf(rm2);
+}
+
+
+/*****
+*
+*	RefLine_P2P::UsesImmediate(RefBase* rb) - return true if this line uses rb for 
+*	immediate reference.
+*
+*****/
+
+const bool RefLine_P2P::UsesImmediate(RefBase* rb) const
+{
+	return (rb == rm1 || rb == rm2);
+}
+
+
+/*****
+*
+*	RefLine_P2P::SetWhoMoves() - decide which mark moves in the fold. Return false if
+*	neither of them can be seen to move with opaque paper.
+*
+*****/
+
+bool RefLine_P2P::SetWhoMoves()
+{
+	bool p1edge = rm1->IsOnEdge();
+	bool p2edge = rm2->IsOnEdge();
+	
+	if (ReferenceFinder::visibilityMatters) {
+		if (p1edge) whoMoves = p1Moves;
+		else if (p2edge) whoMoves = p2Moves;
+		else return false;
+	}
+	else {
+		whoMoves = p1Moves;
+	};
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_P2P::Revalidate() - check this line against the current settings.
+*
+*****/
+
+bool RefLine_P2P::Revalidate()
+{
+	return include && rm1->mKey > 0 && rm2->mKey > 0 && SetWhoMoves() && 
+		!RefBase::paper.MakesSkinnyFlap(l);
+}
+
+
+/*****
+*
+*	RefLine_P2P::SequencePushSelf(RefContext& ac) - Build the folding sequence
+*	that constructs this object.
+*
+*****/
+
+void RefLine_P2P::SequencePushSelf(RefContext& ac)
+{
+	switch (whoMoves) {
+		case p1Moves:
+			rm2->SequencePushSelf(ac);
+			rm1->SequencePushSelf(ac);
+			break;
+		
+		case p2Moves:
+			rm1->SequencePushSelf(ac);
+			rm2->SequencePushSelf(ac);
+			break;
+	};		
+	RefBase::SequencePushSelf(ac);
+}
+
+
+/*****
+*
+*	RefLine_P2P::PutHowto(const RefContext& ac, ostream& os) - put the construction of this
+*	line to a stream.
+*
+*****/
+
+const bool RefLine_P2P::PutHowto(const RefContext& ac, ostream& os) const
+{
+	if (ac.axiomsInVerbalDirections) os << "[02] ";
+	os << "Bring ";
+	switch (whoMoves) {
+		case p1Moves:
+			rm1->PutName(ac, os);
+			os << " to ";
+			rm2->PutName(ac, os);
+			break;
+			
+		case p2Moves:
+			rm2->PutName(ac, os);
+			os << " to ";
+			rm1->PutName(ac, os);
+			break;
+	};
+	os << ", making ";
+	PutName(ac, os);
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_P2P::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw this
+*	line, adding arrows if appropriate
+*
+*****/
+
+void RefLine_P2P::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	// Call inherited method to draw the lines
+	
+	RefLine::DrawSelf(ac, rstyle, ipass);
+	
+	// If we're moving, we need an arrow
+	
+	if ((ipass == arrowPass) && (rstyle == actionRef)) {
+		XYPt& p1 = rm1->p;
+		XYPt& p2 = rm2->p;
+		switch (whoMoves) {
+			case p1Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p1, p2);
+				break;
+			case p2Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p2, p1);
+				break;
+		}
+	}
+}
+			
+
+
+/*****
+*
+*	RefLine_P2P::MakeAll(rank_t arank, RefBuilder<RefLine>& ab) - Go
+*	through existing lines and marks and create RefLine_P2Ps with rank equal to arank,
+*	handing them to ab, which stops us at a cumulative total of maxLines. Each mark mi
+*	is one unit of the outer iteration.
+*
+*****/
+
+void RefLine_P2P::MakeAll(rank_t arank, RefBuilder<RefLine>& ab)
+{
+	for (rank_t irank = 0; irank <= (arank - 1) / 2; irank++) {
+		rank_t jrank = arank - irank - 1;
+		bool sameRank = (irank == jrank);
+		RefContainer<RefMark>::rank_iterator mi = 
+			ReferenceFinder::basisMarks.ranks[irank].begin();
+		if (sameRank) mi++;
+		while (mi != ReferenceFinder::basisMarks.ranks[irank].end()) {
+			if (ab.Owns()) {
+				RefContainer<RefMark>::rank_iterator mj = 
+					ReferenceFinder::basisMarks.ranks[jrank].begin();
+				while (mj != (sameRank ? mi : ReferenceFinder::basisMarks.ranks[jrank].end())) {
+					if (ab.Done()) return;
+					RefLine_P2P rlb(*mi, *mj);
+					ab.AddCopyIfValidAndUnique(rlb);
+					mj++;
+				};
+			}
+			else if (ab.Done()) return;
+			mi++;
+		}
+	}
+}
+
+
+/**********
+*
+*	RefLine_L2L - Huzita-Hatori Axiom O3
+*
+*	Bring line l1 to line l2.
+*
+**********/
+
+/*****
+*
+*	RefLine_L2L::RefLine_L2L(RefLine* arl1, RefLine* arl2, short iroot) - Constructor.
+*	iroot = 0 or 1.
+*
+*****/
+
+RefLine_L2L::RefLine_L2L(RefLine* arl1, RefLine* arl2, short iroot) : 
+	RefLine(CalcLineRank(arl1, arl2)), rl1(arl1), rl2(arl2)
+{			
+	// Get references to lines
+	
+	XYLine& l1 = rl1->l;
+	XYPt& u1 = l1.u;
+	double& d1 = l1.d;
+	XYLine& l2 = rl2->l;
+	XYPt& u2 = l2.u;
+	double& d2 = l2.d;
+	
+	// Parallel lines get handled specially. There's only one solution; we arbitrarily make
+	// it the iroot=0 solution.
+	
+	if (l1.IsParallelTo(l2)) {
+		if (iroot == 0) {
+			l.u = u1;
+			l.d = .5 * (d1 + d2 * u2.Dot(u1));
+		}
+		else return; // iroot = 1 for parallel lines isn't a valid solution.
+	}
+	else {	// nonparallel lines
+	
+		// Construct the direction vector for the bisector, depending on the value of iroot.
+		
+		if (iroot == 0) l.u = (u1 + u2).Normalize();
+		else l.u = (u1 - u2).Normalize();
+		
+		l.d = Intersection(l1, l2).Dot(l.u);
+	};
+	
+	// If the paper doesn't overlap the fold line, we're not valid.
+	
+	if (!RefBase::paper.InteriorOverlaps(l)) {
+		Reject(noOverlap);
+		return;
+	}
+	
+	// Check visibility
+	
+	if (!SetWhoMoves()) {
+		Reject(notVisible);
+		return;
+	}
+	
+	// If this line creates a skinny flap, we won't use it.
+	
+	if (RefBase::paper.MakesSkinnyFlap(l)) {
+		Reject(skinnyFlap);
+		return;
+	}
+
+	// Set the key.
+	
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefLine_L2L(const RefRecord& ar) - Constructor that restores a line from a
+*	snapshot record.
+*
+*****/
+
+RefLine_L2L::RefLine_L2L(const RefRecord& ar) : 
+	RefLine(ar),
+	rl1(ReferenceFinder::basisLines[ar.mParents[0]]),
+	rl2(ReferenceFinder::basisLines[ar.mParents[1]]),
+	whoMoves(WhoMoves(ar.mWhoMoves))
+{
+}
+
+
+/*****
+*
+*	RefLine_L2L::Store(RefRecord& ar) - store this line in a snapshot record.
+*
+*****/
+
+void RefLine_L2L::Store(RefRecord& ar) const
+{
+	RefLine::Store(ar);
+	ar.mType = lineL2L;
+	ar.mWhoMoves = static_cast<unsigned char>(whoMoves);
+	ar.mParents[0] = ReferenceFinder::basisLines.IndexOf(rl1);
+	ar.mParents[1] = ReferenceFinder::basisLines.IndexOf(rl2);
+}
+
+
+/*****
+*
+*	RefLine_L2L::UsesImmediate(RefBase* rb) - return true if this line uses rb for 
+*	immediate reference.
+*
+*****/
+
+const bool RefLine_L2L::UsesImmediate(RefBase* rb) const
+{
+	return (rb == rl1 || rb == rl2);
+}
+
+
+/*****
+*
+*	RefLine_L2L::SetWhoMoves() - decide which line moves in the fold. Return false if
+*	neither of them can be seen to move with opaque paper.
+*
+*****/
+
+bool RefLine_L2L::SetWhoMoves()
+{
+	const XYLine& l1 = rl1->l;
+	const XYLine& l2 = rl2->l;
+	bool l1edge = rl1->IsOnEdge();
+	bool l2edge = rl2->IsOnEdge();
+	
+	if (ReferenceFinder::visibilityMatters) {
+		if (l1edge) whoMoves = l1Moves;
+		else if (l2edge) whoMoves = l2Moves;
+		else {
+			XYPt lp1, lp2;
+			RefBase::paper.ClipLine(l1, lp1, lp2);
+			if (RefBase::paper.Encloses(l.Fold(lp1)) && 
+				RefBase::paper.Encloses(l.Fold(lp2))) whoMoves = l1Moves;
+			else {
+				RefBase::paper.ClipLine(l2, lp1, lp2);
+				if (RefBase::paper.Encloses(l.Fold(lp1)) && 
+					RefBase::paper.Encloses(l.Fold(lp2))) whoMoves = l2Moves;
+				else return false;
+			}
+		}
+	}
+	else {
+		whoMoves = l1Moves;
+	};
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_L2L::Revalidate() - check this line against the current settings.
+*
+*****/
+
+bool RefLine_L2L::Revalidate()
+{
+	return include && rl1->mKey > 0 && rl2->mKey > 0 && SetWhoMoves() && 
+		!RefBase::paper.MakesSkinnyFlap(l);
+}
+
+
+/*****
+*
+*	RefLine_L2L::SequencePushSelf(RefContext& ac) - Build the folding sequence
+*	that constructs this object.
+*
+*****/
+
+void RefLine_L2L::SequencePushSelf(RefContext& ac)
+{
+	switch (whoMoves) {
+		case l1Moves:
+			rl2->SequencePushSelf(ac);
+			rl1->SequencePushSelf(ac);
+			break;
+		
+		case l2Moves:
+			rl1->SequencePushSelf(ac);
+			rl2->SequencePushSelf(ac);
+			break;
+	};
+	RefBase::SequencePushSelf(ac);
+}
+
+
+/*****
+*
+*	RefLine_L2L::PutHowto(const RefContext& ac, ostream& os) - put the construction of this
+*	line to a stream.
+*
+*****/
+
+const bool RefLine_L2L::PutHowto(const RefContext& ac, ostream& os) const
+{
+	if (ac.axiomsInVerbalDirections) os << "[03] ";
+	os << "Fold ";
+	switch (whoMoves) {
+		case l1Moves:
+			rl1->PutName(ac, os);
+			os << " to ";
+			rl2->PutName(ac, os);		
+			break;
+		
+		case l2Moves:
+			rl2->PutName(ac, os);
+			os << " to ";
+			rl1->PutName(ac, os);		
+			break;
+	};
+	os << ", making ";
+	PutName(ac, os);
+	if (ac.clarifyVerbalAmbiguities) {
+		os << " through ";
+		
+		// Now we need to specify which of the two bisectors this is, which we do
+		// by specifying a point where the bisector hits the edge of the square.
+		
+		XYPt p;
+		rl1->l.Intersects(rl2->l, p);	// get the intersection of the two bisectors
+
+		XYPt pa, pb;
+		RefBase::paper.ClipLine(l, pa, pb);		// find where our fold line hits the paper.
+		
+		// Return the first point of intersection between the fold line and the edge of the
+		// paper that _isn't_ the intersection of the two bisectors.
+		
+		os.precision(2);
+		os.setf(ios_base::fixed, ios_base::floatfield);
+		if (p == pa) return os << pb.Chop();
+		os << pa.Chop();
+	};
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_L2L::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw this
+*	line, adding arrows if appropriate
+*
+*****/
+
+void RefLine_L2L::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	// Call inherited method to draw the lines
+	
+	RefLine::DrawSelf(ac, rstyle, ipass);
+	
+	// If we're moving, we need an arrow that brings two points from one line to two points on
+	// the other line. We need to pick points that are within the paper for both lines.
+	
+	if ((ipass == arrowPass) && (rstyle == actionRef)) {
+			
+			XYLine& l1 = rl1->l;
+			XYLine& l2 = rl2->l;
+			XYPt p1a, p1b;
+			RefBase::paper.ClipLine(l1, p1a, p1b);	// endpoints of l1
+			XYPt p2a, p2b;
+			RefBase::paper.ClipLine(l2, p2a, p2b);	// endpoints of l2
+			p2a = l.Fold(p2a);								// flop l2 points onto l1
+			p2b = l.Fold(p2b);
+			XYPt du1 = l1.d * l1.u;				// a point on l1
+			XYPt up1 = l1.u.Rotate90();			// a tangent to l1
+			vector<double> tvals;				// holds parameterizations of the 4 points
+			tvals.push_back((p1a - du1).Dot(up1));	// parameterize p1a along l1
+			tvals.push_back((p1b - du1).Dot(up1));	// parameterize p1b along l1
+			tvals.push_back((p2a - du1).Dot(up1));	// parameterize p2a along l1
+			tvals.push_back((p2b - du1).Dot(up1));	// parameterize p2b along l1
+			sort(tvals.begin(), tvals.end());		// sort them in order; we want the middle 2
+			XYPt p1c = du1 + 0.5 * (tvals[1] + tvals[2]) * up1;
+			XYPt p2c = l.Fold(p1c);
+			switch(whoMoves) {
+				case l1Moves:
+					ac.mDgmr->DrawFoldAndUnfoldArrow(p1c, p2c);
+					break;
+				case l2Moves:
+					ac.mDgmr->DrawFoldAndUnfoldArrow(p1c, p2c);
+					break;
+			}
+	}
+}
+
+
+/*****
+*
+*	RefLine_L2L::MakeAll(rank_t arank, RefBuilder<RefLine>& ab) - Go
+*	through existing lines and marks and create RefLine_L2Ls with rank equal to arank,
+*	handing them to ab, which stops us at a cumulative total of maxLines. Each line li
+*	is one unit of the outer iteration.
+*
+*****/
+
+void RefLine_L2L::MakeAll(rank_t arank, RefBuilder<RefLine>& ab)
+{
+	for (rank_t irank = 0; irank <= (arank - 1) / 2; irank++) {
+		rank_t jrank = arank - irank - 1;
+		bool sameRank = (irank == jrank);
+		RefContainer<RefLine>::rank_iterator li = ReferenceFinder::basisLines.ranks[irank].begin();
+		if (sameRank) li++;
+		while (li != ReferenceFinder::basisLines.ranks[irank].end()) {
+			if (ab.Owns()) {
+				RefContainer<RefLine>::rank_iterator lj = 
+					ReferenceFinder::basisLines.ranks[jrank].begin();
+				while (lj != (sameRank ? li : ReferenceFinder::basisLines.ranks[jrank].end())) {
+					if (ab.Done()) return;
+					RefLine_L2L rls1(*li, *lj, 0);
+					ab.AddCopyIfValidAndUnique(rls1);
+					if (ab.Done()) return;
+					RefLine_L2L rls2(*li, *lj, 1);
+					ab.AddCopyIfValidAndUnique(rls2);
+					lj++;
+				};
+			}
+			else if (ab.Done()) return;
+			li++;
+		}
+	}
+}
+
+
+/**********
+*
+*	RefLine_L2L_C2P - Huzita-Hatori Axiom O4
+*
+*	Bring line l1 to itself so that the crease goes through point p1
+*
+**********/
+
+/*****
+*
+*	RefLine_L2L_C2P::RefLine_L2L_C2P(RefLine* arl1, RefMark* arm1) - Constructor.
+*
+*****/
+
+RefLine_L2L_C2P::RefLine_L2L_C2P(RefLine* arl1, RefMark* arm1) : 
+	RefLine(CalcLineRank(arl1, arm1)), rl1(arl1), rm1(arm1)
+{			
+	// Get references to line and mark
+	
+	XYPt& u1 = rl1->l.u;
+	double& d1 = rl1->l.d;
+	XYPt& p1 = rm1->p;
+	
+	// Construct the direction vector and distance scalar for the fold line.
+	
+	l.u = u1.Rotate90();
+	l.d = p1.Dot(l.u);
+
+	// The intersection of the fold line with line l1 must be enclosed in the paper.
+	// That point is the projection of p1 onto line l1.
+	
+	XYPt p1p = p1 + (d1 - (p1.Dot(u1))) * u1;
+	if (!RefBase::paper.Encloses(p1p)) {
+		Reject(offPaper);
+		return;
+	}
+	
+	// Don't need to check visibility, this kind is always visible.
+	
+	// If this line creates a skinny flap, we won't use it.
+	
+	if (RefBase::paper.MakesSkinnyFlap(l)) {
+		Reject(skinnyFlap);
+		return;
+	}
+	
+	// Set the key.
+	
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefLine_L2L_C2P(const RefRecord& ar) - Constructor that restores a line from a
+*	snapshot record.
+*
+*****/
+
+RefLine_L2L_C2P::RefLine_L2L_C2P(const RefRecord& ar) : 
+	RefLine(ar),
+	rl1(ReferenceFinder::basisLines[ar.mParents[0]]),
+	rm1(ReferenceFinder::basisMarks[ar.mParents[1]])
+{
+}
+
+
+/*****
+*
+*	RefLine_L2L_C2P::Store(RefRecord& ar) - store this line in a snapshot record.
+*
+*****/
+
+void RefLine_L2L_C2P::Store(RefRecord& ar) const
+{
+	RefLine::Store(ar);
+	ar.mType = lineL2L_C2P;
+	ar.mParents[0] = ReferenceFinder::basisLines.IndexOf(rl1);
+	ar.mParents[1] = ReferenceFinder::basisMarks.IndexOf(rm1);
+}
+
+
+/*****
+*
+*	RefLine_L2L_C2P::UsesImmediate(RefBase* rb) - return true if this line uses rb for 
+*	immediate reference.
+*
+*****/
+
+const bool RefLine_L2L_C2P::UsesImmediate(RefBase* rb) const
+{
+	return (rb == rl1 || rb == rm1);
+}
+
+
+/*****
+*
+*	RefLine_L2L_C2P::Revalidate() - check this line against the current settings.
+*
+*****/
+
+bool RefLine_L2L_C2P::Revalidate()
+{
+	return include && rl1->mKey > 0 && rm1->mKey > 0 && 
+		!RefBase::paper.MakesSkinnyFlap(l);
+}
+
+
+/*****
+*
+*	RefLine_L2L_C2P::SequencePushSelf(RefContext& ac) - Build the folding sequence
+*	that constructs this object.
+*
+*****/
+
+void RefLine_L2L_C2P::SequencePushSelf(RefContext& ac)
+{
+	rm1->SequencePushSelf(ac);
+	rl1->SequencePushSelf(ac);
+	RefBase::SequencePushSelf(ac);
+}
+
+
+/*****
+*
+*	RefLine_L2L_C2P::PutHowto(const RefContext& ac, ostream& os) - put the construction of
+*	this line to a stream.
+*
+*****/
+
+const bool RefLine_L2L_C2P::PutHowto(const RefContext& ac, ostream& os) const
+{
+	if (ac.axiomsInVerbalDirections) os << "[04] ";
+	os << "Fold ";
+	rl1->PutName(ac, os);
+	os << " onto itself, making ";
+	PutName(ac, os);
+	os << " through ";
+	rm1->PutName(ac, os);
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_L2L_C2P::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw
+*	this line, adding arrows if appropriate
+*
+*****/
+
+void RefLine_L2L_C2P::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	// Call inherited method to draw the lines
+	
+	RefLine::DrawSelf(ac, rstyle, ipass);
+	
+	// If we're moving, we need an arrow
+	
+	if ((ipass == arrowPass) && (rstyle == actionRef)) {
+			
+			XYPt p1, p2;
+			XYLine& l1 = rl1->l;
+			RefBase::paper.ClipLine(l1, p1, p2);	// get endpts of the reference line
+			XYPt pi = Intersection(l, l1);					// intersection w/ fold line
+			XYPt u1p = l1.u.Rotate90();						// tangent to reference line
+			double t1 = abs((p1 - pi).Dot(u1p));
+			double t2 = abs((p2 - pi).Dot(u1p));
+			double tmin = t1 < t2 ? t1 : t2;
+			ac.mDgmr->DrawFoldAndUnfoldArrow(pi + tmin * u1p, pi - tmin * u1p);
+	}
+}
+
+
+/*****
+*
+*	RefLine_L2L_C2P::MakeAll(rank_t arank, RefBuilder<RefLine>& ab) - Go
+*	through existing lines and marks and create RefLine_L2L_C2Ps with rank equal to arank,
+*	handing them to ab, which stops us at a cumulative total of maxLines. Each line li
+*	is one unit of the outer iteration.
+*
+*****/
+
+void RefLine_L2L_C2P::MakeAll(rank_t arank, RefBuilder<RefLine>& ab)
+{
+	for (rank_t irank = 0; irank <= (arank - 1); irank++) {
+		rank_t jrank = arank - irank - 1;
+		RefContainer<RefLine>::rank_iterator li = 
+			ReferenceFinder::basisLines.ranks[irank].begin();
+		while (li != ReferenceFinder::basisLines.ranks[irank].end()) {
+			if (ab.Owns()) {
+				RefContainer<RefMark>::rank_iterator mj = 
+					ReferenceFinder::basisMarks.ranks[jrank].begin();
+				while (mj != ReferenceFinder::basisMarks.ranks[jrank].end()) {
+					if (ab.Done()) return;
+					RefLine_L2L_C2P rls1(*li, *mj);
+					ab.AddCopyIfValidAndUnique(rls1);
+					mj++;
+				};
+			}
+			else if (ab.Done()) return;
+			li++;
+		}
+	}
+}
+
+
+/**********
+*
+*	RefLine_P2L_C2P - Huzita-Hatori Axiom O5.
+*
+*	Bring point p1 to line l1 so that the crease passes through point p2.
+*
+**********/
+
+/*****
+*
+*	RefLine_P2L_C2P::CalcImages(const XYPt& p1, const XYLine& l1, const XYPt& p2, 
+*	XYPt ap1p[2]) - put the images of p1 for each fold that brings p1 onto l1 with the
+*	crease passing through p2 into ap1p, and return the number of them: 0, 1 or 2.
+*
+*****/
+
+short RefLine_P2L_C2P::CalcImages(const XYPt& p1, const XYLine& l1, const XYPt& p2, 
+	XYPt ap1p[2])
+{
+	const XYPt& u1 = l1.u;
+	const double& d1 = l1.d;
+
+	// If either point is already on the line, then this isn't interesting, i.e., it's
+	// a trivial Haga construction.
+	
+	if (l1.Intersects(p1) || l1.Intersects(p2)) return 0;
+	
+	// The image of p1 is as far from p2 as p1 is, so it's where a circle around p2 
+	// crosses l1.
+	
+	double a = d1 - p2.Dot(u1);
+	double b2 = (p2 - p1).Mag2() - a * a;
+	
+	if (b2 < 0) return 0;		// no solution for negative b2 (implies imaginary b)
+	
+	double b = sqrt(b2);
+	XYPt u1p = u1.Rotate90();
+	XYPt pm = p2 + a * u1;
+	ap1p[0] = pm;
+	ap1p[0] += b * u1p;
+	if (b < EPS) return 1;	// degenerate case, there's only one solution
+	ap1p[1] = pm;
+	ap1p[1] -= b * u1p;
+	return 2;
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::RefLine_P2L_C2P(RefMark* arm1, RefLine* arl1, RefMark* arm2, 
+*	const XYPt& ap1p) - Constructor. ap1p is one of the images of arm1 found by 
+*	CalcImages().
+*
+*****/
+
+RefLine_P2L_C2P::RefLine_P2L_C2P(RefMark* arm1, RefLine* arl1, RefMark* arm2, 
+	const XYPt& ap1p) :
+	RefLine(CalcLineRank(arm1, arl1, arm2)), rm1(arm1), rl1(arl1), rm2(arm2)
+{
+	// Get references to the points.
+	
+	XYPt& p1 = rm1->p;
+	XYPt& p2 = rm2->p;
+
+	// Validate; the point of incidence must lie within the square.
+	
+	if (!RefBase::paper.Encloses(ap1p)) {
+		Reject(offPaper);
+		return;
+	}
+	
+	// Construct member data.
+
+	l.u = (ap1p - p1).Normalize();
+	l.d = p2.Dot(l.u);
+	
+	// Check visibility.
+	
+	if (!SetWhoMoves()) {
+		Reject(notVisible);
+		return;
+	}
+	
+	// If this line creates a skinny flap, we won't use it.
+	
+	if (RefBase::paper.MakesSkinnyFlap(l)) {
+		Reject(skinnyFlap);
+		return;
+	}
+	
+	// Set the key.
+	
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P(const RefRecord& ar) - Constructor that restores a line from a
+*	snapshot record.
+*
+*****/
+
+RefLine_P2L_C2P::RefLine_P2L_C2P(const RefRecord& ar) : 
+	RefLine(ar),
+	rm1(ReferenceFinder::basisMarks[ar.mParents[0]]),
+	rl1(ReferenceFinder::basisLines[ar.mParents[1]]),
+	rm2(ReferenceFinder::basisMarks[ar.mParents[2]]),
+	whoMoves(WhoMoves(ar.mWhoMoves))
+{
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::Store(RefRecord& ar) - store this line in a snapshot record.
+*
+*****/
+
+void RefLine_P2L_C2P::Store(RefRecord& ar) const
+{
+	RefLine::Store(ar);
+	ar.mType = lineP2L_C2P;
+	ar.mWhoMoves = static_cast<unsigned char>(whoMoves);
+	ar.mParents[0] = ReferenceFinder::basisMarks.IndexOf(rm1);
+	ar.mParents[1] = ReferenceFinder::basisLines.IndexOf(rl1);
+	ar.mParents[2] = ReferenceFinder::basisMarks.IndexOf(rm2);
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::UsesImmediate(RefBase* rb) - return true if this line uses rb for 
+*	immediate reference.
+*
+*****/
+
+const bool RefLine_P2L_C2P::UsesImmediate(RefBase* rb) const
+{
+	return (rb == rl1 || rb == rm1 || rb == rm2);
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::SetWhoMoves() - decide whether the mark or the line moves in the
+*	fold. Return false if neither of them can be seen to move with opaque paper.
+*
+*****/
+
+bool RefLine_P2L_C2P::SetWhoMoves()
+{
+	bool p1edge = rm1->IsOnEdge();
+	bool l1edge = rl1->IsOnEdge();
+	
+	if (ReferenceFinder::visibilityMatters) {
+		if (p1edge) whoMoves = p1Moves;
+		else if (l1edge) whoMoves = l1Moves;
+		else return false;
+	}
+	else {
+		whoMoves = p1Moves;
+	};
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::Revalidate() - check this line against the current settings.
+*
+*****/
+
+bool RefLine_P2L_C2P::Revalidate()
+{
+	return include && rm1->mKey > 0 && rl1->mKey > 0 && rm2->mKey > 0 && 
+		SetWhoMoves() && !RefBase::paper.MakesSkinnyFlap(l);
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::SequencePushSelf(RefContext& ac) - Build the folding sequence
+*	that constructs this object.
+*
+*****/
+
+void RefLine_P2L_C2P::SequencePushSelf(RefContext& ac)
+{
+	rm2->SequencePushSelf(ac);
+	switch (whoMoves) {
+		case p1Moves:
+			rl1->SequencePushSelf(ac);
+			rm1->SequencePushSelf(ac);
+			break;
+			
+		case l1Moves:
+			rm1->SequencePushSelf(ac);
+			rl1->SequencePushSelf(ac);
+
+			break;
+	};
+	RefBase::SequencePushSelf(ac);
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::PutHowto(const RefContext& ac, ostream& os) - Put the name of this line
+*	to a stream.
+*
+*****/
+
+const bool RefLine_P2L_C2P::PutHowto(const RefContext& ac, ostream& os) const
+{
+	if (ac.axiomsInVerbalDirections) os << "[05] ";
+	os << "Bring ";
+	switch (whoMoves) {
+		case p1Moves:
+			rm1->PutName(ac, os);
+			os << " to ";
+			rl1->PutName(ac, os);
+			break;
+		
+		case l1Moves:
+			rl1->PutName(ac, os);
+			os << " to ";
+			rm1->PutName(ac, os);
+			break;
+	};
+	if (ac.clarifyVerbalAmbiguities) {		
+		os << " so the crease goes through ";
+		rm2->PutName(ac, os);
+	};
+	os << ", making ";
+	PutName(ac, os);
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw
+*	this line, adding arrows if appropriate
+*
+*****/
+
+void RefLine_P2L_C2P::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	// Call inherited method to draw the lines
+	
+	RefLine::DrawSelf(ac, rstyle, ipass);
+	
+	// If we're moving, we need an arrow
+	
+	if ((ipass == arrowPass) && (rstyle == actionRef)) {
+			
+		XYPt& p1 = rm1->p;
+		XYPt p1f = l.Fold(p1);
+		switch (whoMoves) {
+			case p1Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p1, p1f);
+				break;
+			case l1Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p1f, p1);
+				break;
+		}
+	}
+}
+
+
+/*****
+*
+*	RefLine_P2L_C2P::MakeAll(rank_t arank, RefBuilder<RefLine>& ab) - Go
+*	through existing lines and marks and create RefLine_P2L_C2Ps with rank equal arank,
+*	handing them to ab, which stops us at a cumulative total of maxLines. Each pair
+*	(mi, lj) is one unit of the outer iteration; if mi is already on lj, none of its
+*	triples can make a line, so we don't try them.
+*
+*****/
+
+void RefLine_P2L_C2P::MakeAll(rank_t arank, RefBuilder<RefLine>& ab)
+{
+	XYPt p1p[2];
+	
+	for (rank_t irank = 0; irank <= (arank - 1); irank++)
+		for (rank_t jrank = 0; jrank <= (arank - 1 - irank); jrank++) {
+			rank_t krank = arank - irank - jrank - 1;
+			RefContainer<RefMark>::rank_iterator mi = 
+				ReferenceFinder::basisMarks.ranks[irank].begin();
+			while (mi != ReferenceFinder::basisMarks.ranks[irank].end()) {
+				RefContainer<RefLine>::rank_iterator lj = 
+					ReferenceFinder::basisLines.ranks[jrank].begin();
+				while (lj != ReferenceFinder::basisLines.ranks[jrank].end()) {
+					if (ab.Owns()) {
+						if ((*lj)->l.Intersects((*mi)->p)) {
+						
+							// mi is already on lj, so there's nothing to fold.
+							
+							ab.Skip(RefBase::noSolution, 
+								ReferenceFinder::basisMarks.ranks[krank].size());
+						}
+						else {
+							RefContainer<RefMark>::rank_iterator mk = 
+								ReferenceFinder::basisMarks.ranks[krank].begin();
+							while (mk != ReferenceFinder::basisMarks.ranks[krank].end()) {
+								if (*mi != *mk) {
+									if (ab.Done()) return;
+									
+									// Only the first image is used. The second one has always
+									// been constructed and then dropped, and using it would 
+									// change which lines we make.
+									
+									if (CalcImages((*mi)->p, (*lj)->l, (*mk)->p, p1p) > 0) {
+										RefLine_P2L_C2P rlh1(*mi, *lj, *mk, p1p[0]);
+										ab.AddCopyIfValidAndUnique(rlh1);
+									}
+									else ab.Skip(RefBase::noSolution);
+								};
+								mk++;
+							};
+						}
+					}
+					else if (ab.Done()) return;
+					lj++;
+				};
+				mi++;
+			}
+		}
+}
+
+
+/**********
+*
+*	RefLine_P2L_P2L - Huzita-Hatori Axiom O6.
+*
+*	Bring point p1 to line l1 and point p2 to line l2.
+*
+**********/
+
+/*****
+*
+*	CubeRoot(double x) - works for both positive and negative numbers
+*
+*****/
+
+double CubeRoot(double x)
+{
+	if (x >= 0) return pow(x, 1./3);
+	else return -pow(-x, 1./3);
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::CalcRoots(const XYPt& p1, const XYLine& l1, const XYPt& p2, 
+*	const XYLine& l2, double arc[3]) - put the roots of the cubic equation for the folds
+*	that bring p1 onto l1 and p2 onto l2 into arc, and return the number of them: 0 to 3.
+*	All of the roots come out of one pass, in the order that they've always been tried.
+*
+*****/
+
+short RefLine_P2L_P2L::CalcRoots(const XYPt& p1, const XYLine& l1, const XYPt& p2, 
+	const XYLine& l2, double arc[3])
+{
+	// Get references to the parts of the lines involved in the construction
+	
+	const XYPt& u1 = l1.u;
+	const double& d1 = l1.d;
+	const XYPt& u2 = l2.u;
+	const double& d2 = l2.d;
+
+	// This is by far the most complex alignment, and it involves the solution of a cubic equation.
+	
+	XYPt u1p = u1.Rotate90();	// we'll need this later.
+	
+	// First, some trivial checks; we can't have p1 already on l1, or p2 already on l2.
+	
+	if (l1.Intersects(p1)) return 0;
+	if (l2.Intersects(p2)) return 0;
+	
+	// Also make sure we're using distinct points and lines.
+	
+	if ((p1 == p2) || (l1 == l2)) return 0;
+	
+	// Now construct the terms of the cubic equation.
+	
+	XYPt v1 = p1 + d1 * u1 - 2 * p2;
+	XYPt v2 = d1 * u1 - p1;
+
+	double c1 = p2.Dot(u2) - d2;
+	double c2 = 2 * v2.Dot(u1p);
+	double c3 = v2.Dot(v2);
+	double c4 = (v1 + v2).Dot(u1p);
+	double c5 = v1.Dot(v2);
+	double c6 = u1p.Dot(u2);
+	double c7 = v2.Dot(u2);
+	
+	// the equation is a * r^3 + b * r^2 + c * r + d == 0
+	
+	double a = c6;
+	double b = c1 + c4 * c6 + c7;
+	double c = c1 * c2 + c5 * c6 + c4 * c7;
+	double d = c1 * c3 + c5 * c7;
+
+	// compute the order of the equation
+	
+	short order;
+	if (abs(a) > EPS) order = 3;		// cubic equation
+	else if (abs(b) > EPS) order = 2;	// quadratic equation
+	else if (abs(c) > EPS) order = 1;	// linear equation
+	else order = 0;						// ill-formed equation (no variables!)
+	
+	// what we do next depends on the order of the equation.
+	
+	switch(order) {
+		case 0:				// ill-formed equation has 0 roots
+			return 0;
+		
+		case 1:				// linear equation has 1 root
+			arc[0] = -d / c;
+			return 1;
+		
+		case 2:				// quadratic equation has 0, 1 or 2 roots
+			{				
+				double disc = pow(c, 2) - 4 * b * d;
+				double q1 = -c / (2 * b);
+				if (disc < 0) return 0;			// no roots
+				else if (abs(disc) < EPS) {	// 1 degenerate root
+					arc[0] = q1;
+					return 1;
+				}
+				else {							// 2 roots
+					double q2 = sqrt(disc) / (2 * b);
+					arc[0] = q1 + q2;
+					arc[1] = q1 - q2;
+					return 2;
+				}
+			}
+	
+		case 3:				// cubic equation, has 1, 2, or 3 roots
+			{
+				// Construct coefficients that give the roots from Cardano's formula.
+				
+				double a2 = b / a;
+				double a1 = c / a;
+				double a0 = d / a;
+				
+				double Q = (3 * a1 - pow(a2, 2)) / 9;
+				double R = (9 * a2 * a1 - 27 * a0 - 2 * pow(a2, 3)) / 54;
+				double D = pow(Q, 3) + pow(R, 2);
+				double U = -a2 / 3;
+				
+				// The number of roots depends on the value of D.
+				
+				if (D > 0) {					// one root
+					double rD = sqrt(D);
+					double S = CubeRoot(R + rD);
+					double T = CubeRoot(R - rD);
+					arc[0] = U + S + T;
+					return 1;
+				}
+				else if (abs(D) < EPS) {		// two roots
+					double S = pow(R, 1./3);
+					arc[0] = U + 2 * S;
+					arc[1] = U - S;
+					return 2;
+				}
+				else { // D < 0				// three roots
+					double rD = sqrt(-D);
+					double phi = atan2(rD, R) / 3;
+					double rS = pow(pow(R, 2) - D, 1./6);
+					double Sr = rS * cos(phi);
+					double Si = rS * sin(phi);
+					arc[0] = U + 2 * Sr;
+					arc[1] = U - Sr - sqrt(3.) * Si;
+					arc[2] = U - Sr + sqrt(3.) * Si;
+					return 3;
+				}
+			}
+	};	// end of switch(order).
+	return 0;
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::RefLine_P2L_P2L(RefMark* arm1, RefLine* arl1, RefMark* arm2, 
+*	RefLine* arl2, double arc) - Constructor. arc is one of the roots found by 
+*	CalcRoots().
+*
+*****/
+
+RefLine_P2L_P2L::RefLine_P2L_P2L(RefMark* arm1, RefLine* arl1, RefMark* arm2, RefLine* arl2, 
+	double arc) : 
+	RefLine(CalcLineRank(arm1, arl1, arm2, arl2)), rm1(arm1), rl1(arl1), rm2(arm2), rl2(arl2)
+{
+	// Get references to the points and lines involved in the construction
+	
+	XYPt& p1 = rm1->p;
+	XYLine& l1 = rl1->l;
+	XYPt& u1 = l1.u;
+	double& d1 = l1.d;
+	XYPt& p2 = rm2->p;
+	XYPt u1p = u1.Rotate90();
+	
+	// arc is a root of the equation, which must still be validated.
+			
+	XYPt p1p = d1 * u1 + arc * u1p;					// image of p1 in fold line
+	
+	if (p1p == p1) return;							// we only consider p1 off of the fold line
+	
+	l.u = (p1p - p1).Normalize();					// normal to fold line
+	l.d = l.u.Dot(MidPoint(p1p, p1));				// d-parameter of fold line
+	XYPt p2p = p2 + 2 * (l.d - p2.Dot(l.u)) * l.u;	// image of p2 in fold line
+	
+	// Validate; the images of p1 and p2 must lie within the square.
+	
+	if (!RefBase::paper.Encloses(p1p) || !RefBase::paper.Encloses(p2p)) {
+		Reject(offPaper);
+		return;
+	}
+	
+	// Validate visibility; we require that the alignment be visible even with opaque paper.
+	// Meaning that the moving parts must be edge points or edge lines.
+	
+	if (!SetWhoMoves()) {
+		Reject(notVisible);
+		return;
+	}
+	
+	// If this line creates a skinny flap, we won't use it.
+	
+	if (RefBase::paper.MakesSkinnyFlap(l)) {
+		Reject(skinnyFlap);
+		return;
+	}
+	
+	// Set the key.
+	
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L(const RefRecord& ar) - Constructor that restores a line from a
+*	snapshot record.
+*
+*****/
+
+RefLine_P2L_P2L::RefLine_P2L_P2L(const RefRecord& ar) : 
+	RefLine(ar),
+	rm1(ReferenceFinder::basisMarks[ar.mParents[0]]),
+	rl1(ReferenceFinder::basisLines[ar.mParents[1]]),
+	rm2(ReferenceFinder::basisMarks[ar.mParents[2]]),
+	rl2(ReferenceFinder::basisLines[ar.mParents[3]]),
+	whoMoves(WhoMoves(ar.mWhoMoves))
+{
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::Store(RefRecord& ar) - store this line in a snapshot record.
+*
+*****/
+
+void RefLine_P2L_P2L::Store(RefRecord& ar) const
+{
+	RefLine::Store(ar);
+	ar.mType = lineP2L_P2L;
+	ar.mWhoMoves = static_cast<unsigned char>(whoMoves);
+	ar.mParents[0] = ReferenceFinder::basisMarks.IndexOf(rm1);
+	ar.mParents[1] = ReferenceFinder::basisLines.IndexOf(rl1);
+	ar.mParents[2] = ReferenceFinder::basisMarks.IndexOf(rm2);
+	ar.mParents[3] = ReferenceFinder::basisLines.IndexOf(rl2);
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::UsesImmediate(RefBase* rb) - return true if this line uses rb for 
+*	immediate reference.
+*
+*****/
+
+const bool RefLine_P2L_P2L::UsesImmediate(RefBase* rb) const
+{
+	return (rb == rl1 || rb == rm1 || rb == rl2 || rb == rm2);
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::SetWhoMoves() - decide which points and lines move in the fold. 
+*	Return false if the alignment can't be seen with opaque paper.
+*
+*****/
+
+bool RefLine_P2L_P2L::SetWhoMoves()
+{
+	const XYPt& p1 = rm1->p;
+	const XYPt& p2 = rm2->p;
+	
+	// Note whether p1 and p2 are on the same side of the fold line. If they are, then either
+	// both points move or both lines move. If they're not, then one of each moves.
+	
+	bool sameSide = ((p1.Dot(l.u) - l.d) * (p2.Dot(l.u) - l.d) >= 0);
+	
+	// Note which points and lines are on the edge of the paper
+	
+	bool p1edge = rm1->IsOnEdge();
+	bool p2edge = rm2->IsOnEdge();
+	bool l1edge = rl1->IsOnEdge();
+	bool l2edge = rl2->IsOnEdge();
+	
+	// Now, check the visibility of this alignment and use it to specify which parts move
+	
+	if (ReferenceFinder::visibilityMatters) {
+		if (sameSide)
+			if (p1edge && p2edge) whoMoves = p1p2Moves;
+			else if (l1edge && l2edge) whoMoves = l1l2Moves;
+			else return false;
+		else
+			if (p1edge && l2edge) whoMoves = p1l2Moves;
+			else if (p2edge && l1edge) whoMoves = p2l1Moves;
+			else return false;
+	}
+	else {
+		if (sameSide) whoMoves = p1p2Moves;
+		else whoMoves = p1l2Moves;
+	};
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::Revalidate() - check this line against the current settings.
+*
+*****/
+
+bool RefLine_P2L_P2L::Revalidate()
+{
+	return include && rm1->mKey > 0 && rl1->mKey > 0 && rm2->mKey > 0 && 
+		rl2->mKey > 0 && SetWhoMoves() && !RefBase::paper.MakesSkinnyFlap(l);
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::SequencePushSelf(RefContext& ac) - Build the folding sequence
+*	that constructs this object.
+*
+*****/
+
+void RefLine_P2L_P2L::SequencePushSelf(RefContext& ac)
+{
+	switch (whoMoves) {
+		case p1p2Moves:
+			rl2->SequencePushSelf(ac);
+			rl1->SequencePushSelf(ac);
+			rm2->SequencePushSelf(ac);
+			rm1->SequencePushSelf(ac);
+			break;
+			
+		case l1l2Moves:
+			rm2->SequencePushSelf(ac);
+			rm1->SequencePushSelf(ac);
+			rl2->SequencePushSelf(ac);
+			rl1->SequencePushSelf(ac);
+			break;
+		
+		case p1l2Moves:
+			rm2->SequencePushSelf(ac);
+			rl1->SequencePushSelf(ac);
+			rl2->SequencePushSelf(ac);
+			rm1->SequencePushSelf(ac);
+			break;
+		
+		case p2l1Moves:
+			rl2->SequencePushSelf(ac);
+			rm1->SequencePushSelf(ac);
+			rl1->SequencePushSelf(ac);
+			rm2->SequencePushSelf(ac);
+			break;
+	};
+	RefBase::SequencePushSelf(ac);
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::PutHowto(const RefContext& ac, ostream& os) - Put the name of this line
+*	to a stream.
+*
+*****/
+
+const bool RefLine_P2L_P2L::PutHowto(const RefContext& ac, ostream& os) const
+{
+	if (ac.axiomsInVerbalDirections) os << "[06] ";
+	os.precision(2);
+	os.setf(ios_base::fixed, ios_base::floatfield);
+	os << "Bring ";
+	switch (whoMoves) {
+		case p1p2Moves:
+			rm1->PutName(ac, os);
+			os << " to ";
+			rl1->PutName(ac, os);
+			if (ac.clarifyVerbalAmbiguities)
+				os << " at point " << l.Fold(rm1->p).Chop();
+			os << " and ";
+			rm2->PutName(ac, os);
+			os << " to ";
+			rl2->PutName(ac, os);
+			break;
+		
+		case l1l2Moves:
+			rl1->PutName(ac, os);
+			if (ac.clarifyVerbalAmbiguities)
+				os << " so that point " << l.Fold(rm1->p).Chop();
+			os << " touches ";
+			rm1->PutName(ac, os);
+			os << " and ";
+			rl2->PutName(ac, os);
+			os << " to ";
+			rm2->PutName(ac, os);
+			break;
+		
+		case p1l2Moves:
+			rm1->PutName(ac, os);
+			os << " to ";
+			rl1->PutName(ac, os);
+			if (ac.clarifyVerbalAmbiguities)
+				os << " at point " << l.Fold(rm1->p).Chop();
+			os << " and ";
+			rl2->PutName(ac, os);
+			os << " to ";
+			rm2->PutName(ac, os);
+			break;
+		
+		case p2l1Moves:
+			rl1->PutName(ac, os);
+			os << " to ";
+			rm1->PutName(ac, os);
+			os << " and ";
+			rm2->PutName(ac, os);
+			os << " to ";
+			rl2->PutName(ac, os);
+			if (ac.clarifyVerbalAmbiguities)
+				os << " at point " << l.Fold(rm2->p).Chop();
+			break;
+	};
+	os << ", making ";
+	PutName(ac, os);
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_P2P_P2L::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw
+*	this line, adding arrows if appropriate
+*
+*****/
+
+void RefLine_P2L_P2L::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	// Call inherited method to draw the lines
+	
+	RefLine::DrawSelf(ac, rstyle, ipass);
+	
+	// If we're moving, we need an arrow
+	
+	if ((ipass == arrowPass) && (rstyle == actionRef)) {
+			
+				XYPt& p1a = rm1->p;
+				XYPt p1b = l.Fold(p1a);
+				XYPt& p2a = rm2->p;
+				XYPt p2b = l.Fold(p2a);
+		switch (whoMoves) {
+			case p1p2Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p1a, p1b);
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p2a, p2b);
+				break;
+				
+			case l1l2Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p1b, p1a);
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p2b, p2a);
+				break;
+			
+			case p1l2Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p1a, p1b);
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p2b, p2a);
+				break;
+			
+			case p2l1Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p1b, p1a);
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p2a, p2b);
+				break;
+		}
+	}
+}
+
+
+/*****
+*
+*	RefLine_P2L_P2L::MakeAll(rank_t arank, RefBuilder<RefLine>& ab) - Go
+*	through existing lines and marks and create RefLine_P2L_P2Ls with rank equal arank,
+*	handing them to ab, which stops us at a cumulative total of maxLines. Each pair
+*	(mi, mj) is one unit of the outer iteration.
+*
+*	Before solving for the folds that bring mi to lk and mj to ll, we drop combinations
+*	that can't have one: mi already on lk, or lk and ll too close together or too far
+*	apart for the images of mi and mj, which the fold keeps as far apart as mi and mj,
+*	to both land on the paper. The rest are solved once for all of their roots.
+*
+*****/
+
+void RefLine_P2L_P2L::MakeAll(rank_t arank, RefBuilder<RefLine>& ab)
+{
+	const RefLineExtents& le = ReferenceFinder::lineExtents;
+	double rc[3];
+	
+	// psrank == sum of ranks of the two points
+	// lsrank == sum of ranks of the two lines
+	
+	for (rank_t psrank = 0; psrank <= (arank - 1); psrank++)
+		for (rank_t lsrank = 0; lsrank <= (arank - 1) - psrank; lsrank++)
+
+			// point order doesn't matter, so rank(pt[i]) will always be <= rank(pt[j])
+
+			for (rank_t irank = 0; irank <= psrank / 2; irank++) {
+				rank_t jrank = psrank - irank;
+				bool psameRank = (irank == jrank);
+				
+				// line order does matter, so both lines vary over all ranks
+				
+				for (rank_t krank = 0; krank <= lsrank; krank++)
+					for (rank_t lrank = 0; lrank <= lsrank - krank; lrank++) {
+						RefContainer<RefLine>::array_t& rk = 
+							ReferenceFinder::basisLines.ranks[krank];
+						RefContainer<RefLine>::array_t& rl = 
+							ReferenceFinder::basisLines.ranks[lrank];
+		
+						// iterate over all combinations of points & lines with given rank
+		
+						RefContainer<RefMark>::rank_iterator mi = 
+							ReferenceFinder::basisMarks.ranks[irank].begin();
+						if (psameRank) mi++;
+						while (mi != ReferenceFinder::basisMarks.ranks[irank].end()) {
+							RefContainer<RefMark>::rank_iterator mj = 
+								ReferenceFinder::basisMarks.ranks[jrank].begin();
+							while (mj != (psameRank ? mi : 
+								ReferenceFinder::basisMarks.ranks[jrank].end())) {
+								if (ab.Owns()) {
+									const XYPt& p1 = (*mi)->p;
+									const XYPt& p2 = (*mj)->p;
+									double r = (p1 - p2).Mag();	// so are their images
+									for (size_t k = 0; k < rk.size(); k++) {
+										if (rk[k]->l.Intersects(p1)) {
+											ab.Skip(RefBase::noSolution, rl.size());
+											continue;
+										};
+										for (size_t n = 0; n < rl.size(); n++) {
+											if (rk[k] == rl[n]) continue;
+											if (ab.Done()) return;
+											if (le.OutOfReach(krank, k, lrank, n, r)) {
+												ab.Skip(RefBase::offPaper);
+												continue;
+											};
+											const XYLine& l1 = rk[k]->l;
+											short nroots = CalcRoots(p1, l1, p2, rl[n]->l, rc);
+											if (nroots == 0) ab.Skip(RefBase::noSolution);
+											for (short iroot = 0; iroot < nroots; iroot++) {
+												if (ab.Done()) return;
+												
+												// The image of p1 has to land on the paper.
+												
+												if (!RefBase::paper.Encloses(l1.d * l1.u + 
+													rc[iroot] * l1.u.Rotate90())) {
+													ab.Skip(RefBase::offPaper);
+													continue;
+												};
+												RefLine_P2L_P2L rlp(*mi, rk[k], *mj, rl[n], 
+													rc[iroot]);
+												ab.AddCopyIfValidAndUnique(rlp);
+											};
+										};
+									};
+								}
+								else if (ab.Done()) return;
+								mj++;
+							};
+							mi++;
+						}
+					}
+				}
+}
+
+
+/**********
+*
+*	RefLine_L2L_P2L - Huzita-Hatori Axiom O7 (Hatori's Axiom).
+*
+*	Bring line l1 onto itself so that point p1 falls on line l2.
+*
+**********/
+
+/*****
+*
+*	RefLine_L2L_P2L::RefLine_L2L_P2L(RefLine* arl1, RefMark* arm1, RefLine* arl2) - 
+*	Constructor. iroot can be 0 or 1.
+*
+*****/
+
+RefLine_L2L_P2L::RefLine_L2L_P2L(RefLine* arl1, RefMark* arm1, RefLine* arl2) :
+	RefLine(CalcLineRank(arl1, arm1, arl2)), rl1(arl1), rm1(arm1), rl2(arl2)
+{
+	// Get references
+	
+	XYLine& l1 = rl1->l;
+	XYPt& u1 = l1.u;
+	double& d1 = l1.d;
+	XYPt& p1 = rm1->p;
+	XYLine& l2 = rl2->l;
+	XYPt& u2 = l2.u;
+//	double& d2 = l2.d;
+	
+	// Construct direction vector and distance scalar
+	
+	l.u = u2.Rotate90();
+	
+	double uf1 = l.u.Dot(u1);
+	
+	if (abs(uf1) < EPS) return;	// parallel lines, no solution
+	
+	l.d = (d1 + 2 * p1.Dot(l.u) * uf1 - p1.Dot(u1)) / (2 * uf1);
+	
+	// Make sure point of intersection of fold with l2 lies within the paper.
+	
+	XYPt pt = Intersection(l, l2);
+	if (!RefBase::paper.Encloses(pt)) {
+		Reject(offPaper);
+		return;
+	}
+	
+	// Make sure point of incidence of p1 on l1 lies within the paper.
+	
+	XYPt p1p = l.Fold(p1);
+	if (!RefBase::paper.Encloses(p1p)) {
+		Reject(offPaper);
+		return;
+	}
+	
+	// Make sure p1 isn't already on l1 (in which case the alignment is ill-defined).
+	
+	if (l1.Intersects(p1)) return;
+	
+	// Check visibility.
+	
+	bool p1edge = arm1->IsOnEdge();
+	bool l1edge = arl1->IsOnEdge();
+	
+	if (ReferenceFinder::visibilityMatters) {
+		XYPt lp1, lp2;
+		RefBase::paper.ClipLine(l, lp1, lp2);
+		double t1 = (lp1 - pt).Dot(l.u);
+		double t2 = (lp2 - pt).Dot(l.u);
+		double tp = (p1 - pt).Dot(l.u);
+		if ((t1 * tp) < 0) {
+			double ti = t2;
+			t2 = t1;
+			t1 = ti;
+		};	// now t1 is the parameter for the endpoint on the p1 side of l2.
+		if (p1edge && (abs(t1) <= abs(t2))) whoMoves = p1Moves;
+		else if (l1edge && (abs(t1) >= abs(t2))) whoMoves = l1Moves;
+		else {
+			Reject(notVisible);
+			return;
+		}
+	}
+	else {
+		whoMoves = p1Moves;
+	};
+		
+	// If this line creates a skinny flap, we won't use it.
+	
+	if (RefBase::paper.MakesSkinnyFlap(l)) {
+		Reject(skinnyFlap);
+		return;
+	}
+	
+	// Set the key.
+	
+	FinishConstructor();
+}
+
+
+/*****
+*
+*	RefLine_L2L_P2L(const RefRecord& ar) - Constructor that restores a line from a
+*	snapshot record.
+*
+*****/
+
+RefLine_L2L_P2L::RefLine_L2L_P2L(const RefRecord& ar) : 
+	RefLine(ar),
+	rl1(ReferenceFinder::basisLines[ar.mParents[0]]),
+	rm1(ReferenceFinder::basisMarks[ar.mParents[1]]),
+	rl2(ReferenceFinder::basisLines[ar.mParents[2]]),
+	whoMoves(WhoMoves(ar.mWhoMoves))
+{
+}
+
+
+/*****
+*
+*	RefLine_L2L_P2L::Store(RefRecord& ar) - store this line in a snapshot record.
+*
+*****/
+
+void RefLine_L2L_P2L::Store(RefRecord& ar) const
+{
+	RefLine::Store(ar);
+	ar.mType = lineL2L_P2L;
+	ar.mWhoMoves = static_cast<unsigned char>(whoMoves);
+	ar.mParents[0] = ReferenceFinder::basisLines.IndexOf(rl1);
+	ar.mParents[1] = ReferenceFinder::basisMarks.IndexOf(rm1);
+	ar.mParents[2] = ReferenceFinder::basisLines.IndexOf(rl2);
+}
+
+
+/*****
+*
+*	RefLine_L2L_P2L::UsesImmediate(RefBase* rb) - return true if this line uses rb for 
+*	immediate reference.
+*
+*****/
+
+const bool RefLine_L2L_P2L::UsesImmediate(RefBase* rb) const
+{
+	return (rb == rl1 || rb == rm1 || rb == rl2);
+}
+
+
+/*****
+*
+*	RefLine_L2L_P2L::Revalidate() - check this line against the current settings. Which
+*	part moves depends on the orientation the line had before FinishConstructor() settled
+*	it, when the two choices are close, so we construct the line again to find out.
+*
+*****/
+
+bool RefLine_L2L_P2L::Revalidate()
+{
+	if (!include || rl1->mKey <= 0 || rm1->mKey <= 0 || rl2->mKey <= 0) return false;
+	RefLine_L2L_P2L rl(rl1, rm1, rl2);
+	if (rl.mKey != mKey) return false;
+	whoMoves = rl.whoMoves;
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_L2L_P2L::SequencePushSelf(RefContext& ac) - Build the folding sequence
+*	that constructs this object.
+*
+*****/
+
+void RefLine_L2L_P2L::SequencePushSelf(RefContext& ac)
+{
+	switch (whoMoves) {
+		case p1Moves:
+			rl1->SequencePushSelf(ac);
+			rm1->SequencePushSelf(ac);
+			break;
+
+		case l1Moves:
+			rm1->SequencePushSelf(ac);
+			rl1->SequencePushSelf(ac);
+			break;
+	};
+	rl2->SequencePushSelf(ac); 
+	RefBase::SequencePushSelf(ac);
+}
+			
+
+/*****
+*
+*	RefLine_L2L_P2L::PutHowto(const RefContext& ac, ostream& os) - Put the name of this line
+*	to a stream.
+*
+*****/
+
+const bool RefLine_L2L_P2L::PutHowto(const RefContext& ac, ostream& os) const
+{
+	if (ac.axiomsInVerbalDirections) os << "[07] ";
+	os << "Bring ";
+	rl2->PutName(ac, os);
+	os << " onto itself so that ";
+	switch (whoMoves) {
+		case p1Moves:
+			rm1->PutName(ac, os);
+			os << " touches ";
+			rl1->PutName(ac, os);
+			break;
+		
+		case l1Moves:
+			rl1->PutName(ac, os);
+			os << " touches ";
+			rm1->PutName(ac, os);
+			break;
+	};
+	os << ", making ";
+	PutName(ac, os);
+	return true;
+}
+
+
+/*****
+*
+*	RefLine_L2L_P2L::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) - Draw
+*	this line, adding arrows if appropriate
+*
+*****/
+
+void RefLine_L2L_P2L::DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const
+{
+	// Call inherited method to draw the lines
+	
+	RefLine::DrawSelf(ac, rstyle, ipass);
+	
+	// If we're moving, we need an arrow
+	
+	if ((ipass == arrowPass) && (rstyle == actionRef)) {
+			
+		// Draw line-to-itself arrow
+		
+		XYPt p1, p2;
+		XYLine& l2 = rl2->l;
+		RefBase::paper.ClipLine(l2, p1, p2);	// get endpts of the reference line
+		XYPt pi = Intersection(l, l2);					// intersection w/ fold line
+		XYPt u1p = l2.u.Rotate90();						// tangent to reference line
+		double t1 = abs((p1 - pi).Dot(u1p));
+		double t2 = abs((p2 - pi).Dot(u1p));
+		double tmin = t1 < t2 ? t1 : t2;
+		ac.mDgmr->DrawFoldAndUnfoldArrow(pi + tmin * u1p, pi - tmin * u1p);
+		
+		// Draw point-to-line arrow
+		
+		XYPt& p3 = rm1->p;
+		XYPt p3p = l.Fold(p3);
+		switch(whoMoves) {
+			case p1Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p3, p3p);
+				break;
+			case l1Moves:
+				ac.mDgmr->DrawFoldAndUnfoldArrow(p3p, p3);
+				break;
+		}
+	}
+}
+
+
+/*****
+*
+*	RefLine_L2L_P2L::MakeAll(rank_t arank, RefBuilder<RefLine>& ab) - Go
+*	through existing lines and marks and create RefLine_L2L_P2Ls with rank equal arank,
+*	handing them to ab, which stops us at a cumulative total of maxLines. Each pair
+*	(li, mj) is one unit of the outer iteration.
+*
+*****/
+
+void RefLine_L2L_P2L::MakeAll(rank_t arank, RefBuilder<RefLine>& ab)
+{
+	for (rank_t irank = 0; irank <= (arank - 1); irank++)
+		for (rank_t jrank = 0; jrank <= (arank - 1 - irank); jrank++) {
+			rank_t krank = arank - irank - jrank - 1;
+			RefContainer<RefLine>::rank_iterator li = 
+				ReferenceFinder::basisLines.ranks[irank].begin();
+			while (li != ReferenceFinder::basisLines.ranks[irank].end()) {
+				RefContainer<RefMark>::rank_iterator mj = 
+					ReferenceFinder::basisMarks.ranks[jrank].begin();
+				while (mj != ReferenceFinder::basisMarks.ranks[jrank].end()) {
+					if (ab.Owns()) {
+						if ((*li)->l.Intersects((*mj)->p)) {
+						
+							// mj is already on li, so the alignment is ill-defined.
+							
+							ab.Skip(RefBase::noSolution, 
+								ReferenceFinder::basisLines.ranks[krank].size());
+						}
+						else {
+							RefContainer<RefLine>::rank_iterator lk = 
+								ReferenceFinder::basisLines.ranks[krank].begin();
+							while (lk != ReferenceFinder::basisLines.ranks[krank].end()) {
+								if (*li != *lk) {
+									if (ab.Done()) return;
+									RefLine_L2L_P2L rlh1(*li, *mj, *lk);
+									ab.AddCopyIfValidAndUnique(rlh1);
+								};
+								lk++;
+							};
+						}
+					}
+					else if (ab.Done()) return;
+					mj++;
+				};
+				li++;
+			}
+		}
+}
+
+
+/******************************************************************************
+*
+*	Section 3: containers for collections of marks and lines
+*
+*	These containers are templated on the object type; we use the same type for both
+*	RefMarks and RefLines.
+*
+******************************************************************************/
+
+/**********
+*
+*	RefArena - storage for refs, carved out of chunks that double in size up to maxChunk.
+*
+**********/
+
+/*****
+*
+*	RefArena::RefArena() - Constructor. Chunks are only allocated when needed.
+*
+*****/
+
+RefArena::RefArena() : mNext(0), mEnd(0), mChunkSize(minChunk)
+{
+}
+
+
+/*****
+*
+*	RefArena::~RefArena() - Destructor. Free all the chunks.
+*
+*****/
+
+RefArena::~RefArena()
+{
+	Release();
+}
+
+
+/*****
+*
+*	RefArena::Allocate(size_t asize) - return room for an object of size asize.
+*
+*****/
+
+void* RefArena::Allocate(size_t asize)
+{
+	asize = (asize + alignment - 1) & ~size_t(alignment - 1);
+	if (size_t(mEnd - mNext) < asize) {
+		size_t csize = max(asize, mChunkSize);
+		mChunks.push_back(static_cast<char*>(::operator new(csize)));
+		mNext = mChunks.back();
+		mEnd = mNext + csize;
+		if (mChunkSize < size_t(maxChunk)) mChunkSize *= 2;
+	};
+	void* p = mNext;
+	mNext += asize;
+	return p;
+}
+
+
+/*****
+*
+*	RefArena::CopyString(const string& as) - return a copy of as that lives as long as
+*	the arena, for the names of original marks and lines.
+*
+*****/
+
+const char* RefArena::CopyString(const string& as)
+{
+	char* p = static_cast<char*>(Allocate(as.size() + 1));
+	strcpy(p, as.c_str());
+	return p;
+}
+
+
+/*****
+*
+*	RefArena::Release() - free all the chunks, and with them every ref in the arena.
+*
+*****/
+
+void RefArena::Release()
+{
+	for (size_t i = 0; i < mChunks.size(); i++) ::operator delete(mChunks[i]);
+	vector<char*>().swap(mChunks);
+	mNext = mEnd = 0;
+	mChunkSize = minChunk;
+}
+
+
+/**********
+*
+*	RefKeySet - a set of keys, either a bitmap or an open-addressing hash table with
+*	linear probing. Key 0 is never a valid key, so it marks empty hash table slots.
+*
+**********/
+
+/*****
+*
+*	RefKeySet::RefKeySet() - Constructor. Starts out as an empty hash table.
+*
+*****/
+
+RefKeySet::RefKeySet() : mIsBitmap(false), mCount(0)
+{
+	Reinitialize(0);
+}
+
+
+/*****
+*
+*	RefKeySet::UsesBitmap(size_t amaxKey, size_t acount) - return true if a set for keys 
+*	1 through amaxKey, about acount of them, should be a bitmap: if the range is small, or
+*	if the bitmap takes no more memory than a hash table of that many keys would.
+*
+*****/
+
+bool RefKeySet::UsesBitmap(size_t amaxKey, size_t acount)
+{
+	if (amaxKey == 0) return false;
+	if (amaxKey <= size_t(maxBitmapKey)) return true;
+	return acount > 0 && amaxKey / 8 <= Bytes(0, acount);
+}
+
+
+/*****
+*
+*	RefKeySet::Bytes(size_t amaxKey, size_t acount) - return about how much memory a set 
+*	for keys 1 through amaxKey, acount of them, takes. A hash table is kept at most half 
+*	full.
+*
+*****/
+
+size_t RefKeySet::Bytes(size_t amaxKey, size_t acount)
+{
+	if (UsesBitmap(amaxKey, acount)) return (amaxKey / wordBits + 1) * sizeof(word_t);
+	size_t nslots = minSlots;
+	while (nslots < 2 * acount) nslots *= 2;
+	return nslots * sizeof(key_t);
+}
+
+
+/*****
+*
+*	RefKeySet::Reinitialize(size_t amaxKey, size_t acount) - empty the set and get it 
+*	ready for keys 1 through amaxKey, about acount of them. Depending on which takes less
+*	memory, we use a bitmap or a hash table.
+*
+*****/
+
+void RefKeySet::Reinitialize(size_t amaxKey, size_t acount)
+{
+	mIsBitmap = UsesBitmap(amaxKey, acount);
+	if (mIsBitmap) {
+		vector<word_t>(amaxKey / wordBits + 1, 0).swap(mBits);
+		vector<key_t>().swap(mSlots);
+	}
+	else {
+		vector<word_t>().swap(mBits);
+		vector<key_t>(minSlots, 0).swap(mSlots);
+	};
+	mCount = 0;
+}
+
+
+/*****
+*
+*	RefKeySet::Clear() - remove all keys, keeping the storage.
+*
+*****/
+
+void RefKeySet::Clear()
+{
+	fill(mBits.begin(), mBits.end(), word_t(0));
+	fill(mSlots.begin(), mSlots.end(), key_t(0));
+	mCount = 0;
+}
+
+
+/*****
+*
+*	RefKeySet::Slot(key_t akey) - return the hash table slot that holds akey, or the empty
+*	slot where it would go.
+*
+*****/
+
+size_t RefKeySet::Slot(key_t akey) const
+{
+	size_t mask = mSlots.size() - 1;
+	size_t i = (size_t(akey) * size_t(2654435761UL)) & mask;
+	while (mSlots[i] != 0 && mSlots[i] != akey) i = (i + 1) & mask;
+	return i;
+}
+
+
+/*****
+*
+*	RefKeySet::Grow() - double the size of the hash table and rehash its keys.
+*
+*****/
+
+void RefKeySet::Grow()
+{
+	vector<key_t> oldSlots(2 * mSlots.size(), 0);
+	oldSlots.swap(mSlots);
+	for (size_t i = 0; i < oldSlots.size(); i++) 
+		if (oldSlots[i] != 0) mSlots[Slot(oldSlots[i])] = oldSlots[i];
+}
+
+
+/*****
+*
+*	RefKeySet::Contains(key_t akey) - return true if akey is in the set.
+*
+*****/
+
+bool RefKeySet::Contains(key_t akey) const
+{
+	if (mIsBitmap) {
+		size_t iw = size_t(akey) / wordBits;
+		return iw < mBits.size() && (mBits[iw] & (word_t(1) << (size_t(akey) % wordBits)));
+	};
+	return mSlots[Slot(akey)] != 0;
+}
+
+
+/*****
+*
+*	RefKeySet::Insert(key_t akey) - add akey to the set. A bitmap grows if akey is bigger
+*	than we were told to expect.
+*
+*****/
+
+void RefKeySet::Insert(key_t akey)
+{
+	if (mIsBitmap) {
+		size_t iw = size_t(akey) / wordBits;
+		if (iw >= mBits.size()) mBits.resize(max(iw + 1, 2 * mBits.size()), 0);
+		mBits[iw] |= word_t(1) << (size_t(akey) % wordBits);
+		return;
+	};
+	size_t i = Slot(akey);
+	if (mSlots[i] != 0) return;
+	mSlots[i] = akey;
+	if (2 * ++mCount > mSlots.size()) Grow();
+}
+
+
+/**********
+*
+*	RefContainer - a container for storing RefMark* and RefLine* that organizes them by
+*	rank and within a rank, keeps them in an array sorted by key. Only one object is 
+*	stored per key; sets of the keys in use make checking for that quick.
+*	class R = RefMark or RefLine
+*
+**********/
+
+/*****
+*
+*	RefContainer<R>::RefContainer() - Constructor. Initialize arrays.
+*
+*****/
+
+template <class R>
+RefContainer<R>::RefContainer() : rcsz(0), rcbz(0)
+{
+	// expand our rank array to hold all the ranks that we will create
+	
+	ranks.resize(1 + ReferenceFinder::maxRank);
+	rankKeys.Reinitialize(R::MaxKey(), R::MaxCount());
+	bufferKeys.Reinitialize(R::MaxKey(), R::MaxCount());
+}
+
+
+/*****
+*
+*	RefContainer<R>::TotalSize() - return the total size of the container, including
+*	all ranks and the buffer.
+*
+*****/
+
+template <class R>
+size_t RefContainer<R>::TotalSize() const
+{
+	return rcsz + rcbz;
+}
+
+
+/*****
+*
+*	RefContainer<R>::AddCopyIfValidAndUnique(Rs& ars) - Check the validity and uniqueness
+*	of object ars of type Rs (descended from type R), and if it passes, add it to the container.
+*	Used by all the MakeAll() functions. Note that we use the default (compiler-generated)
+*	copy constructor, which is OK since our objects only contain POD and pointers that we 
+*	WANT blind-copied. Returns how it went.
+*
+*****/
+
+template <class R>
+template <class Rs>
+RefBase::Outcome RefContainer<R>::AddCopyIfValidAndUnique(const Rs& ars)
+{
+	// The ref is valid (fully constructed) if its key is greater than 0.
+	// It's unique if the container doesn't already have one with the same key in one of
+	// the ranks or the buffer.
+	
+	ReferenceFinder::OccasionalShowProgress();	// report progress if appropriate
+	if (ars.mKey <= 0) return ars.Rejection();
+	if (Contains(&ars)) return RefBase::duplicate;
+	Add(new (arena) Rs(ars));
+	return RefBase::accepted;
+}
+
+
+/*****
+*
+*	RefContainer<R>::Reinitialize() - Reinitialize all arrays and related counters.
+*
+*****/
+
+template <class R>
+void RefContainer<R>::Reinitialize()
+{
+	rcsz = 0;
+	rcbz = 0;
+	this->resize(0);
+	ranks.resize(0);
+	ranks.resize(1 + ReferenceFinder::maxRank);
+	buffer.resize(0);
+	arena.Release();
+	rankKeys.Reinitialize(R::MaxKey(), R::MaxCount());
+	bufferKeys.Reinitialize(R::MaxKey(), R::MaxCount());
+}
+
+
+/*****
+*
+*	RefContainer<R>::Contains(R* ar) - return true if the container (or the buffer)
+*	contain an equivalent object.
+*
+*****/
+
+template <class R>
+bool RefContainer<R>::Contains(const R* ar) const
+{
+	return rankKeys.Contains(ar->mKey) || bufferKeys.Contains(ar->mKey);
+}
+
+
+/*****
+*
+*	RefContainer<R>::RanksContain(R* ar) - return true if one of the ranks contains an
+*	equivalent object. Unlike the buffer, the ranks don't change while a rank is being
+*	built, so slice builders can call this from any thread.
+*
+*****/
+
+template <class R>
+bool RefContainer<R>::RanksContain(const R* ar) const
+{
+	return rankKeys.Contains(ar->mKey);
+}
+
+
+/*****
+*
+*	RefContainer<R>::Add(R* ar) - Add an element to the array; to be called only if an equivalent
+*	element isn't already present anywhere. To avoid corrupting iterators, we add the new
+*	element to the buffer; it will get added to the main container on the next call to
+*	FlushBuffer().
+*
+*****/
+
+template<class R>
+void RefContainer<R>::Add(R* ar)
+{
+	// Add it to the buffer and increment the buffer size.
+	
+	buffer.push_back(ar);
+	bufferKeys.Insert(ar->mKey);
+	rcbz++;
+}
+
+
+/*****
+*
+*	RefContainer<R>::FlushBuffer() - put the contents of the buffer into the main container.
+*
+*****/
+
+template <class R>
+void RefContainer<R>::FlushBuffer()
+{
+	// Make room for the buffer in the sortable list, and note where each rank ends now.
+	
+	this->reserve(this->size() + rcbz);
+	vector<size_t> oldSizes(ranks.size());
+	for (size_t ir = 0; ir < ranks.size(); ir++) oldSizes[ir] = ranks[ir].size();
+	
+	// Go through the buffer in order of key and add each element to the appropriate rank in
+	// the main container.
+	
+	sort(buffer.begin(), buffer.end(), KeyLess);
+	rank_iterator bi = buffer.begin();
+	while (bi != buffer.end()) {
+		R* rr = *bi;						// get pointer to each new element
+		ranks[rr->mRank].push_back(rr);		// add to the array of the appropriate rank
+		rankKeys.Insert(rr->mKey);			// and its key to the keys in the ranks
+		this->push_back(rr);						// also add to our sortable list
+		rcsz++;								// increment our size counter
+		bi++;								// increment the buffer iterator
+	};
+	buffer.clear();							// clear the buffer
+	bufferKeys.Clear();
+	rcbz = 0;
+	
+	// The new elements of each rank are sorted, and so were the old ones; merge them.
+	
+	for (size_t ir = 0; ir < ranks.size(); ir++)
+		inplace_merge(ranks[ir].begin(), ranks[ir].begin() + oldSizes[ir], ranks[ir].end(), 
+			KeyLess);
+}
+
+
+/*****
+*
+*	RefContainer<R>::ClearRanks() - clear the rank arrays and key sets. Called when they're 
+*	no longer needed.
+*
+*****/
+
+template <class R>
+void RefContainer<R>::ClearRanks()
+{
+	for (size_t ir = 0; ir < ranks.size(); ir++) array_t().swap(ranks[ir]);
+	rankKeys.Reinitialize(0);
+	bufferKeys.Reinitialize(0);
+}
+
+
+/*****
+*
+*	RefContainer<R>::RebuildRanks() - put everything in the sortable list back into the rank
+*	arrays and key sets that ClearRanks() freed, with room for one more rank than before if
+*	maxRank has gone up, so that more ranks can be built on top of them.
+*
+*****/
+
+template <class R>
+void RefContainer<R>::RebuildRanks()
+{
+	ranks.resize(0);
+	ranks.resize(1 + ReferenceFinder::maxRank);
+	rankKeys.Reinitialize(R::MaxKey(), R::MaxCount());
+	bufferKeys.Reinitialize(R::MaxKey(), R::MaxCount());
+	for (size_t i = 0; i < this->size(); i++) {
+		R* rr = (*this)[i];
+		ranks[rr->mRank].push_back(rr);
+		rankKeys.Insert(rr->mKey);
+	};
+	
+	// Each rank must be sorted by key, just as FlushBuffer() left it.
+	
+	for (size_t ir = 0; ir < ranks.size(); ir++)
+		sort(ranks[ir].begin(), ranks[ir].end(), KeyLess);
+}
+
+
+/*****
+*
+*	RefContainer<R>::RemoveDropped() - remove the refs whose key has been set to 0 from the
+*	sortable list, keeping the order of the rest. Only used while the ranks are cleared.
+*
+*****/
+
+template <class R>
+void RefContainer<R>::RemoveDropped()
+{
+	this->erase(remove_if(this->begin(), this->end(), IsDropped), this->end());
+	rcsz = this->size();
+}
+
+
+/*****
+*
+*	RefContainer<R>::BuildLookup() - build the table that IndexOf() uses to find the
+*	position of an object in the sortable list. The table is sorted by pointer so that
+*	lookups are a binary search.
+*
+*****/
+
+template <class R>
+void RefContainer<R>::BuildLookup()
+{
+	lookup.resize(this->size());
+	for (size_t i = 0; i < this->size(); i++) lookup[i] = lookup_t((*this)[i], int(i));
+	sort(lookup.begin(), lookup.end());
+}
+
+
+/*****
+*
+*	RefContainer<R>::ClearLookup() - free the memory used by the lookup table.
+*
+*****/
+
+template <class R>
+void RefContainer<R>::ClearLookup()
+{
+	vector<lookup_t>().swap(lookup);
+}
+
+
+/*****
+*
+*	RefContainer<R>::IndexOf(const R* ar) - return the index of ar in the sortable list,
+*	or -1 if it isn't there. Only valid between calls to BuildLookup() and ClearLookup().
+*
+*****/
+
+template <class R>
+int RefContainer<R>::IndexOf(const R* ar) const
+{
+	typename vector<lookup_t>::const_iterator li = 
+		lower_bound(lookup.begin(), lookup.end(), lookup_t(ar, -1));
+	if (li == lookup.end() || li->first != ar) return -1;
+	return li->second;
+}
+
+
+/**********
+*
+*	RefBuilder - receives the refs made by the MakeAll() routines, either adding them
+*	straight to a container or collecting one slice of them for a later merge.
+*	class R = RefMark or RefLine
+*
+**********/
+
+/*****
+*
+*	RefBuilder<R>::RefBuilder(RefContainer<R>& ac, size_t amax) - Constructor for a serial
+*	builder, which owns every unit of the outer iteration and adds refs to ac until it
+*	holds amax of them.
+*
+*****/
+
+template <class R>
+RefBuilder<R>::RefBuilder(RefContainer<R>& ac, size_t amax) : 
+	mContainer(ac), mMax(amax), mIsSlice(false), mUnit(0), mBegin(0), 
+	mEnd(numeric_limits<size_t>::max())
+{
+}
+
+
+/*****
+*
+*	RefBuilder<R>::RefBuilder(RefContainer<R>& ac, size_t abegin, size_t aend) - Constructor 
+*	for a slice builder, which owns units abegin through aend - 1 of the outer iteration.
+*
+*****/
+
+template <class R>
+RefBuilder<R>::RefBuilder(RefContainer<R>& ac, size_t abegin, size_t aend) : 
+	mContainer(ac), mMax(0), mIsSlice(true), mUnit(0), mBegin(abegin), mEnd(aend)
+{
+	mKeys.Reinitialize(0);
+}
+
+
+/*****
+*
+*	RefBuilder<R>::Owns() - called by a MakeAll() routine once per unit of its outer 
+*	iteration, in order; returns true if this builder should make the refs of that unit.
+*
+*****/
+
+template <class R>
+bool RefBuilder<R>::Owns()
+{
+	size_t n = mUnit++;
+	return n >= mBegin && n < mEnd;
+}
+
+
+/*****
+*
+*	RefBuilder<R>::Done() - return true if the MakeAll() routine can stop; i.e., the 
+*	container is full, time has run out, or we've gone past the end of our slice.
+*
+*****/
+
+template <class R>
+bool RefBuilder<R>::Done() const
+{
+	if (mIsSlice) return mUnit > mEnd;
+	return ReferenceFinder::outOfTime || mContainer.TotalSize() >= mMax;
+}
+
+
+/*****
+*
+*	RefBuilder<R>::AddCopyIfValidAndUnique(Rs& ars) - A serial builder passes ars on to the
+*	container. A slice builder keeps a copy of ars if it's valid and neither the ranks
+*	nor this slice have one with the same key yet; the buffer of the container is checked
+*	when the slice is merged, and that's when the refs we keep get counted.
+*
+*****/
+
+template <class R>
+template <class Rs>
+void RefBuilder<R>::AddCopyIfValidAndUnique(const Rs& ars)
+{
+	mStats.mTries++;
+	if (!mIsSlice) {
+		mStats.Count(mContainer.AddCopyIfValidAndUnique(ars));
+		return;
+	};
+	if (ars.mKey <= 0) mStats.Count(ars.Rejection());
+	else if (mContainer.RanksContain(&ars) || mKeys.Contains(ars.mKey)) 
+		mStats.Count(RefBase::duplicate);
+	else {
+		mKeys.Insert(ars.mKey);
+		mRefs.push_back(new (mArena) Rs(ars));
+		mCopiers.push_back(&CopyRef<Rs>);
+	}
+}
+
+
+/*****
+*
+*	RefBuilder<R>::CopyRef<Rs>(const R* ar, RefArena& aa) - return a copy of ar, which is 
+*	really an Rs, made in aa. A slice keeps one of these for each ref it collects, so that
+*	the refs that survive the merge can be moved into the arena of the container.
+*
+*****/
+
+template <class R>
+template <class Rs>
+R* RefBuilder<R>::CopyRef(const R* ar, RefArena& aa)
+{
+	return new (aa) Rs(*static_cast<const Rs*>(ar));
+}
+
+
+/*****
+*
+*	RefBuilder<R>::Skip(Outcome ao, size_t n) - count n candidates that the MakeAll()
+*	routine could tell would end with outcome ao, and so didn't construct.
+*
+*****/
+
+template <class R>
+void RefBuilder<R>::Skip(RefBase::Outcome ao, size_t n)
+{
+	mStats.mTries += n;
+	mStats.Count(ao, n);
+}
+
+
+/**********
+*
+*	RefBuildStats - counters for the refs that one MakeAll() routine made of one rank.
+*
+**********/
+
+/*****
+*
+*	RefBuildStats::RefBuildStats(RefType atype, rank_t arank) - Constructor, with all the
+*	counters at zero.
+*
+*****/
+
+RefBuildStats::RefBuildStats(RefBase::RefType atype, RefBase::rank_t arank) : 
+	mType(atype), mRank(arank), mTries(0), mSeconds(0), mFull(false), mShare(0), 
+	mOutOfTime(false)
+{
+	for (int i = 0; i < RefBase::numOutcomes; i++) mOutcomes[i] = 0;
+}
+
+
+/*****
+*
+*	RefBuildStats::operator+=(const RefBuildStats& as) - add the counters of as to ours.
+*
+*****/
+
+RefBuildStats& RefBuildStats::operator+=(const RefBuildStats& as)
+{
+	mTries += as.mTries;
+	for (int i = 0; i < RefBase::numOutcomes; i++) mOutcomes[i] += as.mOutcomes[i];
+	mSeconds += as.mSeconds;
+	mFull = mFull || as.mFull;
+	mOutOfTime = mOutOfTime || as.mOutOfTime;
+	return *this;
+}
+
+
+/*****
+*
+*	RefBuildStats::TypeName(RefType atype) - return the name of a kind of ref, which is
+*	the name of its class.
+*
+*****/
+
+const char* RefBuildStats::TypeName(RefBase::RefType atype)
+{
+	switch (atype) {
+		case RefBase::markOriginal: return "RefMark_Original";
+		case RefBase::markIntersection: return "RefMark_Intersection";
+		case RefBase::lineOriginal: return "RefLine_Original";
+		case RefBase::lineC2P_C2P: return "RefLine_C2P_C2P";
+		case RefBase::lineP2P: return "RefLine_P2P";
+		case RefBase::lineL2L: return "RefLine_L2L";
+		case RefBase::lineL2L_C2P: return "RefLine_L2L_C2P";
+		case RefBase::lineP2L_C2P: return "RefLine_P2L_C2P";
+		case RefBase::lineP2L_P2L: return "RefLine_P2L_P2L";
+		case RefBase::lineL2L_P2L: return "RefLine_L2L_P2L";
+	};
+	return "";
+}
+
+
+/*****
+*
+*	RefBuildStats::OutcomeName(Outcome ao) - return the name of an outcome, as used in
+*	reports.
+*
+*****/
+
+const char* RefBuildStats::OutcomeName(RefBase::Outcome ao)
+{
+	switch (ao) {
+		case RefBase::accepted: return "accepted";
+		case RefBase::duplicate: return "duplicate";
+		case RefBase::overCap: return "overCap";
+		case RefBase::noSolution: return "noSolution";
+		case RefBase::offPaper: return "offPaper";
+		case RefBase::noOverlap: return "noOverlap";
+		case RefBase::shallowAngle: return "shallowAngle";
+		case RefBase::notVisible: return "notVisible";
+		case RefBase::skinnyFlap: return "skinnyFlap";
+		case RefBase::numOutcomes: break;
+	};
+	return "";
+}
+
+
+/**********
+*
+*	RefLineExtents - the lines of each rank, with the part of each that lies on the paper.
+*
+**********/
+
+/*****
+*
+*	RefLineExtents static member initialization
+*
+*****/
+
+const double RefLineExtents::margin = 1.0e-6;
+
+
+/*****
+*
+*	RefLineExtents::Update(const RefContainer<RefLine>& ac) - index any rank of ac that has
+*	changed since the last call. Ranks only change while they're being flushed, and 
+*	RefLine_P2L_P2L::MakeAll() only uses the lines of lower ranks, so this gets called 
+*	before the lines of each rank are built.
+*
+*****/
+
+void RefLineExtents::Update(const RefContainer<RefLine>& ac)
+{
+	mRanks.resize(ac.ranks.size());
+	for (size_t r = 0; r < ac.ranks.size(); r++)
+		if (mRanks[r].mExtents.size() != ac.ranks[r].size()) Build(mRanks[r], ac.ranks[r]);
+}
+
+
+/*****
+*
+*	RefLineExtents::Clear() - forget all lines, freeing their memory.
+*
+*****/
+
+void RefLineExtents::Clear()
+{
+	vector<Rank>().swap(mRanks);
+}
+
+
+/*****
+*
+*	RefLineExtents::Build(Rank& ar, const array_t& al) - index the lines al of one rank 
+*	in ar.
+*
+*****/
+
+void RefLineExtents::Build(Rank& ar, const RefContainer<RefLine>::array_t& al)
+{
+	size_t n = al.size();
+	ar.mExtents.resize(n);
+	ar.mEnds.resize(2 * n);
+	for (size_t k = 0; k < n; k++) {
+		Extent& e = ar.mExtents[k];
+		if (!GetExtent(al[k]->l, e, ar.mEnds[2 * k], ar.mEnds[2 * k + 1])) {
+		
+			// A line that misses the paper is marked by an inside-out box.
+			
+			e.mX0 = e.mY0 = 1;
+			e.mX1 = e.mY1 = 0;
+		}
+	};
+}
+
+
+/*****
+*
+*	RefLineExtents::GetExtent(const XYLine& al, Extent& ae, XYPt& ap1, XYPt& ap2) - put 
+*	the ends of the part of al that lies on the paper, padded by margin, in ap1 and ap2,
+*	and a box around them, padded again, in ae. Return false if al misses the padded 
+*	paper. The pad is much larger than the EPS by which Paper::Encloses() lets a point 
+*	stray off the paper, so anything it accepts on al lies between the ends.
+*
+*****/
+
+bool RefLineExtents::GetExtent(const XYLine& al, Extent& ae, XYPt& ap1, XYPt& ap2)
+{
+	// Points on al are al.d * al.u + t * tp, with tp tangent to al. Find the range of t 
+	// that keeps both coordinates within the padded paper.
+	
+	const Paper& pp = RefBase::paper;
+	XYPt pt = al.d * al.u;
+	XYPt tp = al.u.Rotate90();
+	double lo[2] = {pp.bl.x - margin, pp.bl.y - margin};
+	double hi[2] = {pp.tr.x + margin, pp.tr.y + margin};
+	double p0[2] = {pt.x, pt.y};
+	double dp[2] = {tp.x, tp.y};
+	double tmin = -numeric_limits<double>::max();
+	double tmax = numeric_limits<double>::max();
+	for (int i = 0; i < 2; i++) {
+		if (dp[i] == 0) {
+			if (p0[i] < lo[i] || p0[i] > hi[i]) return false;
+			continue;
+		};
+		double t1 = (lo[i] - p0[i]) / dp[i];
+		double t2 = (hi[i] - p0[i]) / dp[i];
+		if (t1 > t2) swap(t1, t2);
+		if (tmin < t1) tmin = t1;
+		if (tmax > t2) tmax = t2;
+	};
+	if (tmin > tmax) return false;
+	
+	// The box runs between the ends of that range, padded again for roundoff.
+	
+	ap1 = pt + tmin * tp;
+	ap2 = pt + tmax * tp;
+	ae.mX0 = min(ap1.x, ap2.x) - margin;
+	ae.mY0 = min(ap1.y, ap2.y) - margin;
+	ae.mX1 = max(ap1.x, ap2.x) + margin;
+	ae.mY1 = max(ap1.y, ap2.y) + margin;
+	return true;
+}
+
+
+/*****
+*
+*	RefLineExtents::Dist2(const XYPt& ap, const XYPt& ap1, const XYPt& ap2) - return the
+*	square of the distance from ap to the segment from ap1 to ap2.
+*
+*****/
+
+double RefLineExtents::Dist2(const XYPt& ap, const XYPt& ap1, const XYPt& ap2)
+{
+	XYPt v = ap2 - ap1;
+	XYPt w = ap - ap1;
+	double t = w.Dot(v);
+	if (t <= 0) return w.Mag2();
+	double vv = v.Mag2();
+	if (t >= vv) return (ap - ap2).Mag2();
+	return w.Mag2() - t * t / vv;
+}
+
+
+/*****
+*
+*	RefLineExtents::OutOfReach(rank_t irank, size_t i, rank_t jrank, size_t j, double ar) - 
+*	return true if no two points, one on the paper on line i of rank irank and one on 
+*	the paper on line j of rank jrank, are ar apart. The distances between such points
+*	run from the distance between the two segments, which is zero if they cross, to the 
+*	largest distance between their ends.
+*
+*****/
+
+bool RefLineExtents::OutOfReach(rank_t irank, size_t i, rank_t jrank, size_t j, 
+	double ar) const
+{
+	const Rank& ri = mRanks[irank];
+	const Rank& rj = mRanks[jrank];
+	if (ri.mExtents[i].IsEmpty() || rj.mExtents[j].IsEmpty()) return true;
+	const XYPt& a1 = ri.mEnds[2 * i];
+	const XYPt& a2 = ri.mEnds[2 * i + 1];
+	const XYPt& b1 = rj.mEnds[2 * j];
+	const XYPt& b2 = rj.mEnds[2 * j + 1];
+	
+	// Too far apart?
+	
+	double dmax2 = max(max((a1 - b1).Mag2(), (a1 - b2).Mag2()), 
+		max((a2 - b1).Mag2(), (a2 - b2).Mag2()));
+	if (ar > sqrt(dmax2) + margin) return true;
+	
+	// Too close together? Not if the segments cross, i.e., the ends of each lie on 
+	// opposite sides of the other.
+	
+	XYPt va = a2 - a1;
+	XYPt vb = b2 - b1;
+	double sb1 = va.Dot((b1 - a1).Rotate90());
+	double sb2 = va.Dot((b2 - a1).Rotate90());
+	double sa1 = vb.Dot((a1 - b1).Rotate90());
+	double sa2 = vb.Dot((a2 - b1).Rotate90());
+	if (sb1 * sb2 <= 0 && sa1 * sa2 <= 0) return false;
+	double dmin2 = min(min(Dist2(a1, b1, b2), Dist2(a2, b1, b2)), 
+		min(Dist2(b1, a1, a2), Dist2(b2, a1, a2)));
+	return ar < sqrt(dmin2) - margin;
+}
+
+
+/******************************************************************************
+*
+*	Section 4: routines for building sets of marks and lines and collecting statistics
+*
+******************************************************************************/
+
+
+/**********
+*
+*	CompareError - function object for comparing two refs of class R according to their 
+*	distance from a target value of class X.
+*
+**********/
+
+/*****
+*
+*	CompareError<R>::operator()(R* r1, R* r2) - return true if rl1 is
+*	a better R than rl2. Comparison is strictly on distance, with ties resolved by rank.
+*
+*****/
+
+template <class R>
+bool CompareError<R>::operator()(R* r1, R* r2) const
+{
+	// Compare the distances from the stored R::bare_t. If the distances are equal,
+	// then compare the marks by their rank.
+	
+	double d1 = r1->Distance(b);
+	double d2 = r2->Distance(b);
+	
+	if (d1 == d2) return r1->mRank < r2->mRank;	
+	else return d1 < d2;
+}
+
+
+/**********
+*
+*	CompareRankAndError - function object for comparing two refs of class R according to their 
+*	distance from a target value of class X, but for close points, letting rank win out
+*
+**********/
+
+/*****
+*
+*	CompareRankAndError<R>::operator()(R* r1, R* r2) - return true if r1 is
+*	a better R than r2. 
+*
+*	If either mark is farther than maxError, return true if r1 is closer than r2.
+*	If both are within maxError, then return true if r1 has a lower rank than r2.
+*	If both are within maxError and they have the same rank, then return true if r1 is closer.
+*	Exact ties are broken by key, so that the best refs come out in the same order no 
+*	matter which refs the search looks at, or in what order.
+*
+*****/
+
+template <class R>
+bool CompareRankAndError<R>::operator()(R* r1, R* r2) const
+{
+	return Better(r1, r1->Distance(b), r2, r2->Distance(b));
+}
+
+
+/*****
+*
+*	CompareRankAndError<R>::Better(const R* r1, double d1, const R* r2, double d2) - 
+*	return true if r1, at distance d1 from the target, is a better R than r2, at distance
+*	d2 from the target.
+*
+*****/
+
+template <class R>
+bool CompareRankAndError<R>::Better(const R* r1, double d1, const R* r2, double d2)
+{
+	// Compare the distances from the given point. If both distances are less than or equal to maxError,
+	// compare the marks by their rank.
+	
+	if ((d1 > ReferenceFinder::maxError) || (d2 > ReferenceFinder::maxError)) {
+		if (d1 != d2) return d1 < d2;
+		if (r1->mRank != r2->mRank) return r1->mRank < r2->mRank;	
+	}
+	else {
+		if (r1->mRank != r2->mRank) return r1->mRank < r2->mRank;
+		if (d1 != d2) return d1 < d2;
+	}
+	return r1->mKey < r2->mKey;
+}
+
+
+/**********
+*
+*	RefTopK - keeps the best k refs offered to it.
+*
+**********/
+
+/*****
+*
+*	RefTopK<R>::Rejects(double ad) - return true if a ref at distance ad from the target
+*	can't beat the worst of the k that we have, whatever its rank and key. This lets a
+*	search pass over most refs without looking at anything but their distance.
+*
+*****/
+
+template <class R>
+bool RefTopK<R>::Rejects(double ad) const
+{
+	if (mBest.size() < mK) return false;
+	if (mK == 0) return true;
+	double dw = mBest.back().second;
+	return (dw > ReferenceFinder::maxError) ? (ad > dw) : (ad > ReferenceFinder::maxError);
+}
+
+
+/*****
+*
+*	RefTopK<R>::Offer(R* ar, double ad) - keep ar, at distance ad from the target, if it's
+*	among the best k refs offered so far.
+*
+*****/
+
+template <class R>
+void RefTopK<R>::Offer(R* ar, double ad)
+{
+	if (Rejects(ad)) return;
+	if (mBest.size() == mK) {
+		if (!CompareRankAndError<R>::Better(ar, ad, mBest.back().first, mBest.back().second)) 
+			return;
+		mBest.pop_back();
+	};
+	typename vector<entry_t>::iterator it = mBest.end();
+	while (it != mBest.begin() && 
+		CompareRankAndError<R>::Better(ar, ad, (it - 1)->first, (it - 1)->second)) it--;
+	mBest.insert(it, entry_t(ar, ad));
+}
+
+
+/*****
+*
+*	RefTopK<R>::Get(vector<R*>& vr) - store the best refs in vr, best first. Like 
+*	partial_sort_copy(), we leave vr with k elements and fill in as many as we have.
+*
+*****/
+
+template <class R>
+void RefTopK<R>::Get(vector<R*>& vr) const
+{
+	vr.resize(mK);
+	for (size_t i = 0; i < mBest.size(); i++) vr[i] = mBest[i].first;
+}
+
+
+/**********
+*
+*	RefRankList - lists the refs within a tolerance of the target by rank.
+*
+**********/
+
+/*****
+*
+*	RefRankList<R>::Before(const entry_t& e1, const entry_t& e2) - return true if ref 
+*	e1.first, at distance e1.second from the target, comes before e2.first on the list:
+*	by rank, then distance, then key, which is how CompareRankAndError orders refs within
+*	maxError.
+*
+*****/
+
+template <class R>
+bool RefRankList<R>::Before(const entry_t& e1, const entry_t& e2)
+{
+	if (e1.first->mRank != e2.first->mRank) return e1.first->mRank < e2.first->mRank;
+	if (e1.second != e2.second) return e1.second < e2.second;
+	return e1.first->mKey < e2.first->mKey;
+}
+
+
+/*****
+*
+*	RefRankList<R>::Get(vector<R*>& vr, bool afrontier) - store the refs within the 
+*	tolerance in vr, by rank and then distance. If afrontier, only store the ones closer
+*	than every ref of lower rank, which are the first of their rank that beat the last 
+*	one stored.
+*
+*****/
+
+template <class R>
+void RefRankList<R>::Get(vector<R*>& vr, bool afrontier)
+{
+	sort(mRefs.begin(), mRefs.end(), Before);
+	vr.clear();
+	double dbest = numeric_limits<double>::infinity();
+	for (size_t i = 0; i < mRefs.size(); i++) {
+		if (afrontier) {
+			if (mRefs[i].second >= dbest) continue;
+			dbest = mRefs[i].second;
+		};
+		vr.push_back(mRefs[i].first);
+	}
+}
+
+
+/**********
+*
+*	RefScorer - computes the distances from a target to runs of marks or lines.
+*
+**********/
+
+/*****
+*
+*	RefScorer static member initialization
+*
+*****/
+
+bool RefScorer::useAVX2 = true;
+
+
+/*****
+*
+*	RefScorer::HaveAVX2() - return true if we were built with AVX2 support and the 
+*	processor that we're running on has AVX2.
+*
+*****/
+
+bool RefScorer::HaveAVX2()
+{
+#ifdef USE_AVX2
+	static const bool haveAVX2 = __builtin_cpu_supports("avx2");
+	return haveAVX2;
+#else
+	return false;
+#endif
+}
+
+
+/*****
+*
+*	RefScorer::KernelName() - return the name of the kernel that the scorer uses.
+*
+*****/
+
+const char* RefScorer::KernelName()
+{
+	return (useAVX2 && HaveAVX2()) ? "AVX2" : "scalar";
+}
+
+
+/*****
+*
+*	RefScorer::MarkDistances(const XYPt& ap, const double* ax, const double* ay, 
+*		size_t an, double* adist) - store in adist[i] the distance from ap to the mark at
+*	(ax[i], ay[i]), for i from 0 to an - 1.
+*
+*****/
+
+void RefScorer::MarkDistances(const XYPt& ap, const double* ax, const double* ay, 
+	size_t an, double* adist)
+{
+#ifdef USE_AVX2
+	if (useAVX2 && HaveAVX2()) {
+		MarkDistancesAVX2(ap, ax, ay, an, adist);
+		return;
+	};
+#endif
+	MarkDistancesScalar(ap, ax, ay, an, adist);
+}
+
+
+/*****
+*
+*	RefScorer::LineDistances(const XYLine& al, const double* aux, const double* auy, 
+*		const double* ad, size_t an, double* adist) - store in adist[i] the distance from al 
+*	to the line with normal (aux[i], auy[i]) and distance ad[i], for i from 0 to an - 1.
+*
+*****/
+
+void RefScorer::LineDistances(const XYLine& al, const double* aux, const double* auy, 
+	const double* ad, size_t an, double* adist)
+{
+#ifdef USE_AVX2
+	if (useAVX2 && HaveAVX2()) {
+		LineDistancesAVX2(al, aux, auy, ad, an, adist);
+		return;
+	};
+#endif
+	LineDistancesScalar(al, aux, auy, ad, an, adist);
+}
+
+
+/*****
+*
+*	RefScorer::MarkDistancesScalar(), LineDistancesScalar() - one at a time, exactly as
+*	RefMark::Distance() and RefLine::Distance() do it.
+*
+*****/
+
+void RefScorer::MarkDistancesScalar(const XYPt& ap, const double* ax, const double* ay, 
+	size_t an, double* adist)
+{
+	for (size_t i = 0; i < an; i++) {
+		double dx = ax[i] - ap.x;
+		double dy = ay[i] - ap.y;
+		adist[i] = sqrt(dx * dx + dy * dy);
+	}
+}
+
+void RefScorer::LineDistancesScalar(const XYLine& al, const double* aux, const double* auy, 
+	const double* ad, size_t an, double* adist)
+{
+	const XYPt v = al.u.Rotate90();
+	for (size_t i = 0; i < an; i++) {
+		double s = aux[i] * v.x + auy[i] * v.y;
+		double c = ad[i] - al.d * (aux[i] * al.u.x + auy[i] * al.u.y);
+		adist[i] = sqrt(s * s + c * c);
+	}
+}
+
+
+/*****
+*
+*	RefScorer::MarkDistancesAVX2(), LineDistancesAVX2() - four at a time, with the same
+*	operations in the same order as the scalar versions, so that the results are 
+*	identical; the last few go through the scalar versions.
+*
+*****/
+
+#ifdef USE_AVX2
+__attribute__((target("avx2")))
+void RefScorer::MarkDistancesAVX2(const XYPt& ap, const double* ax, const double* ay, 
+	size_t an, double* adist)
+{
+	const __m256d px = _mm256_set1_pd(ap.x);
+	const __m256d py = _mm256_set1_pd(ap.y);
+	size_t i = 0;
+	for (; i + 4 <= an; i += 4) {
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(ax + i), px);
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ay + i), py);
+		__m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+		_mm256_storeu_pd(adist + i, _mm256_sqrt_pd(d2));
+	};
+	MarkDistancesScalar(ap, ax + i, ay + i, an - i, adist + i);
+}
+
+__attribute__((target("avx2")))
+void RefScorer::LineDistancesAVX2(const XYLine& al, const double* aux, const double* auy, 
+	const double* ad, size_t an, double* adist)
+{
+	const XYPt v = al.u.Rotate90();
+	const __m256d vx = _mm256_set1_pd(v.x);
+	const __m256d vy = _mm256_set1_pd(v.y);
+	const __m256d ux = _mm256_set1_pd(al.u.x);
+	const __m256d uy = _mm256_set1_pd(al.u.y);
+	const __m256d d = _mm256_set1_pd(al.d);
+	size_t i = 0;
+	for (; i + 4 <= an; i += 4) {
+		__m256d lx = _mm256_loadu_pd(aux + i);
+		__m256d ly = _mm256_loadu_pd(auy + i);
+		__m256d s = _mm256_add_pd(_mm256_mul_pd(lx, vx), _mm256_mul_pd(ly, vy));
+		__m256d c = _mm256_add_pd(_mm256_mul_pd(lx, ux), _mm256_mul_pd(ly, uy));
+		c = _mm256_sub_pd(_mm256_loadu_pd(ad + i), _mm256_mul_pd(d, c));
+		__m256d d2 = _mm256_add_pd(_mm256_mul_pd(s, s), _mm256_mul_pd(c, c));
+		_mm256_storeu_pd(adist + i, _mm256_sqrt_pd(d2));
+	};
+	LineDistancesScalar(al, aux + i, auy + i, ad + i, an - i, adist + i);
+}
+#endif // USE_AVX2
+
+
+/**********
+*
+*	RefMarkIndex - a uniform grid of cells over the paper, each holding the marks that lie
+*	in it.
+*
+**********/
+
+/*****
+*
+*	RefMarkIndex::RefMarkIndex() - Constructor. The index starts out empty.
+*
+*****/
+
+RefMarkIndex::RefMarkIndex() : mCols(0), mRows(0), mCellWidth(0), mCellHeight(0)
+{
+}
+
+
+/*****
+*
+*	RefMarkIndex::CellCol(double x), CellRow(double y) - return the column or row of the
+*	cell that holds a coordinate. Marks can lie a hair outside the paper, and targets 
+*	anywhere, so we clamp to the grid.
+*
+*****/
+
+int RefMarkIndex::CellCol(double x) const
+{
+	double c = floor(x / mCellWidth);
+	if (c < 0) return 0;
+	if (c >= mCols) return mCols - 1;
+	return int(c);
+}
+
+int RefMarkIndex::CellRow(double y) const
+{
+	double r = floor(y / mCellHeight);
+	if (r < 0) return 0;
+	if (r >= mRows) return mRows - 1;
+	return int(r);
+}
+
+
+/*****
+*
+*	RefMarkIndex::Build(const vector<RefMark*>& am) - sort the marks am into cells. We
+*	aim for a couple of marks per cell, which keeps the cells small compared to maxError.
+*
+*****/
+
+void RefMarkIndex::Build(const vector<RefMark*>& am)
+{
+	Clear();
+	if (am.empty()) return;
+	mCols = mRows = max(1, min(1024, int(sqrt(am.size() / 2.0))));
+	mCellWidth = RefBase::paper.pWidth / mCols;
+	mCellHeight = RefBase::paper.pHeight / mRows;
+	
+	// Count the marks in each cell, then turn the counts into starting positions and 
+	// drop each mark into place.
+	
+	size_t ncells = size_t(mCols) * mRows;
+	vector<size_t> cell(am.size());
+	mStart.assign(ncells + 1, 0);
+	for (size_t i = 0; i < am.size(); i++) {
+		cell[i] = size_t(CellRow(am[i]->p.y)) * mCols + CellCol(am[i]->p.x);
+		mStart[cell[i] + 1]++;
+	};
+	for (size_t ic = 0; ic < ncells; ic++) mStart[ic + 1] += mStart[ic];
+	vector<size_t> next(mStart.begin(), mStart.end() - 1);
+	mMarks.resize(am.size());
+	for (size_t i = 0; i < am.size(); i++) mMarks[next[cell[i]]++] = am[i];
+	
+	// Keep the coordinates of the marks alongside, for RefScorer.
+	
+	mX.resize(mMarks.size());
+	mY.resize(mMarks.size());
+	for (size_t k = 0; k < mMarks.size(); k++) {
+		mX[k] = mMarks[k]->p.x;
+		mY[k] = mMarks[k]->p.y;
+	}
+}
+
+
+/*****
+*
+*	RefMarkIndex::Clear() - forget all marks and free the memory used by the index.
+*
+*****/
+
+void RefMarkIndex::Clear()
+{
+	mCols = mRows = 0;
+	vector<size_t>().swap(mStart);
+	vector<RefMark*>().swap(mMarks);
+	vector<double>().swap(mX);
+	vector<double>().swap(mY);
+}
+
+
+/*****
+*
+*	RefMarkIndex::Score(const XYPt& ap, size_t k0, size_t k1, vector<RefMark*>& vm, 
+*		vector<double>& dm) - append marks k0 through k1 - 1 to vm and their distances 
+*	from ap to dm.
+*
+*****/
+
+void RefMarkIndex::Score(const XYPt& ap, size_t k0, size_t k1, vector<RefMark*>& vm, 
+	vector<double>& dm) const
+{
+	if (k1 <= k0) return;
+	vm.insert(vm.end(), mMarks.begin() + k0, mMarks.begin() + k1);
+	size_t n0 = dm.size();
+	dm.resize(n0 + k1 - k0);
+	RefScorer::MarkDistances(ap, &mX[k0], &mY[k0], k1 - k0, &dm[n0]);
+}
+
+
+/*****
+*
+*	RefMarkIndex::Collect(const XYPt& ap, double ar, vector<RefMark*>& vm, 
+*		vector<double>& dm) - append to vm every mark that could be within ar of ap (and
+*	some that aren't), and to dm their distances from ap: all the marks in the cells that
+*	the square around ap with half-width ar touches.
+*
+*****/
+
+void RefMarkIndex::Collect(const XYPt& ap, double ar, vector<RefMark*>& vm, 
+	vector<double>& dm) const
+{
+	if (mMarks.empty()) return;
+	int x0 = CellCol(ap.x - ar);
+	int x1 = CellCol(ap.x + ar);
+	for (int j = CellRow(ap.y - ar); j <= CellRow(ap.y + ar); j++) {
+		size_t ir = size_t(j) * mCols;
+		Score(ap, mStart[ir + x0], mStart[ir + x1 + 1], vm, dm);
+	}
+}
+
+
+/*****
+*
+*	RefMarkIndex::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks) - 
+*	find the best marks for target ap, in the order given by CompareRankAndError, storing
+*	them in vm.
+*
+*	We visit rings of cells around the cell that holds ap. After each ring we know how far
+*	ap is from the nearest cell that we haven't visited; call that the bound. Every mark
+*	that we haven't seen is at least that far away. Once the bound exceeds maxError and 
+*	we've seen numMarks marks closer than the bound, no unseen mark can beat those, so we
+*	can sort what we've seen and stop.
+*
+*****/
+
+void RefMarkIndex::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks) const
+{
+	vm.resize(numMarks);
+	if (numMarks <= 0 || mMarks.empty()) return;
+	int cx = CellCol(ap.x);
+	int cy = CellRow(ap.y);
+	vector<RefMark*> seen;			// marks in the cells visited so far
+	vector<double> dist;			// their distances from ap
+	
+	for (int m = 0; ; m++) {
+		int x0 = cx - m;
+		int x1 = cx + m;
+		int y0 = cy - m;
+		int y1 = cy + m;
+		
+		// Visit ring m: the full top and bottom rows and the two side columns between them.
+		// The cells of a row are contiguous, so a whole top or bottom row is one run.
+		
+		for (int j = max(y0, 0); j <= min(y1, mRows - 1); j++) {
+			size_t ir = size_t(j) * mCols;
+			if (j == y0 || j == y1) 
+				Score(ap, mStart[ir + max(x0, 0)], mStart[ir + min(x1, mCols - 1) + 1], 
+					seen, dist);
+			else {
+				if (x0 >= 0) Score(ap, mStart[ir + x0], mStart[ir + x0 + 1], seen, dist);
+				if (x1 < mCols) Score(ap, mStart[ir + x1], mStart[ir + x1 + 1], seen, dist);
+			}
+		};
+		
+		// Distance to the nearest unvisited cell; infinite once we've visited them all.
+		
+		double bound = numeric_limits<double>::infinity();
+		if (x0 > 0) bound = min(bound, ap.x - x0 * mCellWidth);
+		if (x1 < mCols - 1) bound = min(bound, (x1 + 1) * mCellWidth - ap.x);
+		if (y0 > 0) bound = min(bound, ap.y - y0 * mCellHeight);
+		if (y1 < mRows - 1) bound = min(bound, (y1 + 1) * mCellHeight - ap.y);
+		if (bound == numeric_limits<double>::infinity()) break;
+		if (bound <= ReferenceFinder::maxError) continue;
+		short nclose = 0;
+		for (size_t k = 0; k < dist.size() && nclose < numMarks; k++) 
+			if (dist[k] < bound) nclose++;
+		if (nclose >= numMarks) break;
+	};
+	RefTopK<RefMark> best(numMarks);
+	for (size_t k = 0; k < seen.size(); k++) best.Offer(seen[k], dist[k]);
+	best.Get(vm);
+}
+
+
+/*****
+*
+*	RefMarkIndex::ScanBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks) - 
+*	same as FindBestMarks(), but looking at every mark, a block at a time.
+*
+*****/
+
+void RefMarkIndex::ScanBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks) const
+{
+	const size_t blockSize = 256;
+	double dist[blockSize];
+	RefTopK<RefMark> best(max(short(0), numMarks));
+	for (size_t k0 = 0; k0 < mMarks.size(); k0 += blockSize) {
+		size_t n = min(blockSize, mMarks.size() - k0);
+		RefScorer::MarkDistances(ap, &mX[k0], &mY[k0], n, dist);
+		for (size_t k = 0; k < n; k++) 
+			if (!best.Rejects(dist[k])) best.Offer(mMarks[k0 + k], dist[k]);
+	};
+	best.Get(vm);
+}
+
+
+/*****
+*
+*	RefMarkIndex::FindMarksWithin(const XYPt& ap, RefRankList<RefMark>& ar) - offer ar 
+*	the marks within its tolerance of ap, only looking at the cells nearby.
+*
+*****/
+
+void RefMarkIndex::FindMarksWithin(const XYPt& ap, RefRankList<RefMark>& ar) const
+{
+	vector<RefMark*> seen;
+	vector<double> dist;
+	Collect(ap, ar.Tolerance(), seen, dist);
+	for (size_t k = 0; k < seen.size(); k++) ar.Offer(seen[k], dist[k]);
+}
+
+
+/*****
+*
+*	RefMarkIndex::NearestDistance(const XYPt& ap) - return the distance from ap to the
+*	closest mark, looking at every mark.
+*
+*****/
+
+double RefMarkIndex::NearestDistance(const XYPt& ap) const
+{
+	const size_t blockSize = 256;
+	double dist[blockSize];
+	double dmin = numeric_limits<double>::infinity();
+	for (size_t k0 = 0; k0 < mMarks.size(); k0 += blockSize) {
+		size_t n = min(blockSize, mMarks.size() - k0);
+		RefScorer::MarkDistances(ap, &mX[k0], &mY[k0], n, dist);
+		for (size_t k = 0; k < n; k++) if (dist[k] < dmin) dmin = dist[k];
+	};
+	return dmin;
+}
+
+
+/**********
+*
+*	RefLineIndex - lines bucketed by the angle of their normal and sorted by d within
+*	each bucket.
+*
+*	If line l has normal angle t and distance d, and the target line al has normal angle 
+*	p and distance a, then l.Distance(al) works out to
+*
+*		sqrt(sin(t - p)^2 + (d - a * cos(t - p))^2)
+*
+*	So a line within r of al must have t within asin(r) of p or p + pi, and d within r of 
+*	a * cos(t - p). The first condition picks out a few angle buckets; the second, a 
+*	range of d in each one.
+*
+**********/
+
+/*****
+*
+*	RefLineIndex::RefLineIndex() - Constructor. The index starts out empty.
+*
+*****/
+
+RefLineIndex::RefLineIndex() : mAngles(0)
+{
+}
+
+
+/*****
+*
+*	RefLineIndex::Normalize(const XYLine& al, double& aa, double& ad) - get the angle aa
+*	of the normal of al and its distance ad from the origin, flipping the normal if 
+*	needed so that ad >= 0, as RefLine::FinishConstructor() does.
+*
+*****/
+
+void RefLineIndex::Normalize(const XYLine& al, double& aa, double& ad)
+{
+	if (al.d < 0) {
+		aa = atan2(-al.u.y, -al.u.x);
+		ad = -al.d;
+	}
+	else {
+		aa = atan2(al.u.y, al.u.x);
+		ad = al.d;
+	}
+}
+
+
+/*****
+*
+*	RefLineIndex::AngleBucket(double aa) - return the bucket that holds normal angle aa,
+*	which is between -pi and pi.
+*
+*****/
+
+int RefLineIndex::AngleBucket(double aa) const
+{
+	const double pi = 3.14159265358979323;
+	double b = floor((aa + pi) / (2 * pi) * mAngles);
+	if (b < 0) return 0;
+	if (b >= mAngles) return mAngles - 1;
+	return int(b);
+}
+
+
+/*****
+*
+*	RefLineIndex::Build(const vector<RefLine*>& al) - sort the lines al into buckets.
+*	We aim for a few hundred lines per bucket; a search only reads a short run of each.
+*
+*****/
+
+void RefLineIndex::Build(const vector<RefLine*>& al)
+{
+	Clear();
+	if (al.empty()) return;
+	mAngles = max(1, min(4096, int(al.size() / 256)));
+	
+	// Sort the lines by bucket and then by d.
+	
+	typedef pair<pair<int, double>, RefLine*> entry_t;
+	vector<entry_t> entries(al.size());
+	for (size_t i = 0; i < al.size(); i++) {
+		double aa, ad;
+		Normalize(al[i]->l, aa, ad);
+		entries[i] = entry_t(pair<int, double>(AngleBucket(aa), ad), al[i]);
+	};
+	sort(entries.begin(), entries.end());
+	
+	mStart.assign(mAngles + 1, 0);
+	mLines.resize(entries.size());
+	mD.resize(entries.size());
+	mUx.resize(entries.size());
+	mUy.resize(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		mStart[entries[i].first.first + 1]++;
+		mD[i] = entries[i].first.second;
+		mLines[i] = entries[i].second;
+		
+		// Flipping both u and d changes the sign of both terms of RefLine::Distance(), 
+		// which doesn't change a single bit of the distance.
+		
+		const XYLine& l = mLines[i]->l;
+		mUx[i] = (l.d < 0) ? -l.u.x : l.u.x;
+		mUy[i] = (l.d < 0) ? -l.u.y : l.u.y;
+	};
+	for (int ib = 0; ib < mAngles; ib++) mStart[ib + 1] += mStart[ib];
+}
+
+
+/*****
+*
+*	RefLineIndex::Clear() - forget all lines and free the memory used by the index.
+*
+*****/
+
+void RefLineIndex::Clear()
+{
+	mAngles = 0;
+	vector<size_t>().swap(mStart);
+	vector<RefLine*>().swap(mLines);
+	vector<double>().swap(mD);
+	vector<double>().swap(mUx);
+	vector<double>().swap(mUy);
+}
+
+
+/*****
+*
+*	RefLineIndex::Collect(const XYLine& al, double ar, vector<RefLine*>& vl, 
+*		vector<double>& dl) - append to vl every line that could be within ar of al (and
+*	some that aren't), and to dl their distances from al. Every line that we leave out is
+*	at least ar away.
+*
+*****/
+
+void RefLineIndex::Collect(const XYLine& al, double ar, vector<RefLine*>& vl, 
+	vector<double>& dl) const
+{
+	const double pi = 3.14159265358979323;
+	const double slack = 1e-9;				// covers roundoff in the bounds below
+	double p, a;
+	Normalize(al, p, a);
+	double r = ar + slack;
+	double w = (r >= 1) ? pi : asin(r);		// half-width of the windows of angle
+	double bw = 2 * pi / mAngles;			// width of a bucket
+	vector<char> visited(mAngles, 0);		// the two windows can share buckets
+	
+	for (short ic = 0; ic < 2; ic++) {
+		double c = p + ic * pi;				// center of the window
+		int b0 = int(floor((c - w + pi) / bw));
+		int b1 = int(floor((c + w + pi) / bw));
+		if (b1 - b0 >= mAngles) b1 = b0 + mAngles - 1;
+		for (int ib = b0; ib <= b1; ib++) {
+			int b = ((ib % mAngles) + mAngles) % mAngles;
+			if (visited[b]) continue;
+			visited[b] = 1;
+			
+			// Range of cos(t - p) over the angles t in this bucket
+			
+			double t0 = -pi + b * bw - p - slack;
+			double t1 = -pi + (b + 1) * bw - p + slack;
+			double cmax = max(cos(t0), cos(t1));
+			double cmin = min(cos(t0), cos(t1));
+			if (ceil(t0 / (2 * pi)) * 2 * pi <= t1) cmax = 1;
+			if (ceil((t0 - pi) / (2 * pi)) * 2 * pi + pi <= t1) cmin = -1;
+			
+			// Lines of this bucket with d in range; a >= 0, so the range is easy.
+			
+			vector<double>::const_iterator first = mD.begin() + mStart[b];
+			vector<double>::const_iterator last = mD.begin() + mStart[b + 1];
+			vector<double>::const_iterator lo = lower_bound(first, last, a * cmin - r);
+			vector<double>::const_iterator hi = upper_bound(lo, last, a * cmax + r);
+			size_t k0 = lo - mD.begin();
+			size_t k1 = hi - mD.begin();
+			if (k1 <= k0) continue;
+			vl.insert(vl.end(), mLines.begin() + k0, mLines.begin() + k1);
+			size_t n0 = dl.size();
+			dl.resize(n0 + k1 - k0);
+			RefScorer::LineDistances(al, &mUx[k0], &mUy[k0], &mD[k0], k1 - k0, &dl[n0]);
+		}
+	}
+}
+
+
+/*****
+*
+*	RefLineIndex::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines) - 
+*	find the best lines for target al, in the order given by CompareRankAndError, storing
+*	them in vl.
+*
+*	We collect the lines that could be within some radius of al, doubling the radius until 
+*	it exceeds maxError and we've found numLines lines closer than the radius. No line left
+*	out can beat those, so we can sort what we found and stop.
+*
+*****/
+
+void RefLineIndex::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines) const
+{
+	vl.resize(numLines);
+	if (numLines <= 0 || mLines.empty()) return;
+	vector<RefLine*> seen;			// lines that could be within the radius
+	vector<double> dist;			// their distances from al
+	
+	for (double r = max(2 * ReferenceFinder::maxError, .001); ; r *= 2) {
+		seen.clear();
+		dist.clear();
+		Collect(al, r, seen, dist);
+		if (seen.size() == mLines.size()) break;
+		short nclose = 0;
+		for (size_t k = 0; k < dist.size() && nclose < numLines; k++) 
+			if (dist[k] < r) nclose++;
+		if (nclose >= numLines) break;
+	};
+	RefTopK<RefLine> best(numLines);
+	for (size_t k = 0; k < seen.size(); k++) best.Offer(seen[k], dist[k]);
+	best.Get(vl);
+}
+
+
+/*****
+*
+*	RefLineIndex::ScanBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines) - 
+*	same as FindBestLines(), but looking at every line, a block at a time.
+*
+*****/
+
+void RefLineIndex::ScanBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines) const
+{
+	const size_t blockSize = 256;
+	double dist[blockSize];
+	RefTopK<RefLine> best(max(short(0), numLines));
+	for (size_t k0 = 0; k0 < mLines.size(); k0 += blockSize) {
+		size_t n = min(blockSize, mLines.size() - k0);
+		RefScorer::LineDistances(al, &mUx[k0], &mUy[k0], &mD[k0], n, dist);
+		for (size_t k = 0; k < n; k++) 
+			if (!best.Rejects(dist[k])) best.Offer(mLines[k0 + k], dist[k]);
+	};
+	best.Get(vl);
+}
+
+
+/*****
+*
+*	RefLineIndex::FindLinesWithin(const XYLine& al, RefRankList<RefLine>& ar) - offer ar 
+*	the lines within its tolerance of al, only looking at the runs of lines nearby in
+*	(angle, d) space.
+*
+*****/
+
+void RefLineIndex::FindLinesWithin(const XYLine& al, RefRankList<RefLine>& ar) const
+{
+	vector<RefLine*> seen;
+	vector<double> dist;
+	Collect(al, ar.Tolerance(), seen, dist);
+	for (size_t k = 0; k < seen.size(); k++) ar.Offer(seen[k], dist[k]);
+}
+
+
+/**********
+*
+*	RefCoverage - a table that lists the best refs for each cell of a grid of targets.
+*
+*	If a cell's list holds every ref that could be within maxError of a target in the 
+*	cell, save those of rank cut or higher, then the best refs for a target in the cell
+*	are on the list if they all lie within maxError of it and have rank less than cut: any
+*	ref off the list is either farther than maxError from the target or of rank cut or 
+*	higher, and CompareRankAndError ranks both kinds below the refs we found.
+*
+**********/
+
+/*****
+*
+*	RefCoverage::RefCoverage() - Constructor. The table starts out empty.
+*
+*****/
+
+RefCoverage::RefCoverage() : mCells(0), mDepth(0), mMaxError(0)
+{
+}
+
+
+/*****
+*
+*	RefCoverage::Clear() - forget the table and free the memory it used.
+*
+*****/
+
+void RefCoverage::Clear()
+{
+	mCells = mDepth = 0;
+	mMaxError = 0;
+	vector<unsigned int>().swap(mStart);
+	vector<unsigned int>().swap(mEntries);
+	vector<rank_t>().swap(mCutRank);
+}
+
+
+/*****
+*
+*	RefCoverage::Start(int acells, int adepth) - set up an empty table of acells by acells
+*	cells, listing up to adepth refs per cell, for the current maxError. The cells then 
+*	get filled in order by AddCell().
+*
+*****/
+
+void RefCoverage::Start(int acells, int adepth)
+{
+	Clear();
+	mCells = acells;
+	mDepth = adepth;
+	mMaxError = ReferenceFinder::maxError;
+	mStart.reserve(size_t(acells) * acells + 1);
+	mStart.push_back(0);
+	mCutRank.reserve(size_t(acells) * acells);
+}
+
+
+/*****
+*
+*	RefCoverage::Number(const vector<R*>& ar, vector<pair<R*, unsigned int> >& aindices) - 
+*	fill aindices with each ref of ar and its index in ar, sorted by ref, so that 
+*	AddCell() can look up the indices that it lists.
+*
+*****/
+
+template <class R>
+void RefCoverage::Number(const vector<R*>& ar, vector<pair<R*, unsigned int> >& aindices)
+{
+	aindices.resize(ar.size());
+	for (size_t i = 0; i < ar.size(); i++) 
+		aindices[i] = pair<R*, unsigned int>(ar[i], (unsigned int)(i));
+	sort(aindices.begin(), aindices.end());
+}
+
+
+/*****
+*
+*	RefCoverage::AddCell(vector<pair<R*, double> >& vc, 
+*		const vector<pair<R*, unsigned int> >& aindices) - list the next cell, given every
+*	ref vc that could be within maxError of a target in it, with its distance from the 
+*	center of the cell. We order them as RefRankList does, rank first, so that every ref
+*	we leave off has a rank at least as high as every ref we keep. If there are more than
+*	mDepth, we keep the first mDepth and then drop the ones at the end that have the same
+*	rank as the first one left out, since they can't be told apart from it by rank.
+*
+*****/
+
+template <class R>
+void RefCoverage::AddCell(vector<pair<R*, double> >& vc, 
+	const vector<pair<R*, unsigned int> >& aindices)
+{
+	sort(vc.begin(), vc.end(), RefRankList<R>::Before);
+	size_t n = vc.size();
+	rank_t cut = numeric_limits<rank_t>::max();
+	if (n > size_t(mDepth)) {
+		cut = vc[mDepth].first->mRank;
+		n = size_t(mDepth);
+		while (n > 0 && vc[n - 1].first->mRank == cut) n--;
+	};
+	for (size_t k = 0; k < n; k++) 
+		mEntries.push_back(lower_bound(aindices.begin(), aindices.end(), 
+			pair<R*, unsigned int>(vc[k].first, 0))->second);
+	mStart.push_back((unsigned int)(mEntries.size()));
+	mCutRank.push_back(cut);
+}
+
+
+/*****
+*
+*	RefCoverage::Find(size_t acell, const R::bare_t& ab, const vector<R*>& ar, 
+*		vector<R*>& vr, short numRefs) - find the best numRefs refs for target ab on the
+*	list of cell acell, whose entries index ar, and store them in vr. Return true if 
+*	they're sure to be the best of all the refs; if not, or if maxError has changed since
+*	the table was made, return false and leave the search to the index.
+*
+*	The list runs by rank, and every ref on it has a lower rank than the ones left off, 
+*	so once we've seen numRefs refs within maxError, the refs of higher rank than the 
+*	last one we looked at can't beat them, and we can stop.
+*
+*****/
+
+template <class R>
+bool RefCoverage::Find(size_t acell, const typename R::bare_t& ab, const vector<R*>& ar, 
+	vector<R*>& vr, short numRefs) const
+{
+	if (numRefs <= 0 || mMaxError != ReferenceFinder::maxError) return false;
+	size_t k0 = mStart[acell];
+	size_t k1 = mStart[acell + 1];
+	RefTopK<R> best(numRefs);
+	short nclose = 0;				// refs seen within maxError of ab
+	for (size_t k = k0; k < k1; k++) {
+		R* rr = ar[mEntries[k]];
+		if (nclose >= numRefs && rr->mRank != ar[mEntries[k - 1]]->mRank) break;
+		double d = rr->Distance(ab);
+		if (d <= ReferenceFinder::maxError) nclose++;
+		best.Offer(rr, d);
+	};
+	if (nclose < numRefs) return false;
+	best.Get(vr);
+	return true;
+}
+
+
+/*****
+*
+*	RefCoverage::Bytes() - return the number of bytes of memory that the table takes up.
+*
+*****/
+
+size_t RefCoverage::Bytes() const
+{
+	return (mStart.capacity() + mEntries.capacity()) * sizeof(unsigned int) + 
+		mCutRank.capacity() * sizeof(rank_t);
+}
+
+
+/*****
+*
+*	RefCoverage::Put(string& as) - append the table to as, the way Get() reads it back:
+*	the number of cells along a side, the depth, maxError and the number of entries,
+*	followed by mStart, mEntries and mCutRank if there are any cells.
+*
+*****/
+
+void RefCoverage::Put(string& as) const
+{
+	int sizes[2] = {mCells, mDepth};
+	unsigned int numEntries = (unsigned int)(mEntries.size());
+	as.append(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+	as.append(reinterpret_cast<const char*>(&mMaxError), sizeof(mMaxError));
+	as.append(reinterpret_cast<const char*>(&numEntries), sizeof(numEntries));
+	if (mCells == 0) return;
+	as.append(reinterpret_cast<const char*>(&mStart[0]), mStart.size() * sizeof(unsigned int));
+	if (!mEntries.empty()) as.append(reinterpret_cast<const char*>(&mEntries[0]), 
+		mEntries.size() * sizeof(unsigned int));
+	as.append(reinterpret_cast<const char*>(&mCutRank[0]), mCutRank.size() * sizeof(rank_t));
+}
+
+
+/*****
+*
+*	RefCoverage::Read(const char*& ap, const char* aend, void* adest, size_t asize) - copy
+*	asize bytes from ap to adest and move ap past them, unless that would go past aend.
+*	We copy, since a table in a snapshot needn't be aligned.
+*
+*****/
+
+bool RefCoverage::Read(const char*& ap, const char* aend, void* adest, size_t asize)
+{
+	if (size_t(aend - ap) < asize) return false;
+	if (asize > 0) memcpy(adest, ap, asize);
+	ap += asize;
+	return true;
+}
+
+
+/*****
+*
+*	RefCoverage::Get(const char*& ap, const char* aend, size_t acount, int acells, 
+*		int adepth) - read a table written by Put() from ap, going no farther than aend,
+*	and move ap past it. Keep it and return true if it has acells cells along a side and
+*	depth adepth, was made for the current maxError, and only lists refs below acount;
+*	otherwise leave the table empty and return false.
+*
+*****/
+
+bool RefCoverage::Get(const char*& ap, const char* aend, size_t acount, int acells, 
+	int adepth)
+{
+	Clear();
+	int sizes[2];
+	double maxError;
+	unsigned int numEntries;
+	if (!Read(ap, aend, sizes, sizeof(sizes)) || 
+		!Read(ap, aend, &maxError, sizeof(maxError)) || 
+		!Read(ap, aend, &numEntries, sizeof(numEntries))) return false;
+	if (sizes[0] <= 0 || sizes[0] > 65535) return false;
+	size_t ncells = size_t(sizes[0]) * sizes[0];
+	mStart.resize(ncells + 1);
+	mEntries.resize(numEntries);
+	mCutRank.resize(ncells);
+	bool ok = Read(ap, aend, &mStart[0], mStart.size() * sizeof(unsigned int)) && 
+		Read(ap, aend, mEntries.empty() ? 0 : &mEntries[0], 
+			mEntries.size() * sizeof(unsigned int)) && 
+		Read(ap, aend, &mCutRank[0], mCutRank.size() * sizeof(rank_t));
+	
+	// Make sure the table is one we want and that it hangs together.
+	
+	ok = ok && sizes[0] == acells && sizes[1] == adepth && 
+		maxError == ReferenceFinder::maxError && mStart[0] == 0 && 
+		mStart[ncells] == numEntries;
+	for (size_t ic = 0; ok && ic < ncells; ic++) ok = mStart[ic] <= mStart[ic + 1];
+	for (size_t k = 0; ok && k < mEntries.size(); k++) ok = mEntries[k] < acount;
+	if (!ok) {
+		Clear();
+		return false;
+	};
+	mCells = sizes[0];
+	mDepth = sizes[1];
+	mMaxError = maxError;
+	return true;
+}
+
+
+/**********
+*
+*	RefMarkCoverage - a coverage table for marks over an even grid of cells on the paper.
+*
+**********/
+
+/*****
+*
+*	RefMarkCoverage::Cell(const XYPt& ap, size_t& acell) - store the cell that holds ap 
+*	in acell and return true, or return false if ap is off the paper.
+*
+*****/
+
+bool RefMarkCoverage::Cell(const XYPt& ap, size_t& acell) const
+{
+	if (mCells == 0) return false;
+	double fx = ap.x / RefBase::paper.pWidth * mCells;
+	double fy = ap.y / RefBase::paper.pHeight * mCells;
+	if (!(fx >= 0 && fx <= mCells && fy >= 0 && fy <= mCells)) return false;
+	acell = size_t(min(int(fy), mCells - 1)) * mCells + min(int(fx), mCells - 1);
+	return true;
+}
+
+
+/*****
+*
+*	RefMarkCoverage::Build(const vector<RefMark*>& am, const RefMarkIndex& ai, int acells,
+*		int adepth) - list the marks am for each of acells by acells cells, up to adepth
+*	per cell, using the index ai of am to find the ones near each cell. A mark within 
+*	maxError of a point in the cell is within maxError plus half the cell's diagonal of 
+*	its center.
+*
+*****/
+
+void RefMarkCoverage::Build(const vector<RefMark*>& am, const RefMarkIndex& ai, 
+	int acells, int adepth)
+{
+	const double slack = 1e-9;				// covers roundoff in the distances
+	Clear();
+	if (acells <= 0 || adepth <= 0 || am.empty()) return;
+	Start(acells, adepth);
+	vector<pair<RefMark*, unsigned int> > indices;
+	Number(am, indices);
+	
+	double w = RefBase::paper.pWidth / acells;
+	double h = RefBase::paper.pHeight / acells;
+	double r = ReferenceFinder::maxError + sqrt(w * w + h * h) / 2 + slack;
+	vector<RefMark*> seen;
+	vector<double> dist;
+	vector<pair<RefMark*, double> > cands;
+	for (int cy = 0; cy < acells; cy++) 
+		for (int cx = 0; cx < acells; cx++) {
+			seen.clear();
+			dist.clear();
+			cands.clear();
+			ai.Collect(XYPt((cx + .5) * w, (cy + .5) * h), r, seen, dist);
+			for (size_t k = 0; k < seen.size(); k++) 
+				if (dist[k] <= r) cands.push_back(pair<RefMark*, double>(seen[k], dist[k]));
+			AddCell(cands, indices);
+		}
+}
+
+
+/*****
+*
+*	RefMarkCoverage::FindBestMarks(const XYPt& ap, const vector<RefMark*>& am, 
+*		vector<RefMark*>& vm, short numMarks) - find the best numMarks marks for target ap
+*	from the table of the marks am, storing them in vm. Return false if the table can't 
+*	be sure of them.
+*
+*****/
+
+bool RefMarkCoverage::FindBestMarks(const XYPt& ap, const vector<RefMark*>& am, 
+	vector<RefMark*>& vm, short numMarks) const
+{
+	size_t icell;
+	return Cell(ap, icell) && Find(icell, ap, am, vm, numMarks);
+}
+
+
+/**********
+*
+*	RefLineCoverage - a coverage table for lines over an even grid of cells in the angle
+*	of the normal and the distance from the origin.
+*
+*	If the target moves from normal angle p and distance a to p + dp and a + da, the
+*	distance to a line with normal angle t and distance d, 
+*
+*		sqrt(sin(t - p)^2 + (d - a * cos(t - p))^2), 
+*
+*	changes by no more than (1 + a) * |dp| + |da|, which bounds how far from the target
+*	at the center of a cell a line can be and still be within maxError of some target in
+*	the cell.
+*
+**********/
+
+/*****
+*
+*	RefLineCoverage::MaxD() - return the greatest distance from the origin in the grid,
+*	which is the largest that a line crossing the paper can have.
+*
+*****/
+
+double RefLineCoverage::MaxD()
+{
+	return sqrt(pow(RefBase::paper.pWidth, 2) + pow(RefBase::paper.pHeight, 2));
+}
+
+
+/*****
+*
+*	RefLineCoverage::Cell(const XYLine& al, size_t& acell) - store the cell that holds al 
+*	in acell and return true, or return false if al is too far from the origin to cross
+*	the paper.
+*
+*****/
+
+bool RefLineCoverage::Cell(const XYLine& al, size_t& acell) const
+{
+	const double pi = 3.14159265358979323;
+	if (mCells == 0) return false;
+	double aa, ad;
+	RefLineIndex::Normalize(al, aa, ad);
+	double fa = (aa + pi) / (2 * pi) * mCells;
+	double fd = ad / MaxD() * mCells;
+	if (!(fa >= 0 && fa <= mCells && fd >= 0 && fd <= mCells)) return false;
+	acell = size_t(min(int(fa), mCells - 1)) * mCells + min(int(fd), mCells - 1);
+	return true;
+}
+
+
+/*****
+*
+*	RefLineCoverage::Build(const vector<RefLine*>& al, const RefLineIndex& ai, 
+*		int acells, int adepth) - list the lines al for each of acells by acells cells, up
+*	to adepth per cell, using the index ai of al to find the ones near each cell.
+*
+*****/
+
+void RefLineCoverage::Build(const vector<RefLine*>& al, const RefLineIndex& ai, 
+	int acells, int adepth)
+{
+	const double pi = 3.14159265358979323;
+	const double slack = 1e-9;				// covers roundoff in the distances
+	Clear();
+	if (acells <= 0 || adepth <= 0 || al.empty()) return;
+	Start(acells, adepth);
+	vector<pair<RefLine*, unsigned int> > indices;
+	Number(al, indices);
+	
+	double bw = 2 * pi / acells;			// width of a cell in angle
+	double bd = MaxD() / acells;			// and in distance
+	vector<RefLine*> seen;
+	vector<double> dist;
+	vector<pair<RefLine*, double> > cands;
+	for (int ca = 0; ca < acells; ca++) {
+		double p = -pi + (ca + .5) * bw;
+		for (int cd = 0; cd < acells; cd++) {
+			double r = ReferenceFinder::maxError + (1 + (cd + 1) * bd) * bw / 2 + bd / 2 + 
+				slack;
+			seen.clear();
+			dist.clear();
+			cands.clear();
+			ai.Collect(XYLine((cd + .5) * bd, XYPt(cos(p), sin(p))), r, seen, dist);
+			for (size_t k = 0; k < seen.size(); k++) 
+				if (dist[k] <= r) cands.push_back(pair<RefLine*, double>(seen[k], dist[k]));
+			AddCell(cands, indices);
+		}
+	}
+}
+
+
+/*****
+*
+*	RefLineCoverage::FindBestLines(const XYLine& al, const vector<RefLine*>& alines, 
+*		vector<RefLine*>& vl, short numLines) - find the best numLines lines for target al
+*	from the table of the lines alines, storing them in vl. Return false if the table 
+*	can't be sure of them.
+*
+*****/
+
+bool RefLineCoverage::FindBestLines(const XYLine& al, const vector<RefLine*>& alines, 
+	vector<RefLine*>& vl, short numLines) const
+{
+	size_t icell;
+	return Cell(al, icell) && Find(icell, al, alines, vl, numLines);
+}
+
+
+/**********
+*
+*	RefView - the marks and lines through some rank, published by a background build.
+*
+**********/
+
+/*****
+*
+*	RefView::RefView(rank_t arank, const vector<RefMark*>& am, const vector<RefLine*>& al,
+*		RefView* alower) - Constructor; index the marks am and lines al, whose highest 
+*	rank is arank, that alower (if there is one) doesn't already have. The new view takes
+*	over the use of alower that made it current. Nobody uses the new view yet.
+*
+*****/
+
+RefView::RefView(RefBase::rank_t arank, const vector<RefMark*>& am, 
+	const vector<RefLine*>& al, RefView* alower) : 
+	mRank(arank), mNumMarks(am.size()), mNumLines(al.size()), mLower(alower), mUsers(0)
+{
+	size_t m0 = alower ? alower->mNumMarks : 0;
+	size_t l0 = alower ? alower->mNumLines : 0;
+	mMarkIndex.Build(vector<RefMark*>(am.begin() + m0, am.end()));
+	mLineIndex.Build(vector<RefLine*>(al.begin() + l0, al.end()));
+}
+
+
+/*****
+*
+*	RefView::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks, 
+*		bool ascan) - find the best marks for ap in this view and the ones below it, with
+*	the indexes, or by scanning them if ascan. The best of all of them are among the best
+*	of each, so we pick them out of those.
+*
+*****/
+
+void RefView::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks, 
+	bool ascan) const
+{
+	RefTopK<RefMark> best(max(short(0), numMarks));
+	for (const RefView* rv = this; rv; rv = rv->mLower) {
+		vector<RefMark*> found;
+		if (ascan) rv->mMarkIndex.ScanBestMarks(ap, found, numMarks);
+		else rv->mMarkIndex.FindBestMarks(ap, found, numMarks);
+		for (size_t i = 0; i < found.size() && found[i]; i++) 
+			best.Offer(found[i], found[i]->Distance(ap));
+	};
+	best.Get(vm);
+}
+
+
+/*****
+*
+*	RefView::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines, 
+*		bool ascan) - same as FindBestMarks(), for lines.
+*
+*****/
+
+void RefView::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines, 
+	bool ascan) const
+{
+	RefTopK<RefLine> best(max(short(0), numLines));
+	for (const RefView* rv = this; rv; rv = rv->mLower) {
+		vector<RefLine*> found;
+		if (ascan) rv->mLineIndex.ScanBestLines(al, found, numLines);
+		else rv->mLineIndex.FindBestLines(al, found, numLines);
+		for (size_t i = 0; i < found.size() && found[i]; i++) 
+			best.Offer(found[i], found[i]->Distance(al));
+	};
+	best.Get(vl);
+}
+
+
+/*****
+*
+*	RefView::FindMarksWithin(const XYPt& ap, RefRankList<RefMark>& ar), 
+*		FindLinesWithin(const XYLine& al, RefRankList<RefLine>& ar) - offer ar the marks
+*	or lines within its tolerance of the target from this view and the ones below it.
+*
+*****/
+
+void RefView::FindMarksWithin(const XYPt& ap, RefRankList<RefMark>& ar) const
+{
+	for (const RefView* rv = this; rv; rv = rv->mLower) rv->mMarkIndex.FindMarksWithin(ap, ar);
+}
+
+void RefView::FindLinesWithin(const XYLine& al, RefRankList<RefLine>& ar) const
+{
+	for (const RefView* rv = this; rv; rv = rv->mLower) rv->mLineIndex.FindLinesWithin(al, ar);
+}
+
+
+/**********
+*
+*	ReferenceFinder - object that builds and maintains collections of marks and lines and
+*	can search throught the collection for marks and lines close to a target mark or line.
+*
+**********/
+
+/*****
+*
+*	ReferenceFinder static member initialization
+*
+*****/
+
+RefContainer<RefLine> ReferenceFinder::basisLines;
+RefContainer<RefMark> ReferenceFinder::basisMarks;
+RefMarkIndex ReferenceFinder::markIndex;
+RefLineIndex ReferenceFinder::lineIndex;
+RefMarkCoverage ReferenceFinder::markCoverage;
+RefLineCoverage ReferenceFinder::lineCoverage;
+RefLineExtents ReferenceFinder::lineExtents;
+RefView* ReferenceFinder::currentView = 0;
+bool ReferenceFinder::publishViews = false;
+int ReferenceFinder::builtIncludes = 0;
+bool ReferenceFinder::builtVisibilityMatters = false;
+double ReferenceFinder::builtMinAspectRatio = 0;
+double ReferenceFinder::builtMinAngleSine = 0;
+void *ReferenceFinder::pShowProgressData = 0;
+ReferenceFinder::ProgressFn ReferenceFinder::pShowProgress = &ConsoleShowProgress;
+int ReferenceFinder::numTries;
+double ReferenceFinder::startTime = 0;
+bool ReferenceFinder::outOfTime = false;
+vector<RefBuildStats> ReferenceFinder::buildStats;
+void *ReferenceFinder::pShowBuildStatsData = 0;
+ReferenceFinder::BuildStatsFn ReferenceFinder::pShowBuildStats = 0;
+
+
+/*****
+*
+*	ReferenceFinder::SetShowProgress(ProgressFn apfn) - install a ProgressFn to use as 
+*	the callback routine, overriding the default method which sends progress to the console.
+*
+*****/
+void ReferenceFinder::SetShowProgress(ProgressFn apfn, void *d)
+{
+	pShowProgress = apfn;
+	pShowProgressData = d;
+}
+
+
+/*****
+*
+*	ReferenceFinder::SetShowBuildStats(BuildStatsFn apfn, void *d) - install a BuildStatsFn,
+*	which MakeAllMarksAndLines() calls with the counters of each kind of ref and rank as 
+*	soon as they're built. Pass 0 to remove it.
+*
+*****/
+
+void ReferenceFinder::SetShowBuildStats(BuildStatsFn apfn, void *d)
+{
+	pShowBuildStats = apfn;
+	pShowBuildStatsData = d;
+}
+
+
+/*****
+*
+*	ReferenceFinder::ConsoleShowProgress(ProgressMsg pmsg, rank_t arank) - Show progress by
+*	reporting information to the console. Clients can install their own version of this
+*	function by calling ReferenceFinder::SetShowProgress(..).
+*
+*****/
+
+void ReferenceFinder::ConsoleShowProgress(ProgressMsg pmsg, rank_t arank, void*)
+{
+#ifndef NO_CONSOLE
+	switch (pmsg) {
+		case msgInitializing:	// Called at beginning of initialization
+			cout << "Initializing using";
+			if (RefLine_C2P_C2P::include) cout << " O1,";
+			if (RefLine_P2P::include) cout << " O2,";
+			if (RefLine_L2L::include) cout << " O3,";
+			if (RefLine_L2L_C2P::include) cout << " O4,";
+			if (RefLine_P2L_C2P::include) cout << " O5,";
+			if (RefLine_P2L_P2L::include) cout << " O6,";
+			if (RefLine_L2L_P2L::include) cout << " O7,";
+			cout << " vis=";
+			if (visibilityMatters) cout << "true";
+			else cout << "false";
+			cout << flush;	
+			break;
+			
+		case msgWorking:		// Called while we're building lines and marks
+			cout << "." << flush;
+			break;
+		
+		case msgRankCompleted:	// Called when we've finished a rank
+			cout << endl << "There are " << basisLines.TotalSize() << " lines and " << 
+				basisMarks.TotalSize() << " marks of rank <= " << arank << " " << flush;
+			break;
+		
+		case msgInitialized:	// Called when we're completely done
+			// default doesn't do much, but clients might do something
+			cout << endl << endl << flush;
+			break;
+	}
+#endif
+}
+
+
+/*****
+*
+*	ReferenceFinder::OccasionalShowProgress() - routine called by RefContainer<R> to display 
+*	progress during the time-consuming process of initialization. This routine updates its 
+*	private counter each time it's called and only occasionally passes on a full call to 
+*	pShowProgress. Clients can adjust the frequency of calling by changing the variable
+*	maxTries.
+*
+*****/
+
+void ReferenceFinder::OccasionalShowProgress(size_t ntries)
+{
+	numTries += int(ntries);
+	if (numTries > maxTries) {
+		(*pShowProgress)(msgWorking, 0, pShowProgressData);
+		numTries = 0;
+		CheckClock();
+	}
+}
+
+
+#ifdef USE_PTHREADS
+static pthread_mutex_t sClockMutex = PTHREAD_MUTEX_INITIALIZER;	// guards outOfTime
+#endif
+
+
+/*****
+*
+*	WallSeconds() - return the time in seconds from some fixed moment. The monotonic clock
+*	of POSIX systems resolves well under a millisecond; elsewhere we make do with time().
+*
+*****/
+
+static double WallSeconds()
+{
+#ifdef USE_PTHREADS
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return double(ts.tv_sec) + 1e-9 * double(ts.tv_nsec);
+#else
+	return double(time(0));
+#endif
+}
+
+
+/*****
+*
+*	ReferenceFinder::StartClock() - note the time a build starts.
+*
+*****/
+
+void ReferenceFinder::StartClock()
+{
+#ifdef USE_PTHREADS
+	pthread_mutex_lock(&sClockMutex);
+#endif
+	startTime = WallSeconds();
+	outOfTime = false;
+#ifdef USE_PTHREADS
+	pthread_mutex_unlock(&sClockMutex);
+#endif
+}
+
+
+/*****
+*
+*	ReferenceFinder::CheckClock() - note whether maxSeconds have gone by since the build 
+*	started. We look at the clock only now and then, so a build can run over by as long
+*	as it takes to try maxTries candidates. Only the thread that builds calls this, so it
+*	can read outOfTime freely; it takes sClockMutex to write it, since a background build
+*	can be asked RanOutOfTime() by another thread.
+*
+*****/
+
+void ReferenceFinder::CheckClock()
+{
+	if (maxSeconds <= 0 || outOfTime || WallSeconds() - startTime < maxSeconds) return;
+#ifdef USE_PTHREADS
+	pthread_mutex_lock(&sClockMutex);
+#endif
+	outOfTime = true;
+#ifdef USE_PTHREADS
+	pthread_mutex_unlock(&sClockMutex);
+#endif
+}
+
+
+/*****
+*
+*	ReferenceFinder::RanOutOfTime() - return true if the last build was cut short because
+*	maxSeconds went by; buildStats tells which kinds and ranks didn't get finished.
+*
+*****/
+
+bool ReferenceFinder::RanOutOfTime()
+{
+#ifdef USE_PTHREADS
+	pthread_mutex_lock(&sClockMutex);
+	bool result = outOfTime;
+	pthread_mutex_unlock(&sClockMutex);
+	return result;
+#else
+	return outOfTime;
+#endif
+}
+
+
+/*****
+*
+*	ReferenceFinder::CountThreads() - return the number of threads to build or search with.
+*
+*****/
+
+int ReferenceFinder::CountThreads()
+{
+#ifdef USE_PTHREADS
+	if (numThreads > 0) return numThreads;
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	return (ncpu > 0) ? int(ncpu) : 1;
+#else
+	return 1;
+#endif
+}
+
+
+#ifdef USE_PTHREADS
+/*****
+*
+*	RefBuildJob<R> - the state shared by the threads that build the slices of one
+*	MakeAll() routine. Worker threads take slices in turn and flag each one as done; the
+*	calling thread merges the finished slices in order.
+*
+*****/
+
+template <class R>
+class RefBuildJob {
+	public:
+		typedef void (*MakeAllFn)(RefBase::rank_t, RefBuilder<R>&);
+		MakeAllFn mMakeAll;					// the MakeAll() routine
+		RefBase::rank_t mRank;				// rank that we're building
+		std::vector<RefBuilder<R>*> mSlices;	// one builder per slice
+		std::vector<char> mDone;			// flags slices that are finished
+		std::size_t mNext;					// next slice to hand out
+		bool mStop;							// set when no more slices are needed
+		pthread_mutex_t mMutex;				// guards mDone, mNext and mStop
+		pthread_cond_t mCond;				// signaled whenever a slice is finished
+		
+		RefBuildJob(MakeAllFn amakeAll, RefBase::rank_t arank) : 
+			mMakeAll(amakeAll), mRank(arank), mNext(0), mStop(false) {
+			pthread_mutex_init(&mMutex, 0);
+			pthread_cond_init(&mCond, 0);
+		};
+		~RefBuildJob() {
+			pthread_cond_destroy(&mCond);
+			pthread_mutex_destroy(&mMutex);
+		};
+		static void* Work(void* p);
+};
+
+
+/*****
+*
+*	RefBuildJob<R>::Work(void* p) - thread routine; builds slices until there are none left.
+*
+*****/
+
+template <class R>
+void* RefBuildJob<R>::Work(void* p)
+{
+	RefBuildJob<R>& job = *static_cast<RefBuildJob<R>*>(p);
+	while (true) {
+		pthread_mutex_lock(&job.mMutex);
+		if (job.mStop || job.mNext >= job.mSlices.size()) {
+			pthread_mutex_unlock(&job.mMutex);
+			return 0;
+		};
+		size_t i = job.mNext++;
+		pthread_mutex_unlock(&job.mMutex);
+		(*job.mMakeAll)(job.mRank, *job.mSlices[i]);
+		pthread_mutex_lock(&job.mMutex);
+		job.mDone[i] = 1;
+		pthread_cond_broadcast(&job.mCond);
+		pthread_mutex_unlock(&job.mMutex);
+	}
+}
+#endif // USE_PTHREADS
+
+
+/*****
+*
+*	ReferenceFinder::MakeAllOfType(RefType atype, amakeAll, rank_t arank, 
+*		RefContainer<R>& ac, size_t amax, int ashares) - call the MakeAll() routine 
+*	amakeAll to create refs of kind atype and rank arank, adding them to ac until it holds 
+*	amax refs or time runs out. If fairShares, this kind only gets its share of the room 
+*	left under amax, which ashares kinds (this one and the ones after it) split. The 
+*	counters for the candidates go to buildStats and the BuildStatsFn, if there is one;
+*	a kind we never got to for lack of time gets counters too, with nothing tried.
+*
+*	With more than one thread, the units of the outer iteration of amakeAll are divided
+*	into slices that are built concurrently, each into its own buffer. The slices are then
+*	merged in order, so that the refs that make it into ac -- and which of several refs 
+*	with the same key wins -- are exactly the ones a serial build would give us. The 
+*	counters can differ, though: slices that were being built when ac filled up count 
+*	their candidates, and the valid ones that didn't fit count as overCap.
+*
+*****/
+
+template <class R>
+void ReferenceFinder::MakeAllOfType(RefBase::RefType atype, 
+	void (*amakeAll)(rank_t, RefBuilder<R>&), rank_t arank, RefContainer<R>& ac, size_t amax, 
+	int ashares)
+{
+	RefBuildStats stats(atype, arank);
+	if (fairShares) {
+		amax = ShareLimit(ac.TotalSize(), amax, ashares);
+		stats.mShare = amax - min(amax, ac.TotalSize());
+	};
+	CheckClock();
+	if (!outOfTime) {
+		clock_t t0 = clock();
+		int nthreads = CountThreads();
+		if (nthreads <= 1) {
+			RefBuilder<R> ab(ac, amax);
+			(*amakeAll)(arank, ab);
+			stats += ab.mStats;
+		}
+#ifdef USE_PTHREADS
+		else if (ac.TotalSize() < amax) 
+			MakeAllOfTypeThreaded(amakeAll, arank, ac, amax, stats);
+#endif
+		stats.mSeconds = double(clock() - t0) / CLOCKS_PER_SEC;
+	};
+	stats.mFull = ac.TotalSize() >= amax;
+	stats.mOutOfTime = outOfTime;
+	buildStats.push_back(stats);
+	if (pShowBuildStats) (*pShowBuildStats)(stats, pShowBuildStatsData);
+}
+
+
+#ifdef USE_PTHREADS
+/*****
+*
+*	ReferenceFinder::MakeAllOfTypeThreaded(amakeAll, rank_t arank, RefContainer<R>& ac, 
+*		size_t amax, RefBuildStats& as) - the threaded part of MakeAllOfType(), which adds
+*	the counters of all the slices to as.
+*
+*****/
+
+template <class R>
+void ReferenceFinder::MakeAllOfTypeThreaded(void (*amakeAll)(rank_t, RefBuilder<R>&), 
+	rank_t arank, RefContainer<R>& ac, size_t amax, RefBuildStats& as)
+{
+	int nthreads = CountThreads();
+	
+	// Count the units of the outer iteration with a builder that owns none of them.
+	
+	RefBuilder<R> counter(ac, numeric_limits<size_t>::max(), numeric_limits<size_t>::max());
+	(*amakeAll)(arank, counter);
+	size_t nunits = counter.mUnit;
+	if (nunits == 0) return;
+	
+	// Cut them into enough slices to keep all the threads busy; small slices also mean
+	// that little work is wasted when the container fills up.
+	
+	size_t nslices = min(nunits, size_t(16 * nthreads));
+	RefBuildJob<R> job(amakeAll, arank);
+	job.mSlices.resize(nslices);
+	job.mDone.resize(nslices, 0);
+	for (size_t i = 0; i < nslices; i++)
+		job.mSlices[i] = new RefBuilder<R>(ac, nunits * i / nslices, nunits * (i + 1) / nslices);
+	
+	// Start the threads. Any that start will build slices until there are none left; if
+	// none could be started, we build them all here first.
+	
+	vector<pthread_t> threads(nthreads);
+	int nstarted = 0;
+	for (int i = 0; i < nthreads; i++) 
+		if (pthread_create(&threads[nstarted], 0, &RefBuildJob<R>::Work, &job) == 0) 
+			nstarted++;
+	if (nstarted == 0) RefBuildJob<R>::Work(&job);
+	
+	// Merge the slices in order as they become available. Each ref of a slice goes in
+	// if there's still room and the buffer doesn't already have one with the same key. 
+	// The ones that go in are copied into the arena of the container, and the arena of
+	// the slice goes away with the slice, along with the refs that were turned down.
+	
+	for (size_t i = 0; i < nslices; i++) {
+		pthread_mutex_lock(&job.mMutex);
+		while (!job.mDone[i]) pthread_cond_wait(&job.mCond, &job.mMutex);
+		pthread_mutex_unlock(&job.mMutex);
+		RefBuilder<R>& ab = *job.mSlices[i];
+		for (size_t j = 0; j < ab.mRefs.size(); j++) {
+			R* rr = ab.mRefs[j];
+			if (ac.TotalSize() >= amax) ab.mStats.Count(RefBase::overCap);
+			else if (ac.Contains(rr)) ab.mStats.Count(RefBase::duplicate);
+			else {
+				ac.Add((*ab.mCopiers[j])(rr, ac.arena));
+				ab.mStats.Count(RefBase::accepted);
+			}
+		};
+		OccasionalShowProgress(ab.mStats.mTries);
+		as += ab.mStats;
+		delete job.mSlices[i];
+		job.mSlices[i] = 0;
+		if (ac.TotalSize() >= amax || outOfTime) {
+			pthread_mutex_lock(&job.mMutex);
+			job.mStop = true;
+			pthread_mutex_unlock(&job.mMutex);
+			break;
+		};
+	};
+	for (int i = 0; i < nstarted; i++) pthread_join(threads[i], 0);
+	
+	// If we stopped early, throw away whatever the remaining slices made, counting the
+	// refs they kept as over the cap (even if it was time that ran out).
+	
+	for (size_t i = 0; i < nslices; i++) {
+		if (!job.mSlices[i]) continue;
+		RefBuilder<R>& ab = *job.mSlices[i];
+		ab.mStats.Count(RefBase::overCap, ab.mRefs.size());
+		as += ab.mStats;
+		delete job.mSlices[i];
+	}
+}
+#endif // USE_PTHREADS
+
+
+/*****
+*
+*	ReferenceFinder::ShareLimit(size_t asize, size_t amax, int ashares) - return the limit
+*	on the size of a container that holds asize refs, if it gets an even share of the room
+*	left under amax with ashares - 1 others.
+*
+*****/
+
+size_t ReferenceFinder::ShareLimit(size_t asize, size_t amax, int ashares)
+{
+	if (asize >= amax || ashares <= 1) return amax;
+	return asize + (amax - asize) / size_t(ashares);
+}
+
+
+/*****
+*
+*	ReferenceFinder::MakeAllMarksAndLinesOfRank(rank_t arank) - create all marks and lines 
+*	of a given rank.
+*
+*****/
+
+void ReferenceFinder::MakeAllMarksAndLinesOfRank(rank_t arank)
+{
+	// Note where the lines we have so far cross the paper, for RefLine_P2L_P2L::MakeAll().
+	
+	lineExtents.Update(basisLines);
+	
+	// If the room is shared out, this rank gets an even share of what's left for it and
+	// the ranks above it, and the kinds of lines split the rank's share in turn.
+	
+	size_t lineLimit = maxLines;
+	size_t markLimit = maxMarks;
+	if (fairShares) {
+		lineLimit = ShareLimit(basisLines.TotalSize(), maxLines, maxRank - arank + 1);
+		markLimit = ShareLimit(basisMarks.TotalSize(), maxMarks, maxRank - arank + 1);
+	};
+	int nkinds = RefLine_L2L::include + RefLine_P2P::include + RefLine_L2L_P2L::include + 
+		RefLine_P2L_P2L::include + RefLine_P2L_C2P::include + RefLine_L2L_C2P::include + 
+		RefLine_C2P_C2P::include;
+	
+	// construct all types of lines of the given rank. Note that the order in which we call
+	// the MakeAll() functions determines which types of RefLine get built, since the first
+	// object with a given key to be constructed gets the key slot.
+	
+	// We give first preference to lines that don't involve making creases through
+	// points, because these are the hardest to do accurately in practice.
+	
+	if (RefLine_L2L::include) 
+		MakeAllOfType(RefBase::lineL2L, &RefLine_L2L::MakeAll, arank, 
+			basisLines, lineLimit, nkinds--);
+	if (RefLine_P2P::include) 
+		MakeAllOfType(RefBase::lineP2P, &RefLine_P2P::MakeAll, arank, 
+			basisLines, lineLimit, nkinds--);
+	if (RefLine_L2L_P2L::include) 
+		MakeAllOfType(RefBase::lineL2L_P2L, &RefLine_L2L_P2L::MakeAll, arank, 
+			basisLines, lineLimit, nkinds--);
+	if (RefLine_P2L_P2L::include) 
+		MakeAllOfType(RefBase::lineP2L_P2L, &RefLine_P2L_P2L::MakeAll, arank, 
+			basisLines, lineLimit, nkinds--);
+	
+	// Next, we'll make lines that put a crease through a single point.
+	
+	if (RefLine_P2L_C2P::include) 
+		MakeAllOfType(RefBase::lineP2L_C2P, &RefLine_P2L_C2P::MakeAll, arank, 
+			basisLines, lineLimit, nkinds--);
+	if (RefLine_L2L_C2P::include) 
+		MakeAllOfType(RefBase::lineL2L_C2P, &RefLine_L2L_C2P::MakeAll, arank, 
+			basisLines, lineLimit, nkinds--);
+		
+	// Finally, we'll do lines that put a crease through both points.	
+	
+	if (RefLine_C2P_C2P::include) 
+		MakeAllOfType(RefBase::lineC2P_C2P, &RefLine_C2P_C2P::MakeAll, arank, 
+			basisLines, lineLimit, nkinds--);
+			
+	// Having constructed all lines in the buffer, add them to the main collection.
+	
+	basisLines.FlushBuffer();
+	
+	// construct all types of marks of the given rank
+	
+	MakeAllOfType(RefBase::markIntersection, &RefMark_Intersection::MakeAll, arank, 
+		basisMarks, markLimit);
+	
+	basisMarks.FlushBuffer();
+	
+	// if we're reporting status, say how many we constructed.
+	
+	(*pShowProgress)(msgRankCompleted, arank, pShowProgressData);
+}
+
+
+/*****
+*
+*	ReferenceFinder::SetLimitsFromBudget() - set maxLines and maxMarks, keeping their
+*	proportion, so that the marks and lines take about memoryBudget bytes.
+*
+*****/
+
+void ReferenceFinder::SetLimitsFromBudget()
+{
+	// What each mark and line costs: the largest kind of each, plus pointers to it in the
+	// sortable list, its rank, the buffer and the search index, the index's copy of its
+	// coordinates and, for lines, what lineExtents keeps while building. Vectors that grow
+	// as they're filled can have up to twice the room they need, so pointers count twice.
+	
+	const double markBytes = double(sizeof(RefMark_Intersection) + 
+		2 * 4 * sizeof(RefMark*) + 2 * sizeof(double));
+	const double lineBytes = double(sizeof(RefLine_P2L_P2L) + 
+		2 * 4 * sizeof(RefLine*) + 3 * sizeof(double) + 
+		4 * sizeof(double) + 2 * sizeof(XYPt));
+	if (maxLines + maxMarks == 0) return;
+	
+	// Scale the limits to the budget, then take out what the key sets of both containers
+	// (two apiece) need for that many marks and lines.
+	
+	double scale = double(memoryBudget) / (maxLines * lineBytes + maxMarks * markBytes);
+	double keyBytes = 2.0 * double(
+		RefKeySet::Bytes(RefLine::MaxKey(), size_t(scale * maxLines)) + 
+		RefKeySet::Bytes(RefMark::MaxKey(), size_t(scale * maxMarks)));
+	scale *= max(0.0, 1.0 - keyBytes / double(memoryBudget));
+	maxLines = size_t(scale * maxLines);
+	maxMarks = size_t(scale * maxMarks);
+}
+
+
+/*****
+*
+*	ReferenceFinder::MakeAllMarksAndLines() - create all marks and lines sequentially.
+*
+*****/
+
+void ReferenceFinder::MakeAllMarksAndLines()
+{
+	// The limits have to be settled before the containers size their key sets.
+	
+	if (memoryBudget > 0) SetLimitsFromBudget();
+	
+	// Start by clearing out any old marks or lines; this is so we can restart if
+	// we want.
+	
+	basisLines.Reinitialize();
+	basisMarks.Reinitialize();
+	markIndex.Clear();
+	lineIndex.Clear();
+	markCoverage.Clear();
+	lineCoverage.Clear();
+	lineExtents.Clear();
+	buildStats.clear();
+	NoteBuiltSettings();
+	StartClock();
+	
+	// First thing we do is a range check on the key quantization. There should be some
+	// way to do this to generate a compile-time error rather than a run-time error, but
+	// I haven't figured out a good way to do it.
+	
+	if (!RefMark::KeySizeOK() || !RefLine::KeySizeOK()) {
+#ifndef NO_CONSOLE
+		cout << "Sorry, RefBase::key_t isn't big enough to hold all key values.\n";
+		cout << "Please recompile the program with USE_WIDE_KEYS defined, or use a coarser\n";
+		cout << "discretization of marks and lines.\n";
+#endif
+		exit(1);
+	};
+	
+	// Let the user know that we're initializing and what operations we're using.
+	
+	(*pShowProgress)(msgInitializing, 0, pShowProgressData);
+	
+	// If a snapshot was made with the same settings, we can just load it.
+	
+	if (!snapshotName.empty() && loadSnapshot && LoadSnapshot(snapshotName)) {
+		(*pShowProgress)(msgRankCompleted, maxRank, pShowProgressData);
+		(*pShowProgress)(msgInitialized, 0, pShowProgressData);
+		return;
+	};
+	
+	// Build a bunch of marks of successively higher rank. Note that building lines
+	// up to rank 4 and marks up to rank 8 with no limits would result in 4185 lines and
+	// 1,090,203 marks, which would take about 60 MB of memory.
+	
+	// Rank 0: Construct the four edges of the square.
+
+	basisLines.Add(new (basisLines.arena) RefLine_Original(RefBase::paper.bottomEdge, 0, 
+		"the bottom edge"));
+	basisLines.Add(new (basisLines.arena) RefLine_Original(RefBase::paper.leftEdge, 0, 
+		"the left edge"));
+	basisLines.Add(new (basisLines.arena) RefLine_Original(RefBase::paper.rightEdge, 0, 
+		"the right edge"));
+	basisLines.Add(new (basisLines.arena) RefLine_Original(RefBase::paper.topEdge, 0, 
+		"the top edge"));
+		
+	// Rank 0: Construct the four corners of the square.
+	
+	basisMarks.Add(new (basisMarks.arena) RefMark_Original(RefBase::paper.botLeft, 0, 
+		"the bottom left corner"));
+	basisMarks.Add(new (basisMarks.arena) RefMark_Original(RefBase::paper.botRight, 0, 
+		"the bottom right corner"));
+	basisMarks.Add(new (basisMarks.arena) RefMark_Original(RefBase::paper.topLeft, 0, 
+		"the top left corner"));
+	basisMarks.Add(new (basisMarks.arena) RefMark_Original(RefBase::paper.topRight, 0, 
+		"the top right corner"));
+		
+	// Report our status for rank 0.
+	
+	(*pShowProgress)(msgRankCompleted, 0, pShowProgressData);
+	
+	// Rank 1: Construct the two diagonals.
+
+	basisLines.Add(new (basisLines.arena) RefLine_Original(RefBase::paper.upwardDiagonal, 1, 
+		"the upward diagonal"));
+	basisLines.Add(new (basisLines.arena) RefLine_Original(RefBase::paper.downwardDiagonal, 1, 
+		"the downward diagonal"));
+		
+	// Flush the buffers.
+	
+	basisLines.FlushBuffer();
+	basisMarks.FlushBuffer();
+
+	// Now build the rest, one rank at a time, starting with rank 1.
+	
+	for (rank_t irank = 1; irank <= maxRank; irank++) {
+		MakeAllMarksAndLinesOfRank(irank);
+		if (publishViews) PublishView(irank);
+	};
+	
+	// Once that's done, all the objects are in the sortable arrays and we can free up the
+	// memory used by the ranks.
+	
+	basisLines.ClearRanks();
+	basisMarks.ClearRanks();
+	lineExtents.Clear();
+	
+	// Index the marks and lines for searching.
+	
+	markIndex.Build(basisMarks);
+	lineIndex.Build(basisLines);
+	BuildCoverage();
+	
+	// Save what we built, coverage tables and all, so the next run with the same settings
+	// can skip all that, unless time ran out before we were done.
+	
+	if (!snapshotName.empty() && !outOfTime) SaveSnapshot(snapshotName);
+	
+	(*pShowProgress)(msgInitialized, 0, pShowProgressData);
+}
+
+
+/*****
+*
+*	ReferenceFinder::BuildCoverage() - make the coverage tables of the marks and lines, 
+*	once they're indexed, or get rid of them if coverageCells is 0.
+*
+*****/
+
+void ReferenceFinder::BuildCoverage()
+{
+	markCoverage.Build(basisMarks, markIndex, coverageCells, coverageDepth);
+	lineCoverage.Build(basisLines, lineIndex, coverageCells, coverageDepth);
+}
+
+
+/*****
+*
+*	ReferenceFinder::MakeMarksAndLinesOfNextRank(size_t amaxLines, size_t amaxMarks) - add 
+*	the marks and lines of rank maxRank + 1 to a finished set (built or loaded from a 
+*	snapshot), allowing up to amaxLines lines and amaxMarks marks in all, and bump maxRank. 
+*	Only the new rank gets built; if there's no set yet, all ranks up to the new maxRank are. The result matches a full build at the higher rank only 
+*	if the old limits weren't reached below it, so it isn't saved as a snapshot.
+*
+*****/
+
+void ReferenceFinder::MakeMarksAndLinesOfNextRank(size_t amaxLines, size_t amaxMarks)
+{
+	// A background build has to be done before we can add to it.
+	
+	FinishMakingAllMarksAndLines();
+	maxLines = amaxLines;
+	maxMarks = amaxMarks;
+	
+	// With nothing to add to, just build everything at the higher rank.
+	
+	maxRank++;
+	if (basisLines.empty()) {
+		MakeAllMarksAndLines();
+		return;
+	};
+	
+	// Put the ranks back and build the new one on top of them.
+	
+	markIndex.Clear();
+	lineIndex.Clear();
+	markCoverage.Clear();
+	lineCoverage.Clear();
+	basisLines.RebuildRanks();
+	basisMarks.RebuildRanks();
+	StartClock();
+	MakeAllMarksAndLinesOfRank(maxRank);
+	
+	// Free the ranks again and index everything for searching.
+	
+	basisLines.ClearRanks();
+	basisMarks.ClearRanks();
+	lineExtents.Clear();
+	markIndex.Build(basisMarks);
+	lineIndex.Build(basisLines);
+	BuildCoverage();
+	
+	(*pShowProgress)(msgInitialized, 0, pShowProgressData);
+}
+
+
+/*****
+*
+*	ReferenceFinder::ReconfigureMarksAndLines() - bring a finished set of marks and lines
+*	up to date after minAspectRatio, minAngleSine, visibilityMatters or the include flags
+*	of the lines have changed. If the changes only restrict which refs are valid, we just 
+*	drop the refs that now fail, along with everything made from them. The key slots they 
+*	leave open stay empty, since filling them again would mean going through every 
+*	combination of every rank, which is what a build costs. If anything allows more refs 
+*	than before, new refs could turn up in any rank, so we build everything again.
+*
+*****/
+
+void ReferenceFinder::ReconfigureMarksAndLines()
+{
+	// A background build has to be done before we can change it.
+	
+	FinishMakingAllMarksAndLines();
+	if (basisLines.empty() || !SettingsOnlyRestrict()) {
+		MakeAllMarksAndLines();
+		return;
+	};
+	NoteBuiltSettings();
+	
+	// Check the refs rank by rank, lines before marks, so that the refs each one is made 
+	// from have been checked before it is. The ones that fail get a key of 0, which makes
+	// everything made from them fail too.
+	
+	for (rank_t irank = 0; irank <= maxRank; irank++) {
+		for (size_t i = 0; i < basisLines.size(); i++) {
+			RefLine* rl = basisLines[i];
+			if (rl->mRank == irank && !rl->Revalidate()) rl->mKey = 0;
+		};
+		for (size_t i = 0; i < basisMarks.size(); i++) {
+			RefMark* rm = basisMarks[i];
+			if (rm->mRank == irank && !rm->Revalidate()) rm->mKey = 0;
+		};
+	};
+	
+	// Drop the failures and index the rest for searching.
+	
+	markIndex.Clear();
+	lineIndex.Clear();
+	markCoverage.Clear();
+	lineCoverage.Clear();
+	basisLines.RemoveDropped();
+	basisMarks.RemoveDropped();
+	markIndex.Build(basisMarks);
+	lineIndex.Build(basisLines);
+	BuildCoverage();
+	
+	(*pShowProgress)(msgRankCompleted, maxRank, pShowProgressData);
+	(*pShowProgress)(msgInitialized, 0, pShowProgressData);
+}
+
+
+/*****
+*
+*	ReferenceFinder::IncludeFlags() - return the include flags of the line classes, one bit
+*	per axiom, O1 in the lowest bit.
+*
+*****/
+
+int ReferenceFinder::IncludeFlags()
+{
+	return (RefLine_C2P_C2P::include ? 1 : 0) | (RefLine_P2P::include ? 2 : 0) |
+		(RefLine_L2L::include ? 4 : 0) | (RefLine_L2L_C2P::include ? 8 : 0) |
+		(RefLine_P2L_C2P::include ? 16 : 0) | (RefLine_P2L_P2L::include ? 32 : 0) |
+		(RefLine_L2L_P2L::include ? 64 : 0);
+}
+
+
+/*****
+*
+*	ReferenceFinder::NoteBuiltSettings() - note the settings that decide which refs are 
+*	valid, as the ones the current set of marks and lines is built with.
+*
+*****/
+
+void ReferenceFinder::NoteBuiltSettings()
+{
+	builtIncludes = IncludeFlags();
+	builtVisibilityMatters = visibilityMatters;
+	builtMinAspectRatio = minAspectRatio;
+	builtMinAngleSine = minAngleSine;
+}
+
+
+/*****
+*
+*	ReferenceFinder::SettingsOnlyRestrict() - return true if none of the settings that 
+*	decide which refs are valid allows a ref that the settings of the current set didn't.
+*
+*****/
+
+bool ReferenceFinder::SettingsOnlyRestrict()
+{
+	return (IncludeFlags() & ~builtIncludes) == 0 && 
+		(visibilityMatters || !builtVisibilityMatters) && 
+		minAspectRatio >= builtMinAspectRatio && 
+		minAngleSine >= builtMinAngleSine;
+}
+
+
+/*****
+*
+*	Background builds. The build runs MakeAllMarksAndLines() on a thread of its own, 
+*	publishing a RefView after each rank; searches use the latest view until the build 
+*	is done and the full indexes are ready. Each view counts the searches using it and
+*	the view above it, which searches it in turn, so the last one out deletes it once a
+*	newer view has replaced it.
+*
+*****/
+
+#ifdef USE_PTHREADS
+static pthread_mutex_t sViewMutex = PTHREAD_MUTEX_INITIALIZER;	// guards the views
+static pthread_cond_t sViewCond = PTHREAD_COND_INITIALIZER;	// signaled when they change
+static pthread_t sMaker;						// thread that runs the build
+static bool sMaking = false;					// true until the build is done
+static bool sStarted = false;					// true until sMaker has been joined
+#endif // USE_PTHREADS
+
+
+/*****
+*
+*	ReferenceFinder::StartMakingAllMarksAndLines() - start building all marks and lines 
+*	in the background, returning as soon as there's something to search. Without 
+*	threads, just build them.
+*
+*****/
+
+void ReferenceFinder::StartMakingAllMarksAndLines()
+{
+#ifdef USE_PTHREADS
+	FinishMakingAllMarksAndLines();
+	sMaking = true;
+	publishViews = true;
+	if (pthread_create(&sMaker, 0, &BackgroundMake, 0) != 0) {
+		sMaking = false;
+		publishViews = false;
+		MakeAllMarksAndLines();
+		return;
+	};
+	sStarted = true;
+	pthread_mutex_lock(&sViewMutex);
+	while (sMaking && !currentView) pthread_cond_wait(&sViewCond, &sViewMutex);
+	pthread_mutex_unlock(&sViewMutex);
+#else
+	MakeAllMarksAndLines();
+#endif // USE_PTHREADS
+}
+
+
+/*****
+*
+*	ReferenceFinder::FinishMakingAllMarksAndLines() - wait for a background build to 
+*	finish. Returns right away if there isn't one.
+*
+*****/
+
+void ReferenceFinder::FinishMakingAllMarksAndLines()
+{
+#ifdef USE_PTHREADS
+	if (!sStarted) return;
+	pthread_join(sMaker, 0);
+	sStarted = false;
+	publishViews = false;
+#endif // USE_PTHREADS
+}
+
+
+/*****
+*
+*	ReferenceFinder::IsMakingAllMarksAndLines() - return true if a background build is 
+*	still going on.
+*
+*****/
+
+bool ReferenceFinder::IsMakingAllMarksAndLines()
+{
+#ifdef USE_PTHREADS
+	pthread_mutex_lock(&sViewMutex);
+	bool making = sMaking;
+	pthread_mutex_unlock(&sViewMutex);
+	return making;
+#else
+	return false;
+#endif // USE_PTHREADS
+}
+
+
+/*****
+*
+*	ReferenceFinder::BackgroundMake(void*) - thread routine for a background build. 
+*	Once the build is done, searches go back to the full indexes.
+*
+*****/
+
+void* ReferenceFinder::BackgroundMake(void*)
+{
+	MakeAllMarksAndLines();
+#ifdef USE_PTHREADS
+	pthread_mutex_lock(&sViewMutex);
+	RefView* rv = currentView;
+	currentView = 0;
+	sMaking = false;
+	pthread_cond_broadcast(&sViewCond);
+	pthread_mutex_unlock(&sViewMutex);
+	if (rv) ReleaseView(rv);
+#endif // USE_PTHREADS
+	return 0;
+}
+
+
+/*****
+*
+*	ReferenceFinder::PublishView(rank_t arank) - make the marks and lines made so far,
+*	which go up through rank arank, the ones that searches use. Only the ones made since
+*	the last view get indexed; the new view searches the last one for the rest, keeping 
+*	the use of it that made it current. Only the building thread changes currentView, 
+*	so we can read it without the lock.
+*
+*****/
+
+void ReferenceFinder::PublishView(rank_t arank)
+{
+	RefView* rv = new RefView(arank, basisMarks, basisLines, currentView);
+	rv->mUsers = 1;
+#ifdef USE_PTHREADS
+	pthread_mutex_lock(&sViewMutex);
+#endif // USE_PTHREADS
+	currentView = rv;
+#ifdef USE_PTHREADS
+	pthread_cond_broadcast(&sViewCond);
+	pthread_mutex_unlock(&sViewMutex);
+#endif // USE_PTHREADS
+}
+
+
+/*****
+*
+*	ReferenceFinder::AcquireView() - return the current view, or 0 if searches should 
+*	use the full indexes. The view stays around until it's passed to ReleaseView().
+*
+*****/
+
+RefView* ReferenceFinder::AcquireView()
+{
+#ifdef USE_PTHREADS
+	pthread_mutex_lock(&sViewMutex);
+#endif // USE_PTHREADS
+	RefView* rv = currentView;
+	if (rv) rv->mUsers++;
+#ifdef USE_PTHREADS
+	pthread_mutex_unlock(&sViewMutex);
+#endif // USE_PTHREADS
+	return rv;
+}
+
+
+/*****
+*
+*	ReferenceFinder::ReleaseView(RefView* av) - stop using av, deleting it if nobody
+*	else is and it's no longer current, and then letting go of the view below it too.
+*
+*****/
+
+void ReferenceFinder::ReleaseView(RefView* av)
+{
+	while (av) {
+#ifdef USE_PTHREADS
+		pthread_mutex_lock(&sViewMutex);
+#endif // USE_PTHREADS
+		bool unused = (--av->mUsers == 0);
+#ifdef USE_PTHREADS
+		pthread_mutex_unlock(&sViewMutex);
+#endif // USE_PTHREADS
+		if (!unused) return;
+		RefView* lower = av->mLower;
+		delete av;
+		av = lower;
+	}
+}
+
+
+/*****
+*
+*	ReferenceFinder::PutBuildStats(ostream& os, bool asCSV) - write the counters in
+*	buildStats to os, with a total over all kinds and ranks: as a JSON object, or as CSV
+*	with one row per kind and rank if asCSV is true. The counters are empty if the marks 
+*	and lines came from a snapshot.
+*
+*****/
+
+void ReferenceFinder::PutBuildStats(ostream& os, bool asCSV)
+{
+	RefBuildStats total(RefBase::markOriginal, maxRank);
+	for (size_t i = 0; i < buildStats.size(); i++) total += buildStats[i];
+	
+	if (asCSV) {
+		os << "type,rank,tries,seconds,full,share,outOfTime";
+		for (int j = 0; j < RefBase::numOutcomes; j++) 
+			os << "," << RefBuildStats::OutcomeName(RefBase::Outcome(j));
+		os << endl;
+		for (size_t i = 0; i <= buildStats.size(); i++) {
+			const RefBuildStats& bs = (i < buildStats.size()) ? buildStats[i] : total;
+			os << ((&bs == &total) ? "total" : RefBuildStats::TypeName(bs.mType)) << "," << 
+				bs.mRank << "," << bs.mTries << "," << bs.mSeconds << "," << 
+				(bs.mFull ? 1 : 0) << "," << bs.mShare << "," << (bs.mOutOfTime ? 1 : 0);
+			for (int j = 0; j < RefBase::numOutcomes; j++) os << "," << bs.mOutcomes[j];
+			os << endl;
+		};
+		return;
+	};
+	
+	os << "{\"threads\":" << CountThreads() << ",\"maxRank\":" << maxRank << 
+		",\"maxLines\":" << maxLines << ",\"maxMarks\":" << maxMarks << 
+		",\"outOfTime\":" << (RanOutOfTime() ? "true" : "false") << 
+		",\"lines\":" << basisLines.size() << ",\"marks\":" << basisMarks.size() << 
+		",\"stats\":[";
+	for (size_t i = 0; i <= buildStats.size(); i++) {
+		const RefBuildStats& bs = (i < buildStats.size()) ? buildStats[i] : total;
+		if (&bs == &total) os << "],\"total\":{";
+		else {
+			if (i > 0) os << ",";
+			os << "{\"type\":\"" << RefBuildStats::TypeName(bs.mType) << "\",\"rank\":" << 
+				bs.mRank << ",";
+		};
+		os << "\"tries\":" << bs.mTries << ",\"seconds\":" << bs.mSeconds << 
+			",\"full\":" << (bs.mFull ? "true" : "false") << ",\"share\":" << bs.mShare << 
+			",\"outOfTime\":" << (bs.mOutOfTime ? "true" : "false");
+		for (int j = 0; j < RefBase::numOutcomes; j++) 
+			os << ",\"" << RefBuildStats::OutcomeName(RefBase::Outcome(j)) << "\":" << 
+				bs.mOutcomes[j];
+		os << "}";
+	};
+	os << "}" << endl;
+}
+
+
+/*	Notes on snapshots.
+	Building the marks and lines takes a long time, but the result depends only on a handful
+	of settings, so if snapshotName is set, MakeAllMarksAndLines() saves the finished 
+	collections to a snapshot file and on later runs loads them back if the settings haven't 
+	changed. A snapshot consists of a RefSnapshotHeader, a RefRecord for each line, a 
+	RefRecord for each mark (both in the order of the sortable lists), the names of the 
+	original marks and lines as null-terminated strings, and, if there are any, the coverage 
+	tables of the marks and lines, which are loaded too if they were made with the current 
+	coverageCells, coverageDepth and maxError and made again if not. RefRecords are 
+	fixed-size and hold indices instead of pointers, so the whole file can be mapped into 
+	memory (if USE_MMAP is defined) and restored in a single pass. The format is native to 
+	the machine that wrote it; a snapshot with the wrong version, byte order, record size, 
+	or settings is ignored and rebuilt.
+*/
+
+/**********
+*
+*	RefSnapshotHeader - the header at the start of a snapshot file.
+*
+**********/
+
+class RefSnapshotHeader {
+	public:
+		char mMagic[8];					// identifies the file as a snapshot
+		int mVersion;					// format version
+		int mHeaderSize;				// sizeof(RefSnapshotHeader)
+		int mRecordSize;				// sizeof(RefRecord)
+		int mByteOrder;					// byteOrder, as seen by the machine that wrote it
+		
+		int mMaxRank;					// settings that determine the contents
+		int mMaxLines;
+		int mMaxMarks;
+		int mXNum;
+		int mYNum;
+		int mANum;
+		int mDNum;
+		int mIncludes;					// bit n-1 is set if axiom On is included
+		int mVisibilityMatters;
+		int mFairShares;
+		double mMinAspectRatio;
+		double mMinAngleSine;
+		double mPaperWidth;
+		double mPaperHeight;
+		
+		int mNumLines;					// number of line records
+		int mNumMarks;					// number of mark records
+		int mNamesSize;					// number of bytes in the table of names
+		int mCoverageSize;				// number of bytes of coverage tables after that
+		
+		static const char magic[8];
+		static const int version = 3;
+		static const int byteOrder = 0x01020304;
+		
+		RefSnapshotHeader();
+		const bool IsCompatible() const;
+};
+
+const char RefSnapshotHeader::magic[8] = "RFSNAP";
+
+
+/*****
+*
+*	RefSnapshotHeader::RefSnapshotHeader() - Constructor. Set up a header that describes
+*	a snapshot made with the current settings.
+*
+*****/
+
+RefSnapshotHeader::RefSnapshotHeader()
+{
+	memset(this, 0, sizeof(RefSnapshotHeader));
+	memcpy(mMagic, magic, sizeof(mMagic));
+	mVersion = version;
+	mHeaderSize = sizeof(RefSnapshotHeader);
+	mRecordSize = sizeof(RefRecord);
+	mByteOrder = byteOrder;
+	mMaxRank = ReferenceFinder::maxRank;
+	mMaxLines = int(ReferenceFinder::maxLines);
+	mMaxMarks = int(ReferenceFinder::maxMarks);
+	mXNum = RefMark::xNum;
+	mYNum = RefMark::yNum;
+	mANum = RefLine::aNum;
+	mDNum = RefLine::dNum;
+	mIncludes = (RefLine_C2P_C2P::include ? 1 : 0) | (RefLine_P2P::include ? 2 : 0) |
+		(RefLine_L2L::include ? 4 : 0) | (RefLine_L2L_C2P::include ? 8 : 0) |
+		(RefLine_P2L_C2P::include ? 16 : 0) | (RefLine_P2L_P2L::include ? 32 : 0) |
+		(RefLine_L2L_P2L::include ? 64 : 0);
+	mVisibilityMatters = ReferenceFinder::visibilityMatters ? 1 : 0;
+	mFairShares = ReferenceFinder::fairShares ? 1 : 0;
+	mMinAspectRatio = ReferenceFinder::minAspectRatio;
+	mMinAngleSine = ReferenceFinder::minAngleSine;
+	mPaperWidth = RefBase::paper.pWidth;
+	mPaperHeight = RefBase::paper.pHeight;
+}
+
+
+/*****
+*
+*	RefSnapshotHeader::IsCompatible() - return true if this header came from a snapshot
+*	that we can read and that was made with the current settings.
+*
+*****/
+
+const bool RefSnapshotHeader::IsCompatible() const
+{
+	RefSnapshotHeader h;
+	return memcmp(mMagic, h.mMagic, sizeof(mMagic)) == 0 &&
+		mVersion == h.mVersion &&
+		mHeaderSize == h.mHeaderSize &&
+		mRecordSize == h.mRecordSize &&
+		mByteOrder == h.mByteOrder &&
+		mMaxRank == h.mMaxRank &&
+		mMaxLines == h.mMaxLines &&
+		mMaxMarks == h.mMaxMarks &&
+		mXNum == h.mXNum &&
+		mYNum == h.mYNum &&
+		mANum == h.mANum &&
+		mDNum == h.mDNum &&
+		mIncludes == h.mIncludes &&
+		mVisibilityMatters == h.mVisibilityMatters &&
+		mFairShares == h.mFairShares &&
+		mMinAspectRatio == h.mMinAspectRatio &&
+		mMinAngleSine == h.mMinAngleSine &&
+		mPaperWidth == h.mPaperWidth &&
+		mPaperHeight == h.mPaperHeight;
+}
+
+
+/*****
+*
+*	ReferenceFinder::SaveSnapshot(const string& aName) - save all marks and lines to the
+*	snapshot file aName. Return true if successful.
+*
+*****/
+
+bool ReferenceFinder::SaveSnapshot(const string& aName)
+{
+	// Convert every line and mark to a record. Original marks and lines get the index of
+	// their name, which goes into the table of names.
+	
+	basisLines.BuildLookup();
+	basisMarks.BuildLookup();
+	
+	string names;
+	int numNames = 0;
+	RefContext ac;		// originals are named without a sequence
+	vector<RefRecord> lineRecs(basisLines.size());
+	for (size_t i = 0; i < basisLines.size(); i++) {
+		basisLines[i]->Store(lineRecs[i]);
+		if (lineRecs[i].mType == RefBase::lineOriginal) {
+			ostringstream os;
+			basisLines[i]->PutName(ac, os);
+			names += os.str() + '\0';
+			lineRecs[i].mParents[0] = numNames++;
+		}
+	};
+	vector<RefRecord> markRecs(basisMarks.size());
+	for (size_t i = 0; i < basisMarks.size(); i++) {
+		basisMarks[i]->Store(markRecs[i]);
+		if (markRecs[i].mType == RefBase::markOriginal) {
+			ostringstream os;
+			basisMarks[i]->PutName(ac, os);
+			names += os.str() + '\0';
+			markRecs[i].mParents[0] = numNames++;
+		}
+	};
+	
+	basisLines.ClearLookup();
+	basisMarks.ClearLookup();
+	
+	// The coverage tables go at the end, so that they can be left out.
+	
+	string coverage;
+	if (!markCoverage.IsEmpty() && !lineCoverage.IsEmpty()) {
+		markCoverage.Put(coverage);
+		lineCoverage.Put(coverage);
+	};
+	
+	// Write it all out.
+	
+	RefSnapshotHeader h;
+	h.mNumLines = int(lineRecs.size());
+	h.mNumMarks = int(markRecs.size());
+	h.mNamesSize = int(names.size());
+	h.mCoverageSize = int(coverage.size());
+	
+	ofstream snapfile(aName.c_str(), ios::out | ios::binary | ios::trunc);
+	if (!snapfile.good()) return false;
+	snapfile.write(reinterpret_cast<const char*>(&h), sizeof(h));
+	if (!lineRecs.empty()) snapfile.write(reinterpret_cast<const char*>(&lineRecs[0]), 
+		lineRecs.size() * sizeof(RefRecord));
+	if (!markRecs.empty()) snapfile.write(reinterpret_cast<const char*>(&markRecs[0]), 
+		markRecs.size() * sizeof(RefRecord));
+	snapfile.write(names.data(), names.size());
+	snapfile.write(coverage.data(), coverage.size());
+	snapfile.close();
+	return !snapfile.fail();
+}
+
+
+/*****
+*
+*	ReferenceFinder::LoadSnapshot(const string& aName) - replace all marks and lines with
+*	the contents of the snapshot file aName. Return true if successful; return false,
+*	leaving the collections empty, if the file is missing, damaged, or made with 
+*	different settings.
+*
+*****/
+
+bool ReferenceFinder::LoadSnapshot(const string& aName)
+{
+	bool ok = false;
+#ifdef USE_MMAP
+	int fd = open(aName.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		void* data = mmap(0, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			ok = RestoreSnapshot(static_cast<const char*>(data), size_t(st.st_size));
+			munmap(data, size_t(st.st_size));
+		}
+	};
+	close(fd);
+#else
+	ifstream snapfile(aName.c_str(), ios::in | ios::binary);
+	if (!snapfile.good()) return false;
+	snapfile.seekg(0, ios::end);
+	size_t size = size_t(snapfile.tellg());
+	snapfile.seekg(0, ios::beg);
+	vector<double> data(1 + size / sizeof(double));	// doubles, so records are aligned
+	if (size > 0 && snapfile.read(reinterpret_cast<char*>(&data[0]), size)) 
+		ok = RestoreSnapshot(reinterpret_cast<const char*>(&data[0]), size);
+#endif
+	return ok;
+}
+
+
+/*****
+*
+*	ParentsRestored(const RefRecord& ar, const char* akinds, bool asameRank) - return true
+*	if the parents of ar, whose kinds are given by akinds ('l' = line, 'm' = mark), are 
+*	all refs that have been restored already, of lower rank than ar; or, if asameRank, 
+*	no higher rank (the lines a mark is made from can have the mark's rank).
+*
+*****/
+
+static bool ParentsRestored(const RefRecord& ar, const char* akinds, bool asameRank)
+{
+	for (int i = 0; akinds[i]; i++) {
+		size_t ip = size_t(ar.mParents[i]);
+		const RefBase* rb = 0;
+		if (akinds[i] == 'l') {
+			if (ip >= ReferenceFinder::basisLines.size()) return false;
+			rb = ReferenceFinder::basisLines[ip];
+		}
+		else {
+			if (ip >= ReferenceFinder::basisMarks.size()) return false;
+			rb = ReferenceFinder::basisMarks[ip];
+		};
+		if (!rb || rb->mRank > ar.mRank || (rb->mRank == ar.mRank && !asameRank)) 
+			return false;
+	};
+	return true;
+}
+
+
+/*****
+*
+*	ReferenceFinder::RestoreSnapshot(const char* data, size_t size) - rebuild all marks and
+*	lines from the contents of a snapshot file that has been read into memory.
+*
+*****/
+
+bool ReferenceFinder::RestoreSnapshot(const char* data, size_t size)
+{
+	basisLines.Reinitialize();
+	basisMarks.Reinitialize();
+	
+	// Make sure this is a snapshot that we can use and that it is all there.
+	
+	if (size < sizeof(RefSnapshotHeader)) return false;
+	const RefSnapshotHeader& h = *reinterpret_cast<const RefSnapshotHeader*>(data);
+	if (!h.IsCompatible()) return false;
+	if (h.mNumLines < 0 || h.mNumMarks < 0 || h.mNamesSize < 0 || h.mCoverageSize < 0) 
+		return false;
+	if (size != sizeof(RefSnapshotHeader) + 
+		(size_t(h.mNumLines) + size_t(h.mNumMarks)) * sizeof(RefRecord) + 
+		size_t(h.mNamesSize) + size_t(h.mCoverageSize)) return false;
+	
+	const RefRecord* lineRecs = reinterpret_cast<const RefRecord*>(data + sizeof(h));
+	const RefRecord* markRecs = lineRecs + h.mNumLines;
+	const char* namep = reinterpret_cast<const char*>(markRecs + h.mNumMarks);
+	
+	// Every name must end within the table.
+	
+	vector<string> names;
+	const char* nend = namep + h.mNamesSize;
+	for (const char* np = namep; np < nend; ) {
+		const char* npend = static_cast<const char*>(memchr(np, '\0', size_t(nend - np)));
+		if (!npend) return false;
+		names.push_back(string(np, npend));
+		np = npend + 1;
+	};
+	
+	// Restore the refs rank by rank, lines before marks, so that the refs that each one is
+	// made from have already been restored; a record whose parents haven't been is damaged.
+	
+	basisLines.resize(h.mNumLines, 0);
+	basisMarks.resize(h.mNumMarks, 0);
+	for (rank_t irank = 0; irank <= maxRank; irank++) {
+		for (int i = 0; i < h.mNumLines; i++) {
+			const RefRecord& ar = lineRecs[i];
+			if (ar.mRank != irank) continue;
+			RefLine* rl = 0;
+			switch (ar.mType) {
+				case RefBase::lineOriginal:
+					if (size_t(ar.mParents[0]) < names.size()) 
+						rl = new (basisLines.arena) RefLine_Original(ar, 
+							basisLines.arena.CopyString(names[ar.mParents[0]]));
+					break;
+				case RefBase::lineC2P_C2P:
+					if (ParentsRestored(ar, "mm", false)) 
+						rl = new (basisLines.arena) RefLine_C2P_C2P(ar);
+					break;
+				case RefBase::lineP2P:
+					if (ParentsRestored(ar, "mm", false)) 
+						rl = new (basisLines.arena) RefLine_P2P(ar);
+					break;
+				case RefBase::lineL2L:
+					if (ParentsRestored(ar, "ll", false)) 
+						rl = new (basisLines.arena) RefLine_L2L(ar);
+					break;
+				case RefBase::lineL2L_C2P:
+					if (ParentsRestored(ar, "lm", false)) 
+						rl = new (basisLines.arena) RefLine_L2L_C2P(ar);
+					break;
+				case RefBase::lineP2L_C2P:
+					if (ParentsRestored(ar, "mlm", false)) 
+						rl = new (basisLines.arena) RefLine_P2L_C2P(ar);
+					break;
+				case RefBase::lineP2L_P2L:
+					if (ParentsRestored(ar, "mlml", false)) 
+						rl = new (basisLines.arena) RefLine_P2L_P2L(ar);
+					break;
+				case RefBase::lineL2L_P2L:
+					if (ParentsRestored(ar, "lml", false)) 
+						rl = new (basisLines.arena) RefLine_L2L_P2L(ar);
+					break;
+				default: ; // not a line
+			};
+			if (!rl) {
+				basisLines.Reinitialize();
+				basisMarks.Reinitialize();
+				return false;
+			};
+			basisLines[i] = rl;
+		};
+		for (int i = 0; i < h.mNumMarks; i++) {
+			const RefRecord& ar = markRecs[i];
+			if (ar.mRank != irank) continue;
+			RefMark* rm = 0;
+			switch (ar.mType) {
+				case RefBase::markOriginal:
+					if (size_t(ar.mParents[0]) < names.size()) 
+						rm = new (basisMarks.arena) RefMark_Original(ar, 
+							basisMarks.arena.CopyString(names[ar.mParents[0]]));
+					break;
+				case RefBase::markIntersection:
+					if (ParentsRestored(ar, "ll", true)) 
+						rm = new (basisMarks.arena) RefMark_Intersection(ar);
+					break;
+				default: ; // not a mark
+			};
+			if (!rm) {
+				basisLines.Reinitialize();
+				basisMarks.Reinitialize();
+				return false;
+			};
+			basisMarks[i] = rm;
+		}
+	};
+	
+	// Every record should have been restored, unless some had ranks out of range.
+	
+	if (find(basisLines.begin(), basisLines.end(), (RefLine*)0) != basisLines.end() ||
+		find(basisMarks.begin(), basisMarks.end(), (RefMark*)0) != basisMarks.end()) {
+		basisLines.Reinitialize();
+		basisMarks.Reinitialize();
+		return false;
+	};
+	basisLines.rcsz = basisLines.size();
+	basisMarks.rcsz = basisMarks.size();
+	markIndex.Build(basisMarks);
+	lineIndex.Build(basisLines);
+	
+	// Use the coverage tables of the snapshot if they're the ones we want; if not, make 
+	// them.
+	
+	const char* cp = namep + h.mNamesSize;
+	const char* cend = cp + h.mCoverageSize;
+	if (coverageCells <= 0 || 
+		!markCoverage.Get(cp, cend, basisMarks.size(), coverageCells, coverageDepth) || 
+		!lineCoverage.Get(cp, cend, basisLines.size(), coverageCells, coverageDepth)) 
+		BuildCoverage();
+	return true;
+}
+
+
+/*****
+*
+*	ReferenceFinder::MesserCubeRoot() - this routine builds Peter Messer's construction of 
+*	cube root of 2.	Only used for testing, but I'll leave it in here for edification.
+*
+*****/
+
+void ReferenceFinder::MesserCubeRoot()
+{
+	// Rank 0: Construct the four edges of the square.
+
+	RefLine *be, *le, *re, *te;
+	
+	ReferenceFinder::basisLines.Add(be = new (basisLines.arena) RefLine_Original(
+		RefBase::paper.bottomEdge, 0, "bottom edge"));
+	ReferenceFinder::basisLines.Add(le = new (basisLines.arena) RefLine_Original(
+		RefBase::paper.leftEdge, 0, "left edge"));
+	ReferenceFinder::basisLines.Add(re = new (basisLines.arena) RefLine_Original(
+		RefBase::paper.rightEdge, 0, "right edge"));
+	ReferenceFinder::basisLines.Add(te = new (basisLines.arena) RefLine_Original
+		(RefBase::paper.topEdge, 0, "top edge"));
+
+	// Rank 0: Construct the four corners of the square.
+	
+	RefMark *blc, *brc, *tlc, *trc;
+	
+	ReferenceFinder::basisMarks.Add(blc = new (basisMarks.arena) RefMark_Original(
+	RefBase::paper.botLeft, 0, "bot left corner"));
+	ReferenceFinder::basisMarks.Add(brc = new (basisMarks.arena) RefMark_Original(
+	RefBase::paper.botRight, 0, "bot right corner"));
+	ReferenceFinder::basisMarks.Add(tlc = new (basisMarks.arena) RefMark_Original(
+	RefBase::paper.topLeft, 0, "top left corner"));
+	ReferenceFinder::basisMarks.Add(trc = new (basisMarks.arena) RefMark_Original(
+	RefBase::paper.topRight, 0, "top right corner"));
+
+	// Create the endpoints of the two initial fold lines
+	
+	RefMark *rma1, *rma2, *rmb1, *rmb2;
+	
+	ReferenceFinder::basisMarks.Add(rma1 = new (basisMarks.arena) RefMark_Original(XYPt(0, 1./3), 0, 
+		"(0, 1/3)"));
+	ReferenceFinder::basisMarks.Add(rma2 = new (basisMarks.arena) RefMark_Original(XYPt(1, 1./3), 0, 
+		"(1, 1/3)"));
+	ReferenceFinder::basisMarks.Add(rmb1 = new (basisMarks.arena) RefMark_Original(XYPt(0, 2./3), 0, 
+		"(0, 2/3)"));
+	ReferenceFinder::basisMarks.Add(rmb2 = new (basisMarks.arena) RefMark_Original(XYPt(1, 2./3), 0, 
+		"(1, 2/3)"));
+
+	// Create and add the two initial fold lines.
+	
+	RefLine *rla, *rlb;
+	
+	ReferenceFinder::basisLines.Add(rla = new (basisLines.arena) RefLine_C2P_C2P(rma1, rma2));
+	ReferenceFinder::basisLines.Add(rlb = new (basisLines.arena) RefLine_C2P_C2P(rmb1, rmb2));
+	
+	// Construct the fold line
+	
+	RefLine_P2L_P2L rlc(brc, le, rma2, rlb, 0);
+	
+	// Print the entire sequence
+	
+#ifndef NO_CONSOLE
+	RefContext ac;
+	rlc.PutHowtoSequence(ac, cout);
+#endif
+	
+	// quit the program
+	
+	exit(1);
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks) -- 
+*	Find the best marks closest to a given point ap, storing the results in the vector vm.
+*
+*****/
+
+void ReferenceFinder::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks)
+{
+	rank_t arank;
+	FindBestMarks(ap, vm, numMarks, arank);
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks, 
+*	rank_t& arank) - Find the best marks closest to a given point ap, storing the results 
+*	in the vector vm and the highest rank of the marks we looked at in arank; that's 
+*	less than maxRank if a background build is still going on.
+*
+*****/
+
+void ReferenceFinder::FindBestMarks(const XYPt& ap, vector<RefMark*>& vm, short numMarks, 
+	rank_t& arank)
+{
+	RefView* rv = AcquireView();
+	if (rv) {
+		arank = rv->mRank;
+		rv->FindBestMarks(ap, vm, numMarks, !useSearchIndex);
+		ReleaseView(rv);
+		return;
+	};
+	arank = maxRank;
+	if (!markIndex.IsEmpty()) {
+		if (!useSearchIndex) markIndex.ScanBestMarks(ap, vm, numMarks);
+		else if (!useCoverage || !markCoverage.FindBestMarks(ap, basisMarks, vm, numMarks))
+			markIndex.FindBestMarks(ap, vm, numMarks);
+		return;
+	};
+	vm.resize(numMarks);
+	partial_sort_copy(basisMarks.begin(), basisMarks.end(), vm.begin(), vm.end(), 
+		CompareRankAndError<RefMark>(ap));
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines) -- 
+*	Find the best lines closest to a given line al, storing the results in the vector vl.
+*
+*****/
+
+void ReferenceFinder::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines)
+{
+	rank_t arank;
+	FindBestLines(al, vl, numLines, arank);
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines, 
+*	rank_t& arank) - Find the best lines closest to a given line al, storing the results
+*	in the vector vl and the highest rank of the lines we looked at in arank.
+*
+*****/
+
+void ReferenceFinder::FindBestLines(const XYLine& al, vector<RefLine*>& vl, short numLines, 
+	rank_t& arank)
+{
+	RefView* rv = AcquireView();
+	if (rv) {
+		arank = rv->mRank;
+		rv->FindBestLines(al, vl, numLines, !useSearchIndex);
+		ReleaseView(rv);
+		return;
+	};
+	arank = maxRank;
+	if (!lineIndex.IsEmpty()) {
+		if (!useSearchIndex) lineIndex.ScanBestLines(al, vl, numLines);
+		else if (!useCoverage || !lineCoverage.FindBestLines(al, basisLines, vl, numLines))
+			lineIndex.FindBestLines(al, vl, numLines);
+		return;
+	};
+	vl.resize(numLines);
+	partial_sort_copy(basisLines.begin(), basisLines.end(), vl.begin(), vl.end(), 
+		CompareRankAndError<RefLine>(al));
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindMarksWithin(const XYPt& ap, double atol, vector<RefMark*>& vm, 
+*		bool afrontier) - find every mark within atol of ap and store them in vm by rank,
+*	closest first within a rank; or, if afrontier, store only the marks closer than every
+*	mark of lower rank, so that each one in vm takes more folds than the one before it 
+*	but gets closer. Either way, we only look at the marks near ap.
+*
+*****/
+
+void ReferenceFinder::FindMarksWithin(const XYPt& ap, double atol, vector<RefMark*>& vm, 
+	bool afrontier)
+{
+	RefRankList<RefMark> found(atol);
+	RefView* rv = AcquireView();
+	if (rv) {
+		rv->FindMarksWithin(ap, found);
+		ReleaseView(rv);
+	}
+	else if (!markIndex.IsEmpty()) markIndex.FindMarksWithin(ap, found);
+	else {
+		for (size_t i = 0; i < basisMarks.size(); i++) 
+			found.Offer(basisMarks[i], basisMarks[i]->Distance(ap));
+	};
+	found.Get(vm, afrontier);
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindLinesWithin(const XYLine& al, double atol, vector<RefLine*>& vl, 
+*		bool afrontier) - same as FindMarksWithin(), for lines near al.
+*
+*****/
+
+void ReferenceFinder::FindLinesWithin(const XYLine& al, double atol, vector<RefLine*>& vl, 
+	bool afrontier)
+{
+	RefRankList<RefLine> found(atol);
+	RefView* rv = AcquireView();
+	if (rv) {
+		rv->FindLinesWithin(al, found);
+		ReleaseView(rv);
+	}
+	else if (!lineIndex.IsEmpty()) lineIndex.FindLinesWithin(al, found);
+	else {
+		for (size_t i = 0; i < basisLines.size(); i++) 
+			found.Offer(basisLines[i], basisLines[i]->Distance(al));
+	};
+	found.Get(vl, afrontier);
+}
+
+
+#ifdef USE_PTHREADS
+/*****
+*
+*	RefSearchJob<R> - the state shared by the threads that answer a batch of searches,
+*	either for the best refs (mFind) or for the refs within a tolerance (mWithin).
+*	Threads take runs of targets in turn. A search only reads the marks, lines and 
+*	indexes, so that's all the locking we need.
+*
+*****/
+
+template <class R>
+class RefSearchJob {
+	public:
+		typedef void (*FindFn)(const typename R::bare_t&, std::vector<R*>&, short);
+		typedef void (*WithinFn)(const typename R::bare_t&, double, std::vector<R*>&, bool);
+		enum {runSize = 16};				// targets handed out at a time
+		FindFn mFind;						// the FindBest...() routine, or 0
+		WithinFn mWithin;					// the Find...Within() routine, if mFind is 0
+		const std::vector<typename R::bare_t>& mTargets;	// what we're looking for
+		std::vector< std::vector<R*> >& mFound;	// what we found for each target
+		short mNum;							// number of refs to find for each target
+		double mTol;						// tolerance for mWithin
+		bool mFrontier;						// frontier flag for mWithin
+		std::size_t mNext;					// next target to hand out
+		pthread_mutex_t mMutex;				// guards mNext
+		
+		RefSearchJob(const std::vector<typename R::bare_t>& at, 
+			std::vector< std::vector<R*> >& af) : 
+			mFind(0), mWithin(0), mTargets(at), mFound(af), mNum(0), mTol(0), 
+			mFrontier(false), mNext(0) {
+			pthread_mutex_init(&mMutex, 0);
+		};
+		~RefSearchJob() {
+			pthread_mutex_destroy(&mMutex);
+		};
+		void Search(std::size_t i) {
+			if (mFind) (*mFind)(mTargets[i], mFound[i], mNum);
+			else (*mWithin)(mTargets[i], mTol, mFound[i], mFrontier);
+		};
+		void Run(int anthreads);
+		static void* Work(void* p);
+};
+
+
+/*****
+*
+*	RefSearchJob<R>::Run(int anthreads) - answer all the targets with anthreads threads,
+*	or right here if none of them could be started.
+*
+*****/
+
+template <class R>
+void RefSearchJob<R>::Run(int anthreads)
+{
+	std::vector<pthread_t> threads(anthreads);
+	int nstarted = 0;
+	for (int i = 0; i < anthreads; i++) 
+		if (pthread_create(&threads[nstarted], 0, &RefSearchJob<R>::Work, this) == 0) 
+			nstarted++;
+	if (nstarted == 0) Work(this);
+	for (int i = 0; i < nstarted; i++) pthread_join(threads[i], 0);
+}
+
+
+/*****
+*
+*	RefSearchJob<R>::Work(void* p) - thread routine; answers runs of targets until there
+*	are none left.
+*
+*****/
+
+template <class R>
+void* RefSearchJob<R>::Work(void* p)
+{
+	RefSearchJob<R>& job = *static_cast<RefSearchJob<R>*>(p);
+	while (true) {
+		pthread_mutex_lock(&job.mMutex);
+		size_t i0 = job.mNext;
+		job.mNext = min(job.mNext + size_t(runSize), job.mTargets.size());
+		size_t i1 = job.mNext;
+		pthread_mutex_unlock(&job.mMutex);
+		if (i0 >= i1) return 0;
+		for (size_t i = i0; i < i1; i++) job.Search(i);
+	}
+}
+#endif // USE_PTHREADS
+
+
+/*****
+*
+*	ReferenceFinder::FindBestOfType(afind, const vector<R::bare_t>& at, 
+*		vector< vector<R*> >& vr, short anum) - call afind for every target in at, storing
+*	the results in vr, with as many threads as CountThreads() says.
+*
+*****/
+
+template <class R>
+void ReferenceFinder::FindBestOfType(void (*afind)(const typename R::bare_t&, vector<R*>&, 
+	short), const vector<typename R::bare_t>& at, vector< vector<R*> >& vr, short anum)
+{
+	vr.resize(at.size());
+	int nthreads = min(CountThreads(), int(at.size()));
+	if (nthreads <= 1) {
+		for (size_t i = 0; i < at.size(); i++) (*afind)(at[i], vr[i], anum);
+		return;
+	};
+#ifdef USE_PTHREADS
+	RefSearchJob<R> job(at, vr);
+	job.mFind = afind;
+	job.mNum = anum;
+	job.Run(nthreads);
+#endif // USE_PTHREADS
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindWithinOfType(awithin, const vector<R::bare_t>& at, double atol,
+*		vector< vector<R*> >& vr, bool afrontier) - call awithin for every target in at, 
+*	storing the results in vr, with as many threads as CountThreads() says.
+*
+*****/
+
+template <class R>
+void ReferenceFinder::FindWithinOfType(void (*awithin)(const typename R::bare_t&, double, 
+	vector<R*>&, bool), const vector<typename R::bare_t>& at, double atol, 
+	vector< vector<R*> >& vr, bool afrontier)
+{
+	vr.resize(at.size());
+	int nthreads = min(CountThreads(), int(at.size()));
+	if (nthreads <= 1) {
+		for (size_t i = 0; i < at.size(); i++) (*awithin)(at[i], atol, vr[i], afrontier);
+		return;
+	};
+#ifdef USE_PTHREADS
+	RefSearchJob<R> job(at, vr);
+	job.mWithin = awithin;
+	job.mTol = atol;
+	job.mFrontier = afrontier;
+	job.Run(nthreads);
+#endif // USE_PTHREADS
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindBestMarks(const vector<XYPt>& ap, vector< vector<RefMark*> >& vm, 
+*		short numMarks) - find the best marks for each of the points ap, storing the results 
+*	for ap[i] in vm[i].
+*
+*****/
+
+void ReferenceFinder::FindBestMarks(const vector<XYPt>& ap, vector< vector<RefMark*> >& vm, 
+	short numMarks)
+{
+	void (*find)(const XYPt&, vector<RefMark*>&, short) = &FindBestMarks;
+	FindBestOfType<RefMark>(find, ap, vm, numMarks);
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindBestLines(const vector<XYLine>& al, vector< vector<RefLine*> >& vl, 
+*		short numLines) - find the best lines for each of the lines al, storing the results 
+*	for al[i] in vl[i].
+*
+*****/
+
+void ReferenceFinder::FindBestLines(const vector<XYLine>& al, vector< vector<RefLine*> >& vl, 
+	short numLines)
+{
+	void (*find)(const XYLine&, vector<RefLine*>&, short) = &FindBestLines;
+	FindBestOfType<RefLine>(find, al, vl, numLines);
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindMarksWithin(const vector<XYPt>& ap, double atol, 
+*		vector< vector<RefMark*> >& vm, bool afrontier) - find the marks within atol of 
+*	each of the points ap, storing the results for ap[i] in vm[i].
+*
+*****/
+
+void ReferenceFinder::FindMarksWithin(const vector<XYPt>& ap, double atol, 
+	vector< vector<RefMark*> >& vm, bool afrontier)
+{
+	void (*within)(const XYPt&, double, vector<RefMark*>&, bool) = &FindMarksWithin;
+	FindWithinOfType<RefMark>(within, ap, atol, vm, afrontier);
+}
+
+
+/*****
+*
+*	ReferenceFinder::FindLinesWithin(const vector<XYLine>& al, double atol, 
+*		vector< vector<RefLine*> >& vl, bool afrontier) - find the lines within atol of 
+*	each of the lines al, storing the results for al[i] in vl[i].
+*
+*****/
+
+void ReferenceFinder::FindLinesWithin(const vector<XYLine>& al, double atol, 
+	vector< vector<RefLine*> >& vl, bool afrontier)
+{
+	void (*within)(const XYLine&, double, vector<RefLine*>&, bool) = &FindLinesWithin;
+	FindWithinOfType<RefLine>(within, al, atol, vl, afrontier);
+}
+
+
+/*****
+*
+*	ReferenceFinder::ValidateMark(XYPt ap) - return true if ap is a valid mark. 
+*	Print an error message if it isn't.
+*
+*****/
+
+bool ReferenceFinder::ValidateMark(const XYPt& ap)
+{
+	if (ap.x < 0 || ap.x > RefBase::paper.pWidth) {
+#ifndef NO_CONSOLE
+		cout << endl << "Error -- x coordinate should lie between 0 and " << 
+			RefBase::paper.pWidth << endl;
+#endif
+		return false;
+	}
+	
+	if (ap.y < 0 || ap.y > RefBase::paper.pHeight) {
+#ifndef NO_CONSOLE
+		cout << endl << "Error -- y coordinate should lie between 0 and " << 
+			RefBase::paper.pHeight << endl;
+#endif
+		return false;
+	}
+	return true;
+}
+
+
+/*****
+*
+*	ReferenceFinder::ValidateLine(XYPt ap1, XYPt ap2) - validate the two entered points 
+*	that define the line. Print an error message if they aren't distinct.
+*
+*****/
+
+bool ReferenceFinder::ValidateLine(const XYPt& ap1, const XYPt& ap2)
+{
+	if ((ap1 - ap2).Mag() > EPS) return true;
+#ifndef NO_CONSOLE
+	cout.precision(10);
+	cout << endl << "Error -- the two points must be distinct (separated by at least " <<
+		EPS << ")." << endl;
+#endif
+	return false;
+}
+
+
+/*****
+*
+*	void ReferenceFinder::CalcStatistics() - compute statistics on the accuracy of the 
+*	current set of marks for a randomly chosen set of points.
+*
+*****/
+
+void ReferenceFinder::CalcStatistics()
+{
+#ifndef NO_CONSOLE
+	const short numBuckets = 11;		// We'll sort errors in buckets of width .001.
+	int errBucket[numBuckets];			// array of the number of errors in each bucket
+	for (short i = 0; i < numBuckets; i++) errBucket[i] = 0;	// initialize the array
+	
+	const int numTries = 1000;		// number of test cases
+	vector<double> errors(numTries);	// a record of all errors
+	
+	vector <RefMark*> sortMarks(1);	// a vector to do our sorting into
+	
+	// Run a bunch of test cases.
+		
+		cout.precision(4);
+		cout.setf(ios_base::fixed, ios_base::floatfield);
+		cout << "(test #) error" << endl;
+	
+	for (int i = 0; i < numTries; i++) {
+		// Pick a random coordinate
+		XYPt testPt((double(rand()) / (RAND_MAX * RefBase::paper.pWidth)), 
+			double(rand()) / (RAND_MAX * RefBase::paper.pHeight));
+		
+		// Find the mark closest to the test mark, and note how close we were.
+		if (!markIndex.IsEmpty()) errors[i] = markIndex.NearestDistance(testPt);
+		else {
+			partial_sort_copy(basisMarks.begin(), basisMarks.end(), 
+				sortMarks.begin(), sortMarks.end(), CompareError<RefMark>(testPt));
+			errors[i] = (testPt - sortMarks[0]->p).Mag();
+		};
+			
+		// print the error, 5 to a line
+		cout << "(" << i + 1 << "/" << numTries << ") " << errors[i] << ", ";
+		if (fmod((double)i + 1, 5) == 0) cout << endl;
+		
+		// also, compute a bucket index for this error
+		int errindex = int(errors[i] / .001);
+		
+		// over the top goes into last bucket
+		if (errindex >= numBuckets) errindex = numBuckets - 1;
+		
+		// record the error into the appropriate bucket		
+		errBucket[errindex] += 1;
+	}
+	
+	// Now print the distribution of errors
+	
+	cout.precision(1);
+	cout << endl << "Distribution of errors:" << endl;
+	int cum = 0;
+	for (int i = 0; i < numBuckets -1; i++) {
+		cum += errBucket[i];
+		cout << "error < " << .001 * (i + 1) << " = " << cum << 
+			"(" << 100. * double(cum) / numTries << "%)" << endl;
+	}
+	cout << "error > 0.01 = " << numTries - cum <<
+		"(" << 100. * double(numTries - cum) / numTries << "%)" << endl;
+		
+	// sort the errors and print percentiles of the errors
+	
+	sort(errors.begin(), errors.end());
+	cout.precision(4);
+	cout << endl << "Distribution of errors:" << endl;
+	cout << "10th percentile :" << errors[int(.10 * numTries)] << endl;
+	cout << "20th percentile :" << errors[int(.20 * numTries)] << endl;
+	cout << "50th percentile :" << errors[int(.50 * numTries)] << endl;
+	cout << "80th percentile :" << errors[int(.80 * numTries)] << endl;
+	cout << "90th percentile :" << errors[int(.90 * numTries)] << endl;
+	cout << "95th percentile :" << errors[int(.95 * numTries)] << endl;
+	cout << "99th percentile :" << errors[int(.99 * numTries)] << endl;
+	cout << endl;
+#endif
+}
+
+
+/*****
+*
+*	void ReferenceFinder::TimeSearches() - time FindBestMarks() and FindBestLines() on 
+*	a fixed set of random targets: comparing the refs themselves, as the original search did; 
+*	scanning the coordinate arrays of the indexes with each kernel of RefScorer; using 
+*	the indexes; and using the coverage tables, if there are any, before the indexes. 
+*	Check that all of them give the same answers.
+*
+*****/
+
+void ReferenceFinder::TimeSearches()
+{
+#ifndef NO_CONSOLE
+	const int numQueries = 2000;		// number of test cases
+	const short numMarks = 5;			// marks found per test case, as in the console
+	const short numLines = 5;			// lines found per test case, ditto
+	
+	// Pick all the targets first, so that all searches get the same ones. Target lines
+	// go through two random points. The seed is fixed so that every run gets the same
+	// targets too, and timings can be compared from run to run.
+	
+	srand(1);
+	vector<XYPt> targets(numQueries);
+	vector<XYLine> lineTargets;
+	for (int i = 0; i < numQueries; i++)
+		targets[i] = XYPt(RefBase::paper.pWidth * double(rand()) / RAND_MAX, 
+			RefBase::paper.pHeight * double(rand()) / RAND_MAX);
+	while (lineTargets.size() < size_t(numQueries)) {
+		XYPt p1(RefBase::paper.pWidth * double(rand()) / RAND_MAX, 
+			RefBase::paper.pHeight * double(rand()) / RAND_MAX);
+		XYPt p2(RefBase::paper.pWidth * double(rand()) / RAND_MAX, 
+			RefBase::paper.pHeight * double(rand()) / RAND_MAX);
+		if ((p1 - p2).Mag() > EPS) lineTargets.push_back(XYLine(p1, p2));
+	};
+	
+	// The ways to search: 0 = compare refs, 1 = scalar scan, 2 = vector scan, 3 = index,
+	// 4 = coverage tables, then index.
+	
+	const int numWays = 5;
+	const char* wayNames[numWays] = {"objects", "scan", "scan", "index", "tables"};
+	bool oldUseSearchIndex = useSearchIndex;
+	bool oldUseCoverage = useCoverage;
+	bool oldUseAVX2 = RefScorer::useAVX2;
+	vector< vector< vector<RefMark*> > > foundMarks(numWays, 
+		vector< vector<RefMark*> >(numQueries));
+	vector< vector< vector<RefLine*> > > foundLines(numWays, 
+		vector< vector<RefLine*> >(numQueries));
+	double markTime[numWays], lineTime[numWays];
+	string kernels[numWays];
+	
+	for (int w = 0; w < numWays; w++) {
+		useSearchIndex = (w >= 3);
+		useCoverage = (w == 4);
+		RefScorer::useAVX2 = (w != 1);
+		kernels[w] = (w == 0) ? "" : RefScorer::KernelName();
+		clock_t t0 = clock();
+		for (int i = 0; i < numQueries; i++) {
+			vector<RefMark*>& vm = foundMarks[w][i];
+			if (w == 0) {
+				vm.resize(numMarks);
+				partial_sort_copy(basisMarks.begin(), basisMarks.end(), vm.begin(), vm.end(), 
+					CompareRankAndError<RefMark>(targets[i]));
+			}
+			else FindBestMarks(targets[i], vm, numMarks);
+		};
+		clock_t t1 = clock();
+		for (int i = 0; i < numQueries; i++) {
+			vector<RefLine*>& vl = foundLines[w][i];
+			if (w == 0) {
+				vl.resize(numLines);
+				partial_sort_copy(basisLines.begin(), basisLines.end(), vl.begin(), vl.end(), 
+					CompareRankAndError<RefLine>(lineTargets[i]));
+			}
+			else FindBestLines(lineTargets[i], vl, numLines);
+		};
+		clock_t t2 = clock();
+		markTime[w] = 1000. * double(t1 - t0) / CLOCKS_PER_SEC / numQueries;
+		lineTime[w] = 1000. * double(t2 - t1) / CLOCKS_PER_SEC / numQueries;
+	};
+	useSearchIndex = oldUseSearchIndex;
+	useCoverage = oldUseCoverage;
+	RefScorer::useAVX2 = oldUseAVX2;
+	
+	cout.precision(4);
+	cout.setf(ios_base::fixed, ios_base::floatfield);
+	for (int pass = 0; pass < 2; pass++) {
+		cout << endl << (pass == 0 ? "FindBestMarks, " : "FindBestLines, ") << numQueries << 
+			" targets:" << endl;
+		for (int w = 0; w < numWays; w++) {
+			int numDiffs = 0;
+			for (int i = 0; i < numQueries; i++) 
+				if (pass == 0 ? foundMarks[w][i] != foundMarks[0][i] : 
+					foundLines[w][i] != foundLines[0][i]) numDiffs++;
+			cout << wayNames[w];
+			if (!kernels[w].empty()) cout << " (" << kernels[w] << ")";
+			cout << " : " << (pass == 0 ? markTime[w] : lineTime[w]) << " ms per search, " <<
+				numDiffs << " differences" << endl;
+		}
+	};
+	cout << endl;
+#endif
+}
+
+
+/******************************************************************************
+*
+*	Section 5: Routines for drawing diagrams
+*
+******************************************************************************/
+
+
+/**********
+*
+*	RefDgmr - object that draws folding diagrams of references. Subclasses specialize
+*	to particular drawing environments (print vs screen, multiple GUIs, platform-specific
+*	drawing models, etc.
+*
+**********/
+
+/*	Notes on RefDgmr and its descendants.
+	Subclasses will typically maintain an internal graphics state that describes the location
+	of the diagram on the canvas and will implement the handful of virtual drawing methods
+	that render the diagram on the canvas. The base class does nothing. All points are given
+	in the paper coordinate system. The subclass implementation of drawing should determine
+	the layout of the diagrams and offset and scale appropriately to convert to canvas
+	coordinates. See PSDgmr for an example.
+*/	
+
+/*****
+*
+*	RefDgmr::DrawPt(const XYPt& aPt, PointStyle pstyle) - 
+*	draw a point in the given style.
+*
+*****/
+
+void RefDgmr::DrawPt(const XYPt& /* aPt */, PointStyle /* pstyle */)
+{
+}
+
+
+/*****
+*
+*	RefDgmr::DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle) - 
+*	draw a line in the given style.
+*
+*****/
+
+void RefDgmr::DrawLine(const XYPt& /* fromPt */, const XYPt& /* toPt */, LineStyle /* lstyle */)
+{
+}
+
+
+/*****
+*
+*	RefDgmr::DrawArc(const XYPt& ctr, const double rad, const double fromAngle,
+*	const double toAngle, LineStyle lstyle) - draw an arc in the given style.
+*	fromAngle and toAngle are given in radians.
+*
+*****/
+
+void RefDgmr::DrawArc(const XYPt& /* ctr */, const double /* rad */, const double /* fromAngle */,
+	const double /* toAngle */, const bool /* ccw */, LineStyle /* lstyle */)
+{
+}
+
+
+/*****
+*
+*	RefDgmr::DrawPoly(const vector<XYPt>& poly, PolyStyle pstyle) -
+*	draw a polygon in the given style.
+*
+*****/
+
+void RefDgmr::DrawPoly(const vector<XYPt>& /* poly */, PolyStyle /* pstyle */)
+{
+}
+
+
+/*****
+*
+*	RefDgmr::DrawLabel(const XYPt& aPt, const string& aString, LabelStyle lstyle) -
+*	draw a label at a given point
+*
+*****/
+
+void RefDgmr::DrawLabel(const XYPt& /* aPt */, const string& /* aString */, 
+	LabelStyle /* lstyle */)
+{
+}
+
+
+/*	Class RefDgmr provides a set of routines for drawing arrows that are built on top of
+	the primitive routines above. These can be overridden if you want to implement a different
+	style of arrow.
+*/
+
+/*****
+*
+*	RefDgmr::DrawValleyArrowhead(const XYPt& loc, const XYPt& dir, const double len) -
+*	Draw a valley-fold arrowhead with tip at location loc, direction dir, and size len.
+*
+*****/
+
+void RefDgmr::DrawValleyArrowhead(const XYPt& loc, const XYPt& dir, const double len)
+{
+	DrawLine(loc, loc - len * dir.RotateCCW(.523), arrowLine);
+	DrawLine(loc, loc - len * dir.RotateCCW(-.523), arrowLine);
+}
+
+
+/*****
+*
+*	RefDgmr::DrawMountainArrowhead(const XYPt& loc, const XYPt& dir, const double len) -
+*	Draw a mountain arrowhead with tip at location loc, direction dir, and size len.
+*
+*****/
+
+void RefDgmr::DrawMountainArrowhead(const XYPt& loc, const XYPt& dir, const double len)
+{
+	XYPt ldir = len * dir;
+	vector<XYPt> poly;
+	poly.push_back(loc);
+	poly.push_back(loc - ldir.RotateCCW(.523));
+	poly.push_back(loc - .8 * ldir);
+	DrawPoly(poly, arrowPoly);
+}
+
+
+/*****
+*
+*	RefDgmr::DrawUnfoldArrowhead(const XYPt& loc, const XYPt& dir, const double len) -
+*	Draw an unfold arrowhead with tip at location loc, direction dir, and size len.
+*
+*****/
+
+void RefDgmr::DrawUnfoldArrowhead(const XYPt& loc, const XYPt& dir, const double len)
+{
+	XYPt ldir = len * dir;
+	vector<XYPt> poly;
+	poly.push_back(loc);
+	poly.push_back(loc - ldir.RotateCCW(.523));
+	poly.push_back(loc - .8 * ldir);
+	poly.push_back(loc - ldir.RotateCCW(-.523));
+	DrawPoly(poly, arrowPoly);
+}
+
+
+/*****
+*
+*	CalcArrow(const XYPt& fromPt, const XYPt& toPt,
+*	XYPt& ctr, double& rad, double& fromAngle, double& toAngle, bool& ccw,
+*	XYPt& fromDir, XYPt& toDir) - calculate all the parameters necessary to draw
+*	any type of arrow (valley, mountain, unfold, fold-and-unfold).
+*
+*****/
+
+void RefDgmr::CalcArrow(const XYPt& fromPt, const XYPt& toPt,
+	XYPt& ctr, double& rad, double& fromAngle, double& toAngle, bool& ccw,
+	double& ahSize, XYPt& fromDir, XYPt& toDir)
+{
+	const double RADIANS = 57.29577951;
+	const double TWO_PI = 6.283185308;
+	const double PI = 3.1415926535;
+	
+	const double ha = 30 / RADIANS;			// half-angle of arc of arrow, in degrees
+	const double tana = tan(ha);			// tan of this angle
+	
+	XYPt mp = MidPoint(fromPt, toPt);		// midpoint of arrow line
+	XYPt mu = (toPt - fromPt);				// vector in direction of arrow line
+	XYPt mup = 0.5 * mu.Rotate90() / tana;	// vector from midpt to center of curvature
+	
+	// Compute the center of rotation. There are two possible choices.
+	// We'll want the bulge of the arc to always be toward the inside of the square,
+	// i.e., closer to the middle of the square, so we pick the value of the center
+	// that's farther away.
+	
+	XYPt sqmp = MidPoint(RefBase::paper.botLeft, RefBase::paper.topRight);
+	XYPt ctr1 = mp + mup;
+	XYPt ctr2 = mp - mup;
+	ctr = (ctr1 - sqmp).Mag() > (ctr2 - sqmp).Mag() ? ctr1 : ctr2;
+
+	// radius of the arc.
+
+	rad = (toPt - ctr).Mag();
+	
+	// Now compute the angles of the lines to the two points.
+	
+	XYPt fp = fromPt - ctr;
+	fromAngle = atan2(fp.y, fp.x);
+	XYPt tp = toPt - ctr;
+	toAngle = atan2(tp.y, tp.x);
+	
+	// Check direction of rotation.
+	
+	double ra = toAngle - fromAngle;	// rotation angle
+	while (ra < 0) ra += TWO_PI;		// get it into the right range
+	while (ra > TWO_PI) ra -= TWO_PI;	
+	ccw = (ra < PI);					// true == arc goes in ccw direction
+	
+	// Compute the size of the arrowheads
+	
+	ahSize = RefBase::paper.pWidth;
+	if (ahSize > RefBase::paper.pHeight) ahSize = RefBase::paper.pHeight;
+	ahSize *= 0.15;
+	double ah1 = 0.4 * (toPt - fromPt).Mag();
+	if (ahSize > ah1) ahSize = ah1;
+	
+	// Compute the direction vectors for the arrowheads
+	
+	mu.NormalizeSelf();
+	toDir = ccw ? mu.RotateCCW(ha) : mu.RotateCCW(-ha);
+	mu *= -1;
+	fromDir = ccw ? mu.RotateCCW(-ha) : mu.RotateCCW(ha);
+}
+
+
+/*****
+*
+*	RefDgmr::DrawValleyArrow(XYPt& fromPt, XYPt& toPt) - draw a valley-fold
+*	arrows. fromPt is the moving point, toPt is the destination.
+*
+*****/
+
+void RefDgmr::DrawValleyArrow(const XYPt& fromPt, const XYPt& toPt)
+{
+	XYPt ctr;
+	double rad;
+	double fromAngle;
+	double toAngle;
+	bool ccw;
+	double ahSize;
+	XYPt fromDir;
+	XYPt toDir;
+	CalcArrow(fromPt, toPt, ctr, rad, fromAngle, toAngle, ccw, ahSize, fromDir, toDir);
+	DrawArc(ctr, rad, fromAngle, toAngle, ccw, arrowLine);
+	DrawValleyArrowhead(toPt, toDir, ahSize);
+}
+
+
+/*****
+*
+*	RefDgmr::DrawMountainArrow(XYPt& fromPt, XYPt& toPt) - draw a mountain-fold
+*	arrows. fromPt is the moving point, toPt is the destination.
+*
+*****/
+
+void RefDgmr::DrawMountainArrow(const XYPt& fromPt, const XYPt& toPt)
+{
+	XYPt ctr;
+	double rad;
+	double fromAngle;
+	double toAngle;
+	bool ccw;
+	double ahSize;
+	XYPt fromDir;
+	XYPt toDir;
+	CalcArrow(fromPt, toPt, ctr, rad, fromAngle, toAngle, ccw, ahSize, fromDir, toDir);
+	DrawArc(ctr, rad, fromAngle, toAngle, ccw, arrowLine);
+	DrawMountainArrowhead(toPt, toDir, ahSize);
+}
+
+
+/*****
+*
+*	RefDgmr::DrawUnfoldArrow(XYPt& fromPt, XYPt& toPt) - draw a unfold
+*	arrows. fromPt is the moving point, toPt is the destination.
+*
+*****/
+
+void RefDgmr::DrawUnfoldArrow(const XYPt& fromPt, const XYPt& toPt)
+{
+	XYPt ctr;
+	double rad;
+	double fromAngle;
+	double toAngle;
+	bool ccw;
+	double ahSize;
+	XYPt fromDir;
+	XYPt toDir;
+	CalcArrow(fromPt, toPt, ctr, rad, fromAngle, toAngle, ccw, ahSize, fromDir, toDir);
+	DrawArc(ctr, rad, fromAngle, toAngle, ccw, arrowLine);
+	DrawUnfoldArrowhead(toPt, toDir, ahSize);
+}
+
+
+/*****
+*
+*	RefDgmr::DrawFoldAndUnfoldArrow(XYPt& fromPt, XYPt& toPt) - draw a fold-and-unfold
+*	arrows. fromPt is the moving point, toPt is the destination.
+*
+*****/
+
+void RefDgmr::DrawFoldAndUnfoldArrow(const XYPt& fromPt, const XYPt& toPt)
+{
+	XYPt ctr;
+	double rad;
+	double fromAngle;
+	double toAngle;
+	bool ccw;
+	double ahSize;
+	XYPt fromDir;
+	XYPt toDir;
+	CalcArrow(fromPt, toPt, ctr, rad, fromAngle, toAngle, ccw, ahSize, fromDir, toDir);
+	DrawArc(ctr, rad, fromAngle, toAngle, ccw, arrowLine);
+	DrawValleyArrowhead(toPt, toDir, ahSize);
+	DrawUnfoldArrowhead(fromPt, fromDir, ahSize);
+}
+
+
+/**********
+*
+*	class ConsoleTextDgmr - a minimal subclass of RefDgmr that puts verbal-only descriptions
+*	to the console.
+*
+**********/
+
+
+/*****
+*
+*	ConsoleTextDgmr::PutRefList(const R::bare_t& ar, vector<R*>& vr) - Write a list of 
+*	references to the console, along with their error and how-to description. 
+*	This template function is used in the mark- and line-specific routines that follow.
+*
+*****/
+
+template <class R>
+void ConsoleTextDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr)
+{
+	RefContext ac;
+	ac.clarifyVerbalAmbiguities = true;	// resolve all ambiguities with extra info
+	ac.axiomsInVerbalDirections = true;	// list the axioms with each alignment
+	
+	// Print out the distance error, rank, and instructions for each ref.
+	
+	cout << endl;
+	for (size_t i = 0; i < vr.size(); i++) {
+		vr[i]->PutDistanceAndRank(cout, ar);
+		cout << endl;
+		vr[i]->PutHowtoSequence(ac, cout);
+	};
+	cout << endl;
+}
+
+
+/*****
+*
+*	ConsoleTextDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl) - 
+*	write a list of lines to the console, including error and how-to description.
+*
+*****/
+
+void ConsoleTextDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl)
+{
+	PutRefList(ll, vl);
+}
+
+
+/*****
+*
+*	ConsoleTextDgmr::PutMarkList(const XYPt& pp, vector<RefMark*> vm) - 
+*	write a list of marks to the console, including error and how-to description.
+*
+*****/
+
+void ConsoleTextDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm)
+{
+	PutRefList(pp, vm);
+}
+
+
+/**********
+*
+*	class JSONLinesDgmr - a subclass of RefDgmr that puts one JSON object per line to a
+*	stream, for programs rather than people.
+*
+**********/
+
+/*****
+*
+*	JSONLinesDgmr::PutString(ostream& aos, const string& as) - put a string to a stream
+*	as a JSON string, quoted and escaped. Our strings are Latin-1, so bytes above 0x7f are
+*	escaped too, which keeps the output plain ASCII.
+*
+*****/
+
+void JSONLinesDgmr::PutString(ostream& aos, const string& as)
+{
+	aos << '"';
+	for (size_t i = 0; i < as.size(); i++) {
+		unsigned char c = as[i];
+		switch (c) {
+			case '"': aos << "\\\""; break;
+			case '\\': aos << "\\\\"; break;
+			case '\n': aos << "\\n"; break;
+			case '\t': aos << "\\t"; break;
+			default:
+				if (c < 0x20 || c >= 0x80) aos << "\\u00" << "0123456789abcdef"[c >> 4] << 
+					"0123456789abcdef"[c & 15];
+				else aos << c;
+		}
+	};
+	aos << '"';
+}
+
+
+/*****
+*
+*	JSONLinesDgmr::PutNumber(ostream& aos, double ad) - put ad as a JSON number, or as 
+*	null if it's NaN or infinite, which JSON has no way to write.
+*
+*****/
+
+void JSONLinesDgmr::PutNumber(ostream& aos, double ad)
+{
+	if (ad - ad != 0) aos << "null";	// true for NaN and both infinities
+	else aos << ad;
+}
+
+
+/*****
+*
+*	JSONLinesDgmr::PutBare(ostream& aos, const XYPt& ap), PutBare(ostream& aos, 
+*		const XYLine& al) - put a point as [x, y] and a line as {"u": [x, y], "d": d}. The
+*	overloads for a RefMark and a RefLine put the point or line that it represents.
+*
+*****/
+
+void JSONLinesDgmr::PutBare(ostream& aos, const XYPt& ap)
+{
+	aos << "[";
+	PutNumber(aos, ap.x);
+	aos << ",";
+	PutNumber(aos, ap.y);
+	aos << "]";
+}
+
+void JSONLinesDgmr::PutBare(ostream& aos, const XYLine& al)
+{
+	aos << "{\"u\":";
+	PutBare(aos, al.u);
+	aos << ",\"d\":";
+	PutNumber(aos, al.d);
+	aos << "}";
+}
+
+void JSONLinesDgmr::PutBare(ostream& aos, const RefMark* rm)
+{
+	PutBare(aos, rm->p);
+}
+
+void JSONLinesDgmr::PutBare(ostream& aos, const RefLine* rl)
+{
+	PutBare(aos, rl->l);
+}
+
+
+/*****
+*
+*	JSONLinesDgmr::PutRefList(const R::bare_t& ar, vector<R*>& vr, size_t ainput, 
+*		const string& aDiagrams, int apage) - put one line describing the refs vr found for
+*	target ar, which came from input number ainput. aDiagrams is the file with the 
+*	diagrams, if any, and apage the page of that file they start on, if it has several.
+*
+*****/
+
+template <class R>
+void JSONLinesDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr, size_t ainput,
+	const string& aDiagrams, int apage)
+{
+	RefContext ac;
+	ac.clarifyVerbalAmbiguities = true;	// resolve all ambiguities with extra info
+	ac.axiomsInVerbalDirections = true;	// list the axioms with each alignment
+	
+	ios_base::fmtflags oldFlags = os.flags();
+	streamsize oldPrecision = os.precision(10);
+	os.unsetf(ios_base::floatfield);
+	
+	os << "{\"input\":" << ainput << ",\"target\":";
+	PutBare(os, ar);
+	if (!aDiagrams.empty()) {
+		os << ",\"diagrams\":";
+		PutString(os, aDiagrams);
+		if (apage > 0) os << ",\"page\":" << apage;
+	};
+	os << ",\"results\":[";
+	bool first = true;
+	for (size_t i = 0; i < vr.size(); i++) {
+		if (!vr[i]) continue;
+		if (!first) os << ",";
+		first = false;
+		os << "{\"error\":";
+		PutNumber(os, vr[i]->Distance(ar));
+		os << ",\"rank\":" << vr[i]->mRank << ",\"ref\":";
+		PutBare(os, vr[i]);
+		
+		// The construction sequence, by name, and if asked, how to fold each step.
+		
+		vr[i]->BuildAndNumberSequence(ac);
+		os << ",\"sequence\":[";
+		for (size_t j = 0; j < ac.mSequence.size(); j++) {
+			ostringstream name;
+			ac.mSequence[j]->PutName(ac, name);
+			if (j > 0) os << ",";
+			PutString(os, name.str());
+		};
+		os << "]";
+		if (putHowto) {
+			os << ",\"howto\":[";
+			bool firstStep = true;
+			for (size_t j = 0; j < ac.mSequence.size(); j++) {
+				ostringstream step;
+				if (!ac.mSequence[j]->PutHowto(ac, step)) continue;
+				if (!firstStep) os << ",";
+				firstStep = false;
+				PutString(os, step.str() + ".");
+			};
+			os << "]";
+		};
+		os << "}";
+	};
+	os << "]}" << endl;
+	os.flags(oldFlags);
+	os.precision(oldPrecision);
+}
+
+
+/*****
+*
+*	JSONLinesDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm, size_t ainput, 
+*		const string& aDiagrams, int apage) - put a line describing the marks vm found
+*	for point pp.
+*
+*****/
+
+void JSONLinesDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm, size_t ainput, 
+	const string& aDiagrams, int apage)
+{
+	PutRefList(pp, vm, ainput, aDiagrams, apage);
+}
+
+
+/*****
+*
+*	JSONLinesDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl, size_t ainput, 
+*		const string& aDiagrams, int apage) - put a line describing the lines vl found
+*	for line ll.
+*
+*****/
+
+void JSONLinesDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl, size_t ainput, 
+	const string& aDiagrams, int apage)
+{
+	PutRefList(ll, vl, ainput, aDiagrams, apage);
+}
+
+
+/*****
+*
+*	JSONLinesDgmr::PutProblem(size_t ainput, const string& amsg) - put a line saying 
+*	that input number ainput couldn't be used, and why.
+*
+*****/
+
+void JSONLinesDgmr::PutProblem(size_t ainput, const string& amsg)
+{
+	os << "{\"input\":" << ainput << ",\"problem\":";
+	PutString(os, amsg);
+	os << "}" << endl;
+}
+
+
+/**********
+*
+*	PSDgmr - a specialization of RefDgmr that writes PostScript code for diagrams to a
+*	stream.
+*
+**********/
+
+/*	Notes on PostScript output.
+	The code is written a line at a time with "\n" rather than endl, so that it goes out
+	in large blocks instead of being flushed after every line.
+*/
+
+/*****
+*
+*	PSDgmr static member initialization
+*
+*****/
+
+double PSDgmr::usize = 64;		// 72 pts = 1 inch, 1 unit = 64 pts, fits 7 dgms
+const XYRect PSDgmr::pageSize(40, 40, 572, 752);	// printable area on the page
+
+
+/*****
+*
+*	PSDgmr::PSPt::PSPt(const PSDgmr& adgmr, const XYPt& aPt) - constructor for a 
+*	PostScript point, which scales the XYPt by usize and offsets it by the origin of adgmr.
+*
+*****/
+
+PSDgmr::PSPt::PSPt(const PSDgmr& adgmr, const XYPt& aPt) : 
+	px(adgmr.origin.x + usize * aPt.x), 
+	py(adgmr.origin.y + usize * aPt.y)
+{
+}
+
+
+/*****
+*
+*	operator<<(ostream& os, const PSPt& pp) - Stream output for a PostScript point
+*
+*****/
+
+ostream& operator<<(ostream& os, const PSDgmr::PSPt& pp)
+{
+	return os << pp.px << " " << pp.py;
+}
+
+
+/*****
+*
+*	PSDgmr::SetPointStyle(PointStyle pstyle) - set the current graphics state to the
+*	given PointStyle.
+*
+*****/
+
+void PSDgmr::SetPointStyle(PointStyle pstyle)
+{
+	switch (pstyle) {
+		case normalPt:
+			*psout << "1 setlinewidth 0 setgray " << "\n";
+			break;
+		case hilitePt:
+			*psout << "3 setlinewidth .5 .25 .25 setrgbcolor " << "\n";
+			break;
+		case actionPt:
+			*psout << "3 setlinewidth .5 0 0 setrgbcolor " << "\n";
+			break;
+	}
+}
+
+
+/*****
+*
+*	PSDgmr::SetLineStyle(LineStyle lstyle) - set the current graphics state to the
+*	given LineStyle
+*
+*****/
+
+void PSDgmr::SetLineStyle(LineStyle lstyle)
+{
+	switch (lstyle) {
+		case creaseLine:
+			*psout << "[] 0 setdash .20 setlinewidth 0 setgray " << "\n";
+			break;
+		case edgeLine:
+			*psout << "[] 0 setdash .5 setlinewidth 0 setgray " << "\n";
+			break;
+		case hiliteLine:
+			*psout << "[] 0 setdash 1 setlinewidth 1 .5 .5 setrgbcolor " << "\n";
+			break;
+		case valleyLine:
+			*psout << "[4 3] 0 setdash .5 setlinewidth 1 0 0 setrgbcolor " << "\n";
+			break;
+		case mountainLine:
+			*psout << "[3 3 0 3 0 3] 0 setdash .5 setlinewidth 1 0 0 setrgbcolor " << "\n";
+			break;
+		case arrowLine:
+			*psout << "[] 0 setdash .4 setlinewidth 0 .5 0 setrgbcolor " << "\n";
+			break;
+	}
+}
+
+
+/*****
+*
+*	PSDgmr::SetPolyStyle(PolyStyle pstyle) - set the current graphics state to the
+*	given PolyStyle
+*
+*****/
+
+void PSDgmr::SetPolyStyle(PolyStyle pstyle)
+{
+	switch (pstyle) {
+		case whitePoly:
+			*psout << ".95 .95 1 setrgbcolor " << "\n";
+			break;
+		case coloredPoly:
+			*psout << "0 0 .5 setrgbcolor " << "\n";
+			break;
+		case arrowPoly:
+			*psout << ".95 1 .95 setrgbcolor " << "\n";
+			break;
+	}
+}
+
+
+/*****
+*
+*	PSDgmr::SetLabelStyle(LabelStyle lstyle) - set the current graphics state to the
+*	given LabelStyle
+*
+*****/
+
+void PSDgmr::SetLabelStyle(LabelStyle lstyle)
+{
+	switch (lstyle) {
+		case normalLabel:
+			*psout << "0 setgray " << "\n";
+			break;
+		case hiliteLabel:
+			*psout << ".5 .25 .25 setrgbcolor " << "\n";
+			break;
+		case actionLabel:
+			*psout << ".5 0 0 setrgbcolor " << "\n";
+			break;
+	}
+}
+
+
+/*****
+*
+*	PSDgmr::DrawPt(const XYPt& aPt, PointStyle pstyle) - draw a PostScript
+*	point in the indicated style.
+*
+*****/
+
+void PSDgmr::DrawPt(const XYPt& aPt, PointStyle pstyle)
+{
+	SetPointStyle(pstyle);
+	*psout << "newpath " << PSPt(*this, aPt) << " moveto 0 0 rlineto stroke" << "\n";
+}
+
+
+/*****
+*
+*	PSDgmr::DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle) -
+*	Draw a PostScript line in the indicated style.
+*
+*****/
+
+void PSDgmr::DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle)
+{
+	SetLineStyle(lstyle);
+	*psout << "newpath " << PSPt(*this, fromPt) << " moveto " << PSPt(*this, toPt) << " lineto stroke" << "\n";
+}
+
+
+/*****
+*
+*	PSDgmr::DrawArc(const XYPt& ctr, const double rad, const double fromAngle,
+	const double toAngle, LineStyle lstyle) - draw a PostScript arc in the indicated style.
+*
+*****/
+
+void PSDgmr::DrawArc(const XYPt& ctr, const double rad, const double fromAngle,
+	const double toAngle, bool ccw, LineStyle lstyle)
+{
+	SetLineStyle(lstyle);
+	const double RADIANS = 57.29577951;
+	if (ccw)
+		*psout << "newpath " << PSPt(*this, ctr) << " " << rad * usize << " " << 
+		fromAngle * RADIANS << " " << toAngle * RADIANS  << " arc stroke" << "\n";
+	else
+		*psout << "newpath " << PSPt(*this, ctr) << " " << rad * usize << " " << 
+		fromAngle * RADIANS  << " " << toAngle * RADIANS  << " arcn stroke" << "\n";
+}
+
+
+/*****
+*
+*	PSDgmr::DrawPoly(const vector<XYPt>& poly, PolyStyle pstyle) -
+*	Fill and stroke the given poly in the indicated style.
+*
+*****/
+
+void PSDgmr::DrawPoly(const vector<XYPt>& poly, PolyStyle pstyle)
+{
+	*psout << "newpath " << PSPt(*this, poly[poly.size()-1]) << " moveto " << "\n";
+	for (size_t i = 0; i < poly.size(); i++)
+		*psout << PSPt(*this, poly[i]) << " lineto" << "\n";
+	*psout << "gsave " << "\n";
+
+	// Fill the poly
+	
+	SetPolyStyle(pstyle);
+	*psout << "fill grestore " << "\n";
+	
+	// Stroke the poly
+	
+	switch (pstyle) {
+		case whitePoly:
+		case coloredPoly:
+			SetLineStyle(edgeLine);
+			break;
+		case arrowPoly:
+			SetLineStyle(arrowLine);
+			break;
+	};
+	*psout << "stroke " << "\n";
+}
+
+
+/*****
+*
+*	PSDgmr::DrawLabel(const XYPt& aPt, const string& aString, labelStyle lstyle) -
+*	Draw a text label at the point aPt in the indicated style
+*
+*****/
+
+void PSDgmr::DrawLabel(const XYPt& aPt, const string& aString, LabelStyle lstyle)
+{
+	SetLabelStyle(lstyle);
+	*psout << PSPt(*this, aPt) << " moveto (" << aString << ") show " << "\n";
+}
+
+
+/*****
+*
+*	PSDgmr::DecrementOrigin(double d) - decrement the origin by a distance
+*	d. If we drop below the bottom margin, start a new page.
+*
+*****/
+
+void PSDgmr::DecrementOrigin(double d)
+{
+	origin.y -= d;
+	if (origin.y >= pageSize.bl.y) return;
+	*psout << "showpage" << "\n";
+	++pageNum;
+	*psout << "%%Page: " << pageNum << " " << pageNum << "\n";
+	origin.y = pageSize.tr.y - d;
+}
+
+	
+/*****
+*
+*	PSDgmr::PutProlog(ostream& os) - start a PostScript document, with no pages yet.
+*
+*****/
+
+void PSDgmr::PutProlog(ostream& os)
+{
+	// Put some comments so our readers are happy	
+	os << "%!PS-Adobe-1.0" << "\n";
+	os << "%%Pages: (atend)" << "\n";
+	os << "%%EndComments" << "\n";
+}
+
+
+/*****
+*
+*	PSDgmr::PutTrailer(ostream& os, int apages) - finish the last page and a document
+*	of apages pages.
+*
+*****/
+
+void PSDgmr::PutTrailer(ostream& os, int apages)
+{
+	os << "showpage" << "\n";
+	os << "%%Trailer" << "\n";
+	os << "%%Pages: " << apages << "\n";
+}
+
+
+/*****
+*
+*	PSDgmr::PutDiagram(RefContext& ac, const RefBase::DgmInfo& aDgm) - draw one diagram 
+*	of the sequence in ac with its lower left corner at the origin. Subclasses may 
+*	override this to reuse diagrams they have drawn before.
+*
+*****/
+
+void PSDgmr::PutDiagram(RefContext& ac, const RefBase::DgmInfo& aDgm)
+{
+	RefBase::DrawDiagram(ac, *this, aDgm);
+}
+
+
+/*****
+*
+*	PSDgmr::PutRefPages(const typename R::bare_t& ar, vector<R*>& vr) -
+*	Draw a set of marks or lines, starting on a new page, showing distance and rank for
+*	each sequence.
+*
+*****/
+
+template <class R>
+void PSDgmr::PutRefPages(const typename R::bare_t& ar, vector<R*>& vr)
+{
+	RefContext ac;
+	ac.clarifyVerbalAmbiguities = false;	// don't need extra info with diagrams
+	ac.axiomsInVerbalDirections = false;	// don't need axiom numbers
+
+	// Start a new page. DecrementOrigin will start more as needed
+	if (pageNum > 0) *psout << "showpage" << "\n";
+	pageNum++;
+	*psout << "%%Page: " << pageNum << " " << pageNum << "\n";
+	
+	// Put some initial setup information	
+	*psout << "1 setlinecap" << "\n";
+	*psout << "1 setlinejoin" << "\n";
+	
+	// Setup and draw a header.	
+	origin.x = pageSize.bl.x;
+	origin.y = pageSize.tr.y;
+	*psout << "/Times-Roman findfont 12 scalefont setfont" << "\n";
+	*psout << "0 setgray" << "\n";
+	DecrementOrigin(12);
+	DrawLabel(XYPt(0), "ReferenceFinder 3.1 by Robert J. Lang", normalLabel);
+	
+	// Note the point we're searching for.
+	*psout << "/Times-Roman findfont 9 scalefont setfont" << "\n";
+	DecrementOrigin(12);
+	stringstream targstr;
+	targstr << "Target: " << ar;
+	DrawLabel(XYPt(0), targstr.str(), normalLabel);
+	
+	// Go through our list and draw all the diagrams in a single row.	
+	for (size_t irow = 0; irow < vr.size(); irow++) {
+		DecrementOrigin(1.2 * usize * RefBase::paper.pHeight);
+		vr[irow]->BuildDiagrams(ac);
+		origin.x = pageSize.bl.x;
+		for (size_t icol = 0; icol < ac.mDgms.size(); icol++) {
+			PutDiagram(ac, ac.mDgms[icol]);
+			origin.x += 1.2 * RefBase::paper.pWidth * usize;
+		};
+		
+		// Also put the text description below the diagrams		
+		origin.x = pageSize.bl.x;
+		DecrementOrigin(11);
+		ostringstream sd;
+		vr[irow]->PutDistanceAndRank(sd, ar);
+		DrawLabel(XYPt(0), sd.str(), normalLabel);
+		for (size_t i = 0; i < ac.mSequence.size(); i++) {
+			origin.x = pageSize.bl.x;
+			ostringstream s;
+			if (ac.mSequence[i]->PutHowto(ac, s)) {
+				DecrementOrigin(11);
+				s << ".";
+				DrawLabel(XYPt(0), s.str(), normalLabel);
+			}
+		}
+	}
+}
+
+
+/**********
+*
+*	PSFileDgmr - a specialization of PSDgmr that writes a PostScript file of diagrams.
+*
+**********/
+
+/*****
+*
+*	PSFileDgmr static member initialization
+*
+*****/
+
+int PSFileDgmr::fileNum = 0;							// counter for output files
+#ifdef USE_PTHREADS
+static pthread_mutex_t sFileNumMutex = PTHREAD_MUTEX_INITIALIZER;	// guards fileNum
+#endif
+
+	
+/*****
+*
+*	PSFileDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr) -
+*	Draw a set of marks or lines to a PostScript file, showing distance and rank for
+*	each sequence.
+*
+*****/
+
+template <class R>
+void PSFileDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr)
+{
+	// Open a file for output. The file counter is shared, so other threads may be
+	// numbering files at the same time.
+#ifdef USE_PTHREADS
+	pthread_mutex_lock(&sFileNumMutex);
+#endif
+	int thisFileNum = ++fileNum;
+#ifdef USE_PTHREADS
+	pthread_mutex_unlock(&sFileNumMutex);
+#endif
+	stringstream filestr;
+	filestr << "ReferenceFinder_" << setw(3) << setfill('0') << thisFileNum << ".ps";
+	fileName = filestr.str();	// note filename for future reference
+	psfile.open(fileName.c_str(), ios::out | ios::trunc);
+	if (!psfile.good()) {
+		cout << "error opening file" << endl;
+		return;
+	};
+	psout = &psfile;
+	
+	// Write the diagrams and close the file.
+	PutProlog(psfile);
+	pageNum = 0;
+	PutRefPages(ar, vr);
+	PutTrailer(psfile, pageNum);
+	psfile.close();
+}
+
+
+/*****
+*
+*	PSFileDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm) -
+*	Write the PostScript code that draws folding sequences for a list of marks.
+*
+*****/
+
+void PSFileDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm)
+{
+	PutRefList(pp, vm);
+}
+
+
+/*****
+*
+*	PSFileDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl) -
+*	Write the PostScript code that draws folding sequences for a list of lines.
+*
+*****/
+
+void PSFileDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl)
+{
+	PutRefList(ll, vl);
+}
+
+
+/**********
+*
+*	PSDocumentDgmr - a specialization of PSDgmr that collects the diagrams for many 
+*	targets into one PostScript document in memory.
+*
+**********/
+
+/*	Notes on the diagram cache.
+	A diagram shows the first iact + 1 refs of the sequence of the ref being described, 
+	and what it shows depends only on them: the labels are numbered in the order of the 
+	sequence, and idef and the highlighting follow from which refs are action lines and 
+	which ones the action line uses. The sequence of a ref starts with the sequences of 
+	the refs it's made from, so every ref made from, say, a popular rank-2 line starts 
+	with the same diagrams. We draw each diagram once with the origin at its lower left 
+	corner, keep the code under the refs it shows, and place it with a translation each
+	time it turns up. The code of each diagram is bracketed by gsave and grestore, which
+	leaves the graphics state as it was for whatever comes after.
+*/
+
+/*****
+*
+*	PSDocumentDgmr static member initialization
+*
+*****/
+
+size_t PSDocumentDgmr::maxCacheBytes = 64 * 1048576;	// past this, draw every time
+
+
+/*****
+*
+*	PSDocumentDgmr::PSDocumentDgmr() - constructor, starts an empty document.
+*
+*****/
+
+PSDocumentDgmr::PSDocumentDgmr() : 
+	mCacheBytes(0), 
+	mHits(0), 
+	mMisses(0)
+{
+	psout = &mBody;
+}
+
+
+/*****
+*
+*	PSDocumentDgmr::PutDiagram(RefContext& ac, const RefBase::DgmInfo& aDgm) - put one 
+*	diagram at the origin, drawing it only if it isn't in the cache already.
+*
+*****/
+
+void PSDocumentDgmr::PutDiagram(RefContext& ac, const RefBase::DgmInfo& aDgm)
+{
+	dgmkey_t key(ac.mSequence.begin(), ac.mSequence.begin() + aDgm.iact + 1);
+	map<dgmkey_t, string>::iterator it = mCache.find(key);
+	string drawn;
+	if (it != mCache.end()) mHits++;
+	else {
+		mMisses++;
+		ostringstream dgmout;
+		XYPt oldOrigin = origin;
+		origin = XYPt(0);
+		psout = &dgmout;
+		PSDgmr::PutDiagram(ac, aDgm);
+		psout = &mBody;
+		origin = oldOrigin;
+		drawn = dgmout.str();
+		if (mCacheBytes + drawn.size() <= maxCacheBytes) {
+			it = mCache.insert(make_pair(key, drawn)).first;
+			mCacheBytes += drawn.size();
+		}
+	};
+	mBody << "gsave " << origin.x << " " << origin.y << " translate" << "\n";
+	mBody << (it != mCache.end() ? it->second : drawn);
+	mBody << "grestore" << "\n";
+}
+
+
+/*****
+*
+*	PSDocumentDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr) - add the 
+*	pages for a list of marks or lines to the document. Return the number of the first.
+*
+*****/
+
+template <class R>
+int PSDocumentDgmr::PutRefList(const typename R::bare_t& ar, vector<R*>& vr)
+{
+	int firstPage = pageNum + 1;
+	PutRefPages(ar, vr);
+	return firstPage;
+}
+
+
+/*****
+*
+*	PSDocumentDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm) - add the 
+*	diagrams for a list of marks to the document. Return the page they start on.
+*
+*****/
+
+int PSDocumentDgmr::PutMarkList(const XYPt& pp, vector<RefMark*>& vm)
+{
+	return PutRefList(pp, vm);
+}
+
+
+/*****
+*
+*	PSDocumentDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl) - add the 
+*	diagrams for a list of lines to the document. Return the page they start on.
+*
+*****/
+
+int PSDocumentDgmr::PutLineList(const XYLine& ll, vector<RefLine*>& vl)
+{
+	return PutRefList(ll, vl);
+}
+
+
+/*****
+*
+*	PSDocumentDgmr::Document() - return the whole document: the prolog, the pages added
+*	so far, and the trailer. An empty document has no pages and no trailer.
+*
+*****/
+
+string PSDocumentDgmr::Document() const
+{
+	ostringstream doc;
+	PutProlog(doc);
+	if (pageNum > 0) {
+		doc << mBody.str();
+		PutTrailer(doc, pageNum);
+	};
+	return doc.str();
+}
+
+
+/*****
+*
+*	PSDocumentDgmr::WriteDocument(const string& aName) - write the whole document to the 
+*	file aName in a single write. Return false if that didn't work.
+*
+*****/
+
+bool PSDocumentDgmr::WriteDocument(const string& aName) const
+{
+	string doc = Document();
+	ofstream docfile(aName.c_str(), ios::out | ios::trunc | ios::binary);
+	if (!docfile.good()) return false;
+	docfile.write(doc.data(), streamsize(doc.size()));
+	docfile.close();
+	return !docfile.fail();
+}
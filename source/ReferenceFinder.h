@@ -1 +1,1867 @@
-/******************************************************************************	ReferenceFinder - a program for finding compact folding sequences for locating 	approximate reference points on a unit square.		Version 3.1		Copyright 1999-2003 by Robert J. Lang. All rights reserved.		Rights of usage: you may compile this code and modifications thereof for your 	own personal use. You may not redistribute this code or modifications thereof.		ReferenceFinder is ANSI C++ code that should compile for any compiler/platform	that supports the C++ standard library.		After the program initializes, the user is prompted for x and y coordinates of	a desired point or line. The program responds with several folding sequences based on 	lines and marks made by folding (no measuring).		See file "README.txt" for version history and compilation notes.******************************************************************************/ #ifndef _REFERENCEFINDER_H_#define _REFERENCEFINDER_H_#include <iostream>#include <vector>#include <map>#include <string>#include <cmath>#include <fstream>/********************************************************************************	Section 1: lightweight classes that represent points and lines**	These are mostly defined in the header to give the compiler a chance to *	inline them.*******************************************************************************/// global stuffconst double EPS = 1.0e-8;		// used for equality of XYPts and parallelness of XYLines/************	XYPt - a 2-vector that represents a point or a direction.***********/class XYPt {	public:		double x;	// x coordinate		double y;	// y coordinate				// Constructor				XYPt(double xx = 0, double yy = 0) : x(xx), y(yy) {};				// Arithmetic with XYPts and scalars				const XYPt operator+(const XYPt& p) const {return XYPt(x + p.x, y + p.y);};		const XYPt operator-(const XYPt& p) const {return XYPt(x - p.x, y - p.y);};		const XYPt operator*(const XYPt& p) const {return XYPt(x * p.x, y * p.y);};		const XYPt operator/(const XYPt& p) const {return XYPt(x / p.x, y / p.y);};				const XYPt operator+(double z) const {return XYPt(x + z, y + z);};		const XYPt operator-(double z) const {return XYPt(x - z, y - z);};		const XYPt operator*(double z) const {return XYPt(x * z, y * z);};		const XYPt operator/(double z) const {return XYPt(x / z, y / z);};				friend const XYPt operator+(const double d, const XYPt& pp) {			return XYPt(d + pp.x, d + pp.y);};		friend const XYPt operator-(const double d, const XYPt& pp) {			return XYPt(d - pp.x, d - pp.y);};		friend const XYPt operator*(const double d, const XYPt& pp) {			return XYPt(d * pp.x, d * pp.y);};		friend const XYPt operator/(const double d, const XYPt& pp) {			return XYPt(d / pp.x, d / pp.y);};				XYPt& operator+=(const XYPt& p) {x += p.x; y += p.y; return (*this);};		XYPt& operator-=(const XYPt& p) {x -= p.x; y -= p.y; return (*this);};		XYPt& operator*=(const XYPt& p) {x *= p.x; y *= p.y; return (*this);};		XYPt& operator/=(const XYPt& p) {x /= p.x; y /= p.y; return (*this);};		XYPt& operator+=(double z) {x += z; y += z; return (*this);};		XYPt& operator-=(double z) {x -= z; y -= z; return (*this);};		XYPt& operator*=(double z) {x *= z; y *= z; return (*this);};		XYPt& operator/=(double z) {x /= z; y /= z; return (*this);};		// Counterclockwise rotation				const XYPt Rotate90() const {return XYPt(-y, x);};		const XYPt RotateCCW(const double a) const {	// a is in radians			double sa = std::sin(a);			double ca = std::cos(a);			return XYPt(ca * x - sa * y, sa * x + ca * y);};				// Scalar products and norms					const double Dot(const XYPt& p) const {return x * p.x + y * p.y;};		const double Mag2() const {return x * x + y * y;};		const double Mag() const {return std::sqrt(x * x + y * y);};		const XYPt Normalize() const {double m = Mag(); return XYPt(x / m, y / m);};		XYPt& NormalizeSelf() {double m = Mag(); x /= m; y /= m; return *this;};				// Other common functions				friend const XYPt MidPoint(const XYPt& p1, const XYPt& p2) {			return XYPt(0.5 * (p1.x + p2.x), 0.5 * (p1.y + p2.y));};				// Chop() makes numbers close to zero equal to zero.				const XYPt Chop() const {return XYPt(std::abs(x) < EPS ? 0 : x, std::abs(y) < EPS ? 0 : y);};		XYPt& ChopSelf() {			if (std::abs(x) < EPS) x = 0; 			if (std::abs(y) < EPS) y = 0; return *this;};				// Comparison				const bool operator==(const XYPt& p) const {return (*this - p).Mag() < EPS;};				// Stream I/O				friend std::ostream& operator<<(std::ostream& os, const XYPt& p);};/************	XYLine - a class for representing a line by a scalar and the normal to the line.***********/class XYLine {	public:		double d;	// d*u is the point on the line closest to the origin		XYPt u;		// a unit normal vector to the line				// Constructors				XYLine(double dd = 0, const XYPt& uu = XYPt(1, 0)) : d(dd), u(uu) {};				XYLine(const XYPt& p1, const XYPt& p2) {			// line through two points			u = (p2 - p1).Normalize().Rotate90();			d = p1.Dot(u);};				XYPt Fold(const XYPt& p1) const {					// Fold a point about the line			return p1 + 2 * (d - (p1.Dot(u))) * u;};				const bool IsParallelTo(const XYLine& ll) const {			// true if lines are parallel			return std::abs(u.Dot(ll.u.Rotate90())) < EPS;};				const bool operator==(const XYLine& ll) const {			// true if lines are same			return (std::abs(d - ll.d * u.Dot(ll.u)) < EPS) && 				(std::abs(u.Dot(ll.u.Rotate90())) < EPS);};					const bool Intersects(const XYPt& pp) const {				// true if pt on line			return (std::abs(d - pp.Dot(u)) < EPS);};					const bool Intersects(const XYLine& ll, XYPt& pp) const {	// true if lines intersect,			double denom = u.x * ll.u.y - u.y * ll.u.x;		// intersection goes in pp			if (std::abs(denom) < EPS) return false;			pp.x = (d * ll.u.y - ll.d * u.y) / denom;			pp.y = (ll.d * u.x - d * ll.u.x) / denom;			return true;};					// Intersection() just returns the intersection point, no error checking		// for parallel-ness. Use Intersects() when in doubt.				friend const XYPt Intersection(const XYLine& l1, const XYLine& l2) {			double denom = l1.u.x * l2.u.y - l1.u.y * l2.u.x;			return XYPt((l1.d * l2.u.y - l2.d * l1.u.y) / denom, 				(l2.d * l1.u.x - l1.d * l2.u.x) / denom);};		// Stream I/O				friend std::ostream& operator<<(std::ostream& os, const XYLine& l);};				/************	XYRect - a class for representing rectangles by two points, the bottom left and*	top right corners.***********/class XYRect {	public:		XYPt bl;	// bottom left corner		XYPt tr;	// top right corner				// Constructors				XYRect(const XYPt& ap) : bl(ap), tr(ap) {};		XYRect(const XYPt& abl, const XYPt& atr) : bl(abl), tr(atr) {};		XYRect(double ablx, double ably, double atrx, double atry) : 			bl(ablx, ably), tr(atrx, atry) {};					// Dimensional queries				const double GetWidth() const {return tr.x - bl.x;};		const double GetHeight() const {return tr.y - bl.y;};		const double GetAspectRatio() const;				// IsValid() returns true if bl is below and to the left of tr				const bool IsValid() const {return (bl.x <= tr.x) && (bl.y <= tr.y);};				// IsEmpty() returns true if the rectangle is a line or point				const bool IsEmpty() const {			return (std::abs(bl.x - tr.x) < EPS) || (std::abs(bl.y - tr.y) < EPS);};				// Encloses(p) returns true if pt falls within this rectangle, padded by EPS		// Encloses(p1, p2) returns true if both pts fall within the rectangle.				const bool Encloses(const XYPt& ap) const {			return (ap.x >= bl.x - EPS) && (ap.x <= tr.x + EPS) &&			(ap.y >= bl.y - EPS) && (ap.y <= tr.y + EPS);};					const bool Encloses(const XYPt& ap1, XYPt& ap2) const {			return Encloses(ap1) && Encloses(ap2);};					// Include(p) stretches the coordinates so that this rect encloses the point.		// Returns a reference so multiple calls can be chained.				XYRect& Include(const XYPt& p);				// The various incarnations of BoundingBox() return an XYRect that encloses		// all of the points passed as parameters.				friend const XYRect BoundingBox(const XYPt& p1, const XYPt& p2);		friend const XYRect BoundingBox(const XYPt& p1, const XYPt& p2, const XYPt& p3);		// Stream I/O				friend std::ostream& operator<<(std::ostream& os, const XYRect& r);};/********************************************************************************	Section 2: classes that represent reference marks and reference lines on a *	rectangular piece of paper.*******************************************************************************//************	Paper - specialization of XYRect for representing the paper***********/class Paper : public XYRect {	public:		double pWidth;				// width of the paper		double pHeight;				// height of the paper		XYPt botLeft;				// only used by MakeAllMarksAndLines		XYPt botRight;				// ditto		XYPt topLeft;				// ditto		XYPt topRight;				// ditto		XYLine topEdge;				// used by InteriorOverlaps() and MakeAllMarksAndLines		XYLine leftEdge;			// ditto		XYLine rightEdge;			// ditto		XYLine bottomEdge;			// ditto		XYLine upwardDiagonal;		// only used by MakeAllMarksAndLines		XYLine downwardDiagonal;	// ditto			public:			Paper(double aWidth, double aHeight);				const bool ClipLine(const XYLine& al, XYPt& ap1, XYPt& ap2) const;		const bool InteriorOverlaps(const XYLine& al) const;		const bool MakesSkinnyFlap(const XYLine& al) const;				void DrawSelf();};/************	RefBase - base class for a mark or line. ***********/class RefDgmr;	// forward declaration, see Section 5 belowclass RefBase {	public:		typedef unsigned short rank_t;		// type for ranks		rank_t mRank;						// rank of this mark or line		typedef int key_t;					// key type (compiler-dependent, depending on max int)		key_t mKey;							// key used for maps within RefContainers		static Paper paper;					// the paper		static std::vector<RefBase*> mSequence;	// a sequence of refs that fully define a ref		class DgmInfo {						// information that encodes a diagram description			public:				std::size_t idef;			// first ref that's defined in this diagram				std::size_t iact;			// ref that terminates this diagram				DgmInfo(std::size_t adef, std::size_t aact) : 					idef(adef), iact(aact) {};		};		static std::vector<DgmInfo> mDgms;	// a list of diagrams that describe a given ref	protected:		typedef short index_t;				// type for indices		index_t mIndex;						// used to label this ref in a folding sequence		static RefDgmr* mDgmr;				// object that draws diagrams		static bool clarifyVerbalAmbiguities;// true = clarify ambiguous verbal instructions		static bool axiomsInVerbalDirections;// true = list the axiom number in verbal instructions		enum {linePass, hlinePass, pointPass, arrowPass, labelPass, maxPasses}; // drawing order			public:		RefBase(rank_t arank = 0) : mRank(arank), mKey(0), mIndex(0) {};				virtual ~RefBase() {};		// routines for building a sequence of refs				virtual void SequencePushSelf();		void BuildAndNumberSequence();				// routine for creating a text description of how to fold a ref				static void SetClarifyVerbalAmbiguities(const bool f);		static void SetAxiomsInVerbalDirections(const bool f);		virtual const char GetLabel() const = 0;		virtual const bool PutName(std::ostream& os) const = 0;		virtual const bool PutHowto(std::ostream& os) const;		std::ostream& PutHowtoSequence(std::ostream& os);				// routines for drawing diagrams				void BuildDiagrams();		static void DrawPaper();		static void DrawDiagram(RefDgmr& aDgmr, const DgmInfo& aDgm);		static void PutDiagramCaption(std::ostream& os, const DgmInfo& aDgm);	protected:		virtual const bool UsesImmediate(RefBase* rb) const;		virtual const bool IsActionLine() const = 0;		virtual const bool IsDerived() const;		virtual void SetIndex() = 0;		static void SequencePushUnique(RefBase* rb);		enum RefStyle {normalRef, hiliteRef, actionRef};		virtual void DrawSelf(RefStyle rstyle, short ipass) const = 0;};/************	RefMark - base class for a mark on the paper. ***********/class RefMark : public RefBase {	public:		typedef XYPt bare_t;		// type of bare object a RefMark represents		bare_t p;					// coordinates of the mark	private:		static int xNum;			// discretization in x-direction, used to calculate mKey		static int yNum;			// discretization in y-direction		static index_t mCount;		// class index, used for numbering sequences of marks		static char mLabels[];		// labels for marks, indexed by mCount	public:		RefMark(rank_t arank) : RefBase(arank) {};		RefMark(const XYPt& ap, rank_t arank) : RefBase(arank), p(ap) {};				void FinishConstructor();				const double Distance(const XYPt& ap) const;		const bool IsOnEdge() const;				const bool IsActionLine() const;		static const bool KeySizeOK();		const char GetLabel() const;		const bool PutName(std::ostream& os) const;		void PutDistanceAndRank(std::ostream& os, const XYPt& ap) const;		void DrawSelf(RefStyle rstyle, short ipass) const;	protected:		static rank_t CalcMarkRank(const RefBase* ar1, const RefBase* ar2) {			return ar1->mRank + ar2->mRank;};		void SetIndex();		private:		static void ResetCount();		friend class RefBase;};/************	RefMark_Original - Specialization of RefMark that represents a named mark*	(like a corner).***********/class RefMark_Original : public RefMark {	private:		std::string s;	// name of the mark			public:		RefMark_Original(const XYPt& ap, rank_t arank, std::string as);		const char GetLabel() const;		const bool PutName(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;			protected:		virtual const bool IsDerived() const;		void SetIndex();};/************	RefMark_Intersection - Specialization of a RefMark for a mark defined by the *	intersection of 2 lines.***********/class RefLine;	// forward declaration needed by RefMark_Intersectionclass RefMark_Intersection : public RefMark {	public:		RefLine* rl1;		// first line		RefLine* rl2;		// second line				RefMark_Intersection(RefLine* al1, RefLine* al2);		const bool UsesImmediate(RefBase* rb) const;		void SequencePushSelf();					const bool PutHowto(std::ostream& os) const;		static void MakeAll(rank_t arank);};/************	RefLine - base class for a reference line. ***********/class RefLine : public RefBase {	public:			typedef XYLine bare_t;		// type of bare object that a RefLine represents		bare_t l;					// the line this contains	private:		static int aNum;			// discretization in angle, used to calculate mKey		static int dNum;			// discretization in distance from origin, used for mKey		static index_t mCount;		// class index, used for numbering sequences of lines		static char mLabels[];		// labels for lines, indexed by mCount		public:		RefLine(rank_t arank) : RefBase(arank) {};		RefLine(const XYLine& al, rank_t arank) : RefBase(arank), l(al) {};		void FinishConstructor();		const double Distance(const XYLine& al) const;		const bool IsOnEdge() const;		const bool IsActionLine() const;		static const bool KeySizeOK();		const char GetLabel() const;		const bool PutName(std::ostream& os) const;		void PutDistanceAndRank(std::ostream& os, const XYLine& al) const;		void DrawSelf(RefStyle rstyle, short ipass) const;			protected:		static rank_t CalcLineRank(const RefBase* ar1, const RefBase* ar2) {			return 1 + ar1->mRank + ar2->mRank;};				static rank_t CalcLineRank(const RefBase* ar1, const RefBase* ar2, 			const RefBase* ar3) {return 1 + ar1->mRank + ar2->mRank + ar3->mRank;};				static rank_t CalcLineRank(const RefBase* ar1, const RefBase* ar2, 			const RefBase* ar3, const RefBase* ar4) {			return 1 + ar1->mRank + ar2->mRank + ar3->mRank + ar4->mRank;};		void SetIndex();		private:		static void ResetCount();		friend class RefBase;};/************	RefLine_Original - Specialization of RefLine that represents a line that is the *	edge of the paper or an initial crease (like the diagonal).***********/class RefLine_Original : public RefLine {	private:		std::string s;	// name of the line			public:		RefLine_Original(const XYLine& al, rank_t arank, std::string as);		const bool IsActionLine() const;		const char GetLabel() const;		const bool PutName(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;	protected:		virtual const bool IsDerived() const;		void SetIndex();};/************	RefLine_C2P_C2P - Huzita-Hatori Axiom O1**	Make a crease through two points p1 and p2.***********/class RefLine_C2P_C2P : public RefLine {	public:		RefMark* rm1;				// make a crease from one mark...		RefMark* rm2;				// to another mark		static bool include;		// use this class of RefLine?				RefLine_C2P_C2P(RefMark* arm1, RefMark* arm2);		const bool UsesImmediate(RefBase* rb) const;		void SequencePushSelf();		const bool PutHowto(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;		static void MakeAll(rank_t arank);};/************	RefLine_P2P - Huzita-Hatori Axiom O2**	Bring p1 to p2.***********/class RefLine_P2P : public RefLine {	public:		RefMark* rm1;				// bring one mark...		RefMark* rm2;				// to another mark, and form a crease.		static bool include;		// Use this class of RefLine?			private:		enum WhoMoves {			p1Moves,			p2Moves		};			WhoMoves whoMoves;	public:		RefLine_P2P(RefMark* arm1, RefMark* arm2);				const bool UsesImmediate(RefBase* rb) const;		void SequencePushSelf();		const bool PutHowto(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;		static void MakeAll(rank_t arank);};/************	RefLine_L2L - Huzita-Hatori Axiom O3**	Bring line l1 to line l2.***********/class RefLine_L2L : public RefLine {	public:		RefLine* rl1;				// make a crease by bringing one line...		RefLine* rl2;				// to another line		static bool include;		// Use this class of RefLine?			private:		enum WhoMoves {			l1Moves,			l2Moves		};			WhoMoves whoMoves;	public:			RefLine_L2L(RefLine* arl1, RefLine* arl2, short iroot);				const bool UsesImmediate(RefBase* rb) const;		void SequencePushSelf();		const bool PutHowto(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;		static void MakeAll(rank_t arank);};/************	RefLine_L2L_C2P - Huzita-Hatori Axiom O4.**	Bring line l1 to itself so that the crease passes through point p1.***********/class RefLine_L2L_C2P : public RefLine {	public:		RefLine* rl1;				// bring line l1 to itself		RefMark* rm1;				// so that the crease runs through another point.		static bool include;		// Use this class of RefLine?				RefLine_L2L_C2P(RefLine* arl1, RefMark* arm1);				const bool UsesImmediate(RefBase* rb) const;		void SequencePushSelf();		const bool PutHowto(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;		static void MakeAll(rank_t arank);};/************	RefLine_P2L_C2P - Huzita-Hatori Axiom O5.**	Bring point p1 to line l1 so that the crease passes through point p2.***********/class RefLine_P2L_C2P : public RefLine {	public:		RefMark* rm1;				// bring a point...		RefLine* rl1;				// to a line...		RefMark* rm2;				// so that the crease runs through another point.		static bool include;		// Use this class of RefLine?			private:		enum WhoMoves {			p1Moves,			l1Moves		};			WhoMoves whoMoves;			public:		RefLine_P2L_C2P(RefMark* arm1, RefLine* arl1, RefMark* arm2, short iroot);				const bool UsesImmediate(RefBase* rb) const;		void SequencePushSelf();		const bool PutHowto(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;		static void MakeAll(rank_t arank);};/************	RefLine_P2L_P2L - Huzita-Hatori Axiom O6 (the cubic!)**	Bring point p1 to line l1 and point p2 to line l2***********/class RefLine_P2L_P2L : public RefLine {	public:		RefMark* rm1;				// bring a point...		RefLine* rl1;				// to a line...		RefMark* rm2;				// and another point...		RefLine* rl2;				// to another line.		static bool include;		// Use this class of RefLine?		private:		static short order;			// the order of the equation		static short irootMax;		// maximum value of iroot, = ((# of roots) - 1)		static double q1;			// used for quadratic equation solutions		static double q2;				static double S;			// used for cubic equation solutions		static double Sr;		static double Si;		static double U;				enum WhoMoves {			p1p2Moves,			l1l2Moves,			p1l2Moves,			p2l1Moves		};			WhoMoves whoMoves;			public:				RefLine_P2L_P2L(RefMark* arm1, RefLine* arl1, RefMark* arm2, RefLine* arl2, short iroot);				const bool UsesImmediate(RefBase* rb) const;		void SequencePushSelf();		const bool PutHowto(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;		static void MakeAll(rank_t arank);};/************	RefLine_L2L_P2L - Huzita-Hatori Axiom O7 (Hatori's Axiom).**	Bring line l1 to itself so that the point p1 goes on line l2.***********/class RefLine_L2L_P2L : public RefLine {	public:		RefLine* rl1;				// bring line l1 onto itself		RefMark* rm1;				// so that point p1		RefLine* rl2;				// falls on line l2.		static bool include;	// Use this class of RefLine?	private:		enum WhoMoves {			p1Moves,			l1Moves		};			WhoMoves whoMoves;			public:		RefLine_L2L_P2L(RefLine* arl1, RefMark* arm1, RefLine* arl2);				const bool UsesImmediate(RefBase* rb) const;		void SequencePushSelf();		const bool PutHowto(std::ostream& os) const;		void DrawSelf(RefStyle rstyle, short ipass) const;		static void MakeAll(rank_t arank);};/********************************************************************************	Section 3: container for collections of marks and lines and their construction*******************************************************************************//************	class RefContainer - Container for marks and lines.***********/template<class R>class RefContainer : public std::vector<R*> {	public:		typedef std::map<typename R::key_t, R*> map_t;	// typedef for map holding R*		std::vector<map_t> maps;			// Holds maps of objects, one for each rank		std::size_t rcsz;					// current number of elements in the rank maps		map_t buffer;						// used to accumulate new objects		std::size_t rcbz;					// current size of buffer		typedef typename map_t::iterator rank_iterator;	// for iterating through individual ranks			public:		std::size_t TotalSize() const;			// Total number of elements, all ranks		template <class Rs>		void AddCopyIfValidAndUnique(const Rs& ars);	// add a copy of ars if valid and unique	private:		friend class ReferenceFinder;		// only class that gets to use these methods		RefContainer();						// Constructor		void Reinitialize();				// Re-initialize with new values		bool Contains(const R* ar) const;	// True if an equivalent element already exists		void Add(R* ar);					// Add an element to the array		void FlushBuffer();					// Add the contents of the buffer to the container		void ClearMaps();					// Clear the map arrays when no longer needed};/********************************************************************************	Section 4: routines for searching for marks and lines and collecting statistics*******************************************************************************//************	CompareError - function object for comparing two refs of class R according to their *	distance from a target value of class X.***********/template <class R>class CompareError {	private:		typename R::bare_t b;	// point that we're comparing to			public:		CompareError(const typename R::bare_t& ab) : b(ab) {};		bool operator()(R* rb1, R* rb2) const;};/************	CompareRankAndError - function object for comparing two refs of class R according to their *	distance from a target value of class X, but for close points, letting rank win out***********/template <class R>class CompareRankAndError {	private:		typename R::bare_t b;	// point that we're comparing to	public:		CompareRankAndError(const typename R::bare_t& ab) : b(ab) {};		bool operator()(R* rb1, R* rb2) const;};/************	ReferenceFinder - object that builds and maintains collections of marks and lines and*	can search throught the collection for marks and lines close to a target mark or line.***********/class ReferenceFinder {	public:		typedef RefBase::rank_t rank_t;		// we use ranks, too		static bool visibilityMatters;		// restrict to what can be made w/ opaque paper		static rank_t maxRank;				// maximum rank to create		static std::size_t maxLines;		// maximum number of lines to create		static std::size_t maxMarks;		// maximum number of marks to create		static double maxError;				// tolerable error in a mark or line		static double minAspectRatio;		// minimum aspect ratio for a triangular flap		static double minAngleSine;			// minimum line intersection for defining a mark		static RefContainer<RefLine> basisLines;	// all lines		static RefContainer<RefMark> basisMarks;	// all marks		static int maxTries;				// number of attempts when it's time to show progress	private:		static int numTries;				// number of attempts since last callback		// Stuff that implements a callback function to show progress during initialization			public:		enum ProgressMsg {msgInitializing, msgWorking, msgRankCompleted, msgInitialized};		typedef void (*ProgressFn)(ProgressMsg pmsg, rank_t arank = 0, void*p = 0);		static void *pShowProgressData;		static void SetShowProgress(ProgressFn apfn, void *p =0);	// install a callback function	private:		static void ConsoleShowProgress(ProgressMsg pmsg, rank_t arank = 0, void* =0);	// default function		static void OccasionalShowProgress();			// called by RefContainer<>		static ProgressFn pShowProgress;				// the show-progress function callback				friend class RefContainer<RefLine>;				// gets to call OccasionalShowProgress()		friend class RefContainer<RefMark>;				// ditto				// Creation of all marks and lines			private:		static void MakeAllMarksAndLinesOfRank(rank_t arank);	public:		static void MakeAllMarksAndLines();				// An example that tests axiom O6.		static void MesserCubeRoot();		// Functions for searching for the best marks and/or lines		static void FindBestMarks(const XYPt& ap, std::vector<RefMark*>& vm, short numMarks);		static void FindBestLines(const XYLine& al, std::vector<RefLine*>& vl, short numLines);		// Utility routines for validating user input						static bool ValidateMark(const XYPt& ap);		static bool ValidateLine(const XYPt& ap1, const XYPt& ap2);		// Utility routine for calculating statistics on marks		static void CalcStatistics();};/********************************************************************************	Section 5: Routines for drawing diagrams*******************************************************************************//************	RefDgmr - object that draws folding diagrams of references. Subclasses specialize*	to particular drawing environments (print vs screen, multiple GUIs, platform-specific*	drawing models, etc.***********/class RefDgmr {	public:		RefDgmr() {};		virtual ~RefDgmr() {};		// Subclasses must override these methods				enum PointStyle {normalPt, hilitePt, actionPt};		virtual void DrawPt(const XYPt& aPt, PointStyle pstyle);		enum LineStyle {creaseLine, edgeLine, hiliteLine, valleyLine, mountainLine, arrowLine};		virtual void DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle);		virtual void DrawArc(const XYPt& ctr, const double rad, const double fromAngle,			const double toAngle, const bool ccw, LineStyle lstyle);				enum PolyStyle {whitePoly, coloredPoly, arrowPoly};		virtual void DrawPoly(const std::vector<XYPt>& poly, PolyStyle pstyle);				enum LabelStyle {normalLabel, hiliteLabel, actionLabel};		virtual void DrawLabel(const XYPt& aPt, const std::string& aString, LabelStyle lstyle);				// Subclasses may use or override these methods		virtual void CalcArrow(const XYPt& fromPt, const XYPt& toPt,			XYPt& ctr, double& rad, double& fromAngle, double& toAngle, bool& ccw,			double& ahSize, XYPt& fromDir, XYPt& toDir);		virtual void DrawValleyArrowhead(const XYPt& loc, const XYPt& dir, const double len);		virtual void DrawMountainArrowhead(const XYPt& loc, const XYPt& dir, const double len);		virtual void DrawUnfoldArrowhead(const XYPt& loc, const XYPt& dir, const double len);		virtual void DrawValleyArrow(const XYPt& fromPt, const XYPt& toPt);		virtual void DrawMountainArrow(const XYPt& fromPt, const XYPt& toPt);		virtual void DrawUnfoldArrow(const XYPt& fromPt, const XYPt& toPt);		virtual void DrawFoldAndUnfoldArrow(const XYPt& fromPt, const XYPt& toPt);};/************	class ConsoleTextDgmr - a minimal subclass of RefDgmr that puts verbal-only descriptions*	to the console.***********/class ConsoleTextDgmr : public RefDgmr {	public:		ConsoleTextDgmr() {};		virtual ~ConsoleTextDgmr() {};	private:		template <class R>		static void PutRefList(const typename R::bare_t& ar, std::vector<R*>& vr);	public:		static void PutMarkList(const XYPt& pp, std::vector<RefMark*>& vm);		static void PutLineList(const XYLine& ll, std::vector<RefLine*>& vl);};/************	PSFileDgmr - a subclass of RefDgmr that writes a PostScript	file of diagrams.***********/class PSFileDgmr : public RefDgmr {	public:		std::fstream psfile;			// the file to which all the postscript code gets written		static XYPt origin;				// current location of the origin, in PostScript units		static double usize;			// size in points of a unit square		static const XYRect pageSize;	// printable area on the page		int pageNum;					// page counter		static int fileNum;				// file counter		static std::string fileName;	// file name					PSFileDgmr() {};		virtual ~PSFileDgmr() {};		// Overridden functions from ancestor class RefDgmr			public:		void DrawPt(const XYPt& aPt, PointStyle pstyle);		void DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle);		void DrawArc(const XYPt& ctr, const double rad, const double fromAngle,			const double toAngle, const bool ccw, LineStyle lstyle);		void DrawPoly(const std::vector<XYPt>& poly, PolyStyle pstyle);		void DrawLabel(const XYPt& aPt, const std::string& aString, LabelStyle lstyle);				// PSFileDgmr - specific stuff		private:		class PSPt {			public:				double px;				double py;				PSPt(const XYPt& aPt);	// ctor performs coordinate transformation		};		friend std::ostream& operator<<(std::ostream& os, const PSPt& pp);			void SetPointStyle(PointStyle pstyle);		void SetLineStyle(LineStyle lstyle);		void SetPolyStyle(PolyStyle pstyle);		void SetLabelStyle(LabelStyle lstyle);		void DecrementOrigin(double d);		template <class R>		void PutRefList(const typename R::bare_t& ar, std::vector<R*>& vr);	public:		void PutMarkList(const XYPt& pp, std::vector<RefMark*>& vm);		void PutLineList(const XYLine& ll, std::vector<RefLine*>& vl);};#endif // _REFERENCEFINDER_H_
\ No newline at end of file
+/******************************************************************************
+
+	ReferenceFinder - a program for finding compact folding sequences for locating 
+	approximate reference points on a unit square.
+	
+	Version 3.1
+	
+	Copyright ©1999-2003 by Robert J. Lang. All rights reserved.
+	
+	Rights of usage: you may compile this code and modifications thereof for your 
+	own personal use. You may not redistribute this code or modifications thereof.
+	
+	ReferenceFinder is ANSI C++ code that should compile for any compiler/platform
+	that supports the C++ standard library.
+	
+	After the program initializes, the user is prompted for x and y coordinates of
+	a desired point or line. The program responds with several folding sequences based on 
+	lines and marks made by folding (no measuring).
+	
+	See file "README.txt" for version history and compilation notes.
+
+******************************************************************************/
+ 
+#ifndef _REFERENCEFINDER_H_
+#define _REFERENCEFINDER_H_
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstddef>
+#include <ctime>
+
+/******************************************************************************
+*
+*	Section 1: lightweight classes that represent points and lines
+*
+*	These are mostly defined in the header to give the compiler a chance to 
+*	inline them.
+*
+******************************************************************************/
+
+
+// global stuff
+
+const double EPS = 1.0e-8;		// used for equality of XYPts and parallelness of XYLines
+
+/**********
+*
+*	XYPt - a 2-vector that represents a point or a direction.
+*
+**********/
+
+class XYPt {
+	public:
+		double x;	// x coordinate
+		double y;	// y coordinate
+		
+		// Constructor
+		
+		XYPt(double xx = 0, double yy = 0) : x(xx), y(yy) {};
+		
+		// Arithmetic with XYPts and scalars
+		
+		const XYPt operator+(const XYPt& p) const {return XYPt(x + p.x, y + p.y);};
+		const XYPt operator-(const XYPt& p) const {return XYPt(x - p.x, y - p.y);};
+		const XYPt operator*(const XYPt& p) const {return XYPt(x * p.x, y * p.y);};
+		const XYPt operator/(const XYPt& p) const {return XYPt(x / p.x, y / p.y);};
+		
+		const XYPt operator+(double z) const {return XYPt(x + z, y + z);};
+		const XYPt operator-(double z) const {return XYPt(x - z, y - z);};
+		const XYPt operator*(double z) const {return XYPt(x * z, y * z);};
+		const XYPt operator/(double z) const {return XYPt(x / z, y / z);};
+		
+		friend const XYPt operator+(const double d, const XYPt& pp) {
+			return XYPt(d + pp.x, d + pp.y);};
+		friend const XYPt operator-(const double d, const XYPt& pp) {
+			return XYPt(d - pp.x, d - pp.y);};
+		friend const XYPt operator*(const double d, const XYPt& pp) {
+			return XYPt(d * pp.x, d * pp.y);};
+		friend const XYPt operator/(const double d, const XYPt& pp) {
+			return XYPt(d / pp.x, d / pp.y);};
+		
+		XYPt& operator+=(const XYPt& p) {x += p.x; y += p.y; return (*this);};
+		XYPt& operator-=(const XYPt& p) {x -= p.x; y -= p.y; return (*this);};
+		XYPt& operator*=(const XYPt& p) {x *= p.x; y *= p.y; return (*this);};
+		XYPt& operator/=(const XYPt& p) {x /= p.x; y /= p.y; return (*this);};
+
+		XYPt& operator+=(double z) {x += z; y += z; return (*this);};
+		XYPt& operator-=(double z) {x -= z; y -= z; return (*this);};
+		XYPt& operator*=(double z) {x *= z; y *= z; return (*this);};
+		XYPt& operator/=(double z) {x /= z; y /= z; return (*this);};
+
+		// Counterclockwise rotation
+		
+		const XYPt Rotate90() const {return XYPt(-y, x);};
+		const XYPt RotateCCW(const double a) const {	// a is in radians
+			double sa = std::sin(a);
+			double ca = std::cos(a);
+			return XYPt(ca * x - sa * y, sa * x + ca * y);};
+		
+		// Scalar products and norms
+			
+		const double Dot(const XYPt& p) const {return x * p.x + y * p.y;};
+		const double Mag2() const {return x * x + y * y;};
+		const double Mag() const {return std::sqrt(x * x + y * y);};
+		const XYPt Normalize() const {double m = Mag(); return XYPt(x / m, y / m);};
+		XYPt& NormalizeSelf() {double m = Mag(); x /= m; y /= m; return *this;};
+		
+		// Other common functions
+		
+		friend const XYPt MidPoint(const XYPt& p1, const XYPt& p2) {
+			return XYPt(0.5 * (p1.x + p2.x), 0.5 * (p1.y + p2.y));};
+		
+		// Chop() makes numbers close to zero equal to zero.
+		
+		const XYPt Chop() const {return XYPt(std::abs(x) < EPS ? 0 : x, std::abs(y) < EPS ? 0 : y);};
+		XYPt& ChopSelf() {
+			if (std::abs(x) < EPS) x = 0; 
+			if (std::abs(y) < EPS) y = 0; return *this;};
+		
+		// Comparison
+		
+		const bool operator==(const XYPt& p) const {return (*this - p).Mag() < EPS;};
+		
+		// Stream I/O
+		
+		friend std::ostream& operator<<(std::ostream& os, const XYPt& p);
+};
+
+
+/**********
+*
+*	XYLine - a class for representing a line by a scalar and the normal to the line.
+*
+**********/
+
+class XYLine {
+	public:
+		double d;	// d*u is the point on the line closest to the origin
+		XYPt u;		// a unit normal vector to the line
+		
+		// Constructors
+		
+		XYLine(double dd = 0, const XYPt& uu = XYPt(1, 0)) : d(dd), u(uu) {};
+		
+		XYLine(const XYPt& p1, const XYPt& p2) {			// line through two points
+			u = (p2 - p1).Normalize().Rotate90();
+			d = p1.Dot(u);};
+		
+		XYPt Fold(const XYPt& p1) const {					// Fold a point about the line
+			return p1 + 2 * (d - (p1.Dot(u))) * u;};
+		
+		const bool IsParallelTo(const XYLine& ll) const {			// true if lines are parallel
+			return std::abs(u.Dot(ll.u.Rotate90())) < EPS;};
+		
+		const bool operator==(const XYLine& ll) const {			// true if lines are same
+			return (std::abs(d - ll.d * u.Dot(ll.u)) < EPS) && 
+				(std::abs(u.Dot(ll.u.Rotate90())) < EPS);};
+			
+		const bool Intersects(const XYPt& pp) const {				// true if pt on line
+			return (std::abs(d - pp.Dot(u)) < EPS);};
+			
+		const bool Intersects(const XYLine& ll, XYPt& pp) const {	// true if lines intersect,
+			double denom = u.x * ll.u.y - u.y * ll.u.x;		// intersection goes in pp
+			if (std::abs(denom) < EPS) return false;
+			pp.x = (d * ll.u.y - ll.d * u.y) / denom;
+			pp.y = (ll.d * u.x - d * ll.u.x) / denom;
+			return true;};
+			
+		// Intersection() just returns the intersection point, no error checking
+		// for parallel-ness. Use Intersects() when in doubt.
+		
+		friend const XYPt Intersection(const XYLine& l1, const XYLine& l2) {
+			double denom = l1.u.x * l2.u.y - l1.u.y * l2.u.x;
+			return XYPt((l1.d * l2.u.y - l2.d * l1.u.y) / denom, 
+				(l2.d * l1.u.x - l1.d * l2.u.x) / denom);};
+
+		// Stream I/O
+		
+		friend std::ostream& operator<<(std::ostream& os, const XYLine& l);
+};		
+		
+
+/**********
+*
+*	XYRect - a class for representing rectangles by two points, the bottom left and
+*	top right corners.
+*
+**********/
+
+class XYRect {
+	public:
+		XYPt bl;	// bottom left corner
+		XYPt tr;	// top right corner
+		
+		// Constructors
+		
+		XYRect(const XYPt& ap) : bl(ap), tr(ap) {};
+		XYRect(const XYPt& abl, const XYPt& atr) : bl(abl), tr(atr) {};
+		XYRect(double ablx, double ably, double atrx, double atry) : 
+			bl(ablx, ably), tr(atrx, atry) {};
+			
+		// Dimensional queries
+		
+		const double GetWidth() const {return tr.x - bl.x;};
+		const double GetHeight() const {return tr.y - bl.y;};
+		const double GetAspectRatio() const;
+		
+		// IsValid() returns true if bl is below and to the left of tr
+		
+		const bool IsValid() const {return (bl.x <= tr.x) && (bl.y <= tr.y);};
+		
+		// IsEmpty() returns true if the rectangle is a line or point
+		
+		const bool IsEmpty() const {
+			return (std::abs(bl.x - tr.x) < EPS) || (std::abs(bl.y - tr.y) < EPS);};
+		
+		// Encloses(p) returns true if pt falls within this rectangle, padded by EPS
+		// Encloses(p1, p2) returns true if both pts fall within the rectangle.
+		
+		const bool Encloses(const XYPt& ap) const {
+			return (ap.x >= bl.x - EPS) && (ap.x <= tr.x + EPS) &&
+			(ap.y >= bl.y - EPS) && (ap.y <= tr.y + EPS);};
+			
+		const bool Encloses(const XYPt& ap1, XYPt& ap2) const {
+			return Encloses(ap1) && Encloses(ap2);};
+			
+		// Include(p) stretches the coordinates so that this rect encloses the point.
+		// Returns a reference so multiple calls can be chained.
+		
+		XYRect& Include(const XYPt& p);
+		
+		// The various incarnations of BoundingBox() return an XYRect that encloses
+		// all of the points passed as parameters.
+		
+		friend const XYRect BoundingBox(const XYPt& p1, const XYPt& p2);
+		friend const XYRect BoundingBox(const XYPt& p1, const XYPt& p2, const XYPt& p3);
+
+		// Stream I/O
+		
+		friend std::ostream& operator<<(std::ostream& os, const XYRect& r);
+};
+
+
+/******************************************************************************
+*
+*	Section 2: classes that represent reference marks and reference lines on a 
+*	rectangular piece of paper.
+*
+******************************************************************************/
+
+
+/**********
+*
+*	Paper - specialization of XYRect for representing the paper
+*
+**********/
+
+class Paper : public XYRect {
+	public:
+		double pWidth;				// width of the paper
+		double pHeight;				// height of the paper
+		XYPt botLeft;				// only used by MakeAllMarksAndLines
+		XYPt botRight;				// ditto
+		XYPt topLeft;				// ditto
+		XYPt topRight;				// ditto
+		XYLine topEdge;				// used by InteriorOverlaps() and MakeAllMarksAndLines
+		XYLine leftEdge;			// ditto
+		XYLine rightEdge;			// ditto
+		XYLine bottomEdge;			// ditto
+		XYLine upwardDiagonal;		// only used by MakeAllMarksAndLines
+		XYLine downwardDiagonal;	// ditto
+		
+	public:	
+		Paper(double aWidth, double aHeight);
+		
+		const bool ClipLine(const XYLine& al, XYPt& ap1, XYPt& ap2) const;
+		const bool InteriorOverlaps(const XYLine& al) const;
+		const bool MakesSkinnyFlap(const XYLine& al) const;
+		
+		void DrawSelf();
+};
+
+
+/**********
+*
+*	RefBase - base class for a mark or line. 
+*
+**********/
+
+class RefDgmr;	// forward declaration, see Section 5 below
+class RefRecord;	// forward declaration, see Section 3 below
+class RefArena;		// forward declaration, see Section 3 below
+class RefContext;	// forward declaration, see below
+template <class R> class RefBuilder;	// forward declaration, see Section 3 below
+
+class RefBase {
+	public:
+		typedef unsigned short rank_t;		// type for ranks
+		rank_t mRank;						// rank of this mark or line
+#ifdef USE_WIDE_KEYS
+		typedef std::ptrdiff_t key_t;		// key type, 64 bits on 64-bit systems
+#else
+		typedef int key_t;					// key type (compiler-dependent, depending on max int)
+#endif
+		key_t mKey;							// key used for uniqueness within RefContainers
+		static Paper paper;					// the paper
+
+		class DgmInfo {						// information that encodes a diagram description
+			public:
+				std::size_t idef;			// first ref that's defined in this diagram
+				std::size_t iact;			// ref that terminates this diagram
+				DgmInfo(std::size_t adef, std::size_t aact) : 
+					idef(adef), iact(aact) {};
+		};
+
+	protected:
+		typedef short index_t;				// type for indices
+		enum {linePass, hlinePass, pointPass, arrowPass, labelPass, maxPasses}; // drawing order
+		
+	public:
+		RefBase(rank_t arank = 0) : mRank(arank), mKey(0) {};		
+		RefBase(const RefRecord& ar);
+		virtual ~RefBase() {};
+		
+		// refs live in RefArenas, so they're made with new (arena) and never deleted
+		
+		static void* operator new(std::size_t asize, RefArena& aa);
+		static void operator delete(void*, RefArena&) {};
+
+		// routines for building a sequence of refs
+		
+		virtual void SequencePushSelf(RefContext& ac);
+		void BuildAndNumberSequence(RefContext& ac);
+		
+		// routine for creating a text description of how to fold a ref
+		
+		virtual const char GetLabel(const RefContext& ac) const = 0;
+		virtual const bool PutName(const RefContext& ac, std::ostream& os) const = 0;
+		virtual const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		std::ostream& PutHowtoSequence(RefContext& ac, std::ostream& os);
+		
+		// routines for drawing diagrams
+		
+		void BuildDiagrams(RefContext& ac);
+		static void DrawPaper(const RefContext& ac);
+		static void DrawDiagram(RefContext& ac, RefDgmr& aDgmr, const DgmInfo& aDgm);
+		static void PutDiagramCaption(const RefContext& ac, std::ostream& os, 
+			const DgmInfo& aDgm);
+
+		// routines for storing refs in a snapshot file
+		
+		enum RefType {markOriginal, markIntersection, lineOriginal, lineC2P_C2P, lineP2P,
+			lineL2L, lineL2L_C2P, lineP2L_C2P, lineP2L_P2L, lineL2L_P2L};
+		virtual void Store(RefRecord& ar) const = 0;
+		
+		// how the construction of a candidate ref ended; a candidate that was turned down
+		// by its constructor keeps the reason in mKey, as a negative number
+		
+		enum Outcome {accepted, duplicate, overCap, noSolution, offPaper, noOverlap, 
+			shallowAngle, notVisible, skinnyFlap, numOutcomes};
+		const Outcome Rejection() const {return (mKey < 0) ? Outcome(-mKey) : noSolution;};
+		
+		// routine for checking a ref again after the settings have been tightened
+		
+		virtual bool Revalidate();
+
+	protected:
+		virtual const bool UsesImmediate(RefBase* rb) const;
+		virtual const bool IsActionLine() const = 0;
+		virtual const bool IsDerived() const;
+		virtual void SetIndex(RefContext& ac) const = 0;
+		static void SequencePushUnique(RefContext& ac, RefBase* rb);
+		enum RefStyle {normalRef, hiliteRef, actionRef};
+		virtual void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const = 0;
+		void Reject(Outcome ao) {mKey = -key_t(ao);};
+		static void operator delete(void*) {};	// only for the compiler's benefit
+		
+		friend class RefContext;
+};
+
+
+/**********
+*
+*	RefContext - everything that describing a ref takes besides the refs themselves: the
+*	sequence of refs that define it, the labels they get in that sequence, the diagrams, 
+*	the object that draws them, and the style of the verbal directions. The refs are only
+*	read, so several threads can describe refs at once, each with its own RefContext.
+*
+**********/
+
+class RefContext {
+	public:
+		typedef RefBase::index_t index_t;	// type for indices
+		std::vector<RefBase*> mSequence;	// a sequence of refs that fully define a ref
+		std::vector<RefBase::DgmInfo> mDgms;	// a list of diagrams that describe a given ref
+		RefDgmr* mDgmr;						// object that draws diagrams
+		bool clarifyVerbalAmbiguities;		// true = clarify ambiguous verbal instructions
+		bool axiomsInVerbalDirections;		// true = list the axiom number in verbal instructions
+		
+		RefContext();
+		
+		index_t GetIndex(const RefBase* rb) const;	// index that labels rb in mSequence
+		void SetIndex(const RefBase* rb, index_t aindex);
+		index_t NextMarkIndex() {return ++mMarkCount;};	// index for the next mark
+		index_t NextLineIndex() {return ++mLineCount;};	// index for the next line
+		void ResetIndices();						// start numbering mSequence over
+		
+	private:
+		std::vector<index_t> mIndices;		// index of each ref in mSequence
+		index_t mMarkCount;					// number of marks numbered so far
+		index_t mLineCount;					// number of lines numbered so far
+};
+
+
+/**********
+*
+*	RefMark - base class for a mark on the paper. 
+*
+**********/
+
+class RefMark : public RefBase {
+	public:
+		typedef XYPt bare_t;		// type of bare object a RefMark represents
+		bare_t p;					// coordinates of the mark
+	private:
+		static int xNum;			// discretization in x-direction, used to calculate mKey
+		static int yNum;			// discretization in y-direction
+		static char mLabels[];		// labels for marks, indexed by sequence index
+
+	public:
+		RefMark(rank_t arank) : RefBase(arank) {};
+		RefMark(const XYPt& ap, rank_t arank) : RefBase(arank), p(ap) {};
+		RefMark(const RefRecord& ar);
+		
+		void FinishConstructor();
+		
+		const double Distance(const XYPt& ap) const;
+		const bool IsOnEdge() const;		
+		const bool IsActionLine() const;
+		static const bool KeySizeOK();
+		static const std::size_t MaxKey();
+		static const std::size_t MaxCount();
+		static void SetDiscretization(int anum1, int anum2);
+
+		const char GetLabel(const RefContext& ac) const;
+		const bool PutName(const RefContext& ac, std::ostream& os) const;
+		void PutDistanceAndRank(std::ostream& os, const XYPt& ap) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+
+	protected:
+		static rank_t CalcMarkRank(const RefBase* ar1, const RefBase* ar2) {
+			return ar1->mRank + ar2->mRank;};
+		void SetIndex(RefContext& ac) const;
+	
+	private:
+		friend class RefBase;
+		friend class RefSnapshotHeader;	// snapshots record the key discretization
+};
+
+
+/**********
+*
+*	RefMark_Original - Specialization of RefMark that represents a named mark
+*	(like a corner).
+*
+**********/
+
+class RefMark_Original : public RefMark {
+	private:
+		const char* s;	// name of the mark, which must outlive it
+		
+	public:
+		RefMark_Original(const XYPt& ap, rank_t arank, const char* as);
+		RefMark_Original(const RefRecord& ar, const char* as);
+
+		const char GetLabel(const RefContext& ac) const;
+		const bool PutName(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		
+	protected:
+		virtual const bool IsDerived() const;
+		void SetIndex(RefContext& ac) const;
+};
+
+
+/**********
+*
+*	RefMark_Intersection - Specialization of a RefMark for a mark defined by the 
+*	intersection of 2 lines.
+*
+**********/
+
+class RefLine;	// forward declaration needed by RefMark_Intersection
+
+class RefMark_Intersection : public RefMark {
+	public:
+		RefLine* rl1;		// first line
+		RefLine* rl2;		// second line
+		
+		RefMark_Intersection(RefLine* al1, RefLine* al2);
+		RefMark_Intersection(const RefRecord& ar);
+
+		const bool UsesImmediate(RefBase* rb) const;
+		bool Revalidate();
+		void SequencePushSelf(RefContext& ac);			
+		const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		void Store(RefRecord& ar) const;
+		static void MakeAll(rank_t arank, RefBuilder<RefMark>& ab);
+};
+
+
+/**********
+*
+*	RefLine - base class for a reference line. 
+*
+**********/
+
+class RefLine : public RefBase {
+	public:	
+		typedef XYLine bare_t;		// type of bare object that a RefLine represents
+		bare_t l;					// the line this contains
+	private:
+		static int aNum;			// discretization in angle, used to calculate mKey
+		static int dNum;			// discretization in distance from origin, used for mKey
+		static char mLabels[];		// labels for lines, indexed by sequence index
+	
+	public:
+		RefLine(rank_t arank) : RefBase(arank) {};
+		RefLine(const XYLine& al, rank_t arank) : RefBase(arank), l(al) {};
+		RefLine(const RefRecord& ar);
+
+		void FinishConstructor();
+		const double Distance(const XYLine& al) const;
+		const bool IsOnEdge() const;
+		const bool IsActionLine() const;
+		static const bool KeySizeOK();
+		static const std::size_t MaxKey();
+		static const std::size_t MaxCount();
+		static void SetDiscretization(int anum1, int anum2);
+
+		const char GetLabel(const RefContext& ac) const;
+		const bool PutName(const RefContext& ac, std::ostream& os) const;
+		void PutDistanceAndRank(std::ostream& os, const XYLine& al) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		
+	protected:
+		static rank_t CalcLineRank(const RefBase* ar1, const RefBase* ar2) {
+			return 1 + ar1->mRank + ar2->mRank;};		
+		static rank_t CalcLineRank(const RefBase* ar1, const RefBase* ar2, 
+			const RefBase* ar3) {return 1 + ar1->mRank + ar2->mRank + ar3->mRank;};		
+		static rank_t CalcLineRank(const RefBase* ar1, const RefBase* ar2, 
+			const RefBase* ar3, const RefBase* ar4) {
+			return 1 + ar1->mRank + ar2->mRank + ar3->mRank + ar4->mRank;};
+		void SetIndex(RefContext& ac) const;
+	
+	private:
+		friend class RefBase;
+		friend class RefSnapshotHeader;	// snapshots record the key discretization
+};
+
+
+/**********
+*
+*	RefLine_Original - Specialization of RefLine that represents a line that is the 
+*	edge of the paper or an initial crease (like the diagonal).
+*
+**********/
+
+class RefLine_Original : public RefLine {
+	private:
+		const char* s;	// name of the line, which must outlive it
+		
+	public:
+		RefLine_Original(const XYLine& al, rank_t arank, const char* as);
+		RefLine_Original(const RefRecord& ar, const char* as);
+
+		const bool IsActionLine() const;
+		const char GetLabel(const RefContext& ac) const;
+		const bool PutName(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+
+	protected:
+		virtual const bool IsDerived() const;
+		void SetIndex(RefContext& ac) const;
+};
+
+
+/**********
+*
+*	RefLine_C2P_C2P - Huzita-Hatori Axiom O1
+*
+*	Make a crease through two points p1 and p2.
+*
+**********/
+
+class RefLine_C2P_C2P : public RefLine {
+	public:
+		RefMark* rm1;				// make a crease from one mark...
+		RefMark* rm2;				// to another mark
+		static bool include;		// use this class of RefLine?
+		
+		RefLine_C2P_C2P(RefMark* arm1, RefMark* arm2);
+		RefLine_C2P_C2P(const RefRecord& ar);
+
+		const bool UsesImmediate(RefBase* rb) const;
+		bool Revalidate();
+		void SequencePushSelf(RefContext& ac);
+		const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		static void MakeAll(rank_t arank, RefBuilder<RefLine>& ab);
+};
+
+
+/**********
+*
+*	RefLine_P2P - Huzita-Hatori Axiom O2
+*
+*	Bring p1 to p2.
+*
+**********/
+
+class RefLine_P2P : public RefLine {
+	public:
+		RefMark* rm1;				// bring one mark...
+		RefMark* rm2;				// to another mark, and form a crease.
+		static bool include;		// Use this class of RefLine?
+		
+	private:
+		enum WhoMoves {
+			p1Moves,
+			p2Moves
+		};	
+		WhoMoves whoMoves;
+		bool SetWhoMoves();
+
+	public:
+		RefLine_P2P(RefMark* arm1, RefMark* arm2);
+		RefLine_P2P(const RefRecord& ar);
+		
+		const bool UsesImmediate(RefBase* rb) const;
+		bool Revalidate();
+		void SequencePushSelf(RefContext& ac);
+		const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		static void MakeAll(rank_t arank, RefBuilder<RefLine>& ab);
+};
+
+
+/**********
+*
+*	RefLine_L2L - Huzita-Hatori Axiom O3
+*
+*	Bring line l1 to line l2.
+*
+**********/
+
+class RefLine_L2L : public RefLine {
+	public:
+		RefLine* rl1;				// make a crease by bringing one line...
+		RefLine* rl2;				// to another line
+		static bool include;		// Use this class of RefLine?
+		
+	private:
+		enum WhoMoves {
+			l1Moves,
+			l2Moves
+		};	
+		WhoMoves whoMoves;
+		bool SetWhoMoves();
+
+	public:	
+		RefLine_L2L(RefLine* arl1, RefLine* arl2, short iroot);
+		RefLine_L2L(const RefRecord& ar);
+		
+		const bool UsesImmediate(RefBase* rb) const;
+		bool Revalidate();
+		void SequencePushSelf(RefContext& ac);
+		const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		static void MakeAll(rank_t arank, RefBuilder<RefLine>& ab);
+};
+
+
+/**********
+*
+*	RefLine_L2L_C2P - Huzita-Hatori Axiom O4.
+*
+*	Bring line l1 to itself so that the crease passes through point p1.
+*
+**********/
+
+class RefLine_L2L_C2P : public RefLine {
+	public:
+		RefLine* rl1;				// bring line l1 to itself
+		RefMark* rm1;				// so that the crease runs through another point.
+		static bool include;		// Use this class of RefLine?
+		
+		RefLine_L2L_C2P(RefLine* arl1, RefMark* arm1);
+		RefLine_L2L_C2P(const RefRecord& ar);
+		
+		const bool UsesImmediate(RefBase* rb) const;
+		bool Revalidate();
+		void SequencePushSelf(RefContext& ac);
+		const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		static void MakeAll(rank_t arank, RefBuilder<RefLine>& ab);
+};
+
+
+/**********
+*
+*	RefLine_P2L_C2P - Huzita-Hatori Axiom O5.
+*
+*	Bring point p1 to line l1 so that the crease passes through point p2.
+*
+**********/
+
+class RefLine_P2L_C2P : public RefLine {
+	public:
+		RefMark* rm1;				// bring a point...
+		RefLine* rl1;				// to a line...
+		RefMark* rm2;				// so that the crease runs through another point.
+		static bool include;		// Use this class of RefLine?
+		
+	private:
+		enum WhoMoves {
+			p1Moves,
+			l1Moves
+		};	
+		WhoMoves whoMoves;
+		bool SetWhoMoves();
+		
+	public:
+		RefLine_P2L_C2P(RefMark* arm1, RefLine* arl1, RefMark* arm2, const XYPt& ap1p);
+		RefLine_P2L_C2P(const RefRecord& ar);
+		
+		static short CalcImages(const XYPt& p1, const XYLine& l1, const XYPt& p2, 
+			XYPt ap1p[2]);
+		
+		const bool UsesImmediate(RefBase* rb) const;
+		bool Revalidate();
+		void SequencePushSelf(RefContext& ac);
+		const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		static void MakeAll(rank_t arank, RefBuilder<RefLine>& ab);
+};
+
+
+/**********
+*
+*	RefLine_P2L_P2L - Huzita-Hatori Axiom O6 (the cubic!)
+*
+*	Bring point p1 to line l1 and point p2 to line l2
+*
+**********/
+
+class RefLine_P2L_P2L : public RefLine {
+	public:
+		RefMark* rm1;				// bring a point...
+		RefLine* rl1;				// to a line...
+		RefMark* rm2;				// and another point...
+		RefLine* rl2;				// to another line.
+		static bool include;		// Use this class of RefLine?
+	
+	private:
+		enum WhoMoves {
+			p1p2Moves,
+			l1l2Moves,
+			p1l2Moves,
+			p2l1Moves
+		};	
+		WhoMoves whoMoves;
+		bool SetWhoMoves();
+		
+	public:		
+		RefLine_P2L_P2L(RefMark* arm1, RefLine* arl1, RefMark* arm2, RefLine* arl2, 
+			double arc);
+		RefLine_P2L_P2L(const RefRecord& ar);
+		
+		static short CalcRoots(const XYPt& p1, const XYLine& l1, const XYPt& p2, 
+			const XYLine& l2, double arc[3]);
+		
+		const bool UsesImmediate(RefBase* rb) const;
+		bool Revalidate();
+		void SequencePushSelf(RefContext& ac);
+		const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		static void MakeAll(rank_t arank, RefBuilder<RefLine>& ab);
+};
+
+
+/**********
+*
+*	RefLine_L2L_P2L - Huzita-Hatori Axiom O7 (Hatori's Axiom).
+*
+*	Bring line l1 to itself so that the point p1 goes on line l2.
+*
+**********/
+
+class RefLine_L2L_P2L : public RefLine {
+	public:
+		RefLine* rl1;				// bring line l1 onto itself
+		RefMark* rm1;				// so that point p1
+		RefLine* rl2;				// falls on line l2.
+		static bool include;	// Use this class of RefLine?
+	private:
+		enum WhoMoves {
+			p1Moves,
+			l1Moves
+		};	
+		WhoMoves whoMoves;
+		
+	public:
+		RefLine_L2L_P2L(RefLine* arl1, RefMark* arm1, RefLine* arl2);
+		RefLine_L2L_P2L(const RefRecord& ar);
+		
+		const bool UsesImmediate(RefBase* rb) const;
+		bool Revalidate();
+		void SequencePushSelf(RefContext& ac);
+		const bool PutHowto(const RefContext& ac, std::ostream& os) const;
+		void DrawSelf(const RefContext& ac, RefStyle rstyle, short ipass) const;
+		void Store(RefRecord& ar) const;
+		static void MakeAll(rank_t arank, RefBuilder<RefLine>& ab);
+};
+
+
+/******************************************************************************
+*
+*	Section 3: container for collections of marks and lines and their construction
+*
+******************************************************************************/
+
+/**********
+*
+*	RefRecord - a pointer-free image of a mark or line, used for storing the collections
+*	of marks and lines in a snapshot file. Refs that a mark or line is made from are stored
+*	as indices into ReferenceFinder::basisLines and basisMarks; original marks and lines
+*	store the index of their name in the snapshot's table of names.
+*
+**********/
+
+class RefRecord {
+	public:
+		unsigned char mType;			// subclass of the ref, one of RefBase::RefType
+		unsigned char mWhoMoves;		// whoMoves value for subclasses that have one
+		RefBase::rank_t mRank;			// rank of the ref
+		RefBase::key_t mKey;			// key of the ref
+		double mData[3];				// (p.x, p.y) for marks, (l.d, l.u.x, l.u.y) for lines
+		int mParents[4];				// indices of the refs this one is made from
+};
+
+
+/**********
+*
+*	class RefArena - storage for marks and lines. Refs are carved out of large chunks
+*	instead of being allocated one by one, and they are all freed at once, without calling
+*	their destructors, so refs must not own any other resources.
+*
+**********/
+
+class RefArena {
+	public:
+		RefArena();
+		~RefArena();
+		
+		void* Allocate(std::size_t asize);		// room for an object of size asize
+		const char* CopyString(const std::string& as);	// copy of as that lives here
+		void Release();							// free all memory at once
+
+	private:
+		enum {alignment = 8};					// enough for the doubles and pointers in refs
+		enum {minChunk = 1 << 12};				// size of the first chunk
+		enum {maxChunk = 1 << 20};				// chunks double in size up to this one
+		
+		std::vector<char*> mChunks;				// all the chunks we allocated
+		char* mNext;							// next free byte of the current chunk
+		char* mEnd;								// end of the current chunk
+		std::size_t mChunkSize;					// size of the next chunk
+		
+		RefArena(const RefArena&);				// not copyable
+		void operator=(const RefArena&);
+};
+
+
+/**********
+*
+*	class RefKeySet - a set of keys, used to check the uniqueness of new marks and lines.
+*	Keys are small positive integers, so for the usual key ranges the set is a bitmap;
+*	for very large key ranges holding relatively few keys (or unknown key ranges) it is 
+*	an open-addressing hash table.
+*
+**********/
+
+class RefKeySet {
+	public:
+		typedef RefBase::key_t key_t;
+		
+		RefKeySet();
+		
+		void Reinitialize(std::size_t amaxKey, std::size_t acount = 0);	// empty set for keys 
+												// 1..amaxKey, about acount of them; 0 = unknown
+		void Clear();							// remove all keys
+		bool Contains(key_t akey) const;		// true if akey is in the set
+		void Insert(key_t akey);				// add akey to the set
+		
+		static bool UsesBitmap(std::size_t amaxKey, std::size_t acount);
+		static std::size_t Bytes(std::size_t amaxKey, std::size_t acount);	// memory taken
+
+	private:
+		enum {maxBitmapKey = 1 << 27};			// key range that always gets a bitmap
+		enum {minSlots = 1024};					// smallest hash table
+		typedef unsigned long word_t;			// bitmap word
+		enum {wordBits = 8 * sizeof(word_t)};
+		
+		bool mIsBitmap;							// true = bitmap, false = hash table
+		std::vector<word_t> mBits;				// the bitmap
+		std::vector<key_t> mSlots;				// the hash table, 0 = empty slot
+		std::size_t mCount;						// number of keys in the hash table
+		
+		std::size_t Slot(key_t akey) const;		// hash table slot that holds or wants akey
+		void Grow();							// double the size of the hash table
+};
+
+
+/**********
+*
+*	class RefContainer - Container for marks and lines.
+*
+**********/
+
+template<class R>
+class RefContainer : public std::vector<R*> {
+	public:
+		typedef std::vector<R*> array_t;	// typedef for array holding R*
+		std::vector<array_t> ranks;			// Holds objects of each rank, sorted by key
+		std::size_t rcsz;					// current number of elements in the ranks
+		array_t buffer;						// used to accumulate new objects
+		std::size_t rcbz;					// current size of buffer
+
+		typedef typename array_t::iterator rank_iterator;	// for iterating through individual ranks
+		
+	public:
+		std::size_t TotalSize() const;			// Total number of elements, all ranks
+
+		template <class Rs>
+		RefBase::Outcome AddCopyIfValidAndUnique(const Rs& ars);	// add ars if valid and unique
+		
+		int IndexOf(const R* ar) const;			// index of ar in the sortable list
+
+	private:
+		typedef std::pair<const R*, int> lookup_t;	// pairs a ref with its index
+		std::vector<lookup_t> lookup;		// sorted by pointer, used by IndexOf()
+
+		friend class ReferenceFinder;		// only class that gets to use these methods
+
+		RefContainer();						// Constructor
+
+		void Reinitialize();				// Re-initialize with new values
+		bool Contains(const R* ar) const;	// True if an equivalent element already exists
+		void Add(R* ar);					// Add an element to the array
+		void FlushBuffer();					// Add the contents of the buffer to the container
+		void ClearRanks();					// Clear the rank arrays when no longer needed
+		void RebuildRanks();				// Refill them from the sortable list
+		void RemoveDropped();				// Remove the refs whose key is 0
+		void BuildLookup();					// Set up the lookup table used by IndexOf()
+		void ClearLookup();					// Free the lookup table
+		bool RanksContain(const R* ar) const;	// True if an equivalent element is in a rank
+
+		static bool KeyLess(const R* r1, const R* r2) {return r1->mKey < r2->mKey;};
+		static bool IsDropped(const R* r) {return r->mKey == 0;};
+		
+		RefKeySet rankKeys;					// keys of all objects in the ranks
+		RefKeySet bufferKeys;				// keys of all objects in the buffer
+		RefArena arena;						// storage for all the objects
+
+		friend class RefBuilder<R>;			// gets to use Contains() and Add()
+};
+
+
+/**********
+*
+*	class RefBuildStats - counts the candidates that one MakeAll() routine tried for one
+*	rank, how each of them ended, and the processor time it took.
+*
+**********/
+
+class RefBuildStats {
+	public:
+		RefBase::RefType mType;					// kind of ref built
+		RefBase::rank_t mRank;					// rank built
+		std::size_t mTries;						// number of candidates tried
+		std::size_t mOutcomes[RefBase::numOutcomes];	// number that ended each way
+		double mSeconds;						// processor time spent, all threads
+		bool mFull;								// true = its limit was reached at the end
+		std::size_t mShare;						// room it was given, if fairShares; else 0
+		bool mOutOfTime;						// true = cut short or skipped for lack of time
+		
+		RefBuildStats(RefBase::RefType atype = RefBase::markOriginal, 
+			RefBase::rank_t arank = 0);
+		void Count(RefBase::Outcome ao, std::size_t n = 1) {mOutcomes[ao] += n;};
+		RefBuildStats& operator+=(const RefBuildStats& as);
+		
+		static const char* TypeName(RefBase::RefType atype);
+		static const char* OutcomeName(RefBase::Outcome ao);
+};
+
+
+/**********
+*
+*	class RefBuilder - receives the marks or lines made by the MakeAll() routines. A
+*	serial builder adds them straight to a RefContainer, up to a maximum size. A slice
+*	builder only handles a contiguous range of units of the outer iteration of a MakeAll()
+*	routine and collects what it makes in its own buffer, so that several slices can be
+*	built at once and then merged into the container in order.
+*
+**********/
+
+template <class R>
+class RefBuilder {
+	public:
+		RefBuilder(RefContainer<R>& ac, std::size_t amax);	// serial builder
+		RefBuilder(RefContainer<R>& ac, std::size_t abegin, std::size_t aend);	// slice builder
+		
+		bool Owns();							// next unit of the outer iteration; ours?
+		bool Done() const;						// true if there's no point in going on
+		
+		template <class Rs>
+		void AddCopyIfValidAndUnique(const Rs& ars);	// add a copy of ars if valid and unique
+		void Skip(RefBase::Outcome ao, std::size_t n = 1);	// count n turned down unmade
+
+	private:
+		RefContainer<R>& mContainer;			// container the refs are meant for
+		std::size_t mMax;						// maximum size of the container
+		bool mIsSlice;							// true = collect refs in our own buffer
+		std::size_t mUnit;						// units of the outer iteration seen so far
+		std::size_t mBegin;						// first unit of our slice
+		std::size_t mEnd;						// one past the last unit of our slice
+		typedef R* (*CopyFn)(const R*, RefArena&);
+		std::vector<R*> mRefs;					// refs collected by a slice, in order made
+		std::vector<CopyFn> mCopiers;			// how to copy each of them to another arena
+		RefKeySet mKeys;						// keys of the same refs
+		RefArena mArena;						// storage for the same refs
+		RefBuildStats mStats;					// what happened to the refs we were given
+		
+		template <class Rs>
+		static R* CopyRef(const R* ar, RefArena& aa);	// copy of ar, which is an Rs, in aa
+		
+		friend class ReferenceFinder;			// merges slices into the container
+};
+
+
+/**********
+*
+*	class RefLineExtents - the lines of each rank of a RefContainer<RefLine>, with the 
+*	part of each line that lies on the paper. RefLine_P2L_P2L::MakeAll() uses it to pass 
+*	over pairs of lines too close together or too far apart to take the images of two
+*	points.
+*
+**********/
+
+class RefLineExtents {
+	public:
+		typedef RefBase::rank_t rank_t;
+		
+		void Update(const RefContainer<RefLine>& ac);	// catch up with the ranks of ac
+		void Clear();									// forget all lines
+		
+		// true if no point of line i of rank irank and point of line j of rank jrank that
+		// are on the paper lie ar apart
+		
+		bool OutOfReach(rank_t irank, std::size_t i, rank_t jrank, std::size_t j, 
+			double ar) const;
+		
+	private:
+		class Extent {							// box around a line's run across the paper
+			public:
+				double mX0, mY0, mX1, mY1;
+				bool IsEmpty() const {return mX0 > mX1;};
+		};
+		class Rank {							// the lines of one rank
+			public:
+				std::vector<Extent> mExtents;	// box around each line
+				std::vector<XYPt> mEnds;		// ends of each line on the paper, two apiece
+		};
+		std::vector<Rank> mRanks;
+		
+		static const double margin;				// slack for the paper's EPS and roundoff
+		
+		static void Build(Rank& ar, const RefContainer<RefLine>::array_t& al);
+		static bool GetExtent(const XYLine& al, Extent& ae, XYPt& ap1, XYPt& ap2);
+		static double Dist2(const XYPt& ap, const XYPt& ap1, const XYPt& ap2);
+};
+
+
+/******************************************************************************
+*
+*	Section 4: routines for searching for marks and lines and collecting statistics
+*
+******************************************************************************/
+
+
+/**********
+*
+*	CompareError - function object for comparing two refs of class R according to their 
+*	distance from a target value of class X.
+*
+**********/
+
+template <class R>
+class CompareError {
+	private:
+		typename R::bare_t b;	// point that we're comparing to
+		
+	public:
+		CompareError(const typename R::bare_t& ab) : b(ab) {};
+		bool operator()(R* rb1, R* rb2) const;
+};
+
+
+/**********
+*
+*	CompareRankAndError - function object for comparing two refs of class R according to their 
+*	distance from a target value of class X, but for close points, letting rank win out
+*
+**********/
+
+template <class R>
+class CompareRankAndError {
+	private:
+		typename R::bare_t b;	// point that we're comparing to
+
+	public:
+		CompareRankAndError(const typename R::bare_t& ab) : b(ab) {};
+		bool operator()(R* rb1, R* rb2) const;
+		static bool Better(const R* r1, double d1, const R* r2, double d2);	// same, given distances
+};
+
+
+/**********
+*
+*	RefTopK - keeps the best k refs offered to it, in the order given by 
+*	CompareRankAndError, from refs whose distances from the target are already known.
+*
+**********/
+
+template <class R>
+class RefTopK {
+	private:
+		typedef std::pair<R*, double> entry_t;	// a ref and its distance from the target
+		std::size_t mK;						// number of refs to keep
+		std::vector<entry_t> mBest;			// the best so far, best first
+		
+	public:
+		RefTopK(std::size_t ak) : mK(ak) {mBest.reserve(ak + 1);};
+		bool Rejects(double ad) const;		// true if a ref at distance ad can't make the cut
+		void Offer(R* ar, double ad);		// keep ar if it's among the best k so far
+		void Get(std::vector<R*>& vr) const;	// the best k, best first
+};
+
+
+/**********
+*
+*	RefRankList - keeps the refs offered to it that are within a tolerance of the target,
+*	from refs whose distances are already known, and lists them by rank, closest first 
+*	within a rank. Or it lists just the frontier of rank and error: the refs that are 
+*	closer than every ref of lower rank, so that each one on the list trades a higher
+*	rank for a smaller error.
+*
+**********/
+
+template <class R>
+class RefRankList {
+	public:
+		typedef std::pair<R*, double> entry_t;	// a ref and its distance from the target
+	private:
+		double mTol;						// tolerance
+		std::vector<entry_t> mRefs;			// refs within mTol, in the order offered
+		
+	public:
+		RefRankList(double atol) : mTol(atol) {};
+		double Tolerance() const {return mTol;};
+		void Offer(R* ar, double ad) {if (ad <= mTol) mRefs.push_back(entry_t(ar, ad));};
+		void Get(std::vector<R*>& vr, bool afrontier = false);	// the list
+		static bool Before(const entry_t& e1, const entry_t& e2);	// order of the list
+};
+
+
+/**********
+*
+*	RefScorer - computes the distances from a target to a run of marks or lines whose 
+*	coordinates are stored in contiguous arrays. With USE_AVX2, it does four at a time
+*	if the processor can. Either way, the distances come out exactly as 
+*	RefMark::Distance() and RefLine::Distance() compute them.
+*
+**********/
+
+class RefScorer {
+	public:
+		static bool useAVX2;				// use AVX2 if the processor has it
+		
+		static void MarkDistances(const XYPt& ap, const double* ax, const double* ay, 
+			std::size_t an, double* adist);
+		static void LineDistances(const XYLine& al, const double* aux, const double* auy, 
+			const double* ad, std::size_t an, double* adist);
+		static const char* KernelName();	// name of the kernel that we'd use right now
+		
+	private:
+		static bool HaveAVX2();
+		static void MarkDistancesScalar(const XYPt& ap, const double* ax, const double* ay, 
+			std::size_t an, double* adist);
+		static void LineDistancesScalar(const XYLine& al, const double* aux, 
+			const double* auy, const double* ad, std::size_t an, double* adist);
+#ifdef USE_AVX2
+		static void MarkDistancesAVX2(const XYPt& ap, const double* ax, const double* ay, 
+			std::size_t an, double* adist);
+		static void LineDistancesAVX2(const XYLine& al, const double* aux, 
+			const double* auy, const double* ad, std::size_t an, double* adist);
+#endif
+};
+
+
+/**********
+*
+*	RefMarkIndex - a uniform grid of cells over the paper, each holding the marks that lie
+*	in it, so that a search for the best marks only has to visit the cells near the target.
+*
+**********/
+
+class RefMarkIndex {
+	private:
+		int mCols;							// number of cells across
+		int mRows;							// number of cells up
+		double mCellWidth;					// dimensions of a cell
+		double mCellHeight;
+		std::vector<std::size_t> mStart;	// index of first mark of each cell in mMarks
+		std::vector<RefMark*> mMarks;		// all marks, grouped by cell
+		std::vector<double> mX;				// x of each mark in mMarks
+		std::vector<double> mY;				// y of each mark in mMarks
+		
+		int CellCol(double x) const;		// column of the cell holding x, clamped to grid
+		int CellRow(double y) const;		// row of the cell holding y, clamped to grid
+		void Score(const XYPt& ap, std::size_t k0, std::size_t k1, 
+			std::vector<RefMark*>& vm, std::vector<double>& dm) const;	// marks k0..k1-1
+		void Collect(const XYPt& ap, double ar, std::vector<RefMark*>& vm, 
+			std::vector<double>& dm) const;	// marks that could be within ar of ap
+		
+		friend class RefMarkCoverage;		// gets to use Collect()
+		
+	public:
+		RefMarkIndex();
+		
+		void Build(const std::vector<RefMark*>& am);	// index the marks am
+		void Clear();									// forget all marks
+		bool IsEmpty() const {return mMarks.empty();};
+		void FindBestMarks(const XYPt& ap, std::vector<RefMark*>& vm, short numMarks) const;
+		void ScanBestMarks(const XYPt& ap, std::vector<RefMark*>& vm, short numMarks) const;
+		void FindMarksWithin(const XYPt& ap, RefRankList<RefMark>& ar) const;
+		double NearestDistance(const XYPt& ap) const;	// distance to the closest mark
+};
+
+
+/**********
+*
+*	RefLineIndex - lines bucketed by the angle of their normal, sorted by their distance
+*	from the origin within each bucket, so that a search for the best lines only has to
+*	look at the few lines near the target in (angle, d) space.
+*
+**********/
+
+class RefLineIndex {
+	private:
+		int mAngles;						// number of angle buckets
+		std::vector<std::size_t> mStart;	// index of first line of each bucket in mLines
+		std::vector<RefLine*> mLines;		// all lines, grouped by bucket, sorted by d
+		std::vector<double> mD;				// d of each line in mLines
+		std::vector<double> mUx;			// normal of each line in mLines, flipped
+		std::vector<double> mUy;			// along with d
+		
+		static void Normalize(const XYLine& al, double& aa, double& ad);
+		int AngleBucket(double aa) const;	// bucket that holds angle aa
+		void Collect(const XYLine& al, double ar, std::vector<RefLine*>& vl, 
+			std::vector<double>& dl) const;	// lines that could be within ar of al
+		
+		friend class RefLineCoverage;		// gets to use Normalize() and Collect()
+		
+	public:
+		RefLineIndex();
+		
+		void Build(const std::vector<RefLine*>& al);	// index the lines al
+		void Clear();									// forget all lines
+		bool IsEmpty() const {return mLines.empty();};
+		void FindBestLines(const XYLine& al, std::vector<RefLine*>& vl, short numLines) const;
+		void ScanBestLines(const XYLine& al, std::vector<RefLine*>& vl, short numLines) const;
+		void FindLinesWithin(const XYLine& al, RefRankList<RefLine>& ar) const;
+};
+
+
+/**********
+*
+*	RefCoverage - a table over a grid of cells of targets that lists, for each cell, the 
+*	refs of lowest rank among those that could be within maxError of a target in the cell, 
+*	ranked as CompareRankAndError ranks refs within maxError. A search only has to score
+*	its cell's list if the best refs on it are within maxError of the target and outrank 
+*	every ref left off; other searches go to the index. RefMarkCoverage and 
+*	RefLineCoverage lay out the cells for marks and lines.
+*
+**********/
+
+class RefCoverage {
+	protected:
+		typedef RefBase::rank_t rank_t;
+		int mCells;							// number of cells along each side, 0 = no table
+		int mDepth;							// most refs listed for a cell
+		double mMaxError;					// maxError the table was made for
+		std::vector<unsigned int> mStart;	// first entry of each cell in mEntries
+		std::vector<unsigned int> mEntries;	// refs listed for each cell, by container index
+		std::vector<rank_t> mCutRank;		// lowest rank left off each cell's list
+		
+		RefCoverage();
+		void Start(int acells, int adepth);	// set up an empty table to be filled
+		template <class R>
+		void AddCell(std::vector<std::pair<R*, double> >& vc, 
+			const std::vector<std::pair<R*, unsigned int> >& aindices);	// list the next cell
+		template <class R>
+		bool Find(std::size_t acell, const typename R::bare_t& ab, const std::vector<R*>& ar, 
+			std::vector<R*>& vr, short numRefs) const;	// answer from one cell, if we can
+		template <class R>
+		static void Number(const std::vector<R*>& ar, 
+			std::vector<std::pair<R*, unsigned int> >& aindices);	// container index of refs
+		static bool Read(const char*& ap, const char* aend, void* adest, std::size_t asize);
+			
+	public:
+		void Clear();						// forget the table and free its memory
+		bool IsEmpty() const {return mCells == 0;};
+		std::size_t Bytes() const;			// memory used by the table
+		void Put(std::string& as) const;	// append the table to as, for a snapshot
+		bool Get(const char*& ap, const char* aend, std::size_t acount, int acells, 
+			int adepth);					// read one back, if it fits the current settings
+};
+
+
+/**********
+*
+*	RefMarkCoverage - a coverage table for marks, whose cells are an even grid over the 
+*	paper.
+*
+**********/
+
+class RefMarkCoverage : public RefCoverage {
+	private:
+		bool Cell(const XYPt& ap, std::size_t& acell) const;	// cell that holds ap, if any
+		
+	public:
+		void Build(const std::vector<RefMark*>& am, const RefMarkIndex& ai, int acells, 
+			int adepth);					// list the marks am, found with ai
+		bool FindBestMarks(const XYPt& ap, const std::vector<RefMark*>& am, 
+			std::vector<RefMark*>& vm, short numMarks) const;
+};
+
+
+/**********
+*
+*	RefLineCoverage - a coverage table for lines, whose cells are an even grid over the
+*	angle of the normal and the distance from the origin, the quantities that 
+*	RefLine::FinishConstructor() makes keys from.
+*
+**********/
+
+class RefLineCoverage : public RefCoverage {
+	private:
+		static double MaxD();				// greatest distance from the origin in the grid
+		bool Cell(const XYLine& al, std::size_t& acell) const;	// cell that holds al, if any
+		
+	public:
+		void Build(const std::vector<RefLine*>& al, const RefLineIndex& ai, int acells, 
+			int adepth);					// list the lines al, found with ai
+		bool FindBestLines(const XYLine& al, const std::vector<RefLine*>& alines, 
+			std::vector<RefLine*>& vl, short numLines) const;
+};
+
+
+/**********
+*
+*	RefView - the marks and lines of every rank up through some rank, indexed for 
+*	searching, as published by a background build when it finishes a rank. A view only
+*	indexes the marks and lines that are new since the view before it, and searches that
+*	one too, and so on down to rank 0, so the lower ranks are indexed only once. A view 
+*	never changes once it's published, so searches can read it while the build goes on.
+*
+**********/
+
+class RefView {
+	public:
+		RefBase::rank_t mRank;				// highest rank of the marks and lines
+		std::size_t mNumMarks;				// marks in this view and the ones below it
+		std::size_t mNumLines;				// lines in this view and the ones below it
+		RefMarkIndex mMarkIndex;			// index of the marks new in this view
+		RefLineIndex mLineIndex;			// index of the lines new in this view
+		RefView* mLower;					// view of the ranks below, or 0
+		int mUsers;							// searches using the view, + 1 while current,
+											// + 1 while the view above uses it
+		
+		RefView(RefBase::rank_t arank, const std::vector<RefMark*>& am, 
+			const std::vector<RefLine*>& al, RefView* alower);
+		
+		void FindBestMarks(const XYPt& ap, std::vector<RefMark*>& vm, short numMarks, 
+			bool ascan = false) const;
+		void FindBestLines(const XYLine& al, std::vector<RefLine*>& vl, short numLines, 
+			bool ascan = false) const;
+		void FindMarksWithin(const XYPt& ap, RefRankList<RefMark>& ar) const;
+		void FindLinesWithin(const XYLine& al, RefRankList<RefLine>& ar) const;
+};
+
+
+/**********
+*
+*	ReferenceFinder - object that builds and maintains collections of marks and lines and
+*	can search throught the collection for marks and lines close to a target mark or line.
+*
+**********/
+
+class ReferenceFinder {
+	public:
+		typedef RefBase::rank_t rank_t;		// we use ranks, too
+		static bool visibilityMatters;		// restrict to what can be made w/ opaque paper
+		static rank_t maxRank;				// maximum rank to create
+		static std::size_t maxLines;		// maximum number of lines to create
+		static std::size_t maxMarks;		// maximum number of marks to create
+		static std::size_t memoryBudget;	// bytes for marks and lines, sets maxLines and
+											// maxMarks if nonzero
+		static double maxSeconds;			// wall-clock time to build in, 0 = no limit
+		static bool fairShares;				// share the room among ranks and kinds of lines
+		static double maxError;				// tolerable error in a mark or line
+		static double minAspectRatio;		// minimum aspect ratio for a triangular flap
+		static double minAngleSine;			// minimum line intersection for defining a mark
+		static RefContainer<RefLine> basisLines;	// all lines
+		static RefContainer<RefMark> basisMarks;	// all marks
+		static RefMarkIndex markIndex;		// spatial index of basisMarks
+		static RefLineIndex lineIndex;		// (angle, d) index of basisLines
+		static RefLineExtents lineExtents;	// where basisLines cross the paper, while building
+		static bool useSearchIndex;			// search the indexes instead of scanning everything
+		static RefMarkCoverage markCoverage;	// best marks for each cell of the paper
+		static RefLineCoverage lineCoverage;	// best lines for each cell of (angle, d)
+		static int coverageCells;			// cells along each side of the tables, 0 = none
+		static int coverageDepth;			// most refs listed for each cell
+		static bool useCoverage;			// answer from the tables when they can
+
+		static int maxTries;				// number of attempts when it's time to show progress
+		static int numThreads;				// threads that build refs and answer batches, 0 = one per CPU
+	private:
+		static int numTries;				// number of attempts since last callback
+
+		// Stuff that implements a callback function to show progress during initialization
+		
+	public:
+		enum ProgressMsg {msgInitializing, msgWorking, msgRankCompleted, msgInitialized};
+		typedef void (*ProgressFn)(ProgressMsg pmsg, rank_t arank, void* p);
+		static void *pShowProgressData;
+		static void SetShowProgress(ProgressFn apfn, void *p =0);	// install a callback function
+	private:
+		static void ConsoleShowProgress(ProgressMsg pmsg, rank_t arank = 0, void* =0);	// default function
+		static void OccasionalShowProgress(std::size_t ntries = 1);	// called by RefContainer<>
+		static ProgressFn pShowProgress;				// the show-progress function callback
+		
+		friend class RefContainer<RefLine>;				// gets to call OccasionalShowProgress()
+		friend class RefContainer<RefMark>;				// ditto
+		
+		// Keeping to maxSeconds
+		
+	public:
+		static bool RanOutOfTime();			// true if the last build was cut short
+	private:
+		static double startTime;			// when the build started, in seconds
+		static bool outOfTime;				// true once maxSeconds have gone by; only the
+											// building thread reads it directly
+		static void StartClock();
+		static void CheckClock();
+		
+		friend class RefBuilder<RefLine>;				// stops when outOfTime
+		friend class RefBuilder<RefMark>;				// ditto
+		
+		// Creation of all marks and lines
+		
+	private:
+		static int CountThreads();
+		template <class R>
+		static void MakeAllOfType(RefBase::RefType atype, 
+			void (*amakeAll)(rank_t, RefBuilder<R>&), rank_t arank, RefContainer<R>& ac, 
+			std::size_t amax, int ashares = 1);
+		static std::size_t ShareLimit(std::size_t asize, std::size_t amax, int ashares);
+#ifdef USE_PTHREADS
+		template <class R>
+		static void MakeAllOfTypeThreaded(void (*amakeAll)(rank_t, RefBuilder<R>&), 
+			rank_t arank, RefContainer<R>& ac, std::size_t amax, RefBuildStats& as);
+#endif
+		static void MakeAllMarksAndLinesOfRank(rank_t arank);
+		static void SetLimitsFromBudget();
+		static void BuildCoverage();
+	public:
+		static void MakeAllMarksAndLines();
+		
+		// Building in the background. Searches made before the build is done look at the 
+		// marks and lines of the ranks finished so far.
+		
+		static void StartMakingAllMarksAndLines();	// start a build, return once searchable
+		static void FinishMakingAllMarksAndLines();	// wait for the build to finish
+		static bool IsMakingAllMarksAndLines();		// true until the build is finished
+		
+		// Deepening a finished set of marks and lines by one more rank, e.g. when searches
+		// don't come within maxError, without building the lower ranks again
+		
+		static void MakeMarksAndLinesOfNextRank(std::size_t amaxLines, std::size_t amaxMarks);
+		
+		// Bringing a finished set of marks and lines up to date after changes to the settings
+		// that decide which ones are valid: minAspectRatio, minAngleSine, visibilityMatters
+		// and the include flags of the lines
+		
+		static void ReconfigureMarksAndLines();
+	private:
+		static int builtIncludes;			// include flags the set was built with
+		static bool builtVisibilityMatters;	// visibilityMatters it was built with
+		static double builtMinAspectRatio;	// minAspectRatio it was built with
+		static double builtMinAngleSine;	// minAngleSine it was built with
+		static int IncludeFlags();			// include flags of the lines, one bit per axiom
+		static void NoteBuiltSettings();	// note the settings of the current build
+		static bool SettingsOnlyRestrict();	// true if no setting allows more than it did
+	private:
+		static RefView* currentView;		// latest view published, 0 = search everything
+		static bool publishViews;			// true = publish a view after each rank
+		static void PublishView(rank_t arank);	// make the ranks through arank searchable
+		static RefView* AcquireView();			// current view, held until released
+		static void ReleaseView(RefView* av);
+		static void* BackgroundMake(void*);		// thread routine for the build
+	public:
+		
+		// Counters that show where the time and the candidates of MakeAllMarksAndLines() 
+		// went, with a callback that gets each set of counters as it is finished
+		
+		static std::vector<RefBuildStats> buildStats;	// one per kind and rank, in order built
+		typedef void (*BuildStatsFn)(const RefBuildStats& as, void* p);
+		static void *pShowBuildStatsData;
+		static void SetShowBuildStats(BuildStatsFn apfn, void *p = 0);	// install a callback
+		static void PutBuildStats(std::ostream& os, bool asCSV = false);	// write a report
+	private:
+		static BuildStatsFn pShowBuildStats;			// the callback, 0 = none
+	public:
+		
+		// Saving and restoring the marks and lines in a snapshot file
+		
+		static std::string snapshotName;	// snapshot used by MakeAllMarksAndLines, "" = none
+		static bool loadSnapshot;			// false = always build, but still save a snapshot
+		static bool SaveSnapshot(const std::string& aName);
+		static bool LoadSnapshot(const std::string& aName);
+	private:
+		static bool RestoreSnapshot(const char* data, std::size_t size);
+	public:
+		
+		// An example that tests axiom O6.
+
+		static void MesserCubeRoot();
+
+		// Functions for searching for the best marks and/or lines
+
+		static void FindBestMarks(const XYPt& ap, std::vector<RefMark*>& vm, short numMarks);
+		static void FindBestLines(const XYLine& al, std::vector<RefLine*>& vl, short numLines);
+		
+		// Same, also giving the highest rank of the marks or lines that were searched
+		
+		static void FindBestMarks(const XYPt& ap, std::vector<RefMark*>& vm, short numMarks, 
+			rank_t& arank);
+		static void FindBestLines(const XYLine& al, std::vector<RefLine*>& vl, short numLines, 
+			rank_t& arank);
+		
+		// Same, for a whole batch of targets at once, searched with several threads
+		
+		static void FindBestMarks(const std::vector<XYPt>& ap, 
+			std::vector< std::vector<RefMark*> >& vm, short numMarks);
+		static void FindBestLines(const std::vector<XYLine>& al, 
+			std::vector< std::vector<RefLine*> >& vl, short numLines);
+	private:
+		template <class R>
+		static void FindBestOfType(void (*afind)(const typename R::bare_t&, std::vector<R*>&, 
+			short), const std::vector<typename R::bare_t>& at, 
+			std::vector< std::vector<R*> >& vr, short anum);
+	public:
+		
+		// Functions for finding every mark or line within atol of a target, by rank and 
+		// then error; or, if afrontier, just the ones closer than every one of lower rank
+		
+		static void FindMarksWithin(const XYPt& ap, double atol, std::vector<RefMark*>& vm, 
+			bool afrontier = false);
+		static void FindLinesWithin(const XYLine& al, double atol, std::vector<RefLine*>& vl, 
+			bool afrontier = false);
+		
+		// Same, for a whole batch of targets at once, searched with several threads
+		
+		static void FindMarksWithin(const std::vector<XYPt>& ap, double atol, 
+			std::vector< std::vector<RefMark*> >& vm, bool afrontier = false);
+		static void FindLinesWithin(const std::vector<XYLine>& al, double atol, 
+			std::vector< std::vector<RefLine*> >& vl, bool afrontier = false);
+	private:
+		template <class R>
+		static void FindWithinOfType(void (*awithin)(const typename R::bare_t&, double, 
+			std::vector<R*>&, bool), const std::vector<typename R::bare_t>& at, double atol, 
+			std::vector< std::vector<R*> >& vr, bool afrontier);
+	public:
+
+		// Utility routines for validating user input
+				
+		static bool ValidateMark(const XYPt& ap);
+		static bool ValidateLine(const XYPt& ap1, const XYPt& ap2);
+
+		// Utility routine for calculating statistics on marks
+
+		static void CalcStatistics();
+		
+		// Utility routine that times searches with and without the indexes
+
+		static void TimeSearches();
+};
+
+
+/******************************************************************************
+*
+*	Section 5: Routines for drawing diagrams
+*
+******************************************************************************/
+
+
+/**********
+*
+*	RefDgmr - object that draws folding diagrams of references. Subclasses specialize
+*	to particular drawing environments (print vs screen, multiple GUIs, platform-specific
+*	drawing models, etc.
+*
+**********/
+
+class RefDgmr {
+	public:
+		RefDgmr() {};
+		virtual ~RefDgmr() {};
+
+		// Subclasses must override these methods
+		
+		enum PointStyle {normalPt, hilitePt, actionPt};
+		virtual void DrawPt(const XYPt& aPt, PointStyle pstyle);
+
+		enum LineStyle {creaseLine, edgeLine, hiliteLine, valleyLine, mountainLine, arrowLine};
+		virtual void DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle);
+		virtual void DrawArc(const XYPt& ctr, const double rad, const double fromAngle,
+			const double toAngle, const bool ccw, LineStyle lstyle);
+		
+		enum PolyStyle {whitePoly, coloredPoly, arrowPoly};
+		virtual void DrawPoly(const std::vector<XYPt>& poly, PolyStyle pstyle);
+		
+		enum LabelStyle {normalLabel, hiliteLabel, actionLabel};
+		virtual void DrawLabel(const XYPt& aPt, const std::string& aString, LabelStyle lstyle);
+		
+		// Subclasses may use or override these methods
+
+		virtual void CalcArrow(const XYPt& fromPt, const XYPt& toPt,
+			XYPt& ctr, double& rad, double& fromAngle, double& toAngle, bool& ccw,
+			double& ahSize, XYPt& fromDir, XYPt& toDir);
+		virtual void DrawValleyArrowhead(const XYPt& loc, const XYPt& dir, const double len);
+		virtual void DrawMountainArrowhead(const XYPt& loc, const XYPt& dir, const double len);
+		virtual void DrawUnfoldArrowhead(const XYPt& loc, const XYPt& dir, const double len);
+		virtual void DrawValleyArrow(const XYPt& fromPt, const XYPt& toPt);
+		virtual void DrawMountainArrow(const XYPt& fromPt, const XYPt& toPt);
+		virtual void DrawUnfoldArrow(const XYPt& fromPt, const XYPt& toPt);
+		virtual void DrawFoldAndUnfoldArrow(const XYPt& fromPt, const XYPt& toPt);
+};
+
+
+/**********
+*
+*	class ConsoleTextDgmr - a minimal subclass of RefDgmr that puts verbal-only descriptions
+*	to the console.
+*
+**********/
+
+class ConsoleTextDgmr : public RefDgmr {
+	public:
+		ConsoleTextDgmr() {};
+		virtual ~ConsoleTextDgmr() {};
+
+	private:
+		template <class R>
+		static void PutRefList(const typename R::bare_t& ar, std::vector<R*>& vr);
+	public:
+		static void PutMarkList(const XYPt& pp, std::vector<RefMark*>& vm);
+		static void PutLineList(const XYLine& ll, std::vector<RefLine*>& vl);
+};
+
+
+/**********
+*
+*	class JSONLinesDgmr - a subclass of RefDgmr that puts machine-readable descriptions to
+*	a stream, one JSON object per line: the target, and for each ref found its error, rank,
+*	construction sequence and (optionally) verbal directions.
+*
+**********/
+
+class JSONLinesDgmr : public RefDgmr {
+	public:
+		std::ostream& os;				// stream that gets the JSON objects
+		bool putHowto;					// include the verbal directions of each ref?
+		
+		JSONLinesDgmr(std::ostream& aos, bool aputHowto = false) : 
+			os(aos), putHowto(aputHowto) {};
+		virtual ~JSONLinesDgmr() {};
+
+	private:
+		static void PutString(std::ostream& aos, const std::string& as);
+		static void PutNumber(std::ostream& aos, double ad);
+		static void PutBare(std::ostream& aos, const XYPt& ap);
+		static void PutBare(std::ostream& aos, const XYLine& al);
+		static void PutBare(std::ostream& aos, const RefMark* rm);
+		static void PutBare(std::ostream& aos, const RefLine* rl);
+		template <class R>
+		void PutRefList(const typename R::bare_t& ar, std::vector<R*>& vr, 
+			std::size_t ainput, const std::string& aDiagrams, int apage);
+	public:
+		void PutMarkList(const XYPt& pp, std::vector<RefMark*>& vm, std::size_t ainput, 
+			const std::string& aDiagrams = "", int apage = 0);
+		void PutLineList(const XYLine& ll, std::vector<RefLine*>& vl, std::size_t ainput, 
+			const std::string& aDiagrams = "", int apage = 0);
+		void PutProblem(std::size_t ainput, const std::string& amsg);
+};
+
+
+/**********
+*
+*	PSDgmr - a subclass of RefDgmr that writes PostScript code for diagrams to a stream, 
+*	a page or more for each target. Base class of the PostScript diagrammers below, which
+*	decide where the code goes.
+*
+**********/
+
+class PSDgmr : public RefDgmr {
+	public:
+		XYPt origin;					// current location of the origin, in PostScript units
+		static double usize;			// size in points of a unit square
+		static const XYRect pageSize;	// printable area on the page
+		int pageNum;					// page counter
+			
+		PSDgmr() : pageNum(0), psout(0) {};
+		virtual ~PSDgmr() {};
+
+		// Overridden functions from ancestor class RefDgmr
+		
+	public:
+		void DrawPt(const XYPt& aPt, PointStyle pstyle);
+		void DrawLine(const XYPt& fromPt, const XYPt& toPt, LineStyle lstyle);
+		void DrawArc(const XYPt& ctr, const double rad, const double fromAngle,
+			const double toAngle, const bool ccw, LineStyle lstyle);
+		void DrawPoly(const std::vector<XYPt>& poly, PolyStyle pstyle);
+		void DrawLabel(const XYPt& aPt, const std::string& aString, LabelStyle lstyle);
+		
+		// PSDgmr - specific stuff
+	
+	protected:
+		std::ostream* psout;			// the stream to which the PostScript code gets written
+		
+		class PSPt {
+			public:
+				double px;
+				double py;
+				PSPt(const PSDgmr& adgmr, const XYPt& aPt);	// performs coordinate transformation
+		};
+		friend std::ostream& operator<<(std::ostream& os, const PSPt& pp);
+	
+		void SetPointStyle(PointStyle pstyle);
+		void SetLineStyle(LineStyle lstyle);
+		void SetPolyStyle(PolyStyle pstyle);
+		void SetLabelStyle(LabelStyle lstyle);
+
+		void DecrementOrigin(double d);
+		static void PutProlog(std::ostream& os);
+		static void PutTrailer(std::ostream& os, int apages);
+		virtual void PutDiagram(RefContext& ac, const RefBase::DgmInfo& aDgm);
+		template <class R>
+		void PutRefPages(const typename R::bare_t& ar, std::vector<R*>& vr);
+};
+
+
+/**********
+*
+*	PSFileDgmr - a subclass of PSDgmr that writes a PostScript file of diagrams for each 
+*	target.
+*
+**********/
+
+class PSFileDgmr : public PSDgmr {
+	public:
+		std::fstream psfile;			// the file to which all the postscript code gets written
+		static int fileNum;				// file counter, shared by all PSFileDgmrs
+		std::string fileName;			// file name
+			
+		PSFileDgmr() {};
+		virtual ~PSFileDgmr() {};
+
+	private:
+		template <class R>
+		void PutRefList(const typename R::bare_t& ar, std::vector<R*>& vr);
+
+	public:
+		void PutMarkList(const XYPt& pp, std::vector<RefMark*>& vm);
+		void PutLineList(const XYLine& ll, std::vector<RefLine*>& vl);
+};
+
+
+/**********
+*
+*	PSDocumentDgmr - a subclass of PSDgmr that puts the diagrams for any number of targets
+*	into a single PostScript document, kept in memory until it's asked for or written to a
+*	file in one go. Each diagram is drawn once, relative to its own corner, and the code 
+*	is kept under the sequence of refs it shows, so the diagrams of the steps that many 
+*	solutions share (the low-rank ones, mostly) are only drawn the first time. A document 
+*	only holds pointers to refs, so it shouldn't outlive the marks and lines it shows.
+*
+**********/
+
+class PSDocumentDgmr : public PSDgmr {
+	public:
+		static std::size_t maxCacheBytes;	// most PostScript code to keep for reuse
+		
+		PSDocumentDgmr();
+		virtual ~PSDocumentDgmr() {};
+		
+		int PutMarkList(const XYPt& pp, std::vector<RefMark*>& vm);		// returns 1st page
+		int PutLineList(const XYLine& ll, std::vector<RefLine*>& vl);	// ditto
+		
+		std::string Document() const;						// the whole document
+		bool WriteDocument(const std::string& aName) const;	// write it to a file
+		std::size_t CacheHits() const {return mHits;};		// diagrams that were reused
+		std::size_t CacheMisses() const {return mMisses;};	// diagrams that were drawn
+		
+	protected:
+		void PutDiagram(RefContext& ac, const RefBase::DgmInfo& aDgm);
+		
+	private:
+		typedef std::vector<const RefBase*> dgmkey_t;	// the refs a diagram shows, in order
+		std::ostringstream mBody;						// the pages so far
+		std::map<dgmkey_t, std::string> mCache;			// code for each diagram drawn
+		std::size_t mCacheBytes;						// total size of the code in mCache
+		std::size_t mHits;								// diagrams found in mCache
+		std::size_t mMisses;							// diagrams drawn
+		template <class R>
+		int PutRefList(const typename R::bare_t& ar, std::vector<R*>& vr);
+};
+
+#endif // _REFERENCEFINDER_H_
@@ -0,0 +1,500 @@
+/******************************************************************************
+
+	ReferenceFinder_bench - a benchmark for the ReferenceFinder engine.
+
+	Builds the marks and lines from scratch with the settings given on the command line,
+	then searches for the best marks and lines for a fixed, seeded sample of random target
+	points and lines with several threads at once, and writes a report as one JSON object:
+
+	- the settings and the number of threads used;
+	- the time to build each rank (wall clock) and the time and candidates taken by each
+	  kind of mark and line, i.e., each axiom (processor time, from buildStats);
+	- the peak memory of the process after the build and after the searches;
+	- percentiles of the time taken by single searches, and the overall rate;
+	- how close the best solution came to the target, and the rank of the first
+	  solution offered, for marks and for lines.
+
+	The targets depend only on the seed and the number of samples, and the searches are
+	deterministic, so the accuracy part of two reports made with the same settings should
+	match exactly; the timing parts vary from run to run and machine to machine. Compare
+	reports from before and after a change to catch regressions. Run with --help to get
+	a usage message. Built and run by "make -f makefile.unx bench".
+
+	Uses POSIX calls for the clock and the peak memory, so it's only built for Unix.
+
+******************************************************************************/
+
+#include "ReferenceFinder.h"
+
+#include <cstdlib>
+#include <algorithm>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#ifdef USE_PTHREADS
+#include <pthread.h>
+#endif // USE_PTHREADS
+
+using namespace std;
+
+
+static const char benchUsage[] =
+	"usage: ReferenceFinder_bench [--samples n] [--seed n] [--count n] [--threads n]\n"
+	"                             [--rank n] [--lines n] [--marks n] [--memory mb]\n"
+	"                             [--resolution n] [--fair] [--coverage n] [--out file]\n"
+	"\n"
+	"Build the marks and lines from scratch, search for random target points and lines,\n"
+	"and write the times, peak memory and accuracy as JSON.\n"
+	"  --samples n   number of target points, and of target lines (default 10000)\n"
+	"  --seed n      seed for picking the targets (default 1)\n"
+	"  --count n     number of solutions per target (default 5)\n"
+	"  --threads n   number of threads to build and search with (default one per CPU)\n"
+	"  --rank n      highest rank of marks and lines to make\n"
+	"  --lines n     most lines to make\n"
+	"  --marks n     most marks to make\n"
+	"  --memory mb   set the number of marks and lines to make from the megabytes\n"
+	"                they may take, instead of the limits\n"
+	"  --resolution n\n"
+	"                tell apart marks and lines n steps apart in each coordinate\n"
+	"  --fair        share the room for marks and lines out evenly among the ranks and\n"
+	"                the kinds of line\n"
+	"  --coverage n  also make tables of the best marks and lines for n by n cells\n"
+	"  --out file    write the report to file instead of the standard output\n";
+
+
+/*****
+*
+*	Seconds() - a wall clock for timing, in seconds from some arbitrary start.
+*
+*****/
+
+static double Seconds()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return double(ts.tv_sec) + 1.e-9 * double(ts.tv_nsec);
+}
+
+
+/*****
+*
+*	PeakMegabytes() - the largest resident memory the process has had so far.
+*
+*****/
+
+static double PeakMegabytes()
+{
+	rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return double(ru.ru_maxrss) / 1024.;	// Linux gives kilobytes
+}
+
+
+/**********
+*
+*	BenchRandom - the "minimal standard" random number generator of Park and Miller,
+*	computed with Schrage's method so it gives the same numbers on every platform, unlike
+*	rand().
+*
+**********/
+
+class BenchRandom {
+	public:
+		BenchRandom(long aseed) : mState(aseed % 2147483646L + 1) {
+			if (mState <= 0) mState += 2147483646L;
+		};
+		double Next() {		// uniform in (0, 1)
+			long hi = mState / 127773L;
+			long lo = mState % 127773L;
+			mState = 16807L * lo - 2836L * hi;
+			if (mState <= 0) mState += 2147483647L;
+			return double(mState) / 2147483647.;
+		};
+	private:
+		long mState;
+};
+
+
+/*****
+*
+*	Build timing. The progress callback notes the time each rank is finished, and when the
+*	indexes are done.
+*
+*****/
+
+static vector<double> rankDone;		// wall clock time each rank was finished
+static double initDone = 0;			// wall clock time the indexes were finished
+
+static void benchShowProgress(ReferenceFinder::ProgressMsg pmsg, RefBase::rank_t arank,
+	void*)
+{
+	if (pmsg == ReferenceFinder::msgRankCompleted) {
+		if (rankDone.size() <= size_t(arank)) rankDone.resize(arank + 1, 0.);
+		rankDone[arank] = Seconds();
+	}
+	else if (pmsg == ReferenceFinder::msgInitialized) initDone = Seconds();
+}
+
+
+/**********
+*
+*	BenchJob<R> - the state shared by the threads that search for one kind of target.
+*	Worker threads take runs of targets in turn; for each one they note how long the
+*	search took, how close the best solution came, and the rank of the first solution.
+*
+**********/
+
+template <class R>
+class BenchJob {
+	public:
+		typedef void (*find_t)(const typename R::bare_t&, vector<R*>&, short);
+		find_t mFind;								// the search to time
+		const vector<typename R::bare_t>& mTargets;	// the targets
+		short mCount;								// solutions per target
+		vector<double> mSeconds;					// time taken for each target
+		vector<double> mErrors;						// error of the best solution of each
+		vector<int> mRanks;							// rank of the first solution of each
+		size_t mNext;								// next target to take
+#ifdef USE_PTHREADS
+		pthread_mutex_t mMutex;						// guards mNext
+#endif // USE_PTHREADS
+
+		BenchJob(find_t afind, const vector<typename R::bare_t>& at, short acount) :
+			mFind(afind), mTargets(at), mCount(acount), mSeconds(at.size()),
+			mErrors(at.size()), mRanks(at.size()), mNext(0) {
+#ifdef USE_PTHREADS
+			pthread_mutex_init(&mMutex, 0);
+#endif // USE_PTHREADS
+		};
+		~BenchJob() {
+#ifdef USE_PTHREADS
+			pthread_mutex_destroy(&mMutex);
+#endif // USE_PTHREADS
+		};
+		void Run(int nthreads);
+	private:
+		static void* Work(void* p);
+};
+
+
+/*****
+*
+*	BenchJob<R>::Work(void* p) - thread routine; searches for runs of targets until there
+*	are none left.
+*
+*****/
+
+template <class R>
+void* BenchJob<R>::Work(void* p)
+{
+	const size_t runSize = 64;
+	BenchJob<R>& job = *static_cast<BenchJob<R>*>(p);
+	vector<R*> vr;
+	while (true) {
+#ifdef USE_PTHREADS
+		pthread_mutex_lock(&job.mMutex);
+#endif // USE_PTHREADS
+		size_t i0 = job.mNext;
+		job.mNext = min(job.mNext + runSize, job.mTargets.size());
+		size_t i1 = job.mNext;
+#ifdef USE_PTHREADS
+		pthread_mutex_unlock(&job.mMutex);
+#endif // USE_PTHREADS
+		if (i0 >= i1) return 0;
+		for (size_t i = i0; i < i1; i++) {
+			double t0 = Seconds();
+			(*job.mFind)(job.mTargets[i], vr, job.mCount);
+			job.mSeconds[i] = Seconds() - t0;
+			double err = -1;
+			for (size_t j = 0; j < vr.size(); j++) {
+				double d = vr[j]->Distance(job.mTargets[i]);
+				if (err < 0 || d < err) err = d;
+			};
+			job.mErrors[i] = err;
+			job.mRanks[i] = vr.empty() ? -1 : int(vr[0]->mRank);
+		}
+	}
+}
+
+
+/*****
+*
+*	BenchJob<R>::Run(int nthreads) - search for all the targets with nthreads threads.
+*
+*****/
+
+template <class R>
+void BenchJob<R>::Run(int nthreads)
+{
+	mNext = 0;
+#ifdef USE_PTHREADS
+	if (nthreads > 1) {
+		vector<pthread_t> threads(nthreads);
+		for (int i = 0; i < nthreads; i++)
+			pthread_create(&threads[i], 0, &BenchJob<R>::Work, this);
+		for (int i = 0; i < nthreads; i++) pthread_join(threads[i], 0);
+		return;
+	};
+#endif // USE_PTHREADS
+	Work(this);
+}
+
+
+/*****
+*
+*	putPercentiles(ostream& os, vector<double> v, double scale) - write the mean, the
+*	usual percentiles and the extremes of v, each times scale, as the members of a JSON
+*	object.
+*
+*****/
+
+static void putPercentiles(ostream& os, vector<double> v, double scale)
+{
+	static const double pcts[] = {10, 50, 90, 95, 99, 99.9};
+	static const char* names[] = {"p10", "p50", "p90", "p95", "p99", "p99.9"};
+	const size_t npcts = sizeof(pcts) / sizeof(pcts[0]);
+	if (v.empty()) {
+		os << "{}";
+		return;
+	};
+	sort(v.begin(), v.end());
+	double sum = 0;
+	for (size_t i = 0; i < v.size(); i++) sum += v[i];
+	os << "{\"mean\":" << scale * sum / v.size() << ",\"min\":" << scale * v.front();
+	for (size_t j = 0; j < npcts; j++)
+		os << ",\"" << names[j] << "\":" <<
+			scale * v[min(v.size() - 1, size_t(pcts[j] / 100. * v.size()))];
+	os << ",\"max\":" << scale * v.back() << "}";
+}
+
+
+/*****
+*
+*	putStats(ostream& os, const RefBuildStats& bs) - write the candidates tried, the
+*	processor time and the outcomes in bs as the members of a JSON object.
+*
+*****/
+
+static void putStats(ostream& os, const RefBuildStats& bs)
+{
+	os << "\"tries\":" << bs.mTries << ",\"seconds\":" << bs.mSeconds;
+	for (int j = 0; j < RefBase::numOutcomes; j++)
+		os << ",\"" << RefBuildStats::OutcomeName(RefBase::Outcome(j)) << "\":" <<
+			bs.mOutcomes[j];
+}
+
+
+/*****
+*
+*	putSearches(ostream& os, const BenchJob<R>& job, double aseconds) - write the timing
+*	and accuracy of the searches of job, which took aseconds in all, as a JSON object.
+*	Errors are bucketed in steps of a tenth of maxError, as cumulative counts.
+*
+*****/
+
+template <class R>
+static void putSearches(ostream& os, const BenchJob<R>& job, double aseconds)
+{
+	const int numBuckets = 10;
+	int buckets[numBuckets + 1];
+	for (int i = 0; i <= numBuckets; i++) buckets[i] = 0;
+	vector<double> errors;
+	vector<int> ranks(ReferenceFinder::maxRank + 2, 0);
+	size_t numGood = 0;
+	for (size_t i = 0; i < job.mErrors.size(); i++) {
+		ranks[job.mRanks[i] + 1]++;
+		if (job.mErrors[i] < 0) continue;
+		errors.push_back(job.mErrors[i]);
+		if (job.mErrors[i] <= ReferenceFinder::maxError) numGood++;
+		int ib = int(job.mErrors[i] / (.1 * ReferenceFinder::maxError));
+		buckets[min(ib, numBuckets)]++;
+	};
+	size_t n = job.mTargets.size();
+
+	os << "{\"targets\":" << n << ",\"seconds\":" << aseconds <<
+		",\"perSecond\":" << (aseconds > 0 ? n / aseconds : 0.) << ",\"micros\":";
+	putPercentiles(os, job.mSeconds, 1.e6);
+	os << ",\"error\":";
+	putPercentiles(os, errors, 1.);
+	os << ",\"withinMaxError\":" << numGood << ",\"errorBelow\":{";
+	int cum = 0;
+	for (int i = 0; i < numBuckets; i++) {
+		cum += buckets[i];
+		os << (i > 0 ? "," : "") << "\"" << .1 * (i + 1) * ReferenceFinder::maxError <<
+			"\":" << cum;
+	};
+	os << "},\"firstRank\":{";
+	bool first = true;
+	for (size_t r = 0; r < ranks.size(); r++) {
+		if (ranks[r] == 0) continue;
+		if (r == 0) os << "\"none\":" << ranks[r];
+		else os << (first ? "" : ",") << "\"" << r - 1 << "\":" << ranks[r];
+		first = false;
+	};
+	os << "}}";
+}
+
+
+/*****
+*
+*	main(int argc, char* argv[]) - parse the command line, build, search, and report.
+*
+*****/
+
+int main(int argc, char* argv[])
+{
+	bool argsOK = true;
+	long samples = 10000;
+	long seed = 1;
+	int count = 5;
+	int resolution = 0;
+	string outName;
+	for (int i = 1; i < argc; i++) {
+		string arg(argv[i]);
+		if (arg == "--samples" && i + 1 < argc) samples = atol(argv[++i]);
+		else if (arg == "--seed" && i + 1 < argc) seed = atol(argv[++i]);
+		else if (arg == "--count" && i + 1 < argc) count = atoi(argv[++i]);
+		else if (arg == "--threads" && i + 1 < argc)
+			ReferenceFinder::numThreads = atoi(argv[++i]);
+		else if (arg == "--rank" && i + 1 < argc)
+			ReferenceFinder::maxRank = RefBase::rank_t(atoi(argv[++i]));
+		else if (arg == "--lines" && i + 1 < argc)
+			ReferenceFinder::maxLines = size_t(atol(argv[++i]));
+		else if (arg == "--marks" && i + 1 < argc)
+			ReferenceFinder::maxMarks = size_t(atol(argv[++i]));
+		else if (arg == "--memory" && i + 1 < argc)
+			ReferenceFinder::memoryBudget = size_t(atof(argv[++i]) * 1048576.0);
+		else if (arg == "--resolution" && i + 1 < argc) resolution = atoi(argv[++i]);
+		else if (arg == "--fair") ReferenceFinder::fairShares = true;
+		else if (arg == "--coverage" && i + 1 < argc)
+			ReferenceFinder::coverageCells = atoi(argv[++i]);
+		else if (arg == "--out" && i + 1 < argc) outName = argv[++i];
+		else argsOK = false;
+	};
+	if (!argsOK || samples < 1 || count < 1 || count > 100 || resolution < 0 ||
+		ReferenceFinder::numThreads < 0 || ReferenceFinder::coverageCells < 0) {
+		cerr << benchUsage;
+		return 1;
+	};
+	if (resolution > 0) {
+		RefMark::SetDiscretization(resolution, resolution);
+		RefLine::SetDiscretization(resolution, resolution);
+	};
+
+	ofstream outFile;
+	if (!outName.empty()) {
+		outFile.open(outName.c_str());
+		if (!outFile) {
+			cerr << "ReferenceFinder_bench: can't open " << outName << endl;
+			return 1;
+		}
+	};
+	ostream& os = outFile.is_open() ? static_cast<ostream&>(outFile) : cout;
+
+	// Pick the targets before anything else, so they don't depend on the build. Target
+	// lines go through two random points.
+
+	BenchRandom rng(seed);
+	vector<XYPt> points(samples);
+	vector<XYLine> lines;
+	for (long i = 0; i < samples; i++) {
+		double x = RefBase::paper.pWidth * rng.Next();
+		points[i] = XYPt(x, RefBase::paper.pHeight * rng.Next());
+	};
+	while (lines.size() < size_t(samples)) {
+		double x1 = RefBase::paper.pWidth * rng.Next();
+		XYPt p1(x1, RefBase::paper.pHeight * rng.Next());
+		double x2 = RefBase::paper.pWidth * rng.Next();
+		XYPt p2(x2, RefBase::paper.pHeight * rng.Next());
+		if ((p1 - p2).Mag() > EPS) lines.push_back(XYLine(p1, p2));
+	};
+
+	// Build from scratch; a snapshot would skip what we want to time.
+
+	ReferenceFinder::snapshotName = "";
+	ReferenceFinder::SetShowProgress(benchShowProgress);
+	double buildStart = Seconds();
+	ReferenceFinder::MakeAllMarksAndLines();
+	double buildEnd = Seconds();
+	double buildMegabytes = PeakMegabytes();
+
+	// Search with all the threads at once.
+
+	int nthreads = ReferenceFinder::numThreads;
+	if (nthreads <= 0) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? int(ncpu) : 1;
+	};
+#ifndef USE_PTHREADS
+	nthreads = 1;
+#endif // USE_PTHREADS
+	void (*findMarks)(const XYPt&, vector<RefMark*>&, short) =
+		&ReferenceFinder::FindBestMarks;
+	void (*findLines)(const XYLine&, vector<RefLine*>&, short) =
+		&ReferenceFinder::FindBestLines;
+	BenchJob<RefMark> markJob(findMarks, points, short(count));
+	BenchJob<RefLine> lineJob(findLines, lines, short(count));
+	double t0 = Seconds();
+	markJob.Run(nthreads);
+	double t1 = Seconds();
+	lineJob.Run(nthreads);
+	double t2 = Seconds();
+
+	// Write the report. Processor times for each kind and rank come from buildStats; we
+	// add them up by rank and by kind.
+
+	os << "{\"settings\":{\"samples\":" << samples << ",\"seed\":" << seed <<
+		",\"count\":" << count << ",\"threads\":" << nthreads <<
+		",\"maxRank\":" << ReferenceFinder::maxRank <<
+		",\"maxLines\":" << ReferenceFinder::maxLines <<
+		",\"maxMarks\":" << ReferenceFinder::maxMarks <<
+		",\"maxError\":" << ReferenceFinder::maxError <<
+		",\"fairShares\":" << (ReferenceFinder::fairShares ? "true" : "false") <<
+		",\"coverageCells\":" << ReferenceFinder::coverageCells <<
+		",\"kernel\":\"" << RefScorer::KernelName() << "\"}";
+
+	os << ",\"build\":{\"seconds\":" << buildEnd - buildStart <<
+		",\"lines\":" << ReferenceFinder::basisLines.size() <<
+		",\"marks\":" << ReferenceFinder::basisMarks.size() << ",\"ranks\":[";
+	vector<RefBuildStats> byRank;
+	vector<RefBuildStats> byType;
+	for (size_t i = 0; i < ReferenceFinder::buildStats.size(); i++) {
+		const RefBuildStats& bs = ReferenceFinder::buildStats[i];
+		while (byRank.size() <= size_t(bs.mRank))
+			byRank.push_back(RefBuildStats(RefBase::markOriginal,
+				RefBase::rank_t(byRank.size())));
+		byRank[bs.mRank] += bs;
+		size_t j = 0;
+		while (j < byType.size() && byType[j].mType != bs.mType) j++;
+		if (j == byType.size()) byType.push_back(RefBuildStats(bs.mType, 0));
+		byType[j] += bs;
+	};
+	double last = buildStart;
+	for (size_t r = 0; r < rankDone.size(); r++) {
+		os << (r > 0 ? "," : "") << "{\"rank\":" << r << ",\"wallSeconds\":" <<
+			(rankDone[r] > 0 ? rankDone[r] - last : 0.);
+		if (rankDone[r] > 0) last = rankDone[r];
+		if (r < byRank.size()) {
+			os << ",";
+			putStats(os, byRank[r]);
+		};
+		os << "}";
+	};
+	os << "],\"indexSeconds\":" << (initDone > last ? initDone - last : 0.) <<
+		",\"kinds\":[";
+	for (size_t j = 0; j < byType.size(); j++) {
+		os << (j > 0 ? "," : "") << "{\"type\":\"" <<
+			RefBuildStats::TypeName(byType[j].mType) << "\",";
+		putStats(os, byType[j]);
+		os << "}";
+	};
+	os << "]},\"peakMegabytes\":{\"build\":" << buildMegabytes <<
+		",\"searches\":" << PeakMegabytes() << "}";
+
+	os << ",\"marks\":";
+	putSearches(os, markJob, t1 - t0);
+	os << ",\"lines\":";
+	putSearches(os, lineJob, t2 - t1);
+	os << "}" << endl;
+	return 0;
+}
@@ -1 +1,633 @@
-/******************************************************************************	ReferenceFinder - a program for finding compact folding sequences for locating 	approximate reference points on a unit square.		Version 3.1		Copyright 1999-2003 by Robert J. Lang. All rights reserved.		Rights of usage: you may compile this code and modifications thereof for your 	own personal use. You may not redistribute this code or modifications thereof.		ReferenceFinder is ANSI C++ code that should compile for any compiler/platform	that supports the C++ standard library.		After the program initializes, the user is prompted for x and y coordinates of	a desired point or line. The program responds with several folding sequences based on 	lines and marks made by folding (no measuring).		See file "README.txt" for version history and compilation notes.******************************************************************************/ // #define CALCINPUT to use the expression evaluator, which accepts symbolic input. If// CALCINPUT is undefined, we'll just use the standard console cin, which wants to see// decimal values.#define CALCINPUT 1#include "ReferenceFinder.h"using namespace std;// if we're using CodeWarrior for the Mac, customize the size of the console window.// __MACOS__ is a CodeWarrior predefined compiler symbol. If we're running CodeWarrior,// the we're using SIOUX as our console window, so we can go in and manipulate the // SIOUX globals to expand the console window.	#ifdef __MWERKS__#ifdef __MACOS__#include <SIOUX.h>#endif#endif//#include "profiler.h"	// Uncomment this to generate profiling information/*******	readNumber (double &n) - Get a number from the user, either via the expression*	evaluator (if CALCINPUT is defined) or from the standard input cin.******/#ifdef CALCINPUT#include "parser.h"Parser parser;/* Read a string from console, parse a numerical expression and   save result in parameter. Loop until a valid expression is   entered. Abort if user ends input.   At present, double readNumber (void) would be enough; we could   generalize it to boolean readNumber (double &) and let user   abort without entering a valid expression.*/ static void readNumber (double &n, bool assumeDefault = true) {  string buffer;	// text read here  for ( ; ! cin.eof (); ) {    getline (cin, buffer);    Parser::errType err = parser.evaluate (buffer, n, assumeDefault);    if (err != Parser::none)      cerr << "  Error (" << Parser::parseMessage (err) << "), try again: ";    else      break;  }  if (cin.eof ())    exit (0);}#else// Use the std console if we're not using the expression evaluatorstatic void readNumber (double& n, bool) {	cin >> n;}#endif/********************************	Main program loop*******************************/int main(){	#ifdef __MACOS__#ifdef __MWERKS__	// blow up the SIOUX console window to display more characters and rows.	// SIOUX will shrink the console to fit the screen.	// Also on quit, close the window.		SIOUXSettings.rows = 120;	SIOUXSettings.columns = 120;	SIOUXSettings.autocloseonquit = true;#endif#endif		cout << "ReferenceFinder v. 3.1" << endl;	cout << "Copyright 1999-2003 by Robert J. Lang. All rights reserved." << endl;		#ifdef __PROFILER__	ProfilerInit(collectDetailed, bestTimeBase, 200, 15);	// Turn on the profiler#endif	ReferenceFinder::MakeAllMarksAndLines();				// Make a complete set of marks#ifdef __PROFILER__	ProfilerDump("\pReferenceFinder 3.1.prof");				// dump profile info to file#endif	//	Loop forever until the user quits from the menu.	while (1) {		cout << "0 = exit, 1 = find mark, 2 = find line : ";		double ns;		readNumber(ns, false);		switch (int(ns)) {			case 0:				{					exit(1);				};				break;						case 1:				{					XYPt pp(0, 0);						cout << endl << "Enter x coordinate: ";					readNumber (pp.x);					cout << "Enter y coordinate: ";					readNumber (pp.y);					if (ReferenceFinder::ValidateMark(pp)) {						vector<RefMark*> vm;						ReferenceFinder::FindBestMarks(pp, vm, 5);												// Write verbal directions to the console						ConsoleTextDgmr tdgmr;						tdgmr.PutMarkList(pp, vm);												// Also draw Postscript directions to a file						PSFileDgmr pdgmr;						pdgmr.PutMarkList(pp, vm);						cout << "Diagrams in <" << pdgmr.fileName << ">." << endl;					}				}				break;					case 2:				{					XYPt p1, p2;					cout << endl << "Enter p1 x coordinate: ";					readNumber (p1.x);					cout << "Enter p1 y coordinate: ";					readNumber (p1.y);					cout << endl << "Enter p2 x coordinate: ";					readNumber (p2.x);					cout << "Enter p2 y coordinate: ";					readNumber (p2.y);					if (ReferenceFinder::ValidateLine(p1, p2)) {						XYLine ll(p1, p2);						vector<RefLine*> vl;						ReferenceFinder::FindBestLines(ll, vl, 5);												// Write verbal directions to the console						ConsoleTextDgmr tdgmr;						tdgmr.PutLineList(ll, vl);												// Also draw Postscript directions to a file						PSFileDgmr pdgmr;						pdgmr.PutLineList(ll, vl);						cout << "Diagrams in <" << pdgmr.fileName << ">." << endl;					}				}				break;									case 99:	// hidden command to calculate statistics on marks				ReferenceFinder::CalcStatistics();				break;						default:				cout << "Enter just 0, 1 or 2, please.\n\n";		}	};	return 0;}
\ No newline at end of file
+/******************************************************************************
+
+	ReferenceFinder - a program for finding compact folding sequences for locating 
+	approximate reference points on a unit square.
+	
+	Version 3.1
+	
+	Copyright ©1999-2003 by Robert J. Lang. All rights reserved.
+	
+	Rights of usage: you may compile this code and modifications thereof for your 
+	own personal use. You may not redistribute this code or modifications thereof.
+	
+	ReferenceFinder is ANSI C++ code that should compile for any compiler/platform
+	that supports the C++ standard library.
+	
+	After the program initializes, the user is prompted for x and y coordinates of
+	a desired point or line. The program responds with several folding sequences based on 
+	lines and marks made by folding (no measuring).
+	
+	Run with --background to get answers while the marks and lines are still being built,
+	with --batch to answer a whole file of targets instead, or with --stats to see where
+	the time to build the marks and lines goes; see batchUsage below.
+	
+	See file "README.txt" for version history and compilation notes.
+
+******************************************************************************/
+ 
+// #define CALCINPUT to use the expression evaluator, which accepts symbolic input. If
+// CALCINPUT is undefined, we'll just use the standard console cin, which wants to see
+// decimal values.
+
+#define CALCINPUT 1
+
+#include "ReferenceFinder.h"
+
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+
+// if we're using CodeWarrior for the Mac, customize the size of the console window.
+// __MACOS__ is a CodeWarrior predefined compiler symbol. If we're running CodeWarrior,
+// the we're using SIOUX as our console window, so we can go in and manipulate the 
+// SIOUX globals to expand the console window.
+	
+#ifdef __MWERKS__
+#ifdef __MACOS__
+#include <SIOUX.h>
+#endif
+#endif
+
+
+//#include "profiler.h"	// Uncomment this to generate profiling information
+
+/*****
+*
+*	readNumber (double &n) - Get a number from the user, either via the expression
+*	evaluator (if CALCINPUT is defined) or from the standard input cin.
+*
+*****/
+
+#ifdef CALCINPUT
+#include "parser.h"
+
+Parser parser;
+
+/* Read a string from console, parse a numerical expression and
+   save result in parameter. Loop until a valid expression is
+   entered. Abort if user ends input.
+   At present, double readNumber (void) would be enough; we could
+   generalize it to boolean readNumber (double &) and let user
+   abort without entering a valid expression.
+*/ 
+static void readNumber (double &n, bool assumeDefault = true) {
+  string buffer;	// text read here
+  for ( ; ! cin.eof (); ) {
+    getline (cin, buffer);
+    Parser::errType err = parser.evaluate (buffer, n, assumeDefault);
+    if (err != Parser::none)
+      cerr << "  Error (" << Parser::parseMessage (err) << "), try again: ";
+    else
+      break;
+  }
+  if (cin.eof ())
+    exit (0);
+}
+#else
+// Use the std console if we're not using the expression evaluator
+static void readNumber (double& n, bool) {
+	cin >> n;
+}
+#endif
+
+
+/******************************
+*
+*	Batch mode
+*
+******************************/
+
+static const char batchUsage[] = 
+	"usage: ReferenceFinder [--background]\n"
+	"       ReferenceFinder [--batch [--howto] [--diagrams] [--count n] [file]]\n"
+	"                       [--threads n] [--stats file] [--memory mb] [--resolution n]\n"
+	"                       [--seconds s] [--fair] [--coverage n]\n"
+	"                       [--within d] [--frontier] [--document file]\n"
+	"                       [--snapshot file]\n"
+	"\n"
+	"With --background, prompt for targets right away and answer from the ranks built\n"
+	"so far while the rest are built.\n"
+	"\n"
+	"With --batch, read targets from file (or the standard input), one per line:\n"
+	"  x, y              find marks close to the point (x, y)\n"
+	"  x1, y1, x2, y2    find lines close to the line through (x1, y1) and (x2, y2)\n"
+	"Fields are separated by commas, or by blanks if there are no commas. Blank lines\n"
+	"and lines starting with # are skipped. The answers go to the standard output as\n"
+	"JSON Lines, one object per target, in the order of the targets.\n"
+	"  --howto       include the verbal directions for each solution\n"
+	"  --diagrams    also write a PostScript file of diagrams for each target\n"
+	"  --document file\n"
+	"                instead, put the diagrams for all the targets in one PostScript\n"
+	"                file, written once all the targets are answered\n"
+	"  --count n     number of solutions per target (default 5)\n"
+	"  --within d    give every solution within d of the target instead, by number of\n"
+	"                folds (rank) and then error\n"
+	"  --frontier    give only the solutions closer than all those of lower rank, each\n"
+	"                trading more folds for less error; within the distance given by\n"
+	"                --within, or else the largest error that counts as good enough\n"
+	"  --threads n   number of threads to build and search with (default one per CPU)\n"
+	"  --stats file  build the marks and lines from scratch and write how many candidates\n"
+	"                of each kind and rank were tried, how each ended, and the time\n"
+	"                taken to file: as CSV if its name ends in .csv, else as JSON\n"
+	"  --memory mb   set the number of marks and lines to make from the megabytes\n"
+	"                they may take, instead of the built-in limits\n"
+	"  --resolution n\n"
+	"                tell apart marks and lines n steps apart in each coordinate\n"
+	"                (default 2000); past about 46000, build with USE_WIDE_KEYS\n"
+	"  --seconds s   stop making marks and lines after about s seconds and make do\n"
+	"                with what has been made by then\n"
+	"  --fair        share the room for marks and lines out evenly among the ranks and\n"
+	"                the kinds of line, instead of first come, first served\n"
+	"  --coverage n  also make tables of the best marks and lines for each of n by n\n"
+	"                cells of targets, which answer most searches faster\n"
+	"  --snapshot file\n"
+	"                load the marks and lines from file if it was made with the same\n"
+	"                settings; if not, build them and save them there for next time\n";
+
+
+/*****
+*
+*	BatchItem - one target read in batch mode: its input line number, and either a
+*	point, a line, or the reason it couldn't be used.
+*
+*****/
+
+class BatchItem {
+	public:
+		size_t input;			// line number in the input
+		bool isLine;			// true = find lines, false = find marks
+		size_t index;			// index among the targets of the same kind
+		string problem;			// why the line couldn't be used, "" = OK
+};
+
+
+/*****
+*
+*	readField(const string& text, double& n, string& err) - evaluate one field of a batch
+*	line, either with the expression evaluator or as a plain decimal number. Batch files
+*	tend to repeat the same few formulas, so we keep the compiled form of the fields 
+*	we've seen (up to a point) and only parse the new ones.
+*
+*****/
+
+static bool readField(const string& text, double& n, string& err)
+{
+#ifdef CALCINPUT
+	const size_t maxCompiled = 4096;		// fields whose compiled form we keep
+	static map<string, Parser::Program> compiled;
+	map<string, Parser::Program>::iterator it = compiled.find(text);
+	Parser::errType perr = Parser::none;
+	if (it == compiled.end()) {
+		if (compiled.size() >= maxCompiled) compiled.clear();
+		Parser::Program prog;
+		perr = parser.compile(text, prog);
+		if (perr == Parser::none) 
+			it = compiled.insert(pair<const string, Parser::Program>(text, prog)).first;
+	};
+	if (perr == Parser::none) perr = Parser::run(it->second, n);
+	if (perr == Parser::none) return true;
+	err = Parser::parseMessage(perr);
+	return false;
+#else
+	istringstream is(text);
+	char c;
+	if ((is >> n) && !(is >> c)) return true;
+	err = "not a number";
+	return false;
+#endif
+}
+
+
+/*****
+*
+*	splitFields(const string& text, vector<string>& fields) - split a batch line into
+*	fields, at commas if there are any, otherwise at blanks.
+*
+*****/
+
+static void splitFields(const string& text, vector<string>& fields)
+{
+	fields.clear();
+	if (text.find(',') != string::npos) {
+		size_t start = 0;
+		while (true) {
+			size_t comma = text.find(',', start);
+			fields.push_back(text.substr(start, comma - start));
+			if (comma == string::npos) break;
+			start = comma + 1;
+		}
+	}
+	else {
+		istringstream is(text);
+		string field;
+		while (is >> field) fields.push_back(field);
+	}
+}
+
+
+/*****
+*
+*	batchShowProgress(...) - progress callback for batch mode, which keeps the standard
+*	output for the answers.
+*
+*****/
+
+static void batchShowProgress(ReferenceFinder::ProgressMsg pmsg, ReferenceFinder::rank_t, 
+	void*)
+{
+	if (pmsg != ReferenceFinder::msgInitialized) return;
+	cerr << "ReferenceFinder: " << ReferenceFinder::basisLines.size() << " lines and " << 
+		ReferenceFinder::basisMarks.size() << " marks" << endl;
+	if (ReferenceFinder::RanOutOfTime())
+		cerr << "ReferenceFinder: ran out of time before all were made" << endl;
+}
+
+
+/*****
+*
+*	runBatch(istream& in, bool howto, bool diagrams, short count, double within, 
+*		bool frontier, const string& document) - answer every target in in. We read the 
+*	targets a chunk at a time, search for all the targets of a chunk at once with several
+*	threads, and then write the answers in order, so output keeps flowing on long inputs.
+*	If within isn't 0, the answers are all the refs within that distance, by rank, 
+*	instead of the best count; if frontier, just the ones closer than all those of lower
+*	rank. If document isn't empty, the diagrams are collected in memory and written to
+*	that file at the end. Returns false if that couldn't be done.
+*
+*****/
+
+static bool runBatch(istream& in, bool howto, bool diagrams, short count, double within, 
+	bool frontier, const string& document)
+{
+	const size_t chunkSize = 4096;			// targets read at a time
+	JSONLinesDgmr jdgmr(cout, howto);
+	PSDocumentDgmr ddgmr;
+	size_t ninput = 0;
+	string text;
+	vector<string> fields;
+	bool more = true;
+	
+	while (more) {
+		vector<BatchItem> items;
+		vector<XYPt> points;
+		vector<XYLine> lines;
+		while (items.size() < chunkSize && (more = !getline(in, text).fail())) {
+			ninput++;
+			size_t first = text.find_first_not_of(" \t\r");
+			if (first == string::npos || text[first] == '#') continue;
+			BatchItem item;
+			item.input = ninput;
+			item.isLine = false;
+			item.index = 0;
+			splitFields(text, fields);
+			vector<double> vals(fields.size());
+			for (size_t i = 0; i < fields.size() && item.problem.empty(); i++) {
+				string err;
+				if (readField(fields[i], vals[i], err) && vals[i] - vals[i] != 0) 
+					err = "not a finite number";	// NaN or infinity
+				if (!err.empty()) {
+					ostringstream msg;
+					msg << "field " << i + 1 << ": " << err;
+					item.problem = msg.str();
+				}
+			};
+			if (!item.problem.empty()) {
+				items.push_back(item);
+				continue;
+			};
+			if (fields.size() == 2) {
+				XYPt pp(vals[0], vals[1]);
+				if (pp.x < 0 || pp.x > RefBase::paper.pWidth || 
+					pp.y < 0 || pp.y > RefBase::paper.pHeight)
+					item.problem = "point is not on the paper";
+				else {
+					item.index = points.size();
+					points.push_back(pp);
+				}
+			}
+			else if (fields.size() == 4) {
+				XYPt p1(vals[0], vals[1]);
+				XYPt p2(vals[2], vals[3]);
+				XYPt c1, c2;
+				if ((p1 - p2).Mag() <= EPS) item.problem = "the two points are not distinct";
+				else if (!RefBase::paper.ClipLine(XYLine(p1, p2), c1, c2) || c1 == c2)
+					item.problem = "line does not cross the paper";
+				else {
+					item.isLine = true;
+					item.index = lines.size();
+					lines.push_back(XYLine(p1, p2));
+				}
+			}
+			else item.problem = "expected 2 fields for a point or 4 for a line";
+			items.push_back(item);
+		};
+		
+		vector< vector<RefMark*> > marksFound;
+		vector< vector<RefLine*> > linesFound;
+		if (within > 0 || frontier) {
+			double tol = within > 0 ? within : ReferenceFinder::maxError;
+			ReferenceFinder::FindMarksWithin(points, tol, marksFound, frontier);
+			ReferenceFinder::FindLinesWithin(lines, tol, linesFound, frontier);
+		}
+		else {
+			ReferenceFinder::FindBestMarks(points, marksFound, count);
+			ReferenceFinder::FindBestLines(lines, linesFound, count);
+		};
+		
+		for (size_t i = 0; i < items.size(); i++) {
+			const BatchItem& item = items[i];
+			if (!item.problem.empty()) {
+				jdgmr.PutProblem(item.input, item.problem);
+				continue;
+			};
+			string dfile;
+			int dpage = 0;
+			if (item.isLine) {
+				if (!document.empty()) {
+					dpage = ddgmr.PutLineList(lines[item.index], linesFound[item.index]);
+					dfile = document;
+				}
+				else if (diagrams) {
+					PSFileDgmr pdgmr;
+					pdgmr.PutLineList(lines[item.index], linesFound[item.index]);
+					dfile = pdgmr.fileName;
+				};
+				jdgmr.PutLineList(lines[item.index], linesFound[item.index], item.input, dfile,
+					dpage);
+			}
+			else {
+				if (!document.empty()) {
+					dpage = ddgmr.PutMarkList(points[item.index], marksFound[item.index]);
+					dfile = document;
+				}
+				else if (diagrams) {
+					PSFileDgmr pdgmr;
+					pdgmr.PutMarkList(points[item.index], marksFound[item.index]);
+					dfile = pdgmr.fileName;
+				};
+				jdgmr.PutMarkList(points[item.index], marksFound[item.index], item.input, dfile,
+					dpage);
+			}
+		}
+	};
+	if (!document.empty() && !ddgmr.WriteDocument(document)) {
+		cerr << "ReferenceFinder: can't write " << document << endl;
+		return false;
+	};
+	return true;
+}
+
+
+/*****
+*
+*	batchMain(int argc, char* argv[]) - parse the command line, then run in batch mode, 
+*	write a report on the construction of the marks and lines, or both. Returns the exit 
+*	status of the program.
+*
+*****/
+
+static int batchMain(int argc, char* argv[])
+{
+	bool batch = false;
+	bool argsOK = true;
+	bool howto = false;
+	bool diagrams = false;
+	int count = 5;
+	double within = 0;
+	bool frontier = false;
+	const char* fileName = 0;
+	string statsName;
+	string document;
+	int resolution = 0;
+	for (int i = 1; i < argc; i++) {
+		string arg(argv[i]);
+		if (arg == "--batch" || arg == "-b") batch = true;
+		else if (arg == "--howto") howto = true;
+		else if (arg == "--diagrams") diagrams = true;
+		else if (arg == "--document" && i + 1 < argc) document = argv[++i];
+		else if (arg == "--count" && i + 1 < argc) count = atoi(argv[++i]);
+		else if (arg == "--within" && i + 1 < argc) within = atof(argv[++i]);
+		else if (arg == "--frontier") frontier = true;
+		else if (arg == "--threads" && i + 1 < argc) 
+			ReferenceFinder::numThreads = atoi(argv[++i]);
+		else if (arg == "--stats" && i + 1 < argc) statsName = argv[++i];
+		else if (arg == "--memory" && i + 1 < argc) 
+			ReferenceFinder::memoryBudget = size_t(atof(argv[++i]) * 1048576.0);
+		else if (arg == "--resolution" && i + 1 < argc) resolution = atoi(argv[++i]);
+		else if (arg == "--seconds" && i + 1 < argc) 
+			ReferenceFinder::maxSeconds = atof(argv[++i]);
+		else if (arg == "--fair") ReferenceFinder::fairShares = true;
+		else if (arg == "--coverage" && i + 1 < argc) 
+			ReferenceFinder::coverageCells = atoi(argv[++i]);
+		else if (arg == "--snapshot" && i + 1 < argc) 
+			ReferenceFinder::snapshotName = argv[++i];
+		else if ((arg.size() > 1 && arg[0] == '-') || fileName) argsOK = false;
+		else fileName = argv[i];
+	};
+	if ((!batch && (statsName.empty() || fileName)) || !argsOK || count < 1 || count > 100 || 
+		within < 0 || 
+		ReferenceFinder::numThreads < 0 || resolution < 0 || 
+		ReferenceFinder::maxSeconds < 0 || ReferenceFinder::coverageCells < 0) {
+		cerr << batchUsage;
+		return 1;
+	};
+	if (resolution > 0) {
+		RefMark::SetDiscretization(resolution, resolution);
+		RefLine::SetDiscretization(resolution, resolution);
+	};
+	
+	ifstream file;
+	if (fileName && string(fileName) != "-") {
+		file.open(fileName);
+		if (!file) {
+			cerr << "ReferenceFinder: can't open " << fileName << endl;
+			return 1;
+		}
+	};
+	
+	ofstream statsFile;
+	if (!statsName.empty()) {
+		statsFile.open(statsName.c_str());
+		if (!statsFile) {
+			cerr << "ReferenceFinder: can't open " << statsName << endl;
+			return 1;
+		};
+		ReferenceFinder::loadSnapshot = false;
+	};
+	
+	ReferenceFinder::SetShowProgress(batchShowProgress);
+	ReferenceFinder::MakeAllMarksAndLines();
+	if (statsFile.is_open()) {
+		bool asCSV = statsName.size() > 4 && statsName.substr(statsName.size() - 4) == ".csv";
+		ReferenceFinder::PutBuildStats(statsFile, asCSV);
+	};
+	if (batch && !runBatch(file.is_open() ? static_cast<istream&>(file) : cin, howto, 
+		diagrams, short(count), within, frontier, document)) return 1;
+	return 0;
+}
+
+
+/*****
+*
+*	backgroundShowProgress(...) - progress callback for a background build, which mustn't
+*	write over the prompts; putSearchedRank() tells the user how far it had got instead.
+*
+*****/
+
+static void backgroundShowProgress(ReferenceFinder::ProgressMsg, ReferenceFinder::rank_t, 
+	void*)
+{
+}
+
+
+/*****
+*
+*	putSearchedRank(rank_t arank) - note that a search only looked at the marks or lines
+*	up through rank arank, if the background build hasn't got through maxRank yet.
+*
+*****/
+
+static void putSearchedRank(ReferenceFinder::rank_t arank)
+{
+	if (arank < ReferenceFinder::maxRank) 
+		cout << "(Searched ranks up through " << arank << " of " << 
+			ReferenceFinder::maxRank << "; the rest are still being built.)" << endl;
+}
+
+
+/******************************
+*
+*	Main program loop
+*
+******************************/
+
+int main(int argc, char* argv[])
+{	
+	// Any arguments at all, other than --background, mean batch mode or a report (or a
+	// usage message).
+	
+	bool background = (argc == 2 && string(argv[1]) == "--background");
+	if (argc > 1 && !background) return batchMain(argc, argv);
+	
+#ifdef __MACOS__
+#ifdef __MWERKS__
+
+	// blow up the SIOUX console window to display more characters and rows.
+	// SIOUX will shrink the console to fit the screen.
+	// Also on quit, close the window.
+	
+	SIOUXSettings.rows = 120;
+	SIOUXSettings.columns = 120;
+	SIOUXSettings.autocloseonquit = true;
+#endif
+#endif
+	
+	cout << "ReferenceFinder v. 3.1" << endl;
+	cout << "Copyright ©1999-2003 by Robert J. Lang. All rights reserved." << endl;
+		
+#ifdef __PROFILER__
+	ProfilerInit(collectDetailed, bestTimeBase, 200, 15);	// Turn on the profiler
+#endif
+
+	if (background) {
+		ReferenceFinder::SetShowProgress(backgroundShowProgress);
+		ReferenceFinder::StartMakingAllMarksAndLines();		// Start on a complete set
+	}
+	else ReferenceFinder::MakeAllMarksAndLines();			// Make a complete set of marks
+
+#ifdef __PROFILER__
+	ProfilerDump("\pReferenceFinder 3.1.prof");				// dump profile info to file
+#endif
+
+	//	Loop forever until the user quits from the menu.
+
+	while (1) {
+		cout << "0 = exit, 1 = find mark, 2 = find line : ";
+		double ns;
+		readNumber(ns, false);
+
+		switch (int(ns)) {
+			case 0:
+				{
+					ReferenceFinder::FinishMakingAllMarksAndLines();
+					exit(1);
+				};
+				break;
+			
+			case 1:
+				{
+					XYPt pp(0, 0);	
+					cout << endl << "Enter x coordinate: ";
+					readNumber (pp.x);
+					cout << "Enter y coordinate: ";
+					readNumber (pp.y);
+					if (ReferenceFinder::ValidateMark(pp)) {
+						vector<RefMark*> vm;
+						ReferenceFinder::rank_t rank;
+						ReferenceFinder::FindBestMarks(pp, vm, 5, rank);
+						
+						// Write verbal directions to the console
+						ConsoleTextDgmr tdgmr;
+						tdgmr.PutMarkList(pp, vm);
+						putSearchedRank(rank);
+						
+						// Also draw Postscript directions to a file
+						PSFileDgmr pdgmr;
+						pdgmr.PutMarkList(pp, vm);
+						cout << "Diagrams in <" << pdgmr.fileName << ">." << endl;
+					}
+				}
+				break;
+		
+			case 2:
+				{
+					XYPt p1, p2;
+					cout << endl << "Enter p1 x coordinate: ";
+					readNumber (p1.x);
+					cout << "Enter p1 y coordinate: ";
+					readNumber (p1.y);
+					cout << endl << "Enter p2 x coordinate: ";
+					readNumber (p2.x);
+					cout << "Enter p2 y coordinate: ";
+					readNumber (p2.y);
+					if (ReferenceFinder::ValidateLine(p1, p2)) {
+						XYLine ll(p1, p2);
+						vector<RefLine*> vl;
+						ReferenceFinder::rank_t rank;
+						ReferenceFinder::FindBestLines(ll, vl, 5, rank);
+						
+						// Write verbal directions to the console
+						ConsoleTextDgmr tdgmr;
+						tdgmr.PutLineList(ll, vl);
+						putSearchedRank(rank);
+						
+						// Also draw Postscript directions to a file
+						PSFileDgmr pdgmr;
+						pdgmr.PutLineList(ll, vl);
+						cout << "Diagrams in <" << pdgmr.fileName << ">." << endl;
+					}
+				}
+				break;			
+			
+			case 97:	// hidden command to build one more rank, with room for twice as many
+				ReferenceFinder::MakeMarksAndLinesOfNextRank(2 * ReferenceFinder::maxLines, 
+					2 * ReferenceFinder::maxMarks);
+				break;
+			
+			case 98:	// hidden command to time searches with and without the indexes
+				ReferenceFinder::FinishMakingAllMarksAndLines();
+				ReferenceFinder::TimeSearches();
+				break;
+			
+			case 99:	// hidden command to calculate statistics on marks
+				ReferenceFinder::FinishMakingAllMarksAndLines();
+				ReferenceFinder::CalcStatistics();
+				break;
+			
+			default:
+				cout << "Enter just 0, 1 or 2, please.\n\n";
+		}
+	};
+	return 0;
+}
@@ -21,11 +21,10 @@ class Lexer {
  public:
   // token classes, other characters returned directly; 0 == eof
   enum {numberTk = 257, wordTk = 258};
-  /* Currently only reads from a string. If generalized, should
-     be constructed from a stream
+  /* Currently only reads from a string, which must outlive the
+     lexer. If generalized, should be constructed from a stream
   */
-  Lexer (const std::string txt) {
-    text = txt;
+  Lexer (const std::string &txt) : text (txt) {
     lastK = -1;
     lexemeStart = current = 0;
     lexeme.erase ();
@@ -37,12 +36,12 @@ class Lexer {
     return lexeme;
   }
  private:
-  /* copy of input source. For most cases extern input remains unchanged
-     during analysis so this could really be a pointer. Also, in the remote
-     chance this class is generalized for other input sources, this
-     member would not be used.
+  /* input source. Extern input remains unchanged during analysis, so
+     there's no need for a copy. Also, in the remote chance this class
+     is generalized for other input sources, this member would not be
+     used.
    */
-  std::string text;
+  const std::string &text;
   /* index of lexeme's start. Currently unused, could be used for smarter
      error recovery (presently RF's parser bails out at first error) */
   std::size_t lexemeStart;
@@ -13,6 +13,7 @@ Copyright (c) 2003 Carlos A. Furuti www.progonos.com/furuti
 
 #include <cmath>	// sin, cos, tan
 #include <cstdlib>	// strtod
+#include <algorithm>	// fill, copy, min
 #include "parser.h"
 
 // some systems don't define those in math.h
@@ -51,77 +52,78 @@ const char *Parser::parseMessage (errType error) {
 std::map <std::string, Parser::id*> Parser::ids;
 bool Parser::idsOk = false;
 
-/* Ordinary recursive descent predictive parser */
+/* initIds: fill in the symbol table with the predefined names, the
+   first time it's needed
+*/
+void Parser::initIds () {
+  if (idsOk)
+    return;
+  idsOk = true;
+  setVariable ("w", 1, false);
+  setVariable ("h", 1, false);
+  setVariable ("d", std::sqrt (2.0), false);
+  ids [std::string("phi")] = new id (num, 0.5 * (std::sqrt (5.0) - 1));
+  ids [std::string("Phi")] = new id (num, 0.5 * (std::sqrt (5.0) + 1));
+  ids [std::string("pi")] = new id (num, M_PI);
+  ids [std::string("e")] = new id (num, M_E);
+  ids [std::string ("sqrt")] = new id (fsqrt);
+  ids [std::string ("sin")] = new id (fsin);
+  ids [std::string ("cos")] = new id (fcos);
+  ids [std::string ("tan")] = new id (ftan);
+  ids [std::string ("deg2rad")] = new id (fdeg2rad);
+}
+
+/* findId: look up identifier
+   Parameters:
+     name: symbol name
+   Returns:
+     identifier record, 0 if name is unknown
+*/
+Parser::id *Parser::findId (const std::string &name) {
+  initIds ();
+  std::map <std::string, id*>::const_iterator it = ids.find (name);
+  return it == ids.end () ? 0 : it -> second;
+}
+
+/* Ordinary recursive descent predictive parser, generating code for
+   the expression as it goes */
 
 /* value: number|var|function(expr)|(expr)
  */
-Parser::errType Parser::value (double &result) {
+Parser::errType Parser::value (Program &prog) {
   errType error;
   switch (nextToken) {
   case Lexer::numberTk:
-    result = std::strtod (lexer -> token ().c_str (), 0);
+    error = prog.emit (Program::op (Program::push, 
+				    std::strtod (lexer -> token ().c_str (), 0)));
     nextToken = lexer -> next ();
-    return none;
+    return error;
   case Lexer::wordTk: {
-    if (! idsOk) {
-      setVariable ("w", 1, false);
-      setVariable ("h", 1, false);
-      setVariable ("d", std::sqrt (2.0), false);
-      ids [std::string("phi")] = new id (num, 0.5 * (std::sqrt (5.0) - 1));
-      ids [std::string("Phi")] = new id (num, 0.5 * (std::sqrt (5.0) + 1));
-      ids [std::string("pi")] = new id (num, M_PI);
-      ids [std::string("e")] = new id (num, M_E);
-      ids [std::string ("sqrt")] = new id (fsqrt);
-      ids [std::string ("sin")] = new id (fsin);
-      ids [std::string ("cos")] = new id (fcos);
-      ids [std::string ("tan")] = new id (ftan);
-      ids [std::string ("deg2rad")] = new id (fdeg2rad);
-      idsOk = true;
-    }
-    id *p = ids [lexer -> token ()];
+    id *p = findId (lexer -> token ());
     if (! p)
       return unknownId;
     if (p -> type == num) { // simple variable
-      result = p -> val;
       nextToken = lexer -> next ();
-      return none;
+      return prog.emit (Program::op (Program::load, 0, p));
     } else { // function call
-      double r1;
       if ((nextToken = lexer -> next ()) != '(')
 	return parExpected;
       nextToken = lexer -> next ();
-      if ((error = expression (r1)) != none)
+      if ((error = expression (prog)) != none)
 	return error;
       if (nextToken != ')')
 	return parExpected;
       nextToken = lexer -> next ();
-      switch (p -> type) {
-      case fsqrt: 
-	if (r1 < 0)
-	  return illegalParameter;
-	result = std::sqrt (r1); break;
-      case fsin: result = std::sin (r1); break;
-      case fcos: result = std::cos (r1); break;
-      case ftan: 
-	if (std::cos (r1) == 0) 
-	  // TODO: should test against an appropriate epsilon
-	  return illegalParameter;
-	result = std::tan (r1); break;
-      case fdeg2rad: result = M_PI * r1 / 180; break;
-      default: return cantHappen;
-      }
-      return none;
+      return prog.emit (Program::op (Program::call, 0, p));
     }
   }
   case '(':
     nextToken = lexer -> next ();
-    double r;
-    if ((error = expression (r)) != none)
+    if ((error = expression (prog)) != none)
       return error;
     if (nextToken != ')')
       return parExpected;
     nextToken = lexer -> next ();
-    result = r;
     return none;
   default:
     return illegalWord;
@@ -130,104 +132,240 @@ Parser::errType Parser::value (double &result) {
 
 /* signedExpr: [+-]?value
  */
-Parser::errType Parser::signedExpr (double &result) {
+Parser::errType Parser::signedExpr (Program &prog) {
   int tokOp = nextToken;
   errType error;
   if (nextToken == '-' || nextToken == '+') {
-    double r1;
     nextToken = lexer -> next ();
-    if ((error = value (r1)) != none)
+    if ((error = value (prog)) != none)
       return error;
-    result = tokOp == '-' ? -r1 : r1;
-    return none;
+    return tokOp == '-' ? prog.emit (Program::op (Program::neg)) : none;
   } else
-    return value (result);
+    return value (prog);
 }
 
 /* factor: signedExpr (^ factor)?
  */
-Parser::errType Parser::factor (double &result) {
-  double r1, r2;
+Parser::errType Parser::factor (Program &prog) {
   errType error;
-  if ((error = signedExpr (r1)) != none)
+  if ((error = signedExpr (prog)) != none)
     return error;
   int tokOp = nextToken;
   if (tokOp == '^') {
     nextToken = lexer -> next ();
-    if ((error = factor (r2)) != none)
+    if ((error = factor (prog)) != none)
       return error;
-    else { // TODO: should test for r1 < 0 and fractionary r2
-      result = std::pow (r1, r2);
-      return none;
-    }
-  } else {
-    result = r1;
+    else // TODO: should test for r1 < 0 and fractionary r2
+      return prog.emit (Program::op (Program::power));
+  } else
     return none;
-  }
 }
 
 /* term: factor ((/|*) factor)*
 */
-Parser::errType Parser::term (double &result) {
-  double r1, r2;
+Parser::errType Parser::term (Program &prog) {
   errType error;
-  if ((error = factor (r1)) != none)
+  if ((error = factor (prog)) != none)
     return error;
-  else {
-    while (1)
-      switch (nextToken) {
-      case '*':
-	nextToken = lexer -> next ();
-	if ((error = factor (r2)) != none)
-	  return error;
-	else
-	  r1 *= r2;
-	break;
-      case '/':
-	nextToken = lexer -> next ();
-	if ((error = factor (r2)) != none)
-	  return error;
-	if (r2 == 0) // should test agains epsilon
-	  return zeroDivide;
-	result = r1 /= r2;
-	break;
-      default:
-	result = r1;
-	return none;
-      }
-    result = r1;
-    return none;
-  }
+  while (1)
+    switch (nextToken) {
+    case '*':
+      nextToken = lexer -> next ();
+      if ((error = factor (prog)) != none || 
+	  (error = prog.emit (Program::op (Program::mul))) != none)
+	return error;
+      break;
+    case '/':
+      nextToken = lexer -> next ();
+      if ((error = factor (prog)) != none || 
+	  (error = prog.emit (Program::op (Program::quot))) != none)
+	return error;
+      break;
+    default:
+      return none;
+    }
 }
 
 /* expression: term ([+-] term)*
  */
-Parser::errType Parser::expression (double &result) {
-  double r1, r2;
+Parser::errType Parser::expression (Program &prog) {
   errType error;
-  if ((error = term (r1)) != none)
+  if ((error = term (prog)) != none)
     return error;
   while (1)
     switch (nextToken) {
     case '+':
       nextToken = lexer -> next ();
-      if ((error = term (r2)) != none)
+      if ((error = term (prog)) != none || 
+	  (error = prog.emit (Program::op (Program::add))) != none)
 	return error;
-      else
-	r1 += r2;
       break;
     case '-':
       nextToken = lexer -> next ();
-      if ((error = term (r2)) != none)
+      if ((error = term (prog)) != none || 
+	  (error = prog.emit (Program::op (Program::sub))) != none)
 	return error;
-      else
-	r1 -= r2;
       break;
     default:
-      result = r1;
       return none;
     }
-  result = r1;
+}
+
+/* Program::clear: forget code
+ */
+void Parser::Program::clear () {
+  code.clear ();
+  depth = height = 0;
+}
+
+/* Program::emit: append an operation to the code, keeping track of
+   the stack it needs. Operations whose operands are all constants are
+   carried out right away instead.
+   Parameters:
+     o: operation
+   Returns:
+     <none> if no error was found, otherwise error code
+*/
+Parser::errType Parser::Program::emit (const op &o) {
+  std::size_t n = code.size ();
+  switch (o.type) {
+  case push:
+  case load:
+    code.push_back (o);
+    if (++height > depth)
+      depth = height;
+    return none;
+  case neg:
+  case call:
+    if (code [n - 1].type == push)
+      return apply (o, code [n - 1].val, 0);
+    code.push_back (o);
+    return none;
+  default: // binary operator
+    height--;
+    if (n >= 2 && code [n - 1].type == push && code [n - 2].type == push) {
+      double b = code [n - 1].val;
+      code.pop_back ();
+      return apply (o, code [n - 2].val, b);
+    }
+    code.push_back (o);
+    return none;
+  }
+}
+
+/* apply: carry out one operation
+   Parameters:
+     o: operation
+     a: left operand, or only operand; replaced by the result
+     b: right operand, if any
+   Returns:
+     <none> if no error was found, otherwise error code
+*/
+Parser::errType Parser::apply (const Program::op &o, double &a, double b) {
+  switch (o.type) {
+  case Program::neg: a = -a; return none;
+  case Program::add: a += b; return none;
+  case Program::sub: a -= b; return none;
+  case Program::mul: a *= b; return none;
+  case Program::quot:
+    if (b == 0) // should test agains epsilon
+      return zeroDivide;
+    a /= b; return none;
+  case Program::power: a = std::pow (a, b); return none;
+  case Program::call:
+    switch (o.var -> type) {
+    case fsqrt: 
+      if (a < 0)
+	return illegalParameter;
+      a = std::sqrt (a); return none;
+    case fsin: a = std::sin (a); return none;
+    case fcos: a = std::cos (a); return none;
+    case ftan: 
+      if (std::cos (a) == 0) 
+	// TODO: should test against an appropriate epsilon
+	return illegalParameter;
+      a = std::tan (a); return none;
+    case fdeg2rad: a = M_PI * a / 180; return none;
+    case num: return notAFunction; // made a variable since compiling
+    default: return cantHappen;
+    }
+  default:
+    return cantHappen;
+  }
+}
+
+/* exec: run compiled code for count values at once, keeping count
+   values in each stack entry. Arithmetic is done an operation at a
+   time over all of them, in loops the compiler can vectorize.
+   Parameters:
+     prog: compiled expression
+     swept: variable that takes a different value for each result, if any
+     first, step, start: the i-th result has swept = first + (start + i) * step
+     count: number of results
+     results: where the results go
+   Returns:
+     <none> if no error was found, otherwise error code
+*/
+Parser::errType Parser::exec (const Program &prog, const id *swept, 
+			      double first, double step, std::size_t start, 
+			      std::size_t count, double *results) {
+  std::vector<double> &stack = prog.stack;
+  if (stack.size () < prog.depth * count)
+    stack.resize (prog.depth * count);
+  std::size_t sp = 0; // number of stack entries
+  errType error;
+  for (std::size_t k = 0; k < prog.code.size (); k++) {
+    const Program::op &o = prog.code [k];
+    double *a, *b;
+    switch (o.type) {
+    case Program::push:
+      a = &stack [sp++ * count];
+      std::fill (a, a + count, o.val);
+      break;
+    case Program::load:
+      a = &stack [sp++ * count];
+      if (o.var == swept)
+	for (std::size_t i = 0; i < count; i++)
+	  a [i] = first + double (start + i) * step;
+      else
+	std::fill (a, a + count, o.var -> val);
+      break;
+    case Program::neg:
+    case Program::call:
+      a = &stack [(sp - 1) * count];
+      for (std::size_t i = 0; i < count; i++)
+	if ((error = apply (o, a [i], 0)) != none)
+	  return error;
+      break;
+    case Program::add:
+      a = &stack [(--sp - 1) * count];
+      b = a + count;
+      for (std::size_t i = 0; i < count; i++)
+	a [i] += b [i];
+      break;
+    case Program::sub:
+      a = &stack [(--sp - 1) * count];
+      b = a + count;
+      for (std::size_t i = 0; i < count; i++)
+	a [i] -= b [i];
+      break;
+    case Program::mul:
+      a = &stack [(--sp - 1) * count];
+      b = a + count;
+      for (std::size_t i = 0; i < count; i++)
+	a [i] *= b [i];
+      break;
+    default:
+      a = &stack [(--sp - 1) * count];
+      b = a + count;
+      for (std::size_t i = 0; i < count; i++)
+	if ((error = apply (o, a [i], b [i])) != none)
+	  return error;
+    }
+  }
+  if (sp != 1)
+    return cantHappen;
+  std::copy (stack.begin (), stack.begin () + count, results);
   return none;
 }
 
@@ -240,27 +378,84 @@ Parser::errType Parser::expression (double &result) {
    Returns:
      <none> if no error was found, otherwise error code
 */
-Parser::errType Parser::evaluate (std::string str, double &result,
+Parser::errType Parser::evaluate (const std::string &str, double &result,
 				  bool useDefault, 
 				  double defaultValue) {
-  lexer = new Lexer (str);
-  if (! (nextToken = lexer -> next ())) { // already end of text
-    if (useDefault) {
-      result = defaultValue;
-      return none;
-    }
-    else
-      return emptyInput;
-  }  
-  double r;
-  errType err = expression (r);
-  if (nextToken && err == none)
-    err = extraInput;
-  if (err == none)
-    result = r;
+  errType err = compile (str, scratch);
+  if (err == emptyInput && useDefault) {
+    result = defaultValue;
+    return none;
+  }
+  if (err != none)
+    return err;
+  return run (scratch, result);
+}
+
+/* compile: parse expression into code that can be evaluated many times
+   Parameters:
+     str: text to parse
+     prog: compiled expression if no error found
+   Returns:
+     <none> if no error was found, otherwise error code
+*/
+Parser::errType Parser::compile (const std::string &str, Program &prog) {
+  Lexer lex (str);
+  lexer = &lex;
+  prog.clear ();
+  errType err;
+  if (! (nextToken = lexer -> next ())) // already end of text
+    err = emptyInput;
+  else {
+    err = expression (prog);
+    if (nextToken && err == none)
+      err = extraInput;
+  }
+  lexer = 0;
+  if (err != none)
+    prog.clear ();
   return err;
 }
 
+/* run: evaluate compiled expression with the current variable values
+   Parameters:
+     prog: compiled expression
+     result: result if no error found
+   Returns:
+     <none> if no error was found, otherwise error code
+*/
+Parser::errType Parser::run (const Program &prog, double &result) {
+  return exec (prog, 0, 0, 0, 0, 1, &result);
+}
+
+/* sweep: evaluate compiled expression for a range of values of one
+   variable, the others keeping their current values. The variable
+   itself is left unchanged.
+   Parameters:
+     prog: compiled expression
+     name: variable to sweep
+     first: first value of variable
+     step: increment of variable
+     count: number of values
+     results: count results, if no error found
+   Returns:
+     <none> if no error was found, otherwise first error code
+*/
+Parser::errType Parser::sweep (const Program &prog, const std::string &name, 
+			       double first, double step, std::size_t count, 
+			       std::vector<double> &results) {
+  const std::size_t block = 256; // values evaluated at a time
+  id *p = findId (name);
+  if (! p || p -> type != num)
+    return unknownId;
+  results.resize (count);
+  errType error;
+  for (std::size_t i = 0; i < count; i += block)
+    if ((error = exec (prog, p, first, step, i, std::min (block, count - i), 
+		       &results [i])) != none)
+      return error;
+  return none;
+}
+
 /* setVariable: create or update variable
    Parameters:
      name: symbol name
@@ -17,6 +17,7 @@ Copyright (c) 2003 Carlos A. Furuti www.progonos.com/furuti
 
 #include <string>
 #include <map>
+#include <vector>
 #include "lexer.h"
 
 class Parser {
@@ -34,10 +35,21 @@ class Parser {
 		illegalParameter, // illegal function parameter
 		cantHappen}; // internal error
   
+  // compiled expression, see below
+  class Program;
+  
   // parse string and evaluate expression
-  errType evaluate (std::string text, double &result, 
+  errType evaluate (const std::string &text, double &result, 
 		    bool useDefault = false, 
 		    double defaultValue = 0);
+  // parse string once, for evaluating many times with run or sweep
+  errType compile (const std::string &text, Program &prog);
+  // evaluate compiled expression with current variable values
+  static errType run (const Program &prog, double &result);
+  // evaluate compiled expression for count values of a variable
+  static errType sweep (const Program &prog, const std::string &name, 
+			double first, double step, std::size_t count, 
+			std::vector<double> &results);
   // map error codes to strings
   static const char *parseMessage (errType);
   // updates or creates numerical variable
@@ -46,12 +58,12 @@ class Parser {
 
   // currently the identifier dictionary is shared
  private:
-  Lexer *lexer;
-  errType value (double &result);
-  errType signedExpr (double &result);
-  errType factor (double &);
-  errType term (double &);
-  errType expression (double &);
+  Lexer *lexer; // current input, only while compiling
+  errType value (Program &);
+  errType signedExpr (Program &);
+  errType factor (Program &);
+  errType term (Program &);
+  errType expression (Program &);
   int nextToken; // current token
 
   /* Identifier dictionary, shared by all instances. In ReferenceFinder
@@ -72,6 +84,46 @@ class Parser {
   // identifier table
   static std::map <std::string, id*> ids;
   static bool idsOk;
+  static void initIds ();
+  static id *findId (const std::string &name);
+
+  friend class Program;
+  
+ public:
+  /* Compiled expression: code for a small stack machine. Variables and
+     functions are referred to by their identifier records, so evaluating
+     sees the latest values from setVariable; subexpressions without
+     variables are evaluated once, while compiling.
+  */
+  class Program {
+  public:
+    Program () : depth (0), height (0) {}
+    bool empty () const {
+      return code.empty ();
+    }
+  private:
+    friend class Parser;
+    enum opType {push, load, neg, add, sub, mul, quot, power, call};
+    struct op {
+      opType type;
+      double val; // constant, for push
+      id *var; // variable or function, for load and call
+      op (opType t, double v = 0, id *p = 0) : type (t), val (v), var (p) {}
+    };
+    std::vector<op> code;
+    int depth; // deepest stack needed
+    int height; // stack depth at end of code, while compiling
+    mutable std::vector<double> stack; // evaluation stack
+    void clear ();
+    errType emit (const op &);
+  };
+
+ private:
+  Program scratch; // compiled form of text being evaluated
+  static errType apply (const Program::op &, double &a, double b);
+  static errType exec (const Program &prog, const id *swept, 
+		       double first, double step, std::size_t start, 
+		       std::size_t count, double *results);
 };
 
 #endif